@@ -0,0 +1,337 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Adts.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Adts.h"
+#include "Id3.h"
+#include "Pcm.h"
+
+#include <string.h>
+
+static const UINT32 adts_sample_rates[] =
+{
+    96000, 88200, 64000, 48000, 44100, 32000,
+    24000, 22050, 16000, 12000, 11025, 8000, 7350
+};
+
+UINT32 AdtsSampleRate(UINT32 index)
+{
+    return index < ARRAYSIZE(adts_sample_rates) ? adts_sample_rates[index] : 0;
+}
+
+BOOL IsAdtsHeader(const BYTE *pData, DWORD cb)
+{
+    return cb >= 2 && pData[0] == 0xFF && (pData[1] & 0xF6) == 0xF0;
+}
+
+HRESULT ParseAdtsHeader(const BYTE *pData, DWORD cb, AdtsHeader *pHeader)
+{
+    if (!pData || !pHeader)
+    {
+        return E_POINTER;
+    }
+
+    if (cb < ADTS_HEADER_SIZE || !IsAdtsHeader(pData, cb))
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    BOOL fNoCrc = pData[1] & 0x01;
+
+    pHeader->profile = pData[2] >> 6;
+    pHeader->sampleRateIndex = (pData[2] >> 2) & 0x0F;
+    pHeader->sampleRate = AdtsSampleRate(pHeader->sampleRateIndex);
+    pHeader->channels = ((pData[2] & 0x01) << 2) | (pData[3] >> 6);
+    pHeader->cbHeader = fNoCrc ? ADTS_HEADER_SIZE : ADTS_HEADER_SIZE + 2;
+    pHeader->cbFrame = ((pData[3] & 0x03) << 11) | (pData[4] << 3) | (pData[5] >> 5);
+    pHeader->cRawBlocks = (pData[6] & 0x03) + 1;
+
+    if (pHeader->sampleRate == 0 || pHeader->cbFrame < pHeader->cbHeader)
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+    return S_OK;
+}
+
+HRESULT WriteAdtsHeader(const AdtsHeader &header, BYTE *pData)
+{
+    if (!pData)
+    {
+        return E_POINTER;
+    }
+
+    if (header.profile > 3 || header.sampleRateIndex >= ARRAYSIZE(adts_sample_rates) ||
+        header.channels > 7 || header.cRawBlocks < 1 || header.cRawBlocks > 4 ||
+        header.cbFrame < ADTS_HEADER_SIZE || header.cbFrame > ADTS_MAX_FRAME_SIZE)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    pData[0] = 0xFF;
+    pData[1] = 0xF1;                                // MPEG-4, no CRC
+    pData[2] = (BYTE)((header.profile << 6) | (header.sampleRateIndex << 2) | (header.channels >> 2));
+    pData[3] = (BYTE)(((header.channels & 0x03) << 6) | (header.cbFrame >> 11));
+    pData[4] = (BYTE)(header.cbFrame >> 3);
+    pData[5] = (BYTE)(((header.cbFrame & 0x07) << 5) | 0x1F);  // Buffer fullness 0x7FF: variable rate
+    pData[6] = (BYTE)(0xFC | (header.cRawBlocks - 1));
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  CAdtsReader
+//-------------------------------------------------------------------
+
+CAdtsReader::CAdtsReader() : m_pFile(NULL), m_cbStart(0), m_cbPosition(0), m_iSample(0)
+{
+    memset(&m_first, 0, sizeof(m_first));
+}
+
+CAdtsReader::~CAdtsReader()
+{
+    Close();
+}
+
+void CAdtsReader::Close()
+{
+    m_pFile = NULL;
+    m_file.Close();
+}
+
+//-------------------------------------------------------------------
+//  Open
+//
+//  Opens the file and parses the first frame header. An ID3v2 tag in
+//  front of the first frame is skipped.
+//-------------------------------------------------------------------
+
+HRESULT CAdtsReader::Open(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    Close();
+
+    HRESULT hr = m_file.Open(sPath);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Open(&m_file);
+    }
+
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+HRESULT CAdtsReader::Open(CMappedFile *pFile)
+{
+    if (!pFile)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (pFile != &m_file)
+    {
+        Close();
+    }
+
+    m_pFile = pFile;
+
+    const BYTE *pHeader = NULL;
+    DWORD cbHeader = 0;
+
+    m_cbStart = 0;
+    m_iSample = 0;
+
+    HRESULT hr = m_pFile->View(0, ID3_HEADER_SIZE, &pHeader, &cbHeader);
+
+    if (SUCCEEDED(hr) && cbHeader != ID3_HEADER_SIZE)
+    {
+        hr = MF_E_UNSUPPORTED_BYTESTREAM_TYPE;
+    }
+
+    if (SUCCEEDED(hr) && Id3TagSize(pHeader, cbHeader) > 0)
+    {
+        m_cbStart = Id3TagSize(pHeader, cbHeader);
+
+        hr = m_pFile->View(m_cbStart, ADTS_HEADER_SIZE, &pHeader, &cbHeader);
+    }
+
+    if (SUCCEEDED(hr) && !IsAdtsHeader(pHeader, cbHeader))
+    {
+        hr = MF_E_UNSUPPORTED_BYTESTREAM_TYPE;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = ParseAdtsHeader(pHeader, cbHeader, &m_first);
+    }
+
+    m_cbPosition = m_cbStart;
+
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  SkipToSample
+//
+//  Positions the reader at the frame that contains sample iTarget, or
+//  at the end of the stream. Every frame carries 1024 samples per raw
+//  data block, so the position advances without decoding.
+//-------------------------------------------------------------------
+
+HRESULT CAdtsReader::SkipToSample(UINT64 iTarget)
+{
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    m_cbPosition = m_cbStart;
+    m_iSample = 0;
+
+    while (m_iSample < iTarget)
+    {
+        const BYTE *pHeader = NULL;
+        DWORD cbHeader = 0;
+        AdtsHeader frame;
+
+        HRESULT hr = m_pFile->View(m_cbPosition, ADTS_HEADER_SIZE, &pHeader, &cbHeader);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        if (cbHeader != ADTS_HEADER_SIZE)
+        {
+            break;
+        }
+
+        hr = ParseAdtsHeader(pHeader, cbHeader, &frame);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        UINT64 cSamples = (UINT64)frame.cRawBlocks * ADTS_SAMPLES_PER_FRAME;
+
+        if (m_iSample + cSamples > iTarget)
+        {
+            break;  // This frame contains the target; read it next.
+        }
+
+        m_iSample += cSamples;
+        m_cbPosition += frame.cbFrame;
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  SeekToTime
+//
+//  The position is counted in samples, so frame boundaries stay exact
+//  however long the stream is.
+//-------------------------------------------------------------------
+
+HRESULT CAdtsReader::SeekToTime(LONGLONG hnsStart)
+{
+    return SkipToSample(HnsToSamples(hnsStart, m_first.sampleRate));
+}
+
+HRESULT CAdtsReader::GetDuration(LONGLONG *phnsDuration)
+{
+    if (!phnsDuration)
+    {
+        return E_POINTER;
+    }
+
+    if (m_pFile && m_pFile->IsStream())
+    {
+        *phnsDuration = 0;
+        return S_OK;
+    }
+
+    UINT64 cbPosition = m_cbPosition;
+    UINT64 iSample = m_iSample;
+
+    HRESULT hr = SkipToSample((UINT64)-1);
+
+    if (SUCCEEDED(hr))
+    {
+        *phnsDuration = SamplesToHns(m_iSample, m_first.sampleRate);
+    }
+
+    m_cbPosition = cbPosition;
+    m_iSample = iSample;
+
+    return hr;
+}
+
+HRESULT CAdtsReader::ReadFrame(const BYTE **ppFrame, DWORD *pcbFrame, AdtsHeader *pHeader)
+{
+    if (!ppFrame || !pcbFrame || !pHeader)
+    {
+        return E_POINTER;
+    }
+
+    *ppFrame = NULL;
+    *pcbFrame = 0;
+
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    const BYTE *pFrame = NULL;
+    DWORD cbRead = 0;
+
+    HRESULT hr = m_pFile->View(m_cbPosition, ADTS_HEADER_SIZE, &pFrame, &cbRead);
+
+    if (FAILED(hr) || cbRead == 0)
+    {
+        return hr;      // End of stream
+    }
+
+    if (cbRead != ADTS_HEADER_SIZE)
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    hr = ParseAdtsHeader(pFrame, cbRead, pHeader);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pFile->View(m_cbPosition, pHeader->cbFrame, &pFrame, &cbRead);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        if (cbRead != pHeader->cbFrame)
+        {
+            // A truncated last frame ends the stream.
+            return S_OK;
+        }
+
+        *ppFrame = pFrame;
+        *pcbFrame = pHeader->cbFrame;
+        m_cbPosition += pHeader->cbFrame;
+        m_iSample += (UINT64)pHeader->cRawBlocks * ADTS_SAMPLES_PER_FRAME;
+    }
+    return hr;
+}
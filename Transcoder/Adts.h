@@ -0,0 +1,101 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Adts.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// ADTS (Audio Data Transport Stream) frame parsing for the portable
+// backend.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "MappedFile.h"
+
+#define ADTS_HEADER_SIZE        7       // Without CRC
+#define ADTS_MAX_FRAME_SIZE     8191    // 13-bit frame length
+#define ADTS_SAMPLES_PER_FRAME  1024
+
+struct AdtsHeader
+{
+    UINT32  profile;            // AAC object type - 1
+    UINT32  sampleRateIndex;
+    UINT32  sampleRate;
+    UINT32  channels;           // Channel configuration
+    UINT32  cbHeader;           // 7, or 9 with CRC
+    UINT32  cbFrame;            // Header and payload
+    UINT32  cRawBlocks;         // Raw data blocks in the frame
+};
+
+// Returns TRUE if the first cb bytes start with an ADTS sync word.
+BOOL    IsAdtsHeader(const BYTE *pData, DWORD cb);
+
+// Parses the fixed and variable header at pData.
+HRESULT ParseAdtsHeader(const BYTE *pData, DWORD cb, AdtsHeader *pHeader);
+
+// Formats the 7-byte header, without CRC, of a frame of cbFrame bytes
+// and cRawBlocks raw data blocks, taking the other fields from header.
+HRESULT WriteAdtsHeader(const AdtsHeader &header, BYTE *pData);
+
+// Maps an ADTS sampling frequency index to Hz. Returns 0 for reserved
+// indices.
+UINT32  AdtsSampleRate(UINT32 index);
+
+//-------------------------------------------------------------------
+//  CAdtsReader
+//
+//  Reads an ADTS stream one frame at a time.
+//-------------------------------------------------------------------
+
+class CAdtsReader
+{
+public:
+    CAdtsReader();
+    ~CAdtsReader();
+
+    HRESULT Open(const WCHAR *sPath);
+
+    // Reads from pFile, which the caller keeps open until Close.
+    HRESULT Open(CMappedFile *pFile);
+    void    Close();
+
+    // Header of the first frame.
+    const AdtsHeader& Format() const { return m_first; }
+
+    // Skips whole frames until the frame that contains hnsStart.
+    HRESULT SeekToTime(LONGLONG hnsStart);
+
+    // Sample position of the next frame.
+    UINT64  Position() const { return m_iSample; }
+
+    // Bytes from the first frame to the end of the file; 0 if the
+    // input is a stream.
+    UINT64  StreamSize() const { return m_pFile->IsStream() ? 0 : m_pFile->Size() - m_cbStart; }
+
+    // Walks the frame headers to the end of the stream. The read
+    // position is kept. The duration of an input stream, which cannot
+    // be walked and then read again, is 0.
+    HRESULT GetDuration(LONGLONG *phnsDuration);
+
+    // Points *ppFrame at the next frame, header included, in the file's
+    // mapping. *pcbFrame is 0 at the end of the stream. The frame stays
+    // valid until the next ReadFrame.
+    HRESULT ReadFrame(const BYTE **ppFrame, DWORD *pcbFrame, AdtsHeader *pHeader);
+
+private:
+
+    HRESULT SkipToSample(UINT64 iTarget);
+
+    CMappedFile m_file;         // If opened by path
+    CMappedFile* m_pFile;       // m_file or the caller's
+    AdtsHeader  m_first;
+    UINT64      m_cbStart;      // Offset of the first frame
+    UINT64      m_cbPosition;   // Offset of the next frame
+    UINT64      m_iSample;      // Sample position of the next frame
+};
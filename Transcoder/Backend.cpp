@@ -0,0 +1,56 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Backend.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Backend.h"
+
+//-------------------------------------------------------------------
+//  CreateMediaBackend
+//
+//  Creates the backend selected by name.
+//-------------------------------------------------------------------
+
+HRESULT CreateMediaBackend(const WCHAR *sName, IMediaBackend **ppBackend)
+{
+    if (!ppBackend)
+    {
+        return E_POINTER;
+    }
+
+    *ppBackend = NULL;
+
+    if (sName == NULL)
+    {
+#ifdef _WIN32
+        sName = L"mf";
+#else
+        sName = L"portable";
+#endif
+    }
+
+#ifdef _WIN32
+    if (_wcsicmp(sName, L"mf") == 0)
+    {
+        return CreateMFBackend(ppBackend);
+    }
+#endif
+
+    if (_wcsicmp(sName, L"portable") == 0)
+    {
+        return CreatePortableBackend(FALSE, ppBackend);
+    }
+
+    if (_wcsicmp(sName, L"fake") == 0)
+    {
+        return CreatePortableBackend(TRUE, ppBackend);
+    }
+
+    return E_INVALIDARG;
+}
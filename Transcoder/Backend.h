@@ -0,0 +1,201 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Backend.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Media backend interface. CTranscoder drives a transcode session
+// through ITranscodeSession; the backend decides how the session is
+// implemented:
+//
+//  mf        Media Foundation (Windows only).
+//  portable  In-process C++ pipeline: WAV/PCM, ADTS and MP3 stream paths.
+//  fake      Deterministic simulated session that produces synthetic
+//            output of the expected size, for orchestration tests and
+//            throughput measurements without real codecs.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "Formats.h"
+#include "OutputSink.h"
+
+// Outputs one session can write, the main output included.
+#define SESSION_MAX_OUTPUTS     8
+
+// Session events, raised in this order for a successful job. Mirrors
+// the MESession* events of the Media Foundation media session.
+enum SessionEventType
+{
+    SessionEvent_TopologySet,
+    SessionEvent_Started,
+    SessionEvent_Ended,
+    SessionEvent_Closed,
+    SessionEvent_Other,         // Any event the transcoder does not act on.
+};
+
+struct SessionEvent
+{
+    SessionEventType    type;
+    HRESULT             hrStatus;   // Status carried by the event.
+};
+
+// What a session knows about its source and output once the audio is
+// configured.
+struct MediaInfo
+{
+    LONGLONG    hnsDuration;        // Source duration; 0 if unknown.
+    UINT32      audioSampleRate;    // Sample rate of the output audio.
+    UINT32      cCopyFrameSamples;  // Samples per source frame if its compressed
+                                    // frames can be copied; 0 otherwise.
+};
+
+// Lookups of a backend's cache of transcode profile settings.
+struct ProfileCacheStats
+{
+    UINT64      cHits;
+    UINT64      cMisses;            // Settings built for the lookup.
+};
+
+//-------------------------------------------------------------------
+//  ISessionEventCallback
+//
+//  Completion of ITranscodeSession::BeginGetEvent. Called once per
+//  request on a backend thread, never from inside BeginGetEvent. hr
+//  is the result of getting the event; pEvent is valid only if hr
+//  succeeded. Implementations should return quickly.
+//-------------------------------------------------------------------
+
+class ISessionEventCallback
+{
+public:
+    virtual ~ISessionEventCallback() {}
+
+    virtual void OnSessionEvent(HRESULT hr, const SessionEvent &event) = 0;
+};
+
+//-------------------------------------------------------------------
+//  ITranscodeSession
+//
+//  One transcode job: a media source, a transcode profile and the
+//  session that runs the topology built from them.
+//-------------------------------------------------------------------
+
+class ITranscodeSession
+{
+public:
+    virtual ~ITranscodeSession() {}
+
+    // Creates the media source for sURL.
+    virtual HRESULT OpenSource(const WCHAR *sURL) = 0;
+
+    // Creates the media source for cbData bytes at pData, a file held
+    // in memory. The caller keeps them valid until Shutdown.
+    virtual HRESULT OpenSourceMemory(const BYTE *pData, UINT64 cbData) = 0;
+
+    // Store the stream and container settings of pFormat in the profile.
+    virtual HRESULT ConfigureAudio(const OutputFormat *pFormat) = 0;
+    virtual HRESULT ConfigureVideo(const OutputFormat *pFormat) = 0;
+    virtual HRESULT ConfigureContainer(const OutputFormat *pFormat) = 0;
+
+    // Allows SetOutput to copy source streams whose codec already
+    // matches the output format into the new container without
+    // decoding them. Allowed by default.
+    virtual HRESULT SetStreamCopy(BOOL fAllow) = 0;
+
+    // Converts the audio to sampleRate (Hz) instead of keeping the rate
+    // of the source. 0 keeps the source rate. Streams are not copied
+    // when their rate changes. Call before ConfigureAudio.
+    virtual HRESULT SetSampleRate(UINT32 sampleRate) = 0;
+
+    // Ends the session at hnsStop (100-nanosecond units) instead of at
+    // the end of the source. 0 runs to the end. Call before SetOutput.
+    virtual HRESULT SetStopTime(LONGLONG hnsStop) = 0;
+
+    // Valid after ConfigureAudio.
+    virtual HRESULT GetMediaInfo(MediaInfo *pInfo) = 0;
+
+    // Presentation time the session has reached in the source
+    // (100-nanosecond units). Valid from Start until Close; it may be
+    // called from any thread and does not wait for the session's work.
+    virtual HRESULT GetPosition(LONGLONG *phnsPosition) = 0;
+
+    // Adds an output in pFormat, written to sURL from the same decoded
+    // source as the main output, so the source is decoded once for
+    // all of them. Call after the Configure methods and before
+    // SetOutput, which creates every output.
+    virtual HRESULT AddOutput(const OutputFormat *pFormat, const WCHAR *sURL) = 0;
+
+    // Builds the transcode topology for the output URL and sets it on
+    // the session. Raises SessionEvent_TopologySet.
+    virtual HRESULT SetOutput(const WCHAR *sURL) = 0;
+
+    // As SetOutput, writing the main output to pSink instead of a file.
+    // The caller keeps pSink until Shutdown.
+    virtual HRESULT SetOutputSink(IOutputSink *pSink) = 0;
+
+    // Starts the session at hnsStart (100-nanosecond units).
+    virtual HRESULT Start(LONGLONG hnsStart) = 0;
+
+    // Requests the next session event. pCallback is called when it is
+    // available. Only one request may be outstanding at a time.
+    virtual HRESULT BeginGetEvent(ISessionEventCallback *pCallback) = 0;
+
+    // Closes the session and finalizes the output. Raises SessionEvent_Closed.
+    virtual HRESULT Close() = 0;
+
+    // Shuts down the source and the session. Synchronous, no events.
+    // Work the backend runs for the session has finished on return.
+    virtual HRESULT Shutdown() = 0;
+
+    // Readies a new or shut down session for another job, as if it had
+    // just been created, and creates ahead what the next OpenSource
+    // needs. What does not depend on the source, such as a transcode
+    // profile, is kept and reused when the next job configures the
+    // same output format. See CSessionPool.
+    virtual HRESULT Reset() = 0;
+};
+
+//-------------------------------------------------------------------
+//  IMediaBackend
+//-------------------------------------------------------------------
+
+class IMediaBackend
+{
+public:
+    virtual ~IMediaBackend() {}
+
+    virtual const WCHAR* GetName() const = 0;
+
+    // Keeps state that is expensive to compute, such as encoder
+    // capabilities, in sPath between runs. Loaded by Startup and saved
+    // by Shutdown. Backends without such state ignore it.
+    virtual HRESULT SetCacheFile(const WCHAR *sPath) = 0;
+
+    // Process-wide startup and shutdown (MFStartup/MFShutdown).
+    virtual HRESULT Startup() = 0;
+    virtual HRESULT Shutdown() = 0;
+
+    virtual HRESULT CreateSession(ITranscodeSession **ppSession) = 0;
+
+    // Lookups of the profile settings cache since Startup. Backends
+    // without profiles report none.
+    virtual HRESULT GetProfileCacheStats(ProfileCacheStats *pStats) = 0;
+};
+
+// Creates a backend by name (L"mf", L"portable" or L"fake"). A NULL
+// name selects the platform default: Media Foundation on Windows and
+// the portable backend elsewhere.
+HRESULT CreateMediaBackend(const WCHAR *sName, IMediaBackend **ppBackend);
+
+HRESULT CreatePortableBackend(BOOL fFake, IMediaBackend **ppBackend);
+
+#ifdef _WIN32
+HRESULT CreateMFBackend(IMediaBackend **ppBackend);
+#endif
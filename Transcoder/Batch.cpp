@@ -0,0 +1,461 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Batch.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Batch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <errno.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+//-------------------------------------------------------------------
+//  CBatch constructor
+//-------------------------------------------------------------------
+
+CBatch::CBatch() :
+    m_pJobs(NULL),
+    m_cJobs(0),
+    m_cAllocated(0),
+    m_cInFlight(0)
+{
+
+}
+
+//-------------------------------------------------------------------
+//  CBatch destructor
+//-------------------------------------------------------------------
+
+CBatch::~CBatch()
+{
+    free(m_pJobs);
+}
+
+//-------------------------------------------------------------------
+//  Grow
+//
+//  Makes room for at least one more job.
+//-------------------------------------------------------------------
+
+HRESULT CBatch::Grow()
+{
+    if (m_cJobs < m_cAllocated)
+    {
+        return S_OK;
+    }
+
+    DWORD cNew = m_cAllocated ? m_cAllocated * 2 : 64;
+
+    BatchJob *pJobs = (BatchJob*)realloc(m_pJobs, cNew * sizeof(BatchJob));
+    if (pJobs == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    m_pJobs = pJobs;
+    m_cAllocated = cNew;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  AddJob
+//
+//  Appends one input/output pair to the batch. An output that is the
+//  input file, as a derived name in the input directory can be, is
+//  refused.
+//-------------------------------------------------------------------
+
+HRESULT CBatch::AddJob(const WCHAR *sInputFile, const WCHAR *sOutputFile)
+{
+    if (!sInputFile || !sOutputFile)
+    {
+        return E_INVALIDARG;
+    }
+
+    // Creating the output would truncate the input.
+    if (IsSameFile(sInputFile, sOutputFile))
+    {
+        wprintf_s(L"Output %ls is the input file.\n", sOutputFile);
+        return HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION);
+    }
+
+    HRESULT hr = Grow();
+
+    if (SUCCEEDED(hr))
+    {
+        BatchJob *pJob = &m_pJobs[m_cJobs];
+
+        if (wcscpy_s(pJob->szInput, MAX_PATH, sInputFile) != 0 ||
+            wcscpy_s(pJob->szOutput, MAX_PATH, sOutputFile) != 0)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+        }
+        else
+        {
+            pJob->hr = E_PENDING;
+            pJob->pBatch = this;
+            m_cJobs++;
+        }
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  AddDerivedJob
+//
+//  Appends a job whose output name is the input file name, without
+//  directory or extension, placed in sOutputDir with sExtension.
+//-------------------------------------------------------------------
+
+HRESULT CBatch::AddDerivedJob(const WCHAR *sInputFile, const WCHAR *sOutputDir, const WCHAR *sExtension)
+{
+    WCHAR szOutput[MAX_PATH];
+
+    size_t iName, iExtension;
+    SplitPathName(sInputFile, &iName, &iExtension);
+
+    int cch = swprintf_s(szOutput, MAX_PATH, L"%ls%lc%.*ls%ls",
+        sOutputDir, PATH_SEPARATOR, (int)(iExtension - iName), sInputFile + iName, sExtension);
+
+    if (cch < 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    return AddJob(sInputFile, szOutput);
+}
+
+//-------------------------------------------------------------------
+//  ReadManifestLine
+//
+//  Reads one line of the manifest as a wide string. On Windows the
+//  CRT decodes UTF-8; elsewhere the line is converted with the
+//  current locale, which main() sets from the environment.
+//-------------------------------------------------------------------
+
+static BOOL ReadManifestLine(FILE *pFile, WCHAR *szLine, size_t cchLine)
+{
+#ifdef _WIN32
+    return fgetws(szLine, (int)cchLine, pFile) != NULL;
+#else
+    char szNarrow[MAX_PATH * 8];
+
+    if (fgets(szNarrow, sizeof(szNarrow), pFile) == NULL)
+    {
+        return FALSE;
+    }
+
+    if (mbstowcs(szLine, szNarrow, cchLine) == (size_t)-1)
+    {
+        szLine[0] = L'\0';
+    }
+    szLine[cchLine - 1] = L'\0';
+    return TRUE;
+#endif
+}
+
+//-------------------------------------------------------------------
+//  AddFromManifest
+//
+//  Reads a UTF-8 text file with one job per line. A line holds an
+//  input file, optionally followed by a tab and an output file. When
+//  the output is omitted it is derived from the input name. Empty
+//  lines and lines starting with '#' are ignored.
+//-------------------------------------------------------------------
+
+HRESULT CBatch::AddFromManifest(const WCHAR *sManifest, const WCHAR *sOutputDir, const WCHAR *sExtension)
+{
+    if (!sManifest || !sOutputDir || !sExtension)
+    {
+        return E_INVALIDARG;
+    }
+
+    FILE *pFile = NULL;
+
+#ifdef _WIN32
+    if (_wfopen_s(&pFile, sManifest, L"rt, ccs=UTF-8") != 0)
+    {
+        pFile = NULL;
+    }
+#else
+    pFile = OpenFileW(sManifest, "r");
+#endif
+
+    if (pFile == NULL)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    HRESULT hr = S_OK;
+    WCHAR szLine[MAX_PATH * 2 + 2];
+
+    while (SUCCEEDED(hr) && ReadManifestLine(pFile, szLine, ARRAYSIZE(szLine)))
+    {
+        // Strip the line terminator.
+        size_t cch = wcslen(szLine);
+        while (cch > 0 && (szLine[cch - 1] == L'\n' || szLine[cch - 1] == L'\r'))
+        {
+            szLine[--cch] = L'\0';
+        }
+
+        if (cch == 0 || szLine[0] == L'#')
+        {
+            continue;
+        }
+
+        WCHAR *pTab = wcschr(szLine, L'\t');
+        if (pTab)
+        {
+            *pTab = L'\0';
+            hr = AddJob(szLine, pTab + 1);
+        }
+        else
+        {
+            hr = AddDerivedJob(szLine, sOutputDir, sExtension);
+        }
+    }
+
+    fclose(pFile);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  AddFromDirectory
+//
+//  Adds every file in sInputDir (not recursive).
+//-------------------------------------------------------------------
+
+HRESULT CBatch::AddFromDirectory(const WCHAR *sInputDir, const WCHAR *sOutputDir, const WCHAR *sExtension)
+{
+    if (!sInputDir || !sOutputDir || !sExtension)
+    {
+        return E_INVALIDARG;
+    }
+
+    WCHAR szInput[MAX_PATH];
+    HRESULT hr = S_OK;
+
+#ifdef _WIN32
+    WCHAR szPattern[MAX_PATH];
+
+    if (swprintf_s(szPattern, MAX_PATH, L"%ls\\*", sInputDir) < 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    WIN32_FIND_DATAW fd;
+    HANDLE hFind = FindFirstFileW(szPattern, &fd);
+
+    if (hFind == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    do
+    {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            continue;
+        }
+
+        if (swprintf_s(szInput, MAX_PATH, L"%ls\\%ls", sInputDir, fd.cFileName) < 0)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+        }
+        else
+        {
+            hr = AddDerivedJob(szInput, sOutputDir, sExtension);
+        }
+    }
+    while (SUCCEEDED(hr) && FindNextFileW(hFind, &fd));
+
+    FindClose(hFind);
+#else
+    char szDir[MAX_PATH * 4];
+
+    if (WideToNarrow(sInputDir, szDir, sizeof(szDir)) < 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    DIR *pDir = opendir(szDir);
+
+    if (pDir == NULL)
+    {
+        return HRESULT_FROM_ERRNO(errno);
+    }
+
+    // readdir order is arbitrary; sort so that batches are repeatable.
+    std::vector<std::wstring> names;
+    struct dirent *pEntry;
+
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        WCHAR szName[MAX_PATH];
+
+        if (mbstowcs(szName, pEntry->d_name, MAX_PATH) >= MAX_PATH)
+        {
+            continue;
+        }
+
+        if (swprintf_s(szInput, MAX_PATH, L"%ls/%ls", sInputDir, szName) < 0 ||
+            PathIsDirectory(szInput))
+        {
+            continue;
+        }
+        names.push_back(szInput);
+    }
+
+    closedir(pDir);
+
+    std::sort(names.begin(), names.end());
+
+    for (size_t i = 0; i < names.size() && SUCCEEDED(hr); i++)
+    {
+        hr = AddDerivedJob(names[i].c_str(), sOutputDir, sExtension);
+    }
+#endif
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CompleteJob
+//
+//  Records the job result and frees its slot. Called on the thread
+//  that finished the job.
+//-------------------------------------------------------------------
+
+void CBatch::CompleteJob(BatchJob *pJob, HRESULT hr)
+{
+    pJob->pBatch->OnJobComplete(pJob, hr);
+}
+
+void CBatch::OnJobComplete(BatchJob *pJob, HRESULT hr)
+{
+    pJob->hr = hr;
+
+    if (SUCCEEDED(hr))
+    {
+        wprintf_s(L"Output file created: %ls\n", pJob->szOutput);
+    }
+    else
+    {
+        wprintf_s(L"Could not create %ls (0x%X).\n", pJob->szOutput, hr);
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_cInFlight--;
+    m_cvComplete.notify_all();
+}
+
+//-------------------------------------------------------------------
+//  Run
+//
+//  Starts the jobs in order, keeping at most cMaxInFlight of them
+//  running, waits for the last one and prints the aggregate
+//  throughput. Returns the first job failure, if any.
+//-------------------------------------------------------------------
+
+HRESULT CBatch::Run(PFN_BEGIN_TRANSCODE_FILE pfnBegin, void *pContext, DWORD cMaxInFlight)
+{
+    if (!pfnBegin)
+    {
+        return E_POINTER;
+    }
+
+    if (m_cJobs == 0)
+    {
+        return S_OK;
+    }
+
+    if (cMaxInFlight == 0)
+    {
+        cMaxInFlight = DefaultWorkerCount();
+    }
+    if (cMaxInFlight > m_cJobs)
+    {
+        cMaxInFlight = m_cJobs;
+    }
+
+    HRESULT hr = S_OK;
+
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+    for (DWORD i = 0; i < m_cJobs; i++)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+
+            while (m_cInFlight >= cMaxInFlight)
+            {
+                m_cvComplete.wait(lock);
+            }
+            m_cInFlight++;
+        }
+
+        HRESULT hrBegin = pfnBegin(&m_pJobs[i], pContext);
+
+        if (FAILED(hrBegin))
+        {
+            OnJobComplete(&m_pJobs[i], hrBegin);
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        while (m_cInFlight > 0)
+        {
+            m_cvComplete.wait(lock);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+
+    DWORD cSucceeded = 0;
+    for (DWORD i = 0; i < m_cJobs; i++)
+    {
+        if (SUCCEEDED(m_pJobs[i].hr))
+        {
+            cSucceeded++;
+        }
+        else if (SUCCEEDED(hr))
+        {
+            hr = m_pJobs[i].hr;
+        }
+    }
+
+    wprintf_s(L"Batch: %u of %u files in %.3f s, %u in flight (%.2f files/sec).\n",
+        cSucceeded, m_cJobs, seconds, cMaxInFlight,
+        seconds > 0 ? m_cJobs / seconds : 0.0);
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  DefaultWorkerCount
+//-------------------------------------------------------------------
+
+DWORD DefaultWorkerCount()
+{
+    DWORD cCores = (DWORD)std::thread::hardware_concurrency();
+
+    return cCores ? cCores : 1;
+}
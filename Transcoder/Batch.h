@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Batch.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Batch mode for the transcoder. A batch is a list of
+// input/output pairs read from a manifest file or collected from a
+// directory, transcoded concurrently with a bounded number of jobs in
+// flight. Jobs are started from the thread that calls Run and finish
+// asynchronously, so the number of threads does not grow with the
+// number of jobs. The media backend is started once for the whole
+// process.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+#include <condition_variable>
+#include <mutex>
+
+class CBatch;
+
+struct BatchJob
+{
+    WCHAR   szInput[MAX_PATH];
+    WCHAR   szOutput[MAX_PATH];
+    HRESULT hr;
+    CBatch  *pBatch;
+};
+
+// Starts transcoding pJob->szInput to pJob->szOutput. If it succeeds,
+// the job must later be finished, on any thread, with
+// CBatch::CompleteJob. pContext is the value passed to CBatch::Run.
+typedef HRESULT (*PFN_BEGIN_TRANSCODE_FILE)(BatchJob *pJob, void *pContext);
+
+class CBatch
+{
+public:
+    CBatch();
+    ~CBatch();
+
+    HRESULT AddJob(const WCHAR *sInputFile, const WCHAR *sOutputFile);
+    HRESULT AddFromManifest(const WCHAR *sManifest, const WCHAR *sOutputDir, const WCHAR *sExtension);
+    HRESULT AddFromDirectory(const WCHAR *sInputDir, const WCHAR *sOutputDir, const WCHAR *sExtension);
+
+    // Runs the batch with at most cMaxInFlight jobs started and not yet
+    // completed. Returns when every job has completed.
+    HRESULT Run(PFN_BEGIN_TRANSCODE_FILE pfnBegin, void *pContext, DWORD cMaxInFlight);
+
+    // Records the result of a job started by PFN_BEGIN_TRANSCODE_FILE.
+    static void CompleteJob(BatchJob *pJob, HRESULT hr);
+
+    DWORD   JobCount() const { return m_cJobs; }
+
+private:
+
+    void    OnJobComplete(BatchJob *pJob, HRESULT hr);
+
+    HRESULT Grow();
+    HRESULT AddDerivedJob(const WCHAR *sInputFile, const WCHAR *sOutputDir, const WCHAR *sExtension);
+
+    BatchJob*           m_pJobs;
+    DWORD               m_cJobs;
+    DWORD               m_cAllocated;
+
+    std::mutex              m_lock;
+    std::condition_variable m_cvComplete;
+    DWORD                   m_cInFlight;
+};
+
+// Returns the number of jobs in flight to use when none is given.
+DWORD DefaultWorkerCount();
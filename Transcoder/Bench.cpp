@@ -0,0 +1,1226 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Bench.cpp - Throughput benchmark of the output format paths.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Generates deterministic synthetic sources, transcodes each of them
+// to each output format a number of times, one job at a time, and
+// reports the job latency (p50, p99), the throughput and the number
+// of allocations per job. The sources are:
+//
+//  sine-<rate>     16-bit PCM WAVE, 440 Hz tone
+//  noise-<rate>    16-bit PCM WAVE, white noise
+//  adts-<rate>     ADTS frames with filler payload
+//  mp3-<rate>      MPEG-1 Layer III frames with filler payload
+//
+// at every sample rate in aac_profiles. Pairs the backend cannot
+// transcode (e.g. anything but wav, and aac and mp3 copy to their own
+// container or mp4, on the portable backend) are skipped and counted.
+//
+// Only allocations made through operator new are counted; those of
+// the C runtime (fopen buffers) and of Media Foundation are not.
+//
+// With -baseline, the results are compared to an earlier -report and
+// the exit code is 1 if a case got slower or allocates more than the
+// tolerance allows, so that CI can gate on it.
+//
+// With -pcm on, the PCM conversions and the resampler of the portable
+// backend are timed instead, once with each kernel set the processor
+// supports, and every set's output is checked against the scalar set's.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Transcode.h"
+#include "WavFile.h"
+#include "Adts.h"
+#include "Mp3.h"
+#include "Pcm.h"
+#include "Resampler.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <locale.h>
+#endif
+
+#define BENCH_DEFAULT_JOBS          20
+#define BENCH_DEFAULT_SECONDS       10
+#define BENCH_DEFAULT_TOLERANCE     25      // Percent
+
+#define BENCH_BLOCK_FRAMES          4096
+#define BENCH_TONE_HZ               440
+#define BENCH_MP3_BITRATE_INDEX     9       // 128 kbps
+#define BENCH_MP3_BITRATE           128000
+#define BENCH_MP3_SAMPLES_PER_FRAME 1152
+
+#define BENCH_PCM_RATE              48000
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//-------------------------------------------------------------------
+//  Allocation counters
+//
+//  The global operator new is replaced so that the allocations made
+//  by a job, on any thread, can be counted.
+//-------------------------------------------------------------------
+
+static std::atomic<UINT64> g_cAllocations(0);
+static std::atomic<UINT64> g_cbAllocated(0);
+
+// Kept out of line: GCC warns at -O2 (-Wmismatched-new-delete) when
+// it sees free called on a pointer from an inlined operator new.
+#ifdef _MSC_VER
+#define BENCH_NOINLINE      __declspec(noinline)
+#elif defined(__GNUC__) || defined(__clang__)
+#define BENCH_NOINLINE      __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+static BENCH_NOINLINE void* CountedAlloc(size_t cb)
+{
+    g_cAllocations++;
+    g_cbAllocated += cb;
+
+    return malloc(cb ? cb : 1);
+}
+
+static BENCH_NOINLINE void CountedFree(void *p)
+{
+    free(p);
+}
+
+void* operator new(size_t cb)
+{
+    void *p = CountedAlloc(cb);
+
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t cb)
+{
+    return operator new(cb);
+}
+
+void* operator new(size_t cb, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(cb);
+}
+
+void* operator new[](size_t cb, const std::nothrow_t&) noexcept
+{
+    return CountedAlloc(cb);
+}
+
+void operator delete(void *p) noexcept
+{
+    CountedFree(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    CountedFree(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) noexcept
+{
+    CountedFree(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) noexcept
+{
+    CountedFree(p);
+}
+
+//-------------------------------------------------------------------
+//  Synthetic sources
+//-------------------------------------------------------------------
+
+enum SourceKind
+{
+    Source_Sine,
+    Source_Noise,
+    Source_Adts,
+    Source_Mp3,
+};
+
+struct BenchSource
+{
+    SourceKind  kind;
+    UINT32      sampleRate;
+    UINT32      channels;
+    UINT32      bytesPerSec;    // Compressed sources
+    WCHAR       szName[32];
+    WCHAR       szPath[MAX_PATH];
+    LONGLONG    hnsDuration;
+    UINT64      cbSize;
+};
+
+// Same sequence on every platform and run.
+static UINT32 NextRandom(UINT32 *pSeed)
+{
+    *pSeed = *pSeed * 1664525 + 1013904223;
+    return *pSeed;
+}
+
+static void FillRandom(BYTE *pData, DWORD cb, UINT32 *pSeed)
+{
+    for (DWORD i = 0; i < cb; i++)
+    {
+        pData[i] = (BYTE)(NextRandom(pSeed) >> 24);
+    }
+}
+
+static HRESULT WritePcmSource(BenchSource *pSource, UINT32 cSeconds)
+{
+    PcmFormat format;
+    format.sampleRate = pSource->sampleRate;
+    format.channels = pSource->channels;
+    format.bitsPerSample = 16;
+    format.fFloat = FALSE;
+
+    CWavWriter writer;
+    HRESULT hr = writer.Create(pSource->szPath, format);
+
+    std::vector<INT16> block(BENCH_BLOCK_FRAMES * format.channels);
+
+    UINT64 cFrames = (UINT64)cSeconds * format.sampleRate;
+    UINT32 seed = 1;
+
+    for (UINT64 iFrame = 0; iFrame < cFrames && SUCCEEDED(hr); )
+    {
+        UINT32 cBlock = (UINT32)std::min<UINT64>(BENCH_BLOCK_FRAMES, cFrames - iFrame);
+
+        for (UINT32 i = 0; i < cBlock; i++, iFrame++)
+        {
+            INT16 sample;
+
+            if (pSource->kind == Source_Sine)
+            {
+                // -6 dBFS
+                sample = (INT16)(16383 * sin(2 * M_PI * BENCH_TONE_HZ * iFrame / format.sampleRate));
+            }
+            else
+            {
+                // -12 dBFS
+                sample = (INT16)((INT32)(NextRandom(&seed) >> 16) - 32768) / 4;
+            }
+
+            for (UINT32 c = 0; c < format.channels; c++)
+            {
+                block[i * format.channels + c] = sample;
+            }
+        }
+
+        hr = writer.Write((const BYTE*)&block[0], cBlock * PcmBlockAlign(format));
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = writer.Finalize();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  WriteFrameSource
+//
+//  Writes frames with a valid header and filler payload, sized for
+//  the bitrate of the source. The portable backend copies the frames
+//  without decoding them.
+//-------------------------------------------------------------------
+
+static HRESULT WriteFrameSource(BenchSource *pSource, UINT32 cSeconds)
+{
+    BYTE frame[ADTS_MAX_FRAME_SIZE];
+    UINT32 cbFrame = 0;
+    UINT32 cSamplesPerFrame = 0;
+
+    if (pSource->kind == Source_Adts)
+    {
+        UINT32 iRate = 0;
+
+        while (AdtsSampleRate(iRate) != 0 && AdtsSampleRate(iRate) != pSource->sampleRate)
+        {
+            iRate++;
+        }
+
+        cSamplesPerFrame = ADTS_SAMPLES_PER_FRAME;
+        cbFrame = ADTS_HEADER_SIZE + pSource->bytesPerSec * cSamplesPerFrame / pSource->sampleRate;
+
+        if (AdtsSampleRate(iRate) == 0 || cbFrame > ADTS_MAX_FRAME_SIZE)
+        {
+            return E_INVALIDARG;
+        }
+
+        // AAC-LC, no CRC, one raw data block.
+        frame[0] = 0xFF;
+        frame[1] = 0xF1;
+        frame[2] = (BYTE)((1 << 6) | (iRate << 2) | ((pSource->channels >> 2) & 0x01));
+        frame[3] = (BYTE)(((pSource->channels & 0x03) << 6) | ((cbFrame >> 11) & 0x03));
+        frame[4] = (BYTE)(cbFrame >> 3);
+        frame[5] = (BYTE)(((cbFrame & 0x07) << 5) | 0x1F);
+        frame[6] = 0xFC;
+    }
+    else
+    {
+        UINT32 iRate = (pSource->sampleRate == 44100) ? 0 : (pSource->sampleRate == 48000) ? 1 : 2;
+
+        cSamplesPerFrame = BENCH_MP3_SAMPLES_PER_FRAME;
+        cbFrame = 144 * BENCH_MP3_BITRATE / pSource->sampleRate;
+
+        // MPEG-1 Layer III, no CRC, no padding, stereo.
+        frame[0] = 0xFF;
+        frame[1] = 0xFB;
+        frame[2] = (BYTE)((BENCH_MP3_BITRATE_INDEX << 4) | (iRate << 2));
+        frame[3] = 0x04;
+    }
+
+    FILE *pFile = OpenFileW(pSource->szPath, "wb");
+
+    if (pFile == NULL)
+    {
+        return HRESULT_FROM_ERRNO(errno);
+    }
+
+    UINT32 cbHeader = (pSource->kind == Source_Adts) ? ADTS_HEADER_SIZE : MP3_HEADER_SIZE;
+    UINT64 cFrames = (UINT64)cSeconds * pSource->sampleRate / cSamplesPerFrame;
+    UINT32 seed = 1;
+
+    HRESULT hr = S_OK;
+
+    for (UINT64 i = 0; i < cFrames && SUCCEEDED(hr); i++)
+    {
+        FillRandom(frame + cbHeader, cbFrame - cbHeader, &seed);
+
+        if (fwrite(frame, 1, cbFrame, pFile) != cbFrame)
+        {
+            hr = HRESULT_FROM_ERRNO(errno);
+        }
+    }
+
+    if (fclose(pFile) != 0 && SUCCEEDED(hr))
+    {
+        hr = HRESULT_FROM_ERRNO(errno);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  AddSources
+//
+//  One source of each kind per distinct rate in aac_profiles. MP3 is
+//  limited to the MPEG-1 rates.
+//-------------------------------------------------------------------
+
+static void AddSources(std::vector<BenchSource> *pSources, const WCHAR *sDir)
+{
+    static const WCHAR *kind_names[] = { L"sine", L"noise", L"adts", L"mp3" };
+    static const WCHAR *kind_extensions[] = { L".wav", L".wav", L".aac", L".mp3" };
+
+    for (UINT32 i = 0; i < aac_profile_count; i++)
+    {
+        const AACProfileInfo *pProfile = &aac_profiles[i];
+
+        BOOL fSeen = FALSE;
+
+        for (UINT32 j = 0; j < i; j++)
+        {
+            fSeen |= (aac_profiles[j].samplesPerSec == pProfile->samplesPerSec);
+        }
+
+        if (fSeen)
+        {
+            continue;
+        }
+
+        for (int kind = Source_Sine; kind <= Source_Mp3; kind++)
+        {
+            if (kind == Source_Mp3 && pProfile->samplesPerSec != 44100 &&
+                pProfile->samplesPerSec != 48000 && pProfile->samplesPerSec != 32000)
+            {
+                continue;
+            }
+
+            BenchSource source;
+            memset(&source, 0, sizeof(source));
+
+            source.kind = (SourceKind)kind;
+            source.sampleRate = pProfile->samplesPerSec;
+            source.channels = pProfile->numChannels;
+            source.bytesPerSec = (kind == Source_Mp3) ? BENCH_MP3_BITRATE / 8 : pProfile->bytesPerSec;
+
+            swprintf_s(source.szName, ARRAYSIZE(source.szName), L"%ls-%u", kind_names[kind], source.sampleRate);
+            swprintf_s(source.szPath, MAX_PATH, L"%ls/bench-%ls%ls", sDir, source.szName, kind_extensions[kind]);
+
+            pSources->push_back(source);
+        }
+    }
+}
+
+static HRESULT CreateSource(BenchSource *pSource, UINT32 cSeconds)
+{
+    HRESULT hr = (pSource->kind == Source_Sine || pSource->kind == Source_Noise) ?
+        WritePcmSource(pSource, cSeconds) : WriteFrameSource(pSource, cSeconds);
+
+    if (SUCCEEDED(hr))
+    {
+        pSource->hnsDuration = (LONGLONG)cSeconds * 10000000;
+        pSource->cbSize = GetPathSize(pSource->szPath);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Results
+//-------------------------------------------------------------------
+
+struct BenchResult
+{
+    std::string sCase;          // "<format>/<source>"
+    DWORD       cJobs;
+    double      p50Seconds;
+    double      p99Seconds;
+    double      meanSeconds;
+    double      realtimeFactor; // Media seconds per wall second
+    double      inputMBps;
+    double      allocsPerJob;
+    double      allocBytesPerJob;
+};
+
+// Nearest-rank percentile of sorted samples.
+static double Percentile(const std::vector<double> &sorted, double p)
+{
+    size_t i = (size_t)ceil(p * sorted.size());
+
+    return sorted[i > 0 ? i - 1 : 0];
+}
+
+static std::string NarrowString(const WCHAR *sWide)
+{
+    char sz[MAX_PATH];
+
+    return WideToNarrow(sWide, sz, sizeof(sz)) < 0 ? std::string() : std::string(sz);
+}
+
+struct BenchOptions
+{
+    IMediaBackend   *pBackend;
+    BOOL            fStreamCopy;
+    DWORD           cJobs;
+    CStatsLog       *pStatsLog;     // NULL without -stats
+};
+
+//-------------------------------------------------------------------
+//  RunJob
+//
+//  Transcodes one file the way the command-line tool does in batch
+//  mode, where consecutive jobs reuse a pooled session.
+//-------------------------------------------------------------------
+
+static HRESULT RunJob(CTranscoder *pTranscoder, const OutputFormat *pFormat, const BenchSource *pSource,
+    const WCHAR *sOutput, const BenchOptions *pOptions)
+{
+    HRESULT hr = pTranscoder->Reset();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->SetOutputFormat(pFormat);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->OpenFile(pSource->szPath);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureAudioOutput();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureVideoOutput();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureContainer();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->SetStreamCopy(pOptions->fStreamCopy);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->EncodeToFile(sOutput);
+    }
+    return hr;
+}
+
+static BOOL IsUnsupported(HRESULT hr)
+{
+    return hr == MF_E_TOPO_CODEC_NOT_FOUND ||
+        hr == MF_E_UNSUPPORTED_BYTESTREAM_TYPE ||
+        hr == MF_E_INVALIDMEDIATYPE;
+}
+
+//-------------------------------------------------------------------
+//  RemoveOutput
+//
+//  Deletes the output of a job, with the segment files of an HLS or
+//  DASH output (StreamPackager.h).
+//-------------------------------------------------------------------
+
+static void RemoveOutput(const OutputFormat *pFormat, const WCHAR *sOutput)
+{
+    (void)RemoveFile(sOutput);
+
+    if (!(pFormat->dwFlags & (FORMAT_FLAG_HLS | FORMAT_FLAG_DASH)))
+    {
+        return;
+    }
+
+    const WCHAR *pDot = wcsrchr(sOutput, L'.');
+    int cchBase = pDot ? (int)(pDot - sOutput) : (int)wcslen(sOutput);
+
+    WCHAR szSegment[MAX_PATH];
+
+    swprintf_s(szSegment, MAX_PATH, L"%.*ls_init.mp4", cchBase, sOutput);
+    (void)RemoveFile(szSegment);
+
+    for (UINT32 i = 1; ; i++)
+    {
+        swprintf_s(szSegment, MAX_PATH, L"%.*ls_%u.m4s", cchBase, sOutput, i);
+
+        if (!RemoveFile(szSegment))
+        {
+            break;
+        }
+    }
+}
+
+//-------------------------------------------------------------------
+//  RunCase
+//
+//  One warm-up job, then cJobs measured jobs, all run by one
+//  transcoder. Returns S_FALSE if the backend does not support the
+//  pair.
+//-------------------------------------------------------------------
+
+static HRESULT RunCase(const OutputFormat *pFormat, const BenchSource *pSource, const WCHAR *sDir,
+    const BenchOptions *pOptions, BenchResult *pResult)
+{
+    WCHAR szOutput[MAX_PATH];
+
+    swprintf_s(szOutput, MAX_PATH, L"%ls/bench-out%ls", sDir, pFormat->sExtension);
+
+    CSessionPool pool(pOptions->pBackend, 1);
+    CTranscoder transcoder(pOptions->pBackend);
+
+    transcoder.SetSessionPool(&pool);
+    transcoder.SetStatsLog(pOptions->pStatsLog);
+    transcoder.SetQuiet(TRUE);
+
+    HRESULT hr = RunJob(&transcoder, pFormat, pSource, szOutput, pOptions);
+
+    if (IsUnsupported(hr))
+    {
+        (void)transcoder.Reset();
+        RemoveOutput(pFormat, szOutput);
+        return S_FALSE;
+    }
+
+    std::vector<double> latencies;
+    UINT64 cAllocations = 0;
+    UINT64 cbAllocated = 0;
+
+    for (DWORD i = 0; i < pOptions->cJobs && SUCCEEDED(hr); i++)
+    {
+        UINT64 cAllocationsStart = g_cAllocations;
+        UINT64 cbAllocatedStart = g_cbAllocated;
+
+        std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+        hr = RunJob(&transcoder, pFormat, pSource, szOutput, pOptions);
+
+        latencies.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count());
+
+        cAllocations += g_cAllocations - cAllocationsStart;
+        cbAllocated += g_cbAllocated - cbAllocatedStart;
+    }
+
+    // The session closes the files of the last job when it shuts down.
+    (void)transcoder.Reset();
+    RemoveOutput(pFormat, szOutput);
+
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    double total = 0;
+
+    for (size_t i = 0; i < latencies.size(); i++)
+    {
+        total += latencies[i];
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    DWORD cJobs = (DWORD)latencies.size();
+    double mediaSeconds = pSource->hnsDuration / 10000000.0;
+
+    pResult->sCase = NarrowString(pFormat->sName) + "/" + NarrowString(pSource->szName);
+    pResult->cJobs = cJobs;
+    pResult->p50Seconds = Percentile(latencies, 0.50);
+    pResult->p99Seconds = Percentile(latencies, 0.99);
+    pResult->meanSeconds = total / cJobs;
+    pResult->realtimeFactor = total > 0 ? mediaSeconds * cJobs / total : 0;
+    pResult->inputMBps = total > 0 ? pSource->cbSize * (double)cJobs / total / (1024 * 1024) : 0;
+    pResult->allocsPerJob = (double)cAllocations / cJobs;
+    pResult->allocBytesPerJob = (double)cbAllocated / cJobs;
+
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  WriteReport
+//
+//  One JSON record per case (JSON Lines); the input of -baseline.
+//-------------------------------------------------------------------
+
+static HRESULT WriteReport(const WCHAR *sPath, const std::vector<BenchResult> &results)
+{
+    FILE *pFile = OpenFileW(sPath, "wb");
+
+    if (pFile == NULL)
+    {
+        return HRESULT_FROM_ERRNO(errno);
+    }
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult &r = results[i];
+
+        fprintf(pFile,
+            "{\"case\":\"%s\",\"jobs\":%u,\"p50_s\":%.6f,\"p99_s\":%.6f,\"mean_s\":%.6f,"
+            "\"realtime_factor\":%.3f,\"input_mb_per_s\":%.3f,\"allocs_per_job\":%.1f,\"alloc_bytes_per_job\":%.0f}\n",
+            r.sCase.c_str(), r.cJobs, r.p50Seconds, r.p99Seconds, r.meanSeconds,
+            r.realtimeFactor, r.inputMBps, r.allocsPerJob, r.allocBytesPerJob);
+    }
+
+    if (fclose(pFile) != 0)
+    {
+        return HRESULT_FROM_ERRNO(errno);
+    }
+    return S_OK;
+}
+
+// Reads a number field of a report record; FALSE if it is missing.
+static BOOL ReadReportField(const char *sRecord, const char *sField, double *pValue)
+{
+    std::string key = std::string("\"") + sField + "\":";
+
+    const char *p = strstr(sRecord, key.c_str());
+
+    return p && sscanf(p + key.size(), "%lf", pValue) == 1;
+}
+
+//-------------------------------------------------------------------
+//  CompareToBaseline
+//
+//  Flags the cases whose p50 latency or allocations per job exceed
+//  the baseline by more than tolerance percent. Cases missing from
+//  either side are ignored. *pcRegressions receives the count.
+//-------------------------------------------------------------------
+
+static HRESULT CompareToBaseline(const WCHAR *sPath, const std::vector<BenchResult> &results,
+    double tolerance, DWORD *pcRegressions)
+{
+    FILE *pFile = OpenFileW(sPath, "rb");
+
+    if (pFile == NULL)
+    {
+        return HRESULT_FROM_ERRNO(errno);
+    }
+
+    *pcRegressions = 0;
+
+    char szLine[1024];
+
+    while (fgets(szLine, sizeof(szLine), pFile))
+    {
+        const char *pCase = strstr(szLine, "\"case\":\"");
+
+        if (pCase == NULL)
+        {
+            continue;
+        }
+
+        pCase += strlen("\"case\":\"");
+
+        const char *pEnd = strchr(pCase, '"');
+
+        if (pEnd == NULL)
+        {
+            continue;
+        }
+
+        std::string sCase(pCase, pEnd - pCase);
+
+        double p50 = 0;
+        double allocs = 0;
+
+        if (!ReadReportField(szLine, "p50_s", &p50) || !ReadReportField(szLine, "allocs_per_job", &allocs))
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const BenchResult &r = results[i];
+
+            if (r.sCase != sCase)
+            {
+                continue;
+            }
+
+            if (r.p50Seconds > p50 * (1 + tolerance))
+            {
+                wprintf_s(L"REGRESSION %hs: p50 %.3f ms, baseline %.3f ms\n",
+                    sCase.c_str(), r.p50Seconds * 1000, p50 * 1000);
+                (*pcRegressions)++;
+            }
+
+            if (r.allocsPerJob > allocs * (1 + tolerance))
+            {
+                wprintf_s(L"REGRESSION %hs: %.1f allocations per job, baseline %.1f\n",
+                    sCase.c_str(), r.allocsPerJob, allocs);
+                (*pcRegressions)++;
+            }
+        }
+    }
+
+    fclose(pFile);
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  PCM kernels
+//-------------------------------------------------------------------
+
+struct PcmCase
+{
+    const WCHAR *sName;
+    UINT32      srcChannels;
+    UINT32      srcBits;
+    BOOL        fSrcFloat;
+    UINT32      dstChannels;
+    UINT32      dstBits;
+    BOOL        fDstFloat;
+};
+
+static const PcmCase pcm_cases[] =
+{
+    { L"int24>int16",           2, 24, FALSE, 2, 16, FALSE },
+    { L"int32>int16",           2, 32, FALSE, 2, 16, FALSE },
+    { L"float>int16",           2, 32, TRUE,  2, 16, FALSE },
+    { L"float>int24",           2, 32, TRUE,  2, 24, FALSE },
+    { L"float>int32",           2, 32, TRUE,  2, 32, FALSE },
+    { L"int16>float",           2, 16, FALSE, 2, 32, TRUE  },
+    { L"int16 stereo>mono",     2, 16, FALSE, 1, 16, FALSE },
+    { L"int16 mono>stereo",     1, 16, FALSE, 2, 16, FALSE },
+    { L"float stereo>int16 mono", 2, 32, TRUE, 1, 16, FALSE },
+};
+
+struct ResampleCase
+{
+    UINT32      inRate;
+    UINT32      outRate;
+};
+
+static const ResampleCase resample_cases[] =
+{
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 96000, 48000 },
+    { 22050, 44100 },
+};
+
+static PcmFormat MakePcmFormat(UINT32 channels, UINT32 bits, BOOL fFloat)
+{
+    PcmFormat format;
+    format.sampleRate = BENCH_PCM_RATE;
+    format.channels = channels;
+    format.bitsPerSample = bits;
+    format.fFloat = fFloat;
+    return format;
+}
+
+//-------------------------------------------------------------------
+//  RunPcmBench
+//
+//  Converts cSeconds of 48 kHz noise that clips now and then, cJobs
+//  times per case and kernel set. *pcMismatches receives the number
+//  of cases where a set's output differs from the scalar set's.
+//-------------------------------------------------------------------
+
+static HRESULT RunPcmBench(DWORD cSeconds, DWORD cJobs, DWORD *pcMismatches)
+{
+    const UINT32 cFrames = cSeconds * BENCH_PCM_RATE;
+
+    // Two channels of float source samples, in [-1.25, 1.25).
+    std::vector<float> noise((size_t)cFrames * 2);
+    UINT32 seed = 1;
+
+    for (size_t i = 0; i < noise.size(); i++)
+    {
+        noise[i] = ((INT32)NextRandom(&seed) / 2147483648.0f) * 1.25f;
+    }
+
+    const PcmFormat noiseFormat = MakePcmFormat(2, 32, TRUE);
+    const PcmFormat monoFormat = MakePcmFormat(1, 32, TRUE);
+
+    *pcMismatches = 0;
+
+    wprintf_s(L"PCM conversion, %u s of %u Hz per run, %u runs.\n\n", cSeconds, BENCH_PCM_RATE, cJobs);
+    wprintf_s(L"%-24ls %-8ls %12ls %10ls\n", L"case", L"kernels", L"in MB/s", L"speedup");
+
+    HRESULT hr = S_OK;
+
+    for (size_t iCase = 0; iCase < ARRAYSIZE(pcm_cases) && SUCCEEDED(hr); iCase++)
+    {
+        const PcmCase &c = pcm_cases[iCase];
+        const PcmFormat srcFormat = MakePcmFormat(c.srcChannels, c.srcBits, c.fSrcFloat);
+        const PcmFormat dstFormat = MakePcmFormat(c.dstChannels, c.dstBits, c.fDstFloat);
+
+        std::vector<BYTE> src((size_t)cFrames * PcmBlockAlign(srcFormat));
+        std::vector<BYTE> reference((size_t)cFrames * PcmBlockAlign(dstFormat));
+        std::vector<BYTE> dst(reference.size());
+
+        // The mono source is the left channel of the noise.
+        std::vector<float> left;
+
+        if (c.srcChannels == 1)
+        {
+            left.resize(cFrames);
+
+            for (UINT32 i = 0; i < cFrames; i++)
+            {
+                left[i] = noise[2 * i];
+            }
+        }
+
+        hr = ConvertPcm(c.srcChannels == 1 ? monoFormat : noiseFormat,
+            c.srcChannels == 1 ? (const BYTE*)&left[0] : (const BYTE*)&noise[0],
+            srcFormat, &src[0], cFrames, GetPcmKernelSet(0));
+
+        double scalarMBps = 0;
+
+        for (UINT32 iSet = 0; iSet < GetPcmKernelSetCount() && SUCCEEDED(hr); iSet++)
+        {
+            const PcmKernels *pKernels = GetPcmKernelSet(iSet);
+            std::vector<BYTE> &out = (iSet == 0) ? reference : dst;
+
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+            for (DWORD iJob = 0; iJob < cJobs && SUCCEEDED(hr); iJob++)
+            {
+                hr = ConvertPcm(srcFormat, &src[0], dstFormat, &out[0], cFrames, pKernels);
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+            double mbps = seconds > 0 ? src.size() * (double)cJobs / seconds / (1024 * 1024) : 0;
+
+            if (FAILED(hr))
+            {
+                break;
+            }
+
+            if (iSet == 0)
+            {
+                scalarMBps = mbps;
+            }
+
+            BOOL fMatch = (iSet == 0) || memcmp(&dst[0], &reference[0], dst.size()) == 0;
+
+            wprintf_s(L"%-24ls %-8hs %12.1f %9.2fx%ls\n", c.sName, pKernels->sName, mbps,
+                scalarMBps > 0 ? mbps / scalarMBps : 0.0, fMatch ? L"" : L"  MISMATCH");
+
+            if (!fMatch)
+            {
+                (*pcMismatches)++;
+            }
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        wprintf_s(L"\n%-24ls %-8ls %12ls %10ls\n", L"resample (stereo)", L"kernels", L"in MB/s", L"speedup");
+    }
+
+    for (size_t iCase = 0; iCase < ARRAYSIZE(resample_cases) && SUCCEEDED(hr); iCase++)
+    {
+        const ResampleCase &c = resample_cases[iCase];
+
+        // The noise is taken to be at the input rate.
+        const UINT32 cInFrames = (UINT32)std::min<UINT64>(cFrames, (UINT64)cSeconds * c.inRate);
+
+        WCHAR szName[32];
+        swprintf_s(szName, ARRAYSIZE(szName), L"%u>%u", c.inRate, c.outRate);
+
+        std::vector<float> reference;
+        std::vector<float> out;
+        double scalarMBps = 0;
+
+        for (UINT32 iSet = 0; iSet < GetPcmKernelSetCount() && SUCCEEDED(hr); iSet++)
+        {
+            const PcmKernels *pKernels = GetPcmKernelSet(iSet);
+            CResampler resampler;
+
+            hr = resampler.Initialize(c.inRate, c.outRate, 2, pKernels);
+
+            std::vector<float> block(2 * (size_t)resampler.MaxOutputFrames(BENCH_BLOCK_FRAMES));
+            std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+            for (DWORD iJob = 0; iJob < cJobs && SUCCEEDED(hr); iJob++)
+            {
+                out.clear();
+
+                for (UINT32 i = 0; i <= cInFrames && SUCCEEDED(hr); i += BENCH_BLOCK_FRAMES)
+                {
+                    UINT32 cOut = 0;
+
+                    if (i < cInFrames)
+                    {
+                        hr = resampler.Process(&noise[2 * (size_t)i], std::min<UINT32>(BENCH_BLOCK_FRAMES, cInFrames - i),
+                            &block[0], (UINT32)block.size() / 2, &cOut);
+                    }
+                    else
+                    {
+                        hr = resampler.Drain(&block[0], (UINT32)block.size() / 2, &cOut);
+                    }
+
+                    out.insert(out.end(), block.begin(), block.begin() + 2 * cOut);
+                }
+            }
+
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+            double mbps = seconds > 0 ? cInFrames * 2 * sizeof(float) * (double)cJobs / seconds / (1024 * 1024) : 0;
+
+            if (FAILED(hr))
+            {
+                break;
+            }
+
+            if (iSet == 0)
+            {
+                scalarMBps = mbps;
+                reference.swap(out);
+            }
+
+            BOOL fMatch = (iSet == 0) || out == reference;
+
+            wprintf_s(L"%-24ls %-8hs %12.1f %9.2fx%ls\n", szName, pKernels->sName, mbps,
+                scalarMBps > 0 ? mbps / scalarMBps : 0.0, fMatch ? L"" : L"  MISMATCH");
+
+            if (!fMatch)
+            {
+                (*pcMismatches)++;
+            }
+        }
+    }
+
+    return hr;
+}
+
+static void PrintUsage(const WCHAR *sExe)
+{
+    wprintf_s(L"Usage: %ls [options]\n", sExe);
+    wprintf_s(L"\nOptions:\n");
+    wprintf_s(L"  -backend name    Media backend (default as for Transcode)\n");
+    wprintf_s(L"  -f format        Only benchmark this output format\n");
+    wprintf_s(L"  -copy on|off     Copy streams that already match the format (default on)\n");
+    wprintf_s(L"  -jobs n          Measured jobs per case (default %u)\n", BENCH_DEFAULT_JOBS);
+    wprintf_s(L"  -seconds n       Length of the synthetic sources (default %u)\n", BENCH_DEFAULT_SECONDS);
+    wprintf_s(L"  -dir path        Directory for the sources and outputs (default .)\n");
+    wprintf_s(L"  -stats file      Append a JSON record of each job's timings to file\n");
+    wprintf_s(L"  -report file     Write one JSON record per case to file\n");
+    wprintf_s(L"  -baseline file   Exit with 1 if a case regressed against this report\n");
+    wprintf_s(L"  -tolerance pct   Allowed regression (default %u)\n", BENCH_DEFAULT_TOLERANCE);
+    wprintf_s(L"  -pcm on|off      Benchmark the PCM conversion kernels instead (default off)\n");
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+    const OutputFormat *pOnlyFormat = NULL;
+    const WCHAR *sBackend = NULL;
+    const WCHAR *sDir = L".";
+    const WCHAR *sStatsFile = NULL;
+    const WCHAR *sReportFile = NULL;
+    const WCHAR *sBaselineFile = NULL;
+    BOOL fStreamCopy = TRUE;
+    BOOL fPcm = FALSE;
+    DWORD cJobs = BENCH_DEFAULT_JOBS;
+    DWORD cSeconds = BENCH_DEFAULT_SECONDS;
+    DWORD tolerance = BENCH_DEFAULT_TOLERANCE;
+
+    for (int iArg = 1; iArg < argc; iArg += 2)
+    {
+        const WCHAR *sValue = (iArg + 1 < argc) ? argv[iArg + 1] : NULL;
+
+        if (sValue == NULL)
+        {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+        else if (_wcsicmp(argv[iArg], L"-backend") == 0)
+        {
+            sBackend = sValue;
+        }
+        else if (_wcsicmp(argv[iArg], L"-f") == 0 && FindOutputFormat(sValue))
+        {
+            pOnlyFormat = FindOutputFormat(sValue);
+        }
+        else if (_wcsicmp(argv[iArg], L"-copy") == 0 &&
+            (_wcsicmp(sValue, L"on") == 0 || _wcsicmp(sValue, L"off") == 0))
+        {
+            fStreamCopy = (_wcsicmp(sValue, L"on") == 0);
+        }
+        else if (_wcsicmp(argv[iArg], L"-jobs") == 0 && _wtoi(sValue) > 0)
+        {
+            cJobs = (DWORD)_wtoi(sValue);
+        }
+        else if (_wcsicmp(argv[iArg], L"-seconds") == 0 && _wtoi(sValue) > 0)
+        {
+            cSeconds = (DWORD)_wtoi(sValue);
+        }
+        else if (_wcsicmp(argv[iArg], L"-dir") == 0)
+        {
+            sDir = sValue;
+        }
+        else if (_wcsicmp(argv[iArg], L"-stats") == 0)
+        {
+            sStatsFile = sValue;
+        }
+        else if (_wcsicmp(argv[iArg], L"-report") == 0)
+        {
+            sReportFile = sValue;
+        }
+        else if (_wcsicmp(argv[iArg], L"-baseline") == 0)
+        {
+            sBaselineFile = sValue;
+        }
+        else if (_wcsicmp(argv[iArg], L"-tolerance") == 0 && _wtoi(sValue) >= 0)
+        {
+            tolerance = (DWORD)_wtoi(sValue);
+        }
+        else if (_wcsicmp(argv[iArg], L"-pcm") == 0 &&
+            (_wcsicmp(sValue, L"on") == 0 || _wcsicmp(sValue, L"off") == 0))
+        {
+            fPcm = (_wcsicmp(sValue, L"on") == 0);
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (fPcm)
+    {
+        DWORD cMismatches = 0;
+
+        HRESULT hr = RunPcmBench(cSeconds, cJobs, &cMismatches);
+
+        if (FAILED(hr))
+        {
+            wprintf_s(L"Benchmark failed (0x%X).\n", hr);
+            return 1;
+        }
+        return cMismatches > 0 ? 1 : 0;
+    }
+
+    IMediaBackend *pBackend = NULL;
+
+    HRESULT hr = CreateMediaBackend(sBackend, &pBackend);
+
+    if (FAILED(hr))
+    {
+        wprintf_s(L"Unknown backend: %ls\n", sBackend);
+        return 2;
+    }
+
+    CStatsLog statsLog;
+
+    if (sStatsFile)
+    {
+        hr = statsLog.Open(sStatsFile);
+    }
+
+#ifdef _WIN32
+    if (SUCCEEDED(hr))
+    {
+        hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+    }
+#endif
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pBackend->Startup();
+    }
+
+    std::vector<BenchSource> sources;
+    AddSources(&sources, sDir);
+
+    for (size_t i = 0; i < sources.size() && SUCCEEDED(hr); i++)
+    {
+        hr = CreateSource(&sources[i], cSeconds);
+    }
+
+    BenchOptions options = { pBackend, fStreamCopy, cJobs, sStatsFile ? &statsLog : NULL };
+
+    std::vector<BenchResult> results;
+    DWORD cUnsupported = 0;
+
+    if (SUCCEEDED(hr))
+    {
+        wprintf_s(L"Backend %ls, %u jobs per case, %u s sources.\n\n", pBackend->GetName(), cJobs, cSeconds);
+        wprintf_s(L"%-24ls %10ls %10ls %12ls %10ls %12ls\n",
+            L"case", L"p50 ms", L"p99 ms", L"x realtime", L"MB/s", L"allocs/job");
+    }
+
+    for (UINT32 i = 0; i < GetOutputFormatCount() && SUCCEEDED(hr); i++)
+    {
+        const OutputFormat *pFormat = GetOutputFormat(i);
+
+        if (pOnlyFormat && pFormat != pOnlyFormat)
+        {
+            continue;
+        }
+
+        for (size_t j = 0; j < sources.size() && SUCCEEDED(hr); j++)
+        {
+            BenchResult result;
+
+            hr = RunCase(pFormat, &sources[j], sDir, &options, &result);
+
+            if (hr == S_FALSE)
+            {
+                cUnsupported++;
+            }
+            else if (SUCCEEDED(hr))
+            {
+                wprintf_s(L"%-24hs %10.3f %10.3f %12.1f %10.1f %12.1f\n",
+                    result.sCase.c_str(), result.p50Seconds * 1000, result.p99Seconds * 1000,
+                    result.realtimeFactor, result.inputMBps, result.allocsPerJob);
+
+                results.push_back(result);
+            }
+            else
+            {
+                wprintf_s(L"%ls/%ls failed (0x%X).\n", pFormat->sName, sources[j].szName, hr);
+            }
+        }
+    }
+
+    if (SUCCEEDED(hr) && cUnsupported > 0)
+    {
+        wprintf_s(L"\n%u format/source pairs are not supported by the backend.\n", cUnsupported);
+    }
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        (void)RemoveFile(sources[i].szPath);
+    }
+
+    pBackend->Shutdown();
+    SafeDelete(&pBackend);
+
+#ifdef _WIN32
+    CoUninitialize();
+#endif
+
+    if (SUCCEEDED(hr) && sReportFile)
+    {
+        hr = WriteReport(sReportFile, results);
+    }
+
+    DWORD cRegressions = 0;
+
+    if (SUCCEEDED(hr) && sBaselineFile)
+    {
+        hr = CompareToBaseline(sBaselineFile, results, tolerance / 100.0, &cRegressions);
+    }
+
+    if (FAILED(hr))
+    {
+        wprintf_s(L"Benchmark failed (0x%X).\n", hr);
+        return 1;
+    }
+
+    return cRegressions > 0 ? 1 : 0;
+}
+
+#ifndef _WIN32
+
+//-------------------------------------------------------------------
+//  main
+//
+//  Converts the arguments from the locale encoding and calls wmain.
+//-------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    setlocale(LC_ALL, "");
+
+    wchar_t **wargv = new wchar_t*[argc + 1];
+
+    for (int i = 0; i < argc; i++)
+    {
+        size_t cch = mbstowcs(NULL, argv[i], 0);
+
+        wargv[i] = new wchar_t[cch == (size_t)-1 ? 1 : cch + 1];
+        if (cch == (size_t)-1 || mbstowcs(wargv[i], argv[i], cch + 1) == (size_t)-1)
+        {
+            wargv[i][0] = L'\0';
+        }
+    }
+    wargv[argc] = NULL;
+
+    int result = wmain(argc, wargv);
+
+    for (int i = 0; i < argc; i++)
+    {
+        delete [] wargv[i];
+    }
+    delete [] wargv;
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,437 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// FakeSession.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Fake backend session. It accepts any input and any output format,
+// reads the whole input, and writes deterministic filler bytes sized
+// to what the real encoder would produce for the input duration. The
+// same input and format always give the same output, so the
+// orchestration layer can be regression-tested and benchmarked
+// without codecs. With several outputs the input is read once and
+// each output gets the filler it would get alone.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "PortableBackend.h"
+#include "MappedFile.h"
+#include "OutputFile.h"
+#include "WavFile.h"
+
+#include <string.h>
+#include <new>
+
+#define FAKE_BLOCK_SIZE         (64 * 1024)
+#define FAKE_AUDIO_BITRATE      128000      // AAC and MP3 output
+#define FAKE_SOURCE_BITRATE     128000      // Assumed for non-WAVE input
+
+#define FNV_OFFSET_BASIS        0xCBF29CE484222325ULL
+#define FNV_PRIME               0x00000100000001B3ULL
+
+static UINT64 HashBytes(UINT64 hash, const BYTE *pData, DWORD cb)
+{
+    for (DWORD i = 0; i < cb; i++)
+    {
+        hash ^= pData[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+class CFakeSession : public CQueuedSession
+{
+public:
+    CFakeSession(CWorkQueue *pQueue);
+    virtual ~CFakeSession();
+
+    HRESULT OpenSource(const WCHAR *sURL);
+    HRESULT OpenSourceMemory(const BYTE *pData, UINT64 cbData);
+    HRESULT ConfigureAudio(const OutputFormat *pFormat);
+    HRESULT ConfigureVideo(const OutputFormat *pFormat);
+    HRESULT ConfigureContainer(const OutputFormat *pFormat);
+    HRESULT GetMediaInfo(MediaInfo *pInfo);
+
+protected:
+
+    HRESULT CreateOutput(const WCHAR *sURL);
+    HRESULT Process();
+    HRESULT FinalizeOutput();
+    void    ReleaseResources();
+    void    ResetJob();
+
+private:
+
+    // One per output; the first is the main output.
+    struct OutputBranch
+    {
+        const OutputFormat* pFormat;
+        COutputFile         file;
+    };
+
+    HRESULT ReadInputInfo();
+    UINT64  OutputBytesPerSecond(const OutputFormat *pFormat) const;
+    HRESULT WriteFiller(OutputBranch &output, UINT64 hash, LONGLONG hnsOutput, BYTE *pBlock);
+
+    CMappedFile         m_input;
+    OutputBranch        m_outputs[SESSION_MAX_OUTPUTS];
+    DWORD               m_cOutputs;
+    const OutputFormat* m_pFormat;
+    LONGLONG            m_hnsDuration;
+    UINT32              m_sampleRate;
+    UINT32              m_pcmBytesPerSecond;    // For PCM output
+};
+
+CFakeSession::CFakeSession(CWorkQueue *pQueue) :
+    CQueuedSession(pQueue),
+    m_cOutputs(0),
+    m_pFormat(NULL),
+    m_hnsDuration(0),
+    m_sampleRate(44100),
+    m_pcmBytesPerSecond(44100 * 2 * 2)
+{
+    for (DWORD i = 0; i < SESSION_MAX_OUTPUTS; i++)
+    {
+        m_outputs[i].pFormat = NULL;
+    }
+}
+
+CFakeSession::~CFakeSession()
+{
+    ReleaseResources();
+}
+
+//-------------------------------------------------------------------
+//  OpenSource
+//
+//  Takes the duration from the WAVE header, or estimates it from the
+//  file size for any other input. An input stream has no size, so
+//  its estimate is 0.
+//-------------------------------------------------------------------
+
+HRESULT CFakeSession::OpenSource(const WCHAR *sURL)
+{
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_input.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_input.Open(sURL);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = ReadInputInfo();
+    }
+    return hr;
+}
+
+HRESULT CFakeSession::OpenSourceMemory(const BYTE *pData, UINT64 cbData)
+{
+    if (m_input.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_input.Open(pData, cbData);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = ReadInputInfo();
+    }
+    return hr;
+}
+
+HRESULT CFakeSession::ReadInputInfo()
+{
+    const BYTE *pHeader = NULL;
+    DWORD cbHeader = 0;
+
+    HRESULT hr = m_input.View(0, 12, &pHeader, &cbHeader);
+
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CWavReader wav;
+
+    if (IsWavHeader(pHeader, cbHeader) && SUCCEEDED(wav.Open(&m_input)))
+    {
+        PcmFormat fmt = wav.Format();
+
+        m_hnsDuration = wav.Duration();
+        m_sampleRate = fmt.sampleRate;
+
+        fmt.bitsPerSample = 16;
+        fmt.fFloat = FALSE;
+        m_pcmBytesPerSecond = PcmBytesPerSecond(fmt);
+    }
+    else
+    {
+        m_hnsDuration = (LONGLONG)(m_input.Size() * 8 * 10000000 / FAKE_SOURCE_BITRATE);
+    }
+    return S_OK;
+}
+
+HRESULT CFakeSession::ConfigureAudio(const OutputFormat *pFormat)
+{
+    if (!pFormat)
+    {
+        return E_INVALIDARG;
+    }
+
+    m_pFormat = pFormat;
+    return S_OK;
+}
+
+HRESULT CFakeSession::ConfigureVideo(const OutputFormat *pFormat)
+{
+    return pFormat ? S_OK : E_INVALIDARG;
+}
+
+HRESULT CFakeSession::ConfigureContainer(const OutputFormat *pFormat)
+{
+    if (!pFormat)
+    {
+        return E_INVALIDARG;
+    }
+
+    m_pFormat = pFormat;
+    return S_OK;
+}
+
+HRESULT CFakeSession::GetMediaInfo(MediaInfo *pInfo)
+{
+    if (!pInfo)
+    {
+        return E_POINTER;
+    }
+
+    if (!m_input.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    pInfo->hnsDuration = m_hnsDuration;
+    pInfo->audioSampleRate = m_sampleRate;
+    pInfo->cCopyFrameSamples = 0;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  CreateOutput
+//
+//  Opens the main output, a file or m_pOutputSink, then the added
+//  ones. Files already opened when one fails are closed by
+//  ReleaseResources.
+//-------------------------------------------------------------------
+
+HRESULT CFakeSession::CreateOutput(const WCHAR *sURL)
+{
+    if (m_pFormat == NULL || !m_input.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = S_OK;
+
+    // The job ends at the stop time at the latest.
+    LONGLONG hnsExpected = (m_hnsStop > 0 && m_hnsStop < m_hnsDuration) ? m_hnsStop : m_hnsDuration;
+
+    for (DWORD i = 0; i <= m_cExtraOutputs && SUCCEEDED(hr); i++)
+    {
+        OutputBranch *pOutput = &m_outputs[i];
+
+        pOutput->pFormat = (i == 0) ? m_pFormat : m_extraOutputs[i - 1].pFormat;
+
+        UINT64 cbExpected = 4 + (UINT64)hnsExpected * OutputBytesPerSecond(pOutput->pFormat) / 10000000;
+
+        if (i == 0 && m_pOutputSink)
+        {
+            hr = pOutput->file.Open(m_pOutputSink, cbExpected);
+        }
+        else
+        {
+            hr = pOutput->file.Create((i == 0) ? sURL : m_extraOutputs[i - 1].szURL, cbExpected);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_cOutputs = m_cExtraOutputs + 1;
+    }
+    return hr;
+}
+
+UINT64 CFakeSession::OutputBytesPerSecond(const OutputFormat *pFormat) const
+{
+    UINT64 cbAudio = FAKE_AUDIO_BITRATE / 8;
+
+    if (pFormat->audioCodec == AudioCodec_PCM)
+    {
+        cbAudio = m_outputSampleRate ?
+            (UINT64)m_pcmBytesPerSecond / m_sampleRate * m_outputSampleRate : m_pcmBytesPerSecond;
+    }
+
+    const H264ProfileInfo *pVideo = GetVideoProfile(pFormat);
+
+    UINT64 cbVideo = pVideo ? pVideo->bitrate / 8 : 0;
+
+    return cbAudio + cbVideo;
+}
+
+//-------------------------------------------------------------------
+//  Process
+//
+//  Walks the input's mapping in blocks, as a decoder would, and writes
+//  filler seeded from a hash of the input to each output.
+//-------------------------------------------------------------------
+
+HRESULT CFakeSession::Process()
+{
+    BYTE *pBlock = new (std::nothrow) BYTE[FAKE_BLOCK_SIZE];
+
+    if (pBlock == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    HRESULT hr = S_OK;
+    UINT64 hash = FNV_OFFSET_BASIS;
+
+    LONGLONG hnsEnd = (m_hnsStop > 0 && m_hnsStop < m_hnsDuration) ? m_hnsStop : m_hnsDuration;
+    LONGLONG hnsOutput = hnsEnd > m_hnsStart ? hnsEnd - m_hnsStart : 0;
+
+    UINT64 cbInput = m_input.Size();
+    UINT64 cbConsumed = 0;
+
+    while (SUCCEEDED(hr) && !IsAborted())
+    {
+        const BYTE *pData = NULL;
+        DWORD cbRead = 0;
+
+        hr = m_input.View(cbConsumed, FAKE_BLOCK_SIZE, &pData, &cbRead);
+
+        if (FAILED(hr) || cbRead == 0)
+        {
+            break;
+        }
+        hash = HashBytes(hash, pData, cbRead);
+
+        // Reading stands in for decoding, so the position follows it.
+        cbConsumed += cbRead;
+        if (cbInput > 0)
+        {
+            SetPosition(m_hnsStart + (LONGLONG)((double)hnsOutput * cbConsumed / cbInput));
+        }
+    }
+
+    for (DWORD i = 0; i < m_cOutputs && SUCCEEDED(hr); i++)
+    {
+        hr = WriteFiller(m_outputs[i], hash, hnsOutput, pBlock);
+    }
+
+    delete [] pBlock;
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  WriteFiller
+//
+//  Writes the output for hnsOutput of media in the output's format.
+//  pBlock is a scratch buffer of FAKE_BLOCK_SIZE bytes.
+//-------------------------------------------------------------------
+
+HRESULT CFakeSession::WriteFiller(OutputBranch &output, UINT64 hash, LONGLONG hnsOutput, BYTE *pBlock)
+{
+    UINT64 cbOutput = (UINT64)hnsOutput * OutputBytesPerSecond(output.pFormat) / 10000000;
+
+    HRESULT hr = output.file.Write((const BYTE*)"FAKE", 4);
+
+    // xorshift64 keeps the filler cheap and reproducible.
+    UINT64 state = hash ? hash : FNV_OFFSET_BASIS;
+
+    while (SUCCEEDED(hr) && cbOutput > 0)
+    {
+        if (IsAborted())
+        {
+            hr = E_ABORT;
+            break;
+        }
+
+        DWORD cbBlock = cbOutput < FAKE_BLOCK_SIZE ? (DWORD)cbOutput : FAKE_BLOCK_SIZE;
+
+        for (DWORD i = 0; i < cbBlock; i += 8)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            memcpy(pBlock + i, &state, (cbBlock - i) < 8 ? (cbBlock - i) : 8);
+        }
+
+        hr = output.file.Write(pBlock, cbBlock);
+        cbOutput -= cbBlock;
+    }
+    return hr;
+}
+
+HRESULT CFakeSession::FinalizeOutput()
+{
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < m_cOutputs; i++)
+    {
+        HRESULT hrOutput = m_outputs[i].file.Close();
+
+        if (SUCCEEDED(hr))
+        {
+            hr = hrOutput;
+        }
+    }
+    return hr;
+}
+
+void CFakeSession::ReleaseResources()
+{
+    m_input.Close();
+
+    for (DWORD i = 0; i < SESSION_MAX_OUTPUTS; i++)
+    {
+        (void)m_outputs[i].file.Close();
+    }
+}
+
+void CFakeSession::ResetJob()
+{
+    for (DWORD i = 0; i < SESSION_MAX_OUTPUTS; i++)
+    {
+        m_outputs[i].pFormat = NULL;
+    }
+
+    m_cOutputs = 0;
+    m_pFormat = NULL;
+    m_hnsDuration = 0;
+    m_sampleRate = 44100;
+    m_pcmBytesPerSecond = 44100 * 2 * 2;
+}
+
+HRESULT CreateFakeSession(CWorkQueue *pQueue, ITranscodeSession **ppSession)
+{
+    if (!ppSession)
+    {
+        return E_POINTER;
+    }
+
+    *ppSession = new (std::nothrow) CFakeSession(pQueue);
+
+    return *ppSession ? S_OK : E_OUTOFMEMORY;
+}
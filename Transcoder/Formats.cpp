@@ -0,0 +1,193 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Formats.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Formats.h"
+
+#include <wchar.h>
+
+//-------------------------------------------------------------------
+//  Output format registry
+//
+//  One entry per former sample directory:
+//
+//  aac      TranscodeToAAC
+//  cmaf     (none; fragmented MPEG-4 for streaming)
+//  dash     (none; CMAF segments and a DASH manifest)
+//  hls      (none; CMAF segments and an HLS playlist)
+//  mp3      TranscodeToMP3
+//  mp4      TranscodeToMp4-AAC
+//  mp4-pcm  TranscodeToMp4-AAC(PCM)
+//  mp4-mp3  TranscodeToMp4-MP3
+//  wav      TranscodeToWAV (PCM)
+//  wma      TranscodeToWMA (PCM)
+//-------------------------------------------------------------------
+
+static const OutputFormat g_formats[] =
+{
+    { L"aac",     L".aac", L"AAC in an ADTS stream",
+      AudioCodec_AAC,    AudioCodec_AAC, AudioSetup_EncoderType, Container_ADTS,  FORMAT_NO_VIDEO, 0, NULL },
+
+    { L"cmaf",    L".m4a", L"AAC audio in fragmented MPEG-4 (CMAF)",
+      AudioCodec_AAC,    AudioCodec_AAC, AudioSetup_AAC,         Container_FMPEG4, FORMAT_NO_VIDEO, 0, NULL },
+
+    { L"dash",    L".mpd", L"AAC audio in CMAF segments with a DASH manifest",
+      AudioCodec_AAC,    AudioCodec_AAC, AudioSetup_AAC,         Container_FMPEG4, FORMAT_NO_VIDEO, FORMAT_FLAG_DASH, NULL },
+
+    { L"hls",     L".m3u8", L"AAC audio in CMAF segments with an HLS playlist",
+      AudioCodec_AAC,    AudioCodec_AAC, AudioSetup_AAC,         Container_FMPEG4, FORMAT_NO_VIDEO, FORMAT_FLAG_HLS, NULL },
+
+    { L"mp3",     L".mp3", L"MP3 audio",
+      AudioCodec_MP3,    AudioCodec_MP3, AudioSetup_EncoderType, Container_MP3,   FORMAT_NO_VIDEO, 0, NULL },
+
+    { L"mp4",     L".mp4", L"H.264 video and AAC audio in MPEG-4",
+      AudioCodec_AAC,    AudioCodec_AAC, AudioSetup_AAC,         Container_MPEG4, 7,               0, NULL },
+
+    { L"mp4-pcm", L".mp4", L"H.264 video and AAC audio in MPEG-4, first sample entry",
+      AudioCodec_AAC,    AudioCodec_AAC, AudioSetup_AAC,         Container_MPEG4, 7,               FORMAT_FLAG_MP4_SAMPLE_ENTRY, NULL },
+
+    { L"mp4-mp3", L".mp4", L"H.264 video and MP3 audio in MPEG-4",
+      AudioCodec_MP3,    AudioCodec_MP3, AudioSetup_EncoderType, Container_MPEG4, 3,               0, NULL },
+
+    { L"wav",     L".wav", L"PCM audio in a WAVE file",
+      AudioCodec_AMR_NB, AudioCodec_PCM, AudioSetup_PCM,         Container_WAVE,  FORMAT_NO_VIDEO, 0, NULL },
+
+    { L"wma",     L".wma", L"PCM audio in an ASF file",
+      AudioCodec_AAC,    AudioCodec_PCM, AudioSetup_PCM,         Container_ASF,   FORMAT_NO_VIDEO, 0, NULL },
+};
+
+const AACProfileInfo aac_profiles[] =
+{
+    { 96000, 2, 16, 24000, 0x29 },
+    { 48000, 2, 16, 24000, 0x29 },
+    { 44100, 2, 16, 16000, 0x29 },
+    { 44100, 2, 16, 12000, 0x29 },
+};
+
+const UINT32 aac_profile_count = ARRAYSIZE(aac_profiles);
+
+enum eAVEncH264VProfile {
+    eAVEncH264VProfile_unknown = 0,
+    eAVEncH264VProfile_Simple = 66,
+    eAVEncH264VProfile_Base = 66,
+    eAVEncH264VProfile_Main = 77,
+    eAVEncH264VProfile_High = 100,
+    eAVEncH264VProfile_422 = 122,
+    eAVEncH264VProfile_High10 = 110,
+    eAVEncH264VProfile_444 = 144,
+    eAVEncH264VProfile_Extended = 88,
+    eAVEncH264VProfile_ScalableBase = 83,
+    eAVEncH264VProfile_ScalableHigh = 86,
+    eAVEncH264VProfile_MultiviewHigh = 118,
+    eAVEncH264VProfile_StereoHigh = 128,
+    eAVEncH264VProfile_ConstrainedBase = 256,
+    eAVEncH264VProfile_UCConstrainedHigh = 257,
+    eAVEncH264VProfile_UCScalableConstrainedBase = 258,
+    eAVEncH264VProfile_UCScalableConstrainedHigh = 259
+};
+
+const H264ProfileInfo h264_profiles[] =
+{
+    { eAVEncH264VProfile_Base,{ 15, 1 },{ 176, 144 },   128000, 0 },
+    { eAVEncH264VProfile_Base,{ 15, 1 },{ 352, 288 },   384000, 0 },
+    { eAVEncH264VProfile_Base,{ 30, 1 },{ 352, 288 },   384000, 0 },
+    { eAVEncH264VProfile_Base,{ 29970, 1000 },{ 320, 240 },   528560, 0 },
+    { eAVEncH264VProfile_Base,{ 15, 1 },{ 720, 576 },  4000000, 0 },
+    { eAVEncH264VProfile_Main,{ 25, 1 },{ 720, 576 }, 10000000, 0 },
+    { eAVEncH264VProfile_Main,{ 30, 1 },{ 352, 288 }, 10000000, 0 },
+    { eAVEncH264VProfile_Base,{ 23, 1 },{ 1280, 720 },  1446912, 0 },
+};
+
+const UINT32 h264_profile_count = ARRAYSIZE(h264_profiles);
+
+const H264ProfileInfo* GetVideoProfile(const OutputFormat *pFormat)
+{
+    if (!pFormat || pFormat->iVideoProfile == FORMAT_NO_VIDEO)
+    {
+        return NULL;
+    }
+
+    if (pFormat->pVideo)
+    {
+        return pFormat->pVideo;
+    }
+
+    if (pFormat->iVideoProfile < 0 || (UINT32)pFormat->iVideoProfile >= h264_profile_count)
+    {
+        return NULL;
+    }
+    return &h264_profiles[pFormat->iVideoProfile];
+}
+
+UINT32 GetOutputFormatCount()
+{
+    return ARRAYSIZE(g_formats);
+}
+
+const OutputFormat* GetOutputFormat(UINT32 index)
+{
+    if (index >= ARRAYSIZE(g_formats))
+    {
+        return NULL;
+    }
+    return &g_formats[index];
+}
+
+//-------------------------------------------------------------------
+//  FindOutputFormat
+//
+//  Looks up a format by its command-line name.
+//-------------------------------------------------------------------
+
+const OutputFormat* FindOutputFormat(const WCHAR *sName)
+{
+    if (!sName)
+    {
+        return NULL;
+    }
+
+    for (UINT32 i = 0; i < ARRAYSIZE(g_formats); i++)
+    {
+        if (_wcsicmp(g_formats[i].sName, sName) == 0)
+        {
+            return &g_formats[i];
+        }
+    }
+    return NULL;
+}
+
+//-------------------------------------------------------------------
+//  FindOutputFormatForFile
+//
+//  Picks the first registered format that uses the file's extension.
+//-------------------------------------------------------------------
+
+const OutputFormat* FindOutputFormatForFile(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return NULL;
+    }
+
+    const WCHAR *pDot = wcsrchr(sPath, L'.');
+    if (!pDot || wcschr(pDot, L'\\') || wcschr(pDot, L'/'))
+    {
+        return NULL;
+    }
+
+    for (UINT32 i = 0; i < ARRAYSIZE(g_formats); i++)
+    {
+        if (_wcsicmp(g_formats[i].sExtension, pDot) == 0)
+        {
+            return &g_formats[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,115 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Formats.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Registry of the output formats the transcoder can produce. Each
+// entry replaces one of the former per-format sample directories
+// (TranscodeToAAC, TranscodeToMP3, ...), so the output format is a
+// run-time choice instead of a separate build.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+// Audio codecs known to the registry.
+enum AudioCodec
+{
+    AudioCodec_AAC,
+    AudioCodec_MP3,
+    AudioCodec_PCM,
+    AudioCodec_AMR_NB,
+};
+
+// Output containers known to the registry.
+enum ContainerType
+{
+    Container_ADTS,
+    Container_MP3,
+    Container_MPEG4,
+    Container_FMPEG4,           // Fragmented MPEG-4 (CMAF)
+    Container_WAVE,
+    Container_ASF,
+};
+
+// How ConfigureAudioOutput turns the encoder's first available output
+// type into the audio attributes of the transcode profile.
+enum AudioSetup
+{
+    AudioSetup_EncoderType,     // Use the encoder's output type as-is.
+    AudioSetup_PCM,             // PCM with the encoder type's rate, channels and depth.
+    AudioSetup_AAC,             // AAC-LC with the fixed settings used for MP4.
+};
+
+// Flags for OutputFormat::dwFlags.
+#define FORMAT_FLAG_MP4_SAMPLE_ENTRY    0x00000001  // Set MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY.
+#define FORMAT_FLAG_HLS                 0x00000002  // Segments and an HLS playlist (Container_FMPEG4).
+#define FORMAT_FLAG_DASH                0x00000004  // Segments and a DASH MPD (Container_FMPEG4).
+
+#define FORMAT_NO_VIDEO                 (-1)
+
+struct H264ProfileInfo;
+
+struct OutputFormat
+{
+    const WCHAR     *sName;             // Name used on the command line.
+    const WCHAR     *sExtension;        // Default extension for derived output names.
+    const WCHAR     *sDescription;
+    AudioCodec      enumCodec;          // Encoder whose output types seed the audio settings.
+    AudioCodec      audioCodec;         // Audio codec written to the container.
+    AudioSetup      audioSetup;
+    ContainerType   container;
+    int             iVideoProfile;      // Index into h264_profiles, or FORMAT_NO_VIDEO.
+    DWORD           dwFlags;
+    const H264ProfileInfo *pVideo;      // Replaces the iVideoProfile entry if set.
+};
+
+struct AACProfileInfo
+{
+    UINT32  samplesPerSec;
+    UINT32  numChannels;
+    UINT32  bitsPerSample;
+    UINT32  bytesPerSec;
+    UINT32  aacProfile;
+};
+
+struct FormatRatio
+{
+    UINT32  Numerator;
+    UINT32  Denominator;
+};
+
+struct H264ProfileInfo
+{
+    UINT32      profile;
+    FormatRatio fps;
+    FormatRatio frame_size;
+    UINT32      bitrate;
+    UINT32      keyframeSpacing;    // Frames from one keyframe to the next; 0 lets the encoder choose.
+};
+
+extern const AACProfileInfo     aac_profiles[];
+extern const UINT32             aac_profile_count;
+
+extern const H264ProfileInfo    h264_profiles[];
+extern const UINT32             h264_profile_count;
+
+// Video settings of pFormat, or NULL if it has no video or an
+// invalid profile index.
+const H264ProfileInfo* GetVideoProfile(const OutputFormat *pFormat);
+
+UINT32              GetOutputFormatCount();
+const OutputFormat* GetOutputFormat(UINT32 index);
+
+// Finds a format by name (case-insensitive), e.g. L"aac" or L"mp4-mp3".
+const OutputFormat* FindOutputFormat(const WCHAR *sName);
+
+// Finds the first format whose extension matches the extension of sPath.
+const OutputFormat* FindOutputFormatForFile(const WCHAR *sPath);
@@ -0,0 +1,34 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Id3.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// ID3v2 tags, which may precede the first frame of ADTS and MPEG
+// audio streams.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+#define ID3_HEADER_SIZE     10
+
+// Returns the size of the ID3v2 tag at pData, header included, or 0 if
+// pData does not start with a tag.
+inline UINT32 Id3TagSize(const BYTE *pData, DWORD cb)
+{
+    if (cb < ID3_HEADER_SIZE || pData[0] != 'I' || pData[1] != 'D' || pData[2] != '3')
+    {
+        return 0;
+    }
+
+    // Syncsafe size, excluding the header.
+    return ID3_HEADER_SIZE + ((pData[6] & 0x7F) << 21 | (pData[7] & 0x7F) << 14 |
+        (pData[8] & 0x7F) << 7 | (pData[9] & 0x7F));
+}
@@ -0,0 +1,178 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Ladder.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Ladder.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+
+HRESULT ParseLadderRungs(const WCHAR *sList, UINT32 *pRungs, DWORD *pcRungs)
+{
+    if (!sList || !pRungs || !pcRungs)
+    {
+        return E_INVALIDARG;
+    }
+
+    DWORD cRungs = 0;
+
+    if (_wcsicmp(sList, L"all") == 0)
+    {
+        for (UINT32 i = 0; i < h264_profile_count && cRungs < LADDER_MAX_RUNGS; i++)
+        {
+            pRungs[cRungs++] = i;
+        }
+        *pcRungs = cRungs;
+        return S_OK;
+    }
+
+    const WCHAR *p = sList;
+
+    while (*p)
+    {
+        WCHAR *pEnd = NULL;
+        unsigned long iRung = wcstoul(p, &pEnd, 10);
+
+        if (pEnd == p || (*pEnd != L',' && *pEnd != L'\0') ||
+            iRung >= h264_profile_count || cRungs == LADDER_MAX_RUNGS)
+        {
+            return E_INVALIDARG;
+        }
+
+        pRungs[cRungs++] = (UINT32)iRung;
+        p = (*pEnd == L',') ? pEnd + 1 : pEnd;
+    }
+
+    if (cRungs == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    *pcRungs = cRungs;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  CBitrateLadder
+//-------------------------------------------------------------------
+
+CBitrateLadder::CBitrateLadder() : m_cRungs(0)
+{
+    memset(m_formats, 0, sizeof(m_formats));
+    memset(m_video, 0, sizeof(m_video));
+}
+
+static UINT32 FrameArea(const H264ProfileInfo &info)
+{
+    return info.frame_size.Numerator * info.frame_size.Denominator;
+}
+
+//-------------------------------------------------------------------
+//  Plan
+//
+//  Sorts the renditions by frame area, largest first, so the main
+//  output of the job is the top rendition, and gives them its frame
+//  rate and a keyframe interval of whole frames.
+//-------------------------------------------------------------------
+
+HRESULT CBitrateLadder::Plan(const OutputFormat *pBase, const UINT32 *pRungs, DWORD cRungs)
+{
+    if (!pBase || !pRungs || cRungs == 0 || cRungs > LADDER_MAX_RUNGS)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (GetVideoProfile(pBase) == NULL)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    m_cRungs = 0;
+
+    for (DWORD i = 0; i < cRungs; i++)
+    {
+        if (pRungs[i] >= h264_profile_count)
+        {
+            return E_INVALIDARG;
+        }
+
+        const H264ProfileInfo &info = h264_profiles[pRungs[i]];
+
+        BOOL fDuplicate = FALSE;
+
+        for (DWORD j = 0; j < m_cRungs && !fDuplicate; j++)
+        {
+            fDuplicate = m_video[j].bitrate == info.bitrate &&
+                m_video[j].frame_size.Numerator == info.frame_size.Numerator &&
+                m_video[j].frame_size.Denominator == info.frame_size.Denominator;
+        }
+
+        if (fDuplicate)
+        {
+            continue;
+        }
+
+        // Insertion sort by frame area, then bitrate.
+        DWORD iInsert = m_cRungs;
+
+        while (iInsert > 0 &&
+            (FrameArea(m_video[iInsert - 1]) < FrameArea(info) ||
+             (FrameArea(m_video[iInsert - 1]) == FrameArea(info) && m_video[iInsert - 1].bitrate < info.bitrate)))
+        {
+            m_video[iInsert] = m_video[iInsert - 1];
+            m_formats[iInsert] = m_formats[iInsert - 1];
+            iInsert--;
+        }
+
+        m_video[iInsert] = info;
+        m_formats[iInsert] = *pBase;
+        m_formats[iInsert].iVideoProfile = (int)pRungs[i];
+        m_cRungs++;
+    }
+
+    const FormatRatio fps = m_video[0].fps;
+
+    UINT32 keyframeSpacing = (UINT32)(((UINT64)LADDER_KEYFRAME_SECONDS * fps.Numerator + fps.Denominator / 2) / fps.Denominator);
+
+    for (DWORD i = 0; i < m_cRungs; i++)
+    {
+        m_video[i].fps = fps;
+        m_video[i].keyframeSpacing = keyframeSpacing ? keyframeSpacing : 1;
+        m_formats[i].pVideo = &m_video[i];
+    }
+    return S_OK;
+}
+
+const OutputFormat* CBitrateLadder::GetFormat(DWORD iRung) const
+{
+    return iRung < m_cRungs ? &m_formats[iRung] : NULL;
+}
+
+HRESULT CBitrateLadder::GetOutputName(DWORD iRung, const WCHAR *sOutput, WCHAR *szPath, size_t cchPath) const
+{
+    if (iRung >= m_cRungs || !sOutput || !szPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    size_t iName, cchBase;
+    SplitPathName(sOutput, &iName, &cchBase);
+
+    const H264ProfileInfo &info = m_video[iRung];
+
+    int cch = swprintf_s(szPath, cchPath, L"%.*ls_%ux%u_%uk%ls",
+        (int)cchBase, sOutput,
+        info.frame_size.Numerator, info.frame_size.Denominator,
+        (info.bitrate + 500) / 1000,
+        sOutput[cchBase] ? sOutput + cchBase : m_formats[iRung].sExtension);
+
+    return cch < 0 ? HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE) : S_OK;
+}
@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Ladder.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Adaptive bitrate ladder. A ladder turns one video format into a set
+// of renditions, one per selected h264_profiles entry, all encoded in
+// one job from a single decode of the source (see
+// ITranscodeSession::AddOutput). Each rendition keeps the frame size
+// and bitrate of its entry; all of them share the frame rate of the
+// largest rendition and a keyframe every LADDER_KEYFRAME_SECONDS, so a
+// player can switch renditions at any keyframe.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "Formats.h"
+#include "Backend.h"
+
+#define LADDER_MAX_RUNGS            SESSION_MAX_OUTPUTS
+#define LADDER_KEYFRAME_SECONDS     2
+
+// Parses a list of h264_profiles indices separated by commas, or
+// "all" for every entry, into pRungs (at most LADDER_MAX_RUNGS).
+HRESULT ParseLadderRungs(const WCHAR *sList, UINT32 *pRungs, DWORD *pcRungs);
+
+class CBitrateLadder
+{
+public:
+    CBitrateLadder();
+
+    // Builds a rendition of pBase for each h264_profiles index in
+    // pRungs, largest frame first. pBase must have video. Entries with
+    // the frame size and bitrate of an earlier one add nothing, since
+    // the ladder replaces their frame rate.
+    HRESULT Plan(const OutputFormat *pBase, const UINT32 *pRungs, DWORD cRungs);
+
+    DWORD   RungCount() const { return m_cRungs; }
+
+    const OutputFormat* GetFormat(DWORD iRung) const;
+
+    // Names the output of a rendition after sOutput, with the frame
+    // size and bitrate before the extension: out.mp4 becomes
+    // out_1280x720_1447k.mp4.
+    HRESULT GetOutputName(DWORD iRung, const WCHAR *sOutput, WCHAR *szPath, size_t cchPath) const;
+
+private:
+
+    OutputFormat        m_formats[LADDER_MAX_RUNGS];
+    H264ProfileInfo     m_video[LADDER_MAX_RUNGS];
+    DWORD               m_cRungs;
+};
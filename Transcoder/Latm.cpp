@@ -0,0 +1,675 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Latm.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Latm.h"
+#include "Pcm.h"
+
+#include <string.h>
+
+#define AAC_OBJECT_SBR          5
+#define AAC_OBJECT_PS           29
+#define AAC_OBJECT_ESCAPE       31
+#define AAC_EXPLICIT_RATE       15      // Sampling frequency index
+
+#define LATM_MAX_SUBFRAMES      4       // Raw data blocks in an ADTS frame
+
+//-------------------------------------------------------------------
+//  CBitReader
+//
+//  Reads big-endian bit fields. Reading past the end returns zeros and
+//  sets Overrun, so a parser checks once at the end.
+//-------------------------------------------------------------------
+
+class CBitReader
+{
+public:
+    CBitReader(const BYTE *pData, DWORD cbData) :
+        m_pData(pData), m_cBits((UINT64)cbData * 8), m_iBit(0)
+    {
+
+    }
+
+    UINT32 Read(UINT32 cBits)
+    {
+        UINT32 value = 0;
+
+        for (UINT32 i = 0; i < cBits; i++, m_iBit++)
+        {
+            UINT32 bit = 0;
+
+            if (m_iBit < m_cBits)
+            {
+                bit = (m_pData[m_iBit >> 3] >> (7 - (m_iBit & 7))) & 1;
+            }
+            value = (value << 1) | bit;
+        }
+        return value;
+    }
+
+    // Copies cb bytes, which need not start on a byte boundary.
+    void ReadBytes(BYTE *pDest, DWORD cb)
+    {
+        if ((m_iBit & 7) == 0 && m_iBit + (UINT64)cb * 8 <= m_cBits)
+        {
+            memcpy(pDest, m_pData + (m_iBit >> 3), cb);
+            m_iBit += (UINT64)cb * 8;
+            return;
+        }
+
+        for (DWORD i = 0; i < cb; i++)
+        {
+            pDest[i] = (BYTE)Read(8);
+        }
+    }
+
+    void    Skip(UINT64 cBits) { m_iBit += cBits; }
+    UINT64  Position() const { return m_iBit; }
+    BOOL    Overrun() const { return m_iBit > m_cBits; }
+
+private:
+
+    const BYTE* m_pData;
+    UINT64      m_cBits;
+    UINT64      m_iBit;
+};
+
+static UINT32 ReadObjectType(CBitReader &bits)
+{
+    UINT32 objectType = bits.Read(5);
+
+    if (objectType == AAC_OBJECT_ESCAPE)
+    {
+        objectType = 32 + bits.Read(6);
+    }
+    return objectType;
+}
+
+// Reads a sampling frequency index, skipping an explicit frequency.
+static UINT32 ReadSampleRateIndex(CBitReader &bits)
+{
+    UINT32 index = bits.Read(4);
+
+    if (index == AAC_EXPLICIT_RATE)
+    {
+        bits.Skip(24);
+    }
+    return index;
+}
+
+// LatmGetValue: 2 bits give the number of bytes, less one, that follow.
+static UINT32 ReadLatmValue(CBitReader &bits)
+{
+    UINT32 cBytes = bits.Read(2) + 1;
+    UINT32 value = 0;
+
+    for (UINT32 i = 0; i < cBytes; i++)
+    {
+        value = (value << 8) | bits.Read(8);
+    }
+    return value;
+}
+
+//-------------------------------------------------------------------
+//  ParseAudioSpecificConfig
+//
+//  Reads the fields ADTS carries. An SBR or PS configuration names the
+//  AAC core after the extension's sampling frequency; ADTS signals the
+//  core and leaves SBR implicit.
+//-------------------------------------------------------------------
+
+static HRESULT ParseAudioSpecificConfig(CBitReader &bits, AdtsHeader *pFormat)
+{
+    UINT32 objectType = ReadObjectType(bits);
+    UINT32 sampleRateIndex = ReadSampleRateIndex(bits);
+    UINT32 channels = bits.Read(4);
+
+    if (objectType == AAC_OBJECT_SBR || objectType == AAC_OBJECT_PS)
+    {
+        (void)ReadSampleRateIndex(bits);
+        objectType = ReadObjectType(bits);
+    }
+
+    // AAC Main, LC, SSR and LTP, the profiles ADTS can signal.
+    if (objectType < 1 || objectType > 4)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    // GASpecificConfig
+    UINT32 fShortFrames = bits.Read(1);
+
+    if (bits.Read(1))
+    {
+        bits.Skip(14);              // coreCoderDelay
+    }
+    (void)bits.Read(1);             // extensionFlag: 0 for these types
+
+    if (bits.Overrun())
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    if (fShortFrames || channels == 0 || AdtsSampleRate(sampleRateIndex) == 0)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    memset(pFormat, 0, sizeof(*pFormat));
+    pFormat->profile = objectType - 1;
+    pFormat->sampleRateIndex = sampleRateIndex;
+    pFormat->sampleRate = AdtsSampleRate(sampleRateIndex);
+    pFormat->channels = channels;
+    pFormat->cbHeader = ADTS_HEADER_SIZE;
+    pFormat->cRawBlocks = 1;
+    return S_OK;
+}
+
+HRESULT ParseAudioSpecificConfig(const BYTE *pConfig, DWORD cbConfig, AdtsHeader *pFormat)
+{
+    if (!pConfig || !pFormat)
+    {
+        return E_POINTER;
+    }
+
+    CBitReader bits(pConfig, cbConfig);
+
+    return ParseAudioSpecificConfig(bits, pFormat);
+}
+
+BOOL IsLoasHeader(const BYTE *pData, DWORD cb)
+{
+    return cb >= 2 && pData[0] == 0x56 && (pData[1] & 0xE0) == 0xE0;
+}
+
+//-------------------------------------------------------------------
+//  CAdtsFramer
+//-------------------------------------------------------------------
+
+CAdtsFramer::CAdtsFramer() : m_fInitialized(FALSE)
+{
+    memset(&m_format, 0, sizeof(m_format));
+}
+
+HRESULT CAdtsFramer::Initialize(const BYTE *pConfig, DWORD cbConfig)
+{
+    HRESULT hr = ParseAudioSpecificConfig(pConfig, cbConfig, &m_format);
+
+    m_fInitialized = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT CAdtsFramer::Frame(const BYTE *pAu, DWORD cbAu, const BYTE **ppFrame, DWORD *pcbFrame)
+{
+    if (!pAu || !ppFrame || !pcbFrame)
+    {
+        return E_POINTER;
+    }
+
+    if (!m_fInitialized)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (cbAu > ADTS_MAX_FRAME_SIZE - ADTS_HEADER_SIZE)
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    m_format.cbFrame = ADTS_HEADER_SIZE + cbAu;
+
+    HRESULT hr = WriteAdtsHeader(m_format, m_frame);
+
+    if (SUCCEEDED(hr))
+    {
+        memcpy(m_frame + ADTS_HEADER_SIZE, pAu, cbAu);
+
+        *ppFrame = m_frame;
+        *pcbFrame = m_format.cbFrame;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CLoasReader
+//-------------------------------------------------------------------
+
+CLoasReader::CLoasReader() :
+    m_pFile(NULL),
+    m_fConfig(FALSE),
+    m_cSubFrames(0),
+    m_cOtherDataBits(0),
+    m_cbStart(0),
+    m_cbPosition(0),
+    m_iSample(0)
+{
+    memset(&m_first, 0, sizeof(m_first));
+    memset(&m_format, 0, sizeof(m_format));
+}
+
+CLoasReader::~CLoasReader()
+{
+    Close();
+}
+
+void CLoasReader::Close()
+{
+    m_pFile = NULL;
+    m_fConfig = FALSE;
+    m_file.Close();
+}
+
+HRESULT CLoasReader::Open(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    Close();
+
+    HRESULT hr = m_file.Open(sPath);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Open(&m_file);
+    }
+
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Open
+//
+//  Finds the first frame that carries a StreamMuxConfig; frames before
+//  it cannot be repacked and are skipped. That frame is repacked once
+//  for the format.
+//-------------------------------------------------------------------
+
+HRESULT CLoasReader::Open(CMappedFile *pFile)
+{
+    if (!pFile)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (pFile != &m_file)
+    {
+        Close();
+    }
+
+    m_pFile = pFile;
+    m_fConfig = FALSE;
+    m_cbStart = 0;
+    m_iSample = 0;
+
+    HRESULT hr = S_OK;
+
+    for (;;)
+    {
+        const BYTE *pFrame = NULL;
+        DWORD cbFrame = 0;
+
+        hr = ViewFrame(m_cbStart, &pFrame, &cbFrame);
+
+        if (SUCCEEDED(hr) && cbFrame == 0)
+        {
+            hr = MF_E_UNSUPPORTED_BYTESTREAM_TYPE;
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = ParseFrame(pFrame, cbFrame, TRUE);
+        }
+
+        if (hr != S_FALSE)
+        {
+            break;
+        }
+
+        m_cbStart += cbFrame;
+    }
+
+    m_cbPosition = m_cbStart;
+    m_first = m_format;
+
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ViewFrame
+//
+//  Points *ppFrame at the LOAS frame at cbOffset, sync header included.
+//  *pcbFrame is 0 at the end of the stream, or if the last frame is
+//  truncated.
+//-------------------------------------------------------------------
+
+HRESULT CLoasReader::ViewFrame(UINT64 cbOffset, const BYTE **ppFrame, DWORD *pcbFrame)
+{
+    const BYTE *pHeader = NULL;
+    DWORD cbRead = 0;
+
+    *ppFrame = NULL;
+    *pcbFrame = 0;
+
+    HRESULT hr = m_pFile->View(cbOffset, LOAS_HEADER_SIZE, &pHeader, &cbRead);
+
+    if (FAILED(hr) || cbRead == 0)
+    {
+        return hr;      // End of stream
+    }
+
+    if (cbRead != LOAS_HEADER_SIZE || !IsLoasHeader(pHeader, cbRead))
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    DWORD cbFrame = LOAS_HEADER_SIZE + (((DWORD)(pHeader[1] & 0x1F) << 8) | pHeader[2]);
+
+    hr = m_pFile->View(cbOffset, cbFrame, ppFrame, &cbRead);
+
+    if (SUCCEEDED(hr) && cbRead == cbFrame)
+    {
+        *pcbFrame = cbFrame;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ParseFrame
+//
+//  Parses an AudioMuxElement with in-band configuration and, if
+//  fRepack, gathers the payloads of its subframes behind an ADTS header
+//  in m_frame. Returns S_FALSE for a frame that refers to a
+//  configuration not seen yet.
+//-------------------------------------------------------------------
+
+HRESULT CLoasReader::ParseFrame(const BYTE *pFrame, DWORD cbFrame, BOOL fRepack)
+{
+    CBitReader bits(pFrame + LOAS_HEADER_SIZE, cbFrame - LOAS_HEADER_SIZE);
+    HRESULT hr = S_OK;
+
+    // useSameStreamMux
+    if (bits.Read(1) == 0)
+    {
+        // StreamMuxConfig
+        UINT32 audioMuxVersion = bits.Read(1);
+
+        if (audioMuxVersion && bits.Read(1))
+        {
+            return MF_E_INVALIDMEDIATYPE;   // audioMuxVersionA
+        }
+
+        if (audioMuxVersion)
+        {
+            (void)ReadLatmValue(bits);      // taraBufferFullness
+        }
+
+        UINT32 fSameTimeFraming = bits.Read(1);
+        UINT32 cSubFrames = bits.Read(6) + 1;
+        UINT32 cPrograms = bits.Read(4) + 1;
+        UINT32 cLayers = bits.Read(3) + 1;
+
+        if (!fSameTimeFraming || cPrograms != 1 || cLayers != 1 || cSubFrames > LATM_MAX_SUBFRAMES)
+        {
+            return MF_E_INVALIDMEDIATYPE;
+        }
+
+        if (audioMuxVersion)
+        {
+            UINT32 cbitConfig = ReadLatmValue(bits);
+            UINT64 iStart = bits.Position();
+
+            hr = ParseAudioSpecificConfig(bits, &m_format);
+
+            // Skip what follows the fields ADTS needs.
+            if (SUCCEEDED(hr) && bits.Position() - iStart > cbitConfig)
+            {
+                hr = MF_E_INVALID_FORMAT;
+            }
+            else if (SUCCEEDED(hr))
+            {
+                bits.Skip(iStart + cbitConfig - bits.Position());
+            }
+        }
+        else
+        {
+            hr = ParseAudioSpecificConfig(bits, &m_format);
+        }
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        // Only frameLengthType 0, a payload length per subframe.
+        if (bits.Read(3) != 0)
+        {
+            return MF_E_INVALIDMEDIATYPE;
+        }
+        bits.Skip(8);                       // latmBufferFullness
+
+        m_cOtherDataBits = 0;
+
+        if (bits.Read(1))                   // otherDataPresent
+        {
+            if (audioMuxVersion)
+            {
+                m_cOtherDataBits = ReadLatmValue(bits);
+            }
+            else
+            {
+                UINT32 fEscape = 0;
+                do
+                {
+                    fEscape = bits.Read(1);
+                    m_cOtherDataBits = (m_cOtherDataBits << 8) | bits.Read(8);
+                }
+                while (fEscape);
+            }
+        }
+
+        if (bits.Read(1))                   // crcCheckPresent
+        {
+            bits.Skip(8);
+        }
+
+        m_cSubFrames = cSubFrames;
+        m_fConfig = TRUE;
+    }
+    else if (!m_fConfig)
+    {
+        return S_FALSE;
+    }
+
+    if (!fRepack)
+    {
+        return bits.Overrun() ? MF_E_INVALID_FORMAT : S_OK;
+    }
+
+    DWORD cbPayload = 0;
+
+    for (UINT32 i = 0; i < m_cSubFrames; i++)
+    {
+        // PayloadLengthInfo: bytes in 255s, then the rest.
+        DWORD cbSubFrame = 0;
+        UINT32 cbPart = 0;
+        do
+        {
+            cbPart = bits.Read(8);
+            cbSubFrame += cbPart;
+        }
+        while (cbPart == 255 && !bits.Overrun());
+
+        if (cbSubFrame > ADTS_MAX_FRAME_SIZE - ADTS_HEADER_SIZE - cbPayload)
+        {
+            return MF_E_INVALID_FORMAT;
+        }
+
+        // PayloadMux
+        bits.ReadBytes(m_frame + ADTS_HEADER_SIZE + cbPayload, cbSubFrame);
+        cbPayload += cbSubFrame;
+    }
+
+    bits.Skip(m_cOtherDataBits);
+
+    if (bits.Overrun())
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    m_format.cbFrame = ADTS_HEADER_SIZE + cbPayload;
+    m_format.cRawBlocks = m_cSubFrames;
+
+    return WriteAdtsHeader(m_format, m_frame);
+}
+
+//-------------------------------------------------------------------
+//  SkipToSample
+//
+//  Positions the reader at the frame that contains sample iTarget, or
+//  at the end of the stream. Configurations are parsed on the way,
+//  since the number of subframes can change, but payloads are not
+//  copied.
+//-------------------------------------------------------------------
+
+HRESULT CLoasReader::SkipToSample(UINT64 iTarget)
+{
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    m_cbPosition = m_cbStart;
+    m_iSample = 0;
+
+    while (m_iSample < iTarget)
+    {
+        const BYTE *pFrame = NULL;
+        DWORD cbFrame = 0;
+
+        HRESULT hr = ViewFrame(m_cbPosition, &pFrame, &cbFrame);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        if (cbFrame == 0)
+        {
+            break;
+        }
+
+        hr = ParseFrame(pFrame, cbFrame, FALSE);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        UINT64 cSamples = (UINT64)m_cSubFrames * ADTS_SAMPLES_PER_FRAME;
+
+        if (m_iSample + cSamples > iTarget)
+        {
+            break;  // This frame contains the target; read it next.
+        }
+
+        m_iSample += cSamples;
+        m_cbPosition += cbFrame;
+    }
+    return S_OK;
+}
+
+HRESULT CLoasReader::SeekToTime(LONGLONG hnsStart)
+{
+    return SkipToSample(HnsToSamples(hnsStart, m_first.sampleRate));
+}
+
+HRESULT CLoasReader::GetDuration(LONGLONG *phnsDuration)
+{
+    if (!phnsDuration)
+    {
+        return E_POINTER;
+    }
+
+    if (m_pFile && m_pFile->IsStream())
+    {
+        *phnsDuration = 0;
+        return S_OK;
+    }
+
+    UINT64 cbPosition = m_cbPosition;
+    UINT64 iSample = m_iSample;
+
+    HRESULT hr = SkipToSample((UINT64)-1);
+
+    if (SUCCEEDED(hr))
+    {
+        *phnsDuration = SamplesToHns(m_iSample, m_first.sampleRate);
+    }
+
+    // The walk leaves the configuration of the last frame, which the
+    // next frame read may not share; walk back to it.
+    if (SUCCEEDED(hr))
+    {
+        hr = SkipToSample(iSample);
+    }
+
+    m_cbPosition = cbPosition;
+    m_iSample = iSample;
+
+    return hr;
+}
+
+HRESULT CLoasReader::ReadFrame(const BYTE **ppFrame, DWORD *pcbFrame, AdtsHeader *pHeader)
+{
+    if (!ppFrame || !pcbFrame || !pHeader)
+    {
+        return E_POINTER;
+    }
+
+    *ppFrame = NULL;
+    *pcbFrame = 0;
+
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    const BYTE *pFrame = NULL;
+    DWORD cbFrame = 0;
+
+    HRESULT hr = ViewFrame(m_cbPosition, &pFrame, &cbFrame);
+
+    if (FAILED(hr) || cbFrame == 0)
+    {
+        return hr;      // End of stream
+    }
+
+    hr = ParseFrame(pFrame, cbFrame, TRUE);
+
+    if (SUCCEEDED(hr))
+    {
+        *pHeader = m_format;
+        *ppFrame = m_frame;
+        *pcbFrame = m_format.cbFrame;
+        m_cbPosition += cbFrame;
+        m_iSample += (UINT64)m_format.cRawBlocks * ADTS_SAMPLES_PER_FRAME;
+    }
+    return hr;
+}
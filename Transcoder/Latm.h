@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Latm.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// AAC in LOAS/LATM (ISO/IEC 14496-3, 1.7) and as raw access units,
+// repacked as ADTS frames without decoding, for the portable backend.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "MappedFile.h"
+#include "Adts.h"
+
+#define LOAS_HEADER_SIZE        3       // 11-bit sync word, 13-bit length
+
+// Returns TRUE if the first cb bytes start with a LOAS AudioSyncStream
+// sync word.
+BOOL    IsLoasHeader(const BYTE *pData, DWORD cb);
+
+// Parses an AudioSpecificConfig into the fields of an ADTS header.
+// Fails with MF_E_INVALIDMEDIATYPE for streams ADTS cannot carry: object
+// types other than AAC Main, LC, SSR and LTP (HE-AAC is carried as its
+// AAC core), 960-sample frames, explicit sampling rates and channel
+// configurations given by a program config element.
+HRESULT ParseAudioSpecificConfig(const BYTE *pConfig, DWORD cbConfig, AdtsHeader *pFormat);
+
+//-------------------------------------------------------------------
+//  CAdtsFramer
+//
+//  Wraps raw AAC access units, such as the samples of an MP4 track,
+//  in ADTS headers.
+//-------------------------------------------------------------------
+
+class CAdtsFramer
+{
+public:
+    CAdtsFramer();
+
+    // Takes the format from the stream's AudioSpecificConfig.
+    HRESULT Initialize(const BYTE *pConfig, DWORD cbConfig);
+
+    const AdtsHeader& Format() const { return m_format; }
+
+    // Points *ppFrame at pAu behind an ADTS header. The frame stays
+    // valid until the next call.
+    HRESULT Frame(const BYTE *pAu, DWORD cbAu, const BYTE **ppFrame, DWORD *pcbFrame);
+
+private:
+
+    AdtsHeader  m_format;
+    BOOL        m_fInitialized;
+    BYTE        m_frame[ADTS_MAX_FRAME_SIZE];
+};
+
+//-------------------------------------------------------------------
+//  CLoasReader
+//
+//  Reads a LOAS stream, AudioMuxElements with in-band configuration,
+//  one frame at a time and repacks each as an ADTS frame. The subframes
+//  of a LOAS frame become the raw data blocks of the ADTS frame. Only
+//  one program and layer, with a variable frame length, is supported.
+//-------------------------------------------------------------------
+
+class CLoasReader
+{
+public:
+    CLoasReader();
+    ~CLoasReader();
+
+    HRESULT Open(const WCHAR *sPath);
+
+    // Reads from pFile, which the caller keeps open until Close.
+    HRESULT Open(CMappedFile *pFile);
+    void    Close();
+
+    // Header of the first ADTS frame.
+    const AdtsHeader& Format() const { return m_first; }
+
+    // Skips whole frames until the frame that contains hnsStart.
+    HRESULT SeekToTime(LONGLONG hnsStart);
+
+    // Sample position of the next frame.
+    UINT64  Position() const { return m_iSample; }
+
+    // Bytes from the first frame to the end of the file; 0 if the
+    // input is a stream.
+    UINT64  StreamSize() const { return m_pFile->IsStream() ? 0 : m_pFile->Size() - m_cbStart; }
+
+    // Walks the frames to the end of the stream. The read position is
+    // kept. The duration of an input stream is 0.
+    HRESULT GetDuration(LONGLONG *phnsDuration);
+
+    // Points *ppFrame at the next frame, repacked as ADTS. *pcbFrame is
+    // 0 at the end of the stream. The frame stays valid until the next
+    // ReadFrame.
+    HRESULT ReadFrame(const BYTE **ppFrame, DWORD *pcbFrame, AdtsHeader *pHeader);
+
+private:
+
+    HRESULT ViewFrame(UINT64 cbOffset, const BYTE **ppFrame, DWORD *pcbFrame);
+    HRESULT ParseFrame(const BYTE *pFrame, DWORD cbFrame, BOOL fRepack);
+    HRESULT SkipToSample(UINT64 iTarget);
+
+    CMappedFile m_file;         // If opened by path
+    CMappedFile* m_pFile;       // m_file or the caller's
+    AdtsHeader  m_first;
+    AdtsHeader  m_format;       // From the last StreamMuxConfig
+    BOOL        m_fConfig;      // m_format is set
+    UINT32      m_cSubFrames;
+    UINT32      m_cOtherDataBits;
+    UINT64      m_cbStart;      // Offset of the first frame with a configuration
+    UINT64      m_cbPosition;   // Offset of the next frame
+    UINT64      m_iSample;      // Sample position of the next frame
+    BYTE        m_frame[ADTS_MAX_FRAME_SIZE];
+};
@@ -0,0 +1,2224 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MFBackend.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+//
+// Media Foundation backend. The transcode session is an IMFMediaSession
+// running a topology built by MFCreateTranscodeTopology, or, when the
+// source audio already has the output codec, a topology that connects
+// the source stream straight to the container sink (stream copy).
+// With added outputs, the transcode topologies of all the outputs are
+// merged behind one decoder and a tee node per source stream.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Backend.h"
+#include "MFTypeCache.h"
+#include "MFProfileCache.h"
+
+#include <assert.h>
+#include <mfapi.h>
+#include <mfidl.h>
+#include <mferror.h>
+#include <shlwapi.h>
+#include <new>
+
+HRESULT CreateMediaSource(const WCHAR *sURL, IMFMediaSource** ppMediaSource);
+HRESULT CreateMediaSourceFromMemory(const BYTE *pData, UINT64 cbData, IMFMediaSource** ppMediaSource);
+
+//-------------------------------------------------------------------
+//  Media Foundation identifiers for the format registry enums.
+//-------------------------------------------------------------------
+
+static const GUID& GetAudioSubtype(AudioCodec codec)
+{
+    switch (codec)
+    {
+    case AudioCodec_AAC:    return MFAudioFormat_AAC;
+    case AudioCodec_MP3:    return MFAudioFormat_MP3;
+    case AudioCodec_AMR_NB: return MFAudioFormat_AMR_NB;
+    default:                return MFAudioFormat_PCM;
+    }
+}
+
+static const GUID& GetContainerGuid(ContainerType container)
+{
+    switch (container)
+    {
+    case Container_ADTS:    return MFTranscodeContainerType_ADTS;
+    case Container_MP3:     return MFTranscodeContainerType_MP3;
+    case Container_MPEG4:   return MFTranscodeContainerType_MPEG4;
+    case Container_FMPEG4:  return MFTranscodeContainerType_FMPEG4;
+    case Container_WAVE:    return MFTranscodeContainerType_WAVE;
+    default:                return MFTranscodeContainerType_ASF;
+    }
+}
+
+// MF_MPEG4SINK_MOOV_BEFORE_MDAT, which older SDK headers lack. The
+// MPEG-4 sink then writes the movie box ahead of the media data (fast
+// start), relocating it with one sequential copy when it finalizes.
+// Sinks that predate the attribute ignore it.
+static const GUID MPEG4SINK_MOOV_BEFORE_MDAT =
+    { 0xf672e3ac, 0xe1e6, 0x4f10, { 0xb5, 0xec, 0x5f, 0x3b, 0x30, 0x82, 0x88, 0x16 } };
+
+//-------------------------------------------------------------------
+//  CMFTranscodeSession
+//-------------------------------------------------------------------
+
+class CMFTranscodeSession : public ITranscodeSession
+{
+public:
+    CMFTranscodeSession(CAudioTypeCache *pTypeCache, CProfileCache *pProfileCache);
+    virtual ~CMFTranscodeSession();
+
+    HRESULT OpenSource(const WCHAR *sURL);
+    HRESULT OpenSourceMemory(const BYTE *pData, UINT64 cbData);
+    HRESULT ConfigureAudio(const OutputFormat *pFormat);
+    HRESULT ConfigureVideo(const OutputFormat *pFormat);
+    HRESULT ConfigureContainer(const OutputFormat *pFormat);
+    HRESULT SetStreamCopy(BOOL fAllow);
+    HRESULT SetSampleRate(UINT32 sampleRate);
+    HRESULT SetStopTime(LONGLONG hnsStop);
+    HRESULT GetMediaInfo(MediaInfo *pInfo);
+    HRESULT AddOutput(const OutputFormat *pFormat, const WCHAR *sURL);
+    HRESULT SetOutput(const WCHAR *sURL);
+    HRESULT SetOutputSink(IOutputSink *pSink);
+    HRESULT Start(LONGLONG hnsStart);
+    HRESULT GetPosition(LONGLONG *phnsPosition);
+    HRESULT BeginGetEvent(ISessionEventCallback *pCallback);
+    HRESULT Close();
+    HRESULT Shutdown();
+    HRESULT Reset();
+
+private:
+
+    HRESULT CreateSessionAndProfile();
+    HRESULT GetProfileSettings(const OutputFormat *pFormat, const ProfileSettings **ppSettings);
+
+    static HRESULT ApplyProfileSettings(IMFTranscodeProfile *pProfile, const ProfileSettings *pSettings);
+    static HRESULT BuildProfileSettings(const OutputFormat *pFormat, UINT32 outputSampleRate, void *pContext,
+        ProfileSettings *pSettings);
+    static HRESULT CreateAudioAttributes(CAudioTypeCache *pTypeCache, const OutputFormat *pFormat,
+        UINT32 outputSampleRate, IMFAttributes **ppAttrs);
+    static HRESULT CreateVideoAttributes(const OutputFormat *pFormat, IMFAttributes **ppAttrs);
+    static HRESULT CreateContainerAttributes(const OutputFormat *pFormat, IMFAttributes **ppAttrs);
+
+    HRESULT CreateCopyTopology(const WCHAR *sURL);
+    HRESULT CreateTeeTopology(const WCHAR *sURL);
+    HRESULT CreateContainerSink(IMFByteStream *pByteStream, IMFMediaType *pType);
+    HRESULT ApplyStopTime();
+
+    CAudioTypeCache*        m_pTypeCache;       // Owned by the backend
+    CProfileCache*          m_pProfileCache;    // Owned by the backend
+    const OutputFormat*     m_pFormat;
+    const ProfileSettings*  m_pSettings;        // Of m_pFormat, from the profile cache
+    BOOL                    m_fStreamCopy;
+    UINT32                  m_sampleRate;       // 0 keeps the encoder type's rate
+    LONGLONG                m_hnsStop;
+    IMFMediaSession*        m_pSession;
+    IMFMediaSource*         m_pSource;
+    IMFTopology*            m_pTopology;
+    IMFTranscodeProfile*    m_pProfile;
+    const OutputFormat*     m_pProfileFormat;   // Format m_pProfile is complete for
+    UINT32                  m_profileSampleRate;
+    BOOL                    m_fProfileKept;     // Configured by an earlier job
+    IMFMediaSink*           m_pSink;            // Stream copy only
+    IMFPresentationClock*   m_pClock;           // Set by Start
+
+    // Outputs added with AddOutput.
+    IMFTranscodeProfile*    m_pExtraProfiles[SESSION_MAX_OUTPUTS - 1];
+    WCHAR                   m_szExtraURLs[SESSION_MAX_OUTPUTS - 1][MAX_PATH];
+    DWORD                   m_cExtraOutputs;
+};
+
+//-------------------------------------------------------------------
+//  CMFTranscodeSession constructor
+//-------------------------------------------------------------------
+
+CMFTranscodeSession::CMFTranscodeSession(CAudioTypeCache *pTypeCache, CProfileCache *pProfileCache) : 
+    m_pTypeCache(pTypeCache),
+    m_pProfileCache(pProfileCache),
+    m_pFormat(NULL),
+    m_pSettings(NULL),
+    m_fStreamCopy(TRUE),
+    m_sampleRate(0),
+    m_hnsStop(0),
+    m_pSession(NULL),
+    m_pSource(NULL),
+    m_pTopology(NULL),
+    m_pProfile(NULL),
+    m_pProfileFormat(NULL),
+    m_profileSampleRate(0),
+    m_fProfileKept(FALSE),
+    m_pSink(NULL),
+    m_pClock(NULL),
+    m_cExtraOutputs(0)
+{
+
+}
+
+//-------------------------------------------------------------------
+//  CMFTranscodeSession destructor
+//-------------------------------------------------------------------
+
+CMFTranscodeSession::~CMFTranscodeSession()
+{
+    for (DWORD i = 0; i < m_cExtraOutputs; i++)
+    {
+        SafeRelease(&m_pExtraProfiles[i]);
+    }
+
+    SafeRelease(&m_pClock);
+    SafeRelease(&m_pSink);
+    SafeRelease(&m_pProfile);
+    SafeRelease(&m_pTopology);
+    SafeRelease(&m_pSource);
+    SafeRelease(&m_pSession);
+}
+
+//-------------------------------------------------------------------
+//  OpenSource
+//        
+//  1. Creates a media source for the caller specified URL.
+//  2. Creates the media session.
+//  3. Creates a transcode profile to hold the stream and 
+//     container attributes.
+//
+//  sURL: Input file URL.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::OpenSource(const WCHAR *sURL)
+{
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = S_OK;
+
+    // Create the media source.
+    hr = CreateMediaSource(sURL, &m_pSource);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = CreateSessionAndProfile();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  OpenSourceMemory
+//
+//  As OpenSource, for a file held in memory. The source resolver
+//  picks the source from the content, since there is no extension to
+//  go by.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::OpenSourceMemory(const BYTE *pData, UINT64 cbData)
+{
+    HRESULT hr = CreateMediaSourceFromMemory(pData, cbData, &m_pSource);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = CreateSessionAndProfile();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CreateSessionAndProfile
+//
+//  Creates the media session and the transcode profile, unless Reset
+//  created them ahead.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::CreateSessionAndProfile()
+{
+    HRESULT hr = S_OK;
+
+    //Create the media session.
+    if (m_pSession == NULL)
+    {
+        hr = MFCreateMediaSession(NULL, &m_pSession);
+    }
+
+    // Create an empty transcode profile.
+    if (SUCCEEDED(hr) && m_pProfile == NULL)
+    {
+        hr = MFCreateTranscodeProfile(&m_pProfile);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ConfigureAudio
+//        
+//  Configures the audio stream attributes.  
+//  These values are stored in the transcode profile.
+//
+//  The attribute stores come from the backend's profile cache (see
+//  MFProfileCache.h); this looks up those of pFormat for the video
+//  and container settings too.
+//
+//  A profile kept by Reset that is complete for the same format and
+//  sample rate is used as it is, along with its video and container
+//  settings. Any other kept profile is replaced by an empty one, as
+//  it may hold settings that the format does not overwrite.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::ConfigureAudio(const OutputFormat *pFormat)
+{
+    assert (m_pProfile);
+
+    m_pFormat = pFormat;
+    m_pSettings = NULL;
+
+    if (m_pProfileFormat != NULL && m_pProfileFormat == pFormat && m_profileSampleRate == m_sampleRate)
+    {
+        m_fProfileKept = TRUE;
+        return S_OK;
+    }
+
+    m_fProfileKept = FALSE;
+
+    if (m_pProfileFormat != NULL)
+    {
+        m_pProfileFormat = NULL;
+
+        SafeRelease(&m_pProfile);
+
+        HRESULT hr = MFCreateTranscodeProfile(&m_pProfile);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    const ProfileSettings *pSettings = NULL;
+
+    HRESULT hr = GetProfileSettings(pFormat, &pSettings);
+
+    if (SUCCEEDED(hr))
+    {
+        m_pSettings = pSettings;
+
+        hr = m_pProfile->SetAudioAttributes(pSettings->pAudio);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  GetProfileSettings
+//
+//  Returns the cached attribute stores for pFormat at the session's
+//  sample rate. Those of the configured format are looked up once per
+//  job.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::GetProfileSettings(const OutputFormat *pFormat, const ProfileSettings **ppSettings)
+{
+    assert (m_pProfileCache);
+
+    if (pFormat == m_pFormat && m_pSettings)
+    {
+        *ppSettings = m_pSettings;
+        return S_OK;
+    }
+
+    return m_pProfileCache->GetSettings(pFormat, m_sampleRate, BuildProfileSettings, m_pTypeCache, ppSettings);
+}
+
+//-------------------------------------------------------------------
+//  ApplyProfileSettings
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::ApplyProfileSettings(IMFTranscodeProfile *pProfile, const ProfileSettings *pSettings)
+{
+    assert (pProfile);
+    assert (pSettings);
+
+    HRESULT hr = pProfile->SetAudioAttributes(pSettings->pAudio);
+
+    if (SUCCEEDED(hr) && pSettings->pVideo)
+    {
+        hr = pProfile->SetVideoAttributes(pSettings->pVideo);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pProfile->SetContainerAttributes(pSettings->pContainer);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  BuildProfileSettings
+//
+//  PFN_BUILD_PROFILE for the profile cache. pContext is the backend's
+//  CAudioTypeCache.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::BuildProfileSettings(const OutputFormat *pFormat, UINT32 outputSampleRate,
+    void *pContext, ProfileSettings *pSettings)
+{
+    CAudioTypeCache *pTypeCache = static_cast<CAudioTypeCache*>(pContext);
+
+    HRESULT hr = CreateAudioAttributes(pTypeCache, pFormat, outputSampleRate, &pSettings->pAudio);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = CreateVideoAttributes(pFormat, &pSettings->pVideo);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = CreateContainerAttributes(pFormat, &pSettings->pContainer);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CreateAudioAttributes
+//
+//  The first output type of the format's seed encoder provides the
+//  sample rate and channel count; the format's AudioSetup decides
+//  how the remaining attributes are filled in.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::CreateAudioAttributes(CAudioTypeCache *pTypeCache, const OutputFormat *pFormat,
+    UINT32 outputSampleRate, IMFAttributes **ppAttrs)
+{
+    assert (pTypeCache);
+    assert (pFormat);
+
+    HRESULT hr = S_OK;
+
+    IMFMediaType    *pAudioType = NULL;
+    IMFAttributes   *pAudioAttrs = NULL;
+
+    const GUID& targetSubtype = GetAudioSubtype(pFormat->audioCodec);
+
+    // Get the first output format supported by the seed encoder.
+    // (Win10) only MFAudioFormat_WMAudioV9/MFAudioFormat_MP3/MFAudioFormat_MPEG/MFAudioFormat_AAC/MFAudioFormat_AMR_NB
+    // The encoders are enumerated once per process; see MFTypeCache.h.
+
+    hr = pTypeCache->GetFirstOutputType(
+        GetAudioSubtype(pFormat->enumCodec),
+        MFT_ENUM_FLAG_ALL,
+        &pAudioType
+        );
+
+    GUID majortype = { 0 };
+    GUID subtype = { 0 };
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pAudioType->GetGUID(MF_MT_MAJOR_TYPE, &majortype);
+    }
+    if (SUCCEEDED(hr) && majortype != MFMediaType_Audio)
+    {
+        hr = MF_E_INVALIDMEDIATYPE;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pAudioType->GetGUID(MF_MT_SUBTYPE, &subtype);
+    }
+
+    // Create a copy of the attribute store so that we can modify it safely.
+    if (SUCCEEDED(hr))
+    {
+        hr = MFCreateAttributes(&pAudioAttrs, 12);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pAudioType->CopyAllItems(pAudioAttrs);
+    }
+
+    // Set the encoder subtype, so that the appropriate MFTs are added
+    // to the topology.
+
+    if (SUCCEEDED(hr) && (subtype != targetSubtype || pFormat->audioSetup == AudioSetup_AAC))
+    {
+        hr = pAudioAttrs->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetGUID(MF_MT_SUBTYPE, targetSubtype);
+        }
+    }
+
+    // Get the sample rate and other information from the audio format.
+
+    UINT32 sampleRate = MFGetAttributeUINT32(pAudioType, MF_MT_AUDIO_SAMPLES_PER_SECOND, 0);    // Samples per second
+    UINT32 bitsPerSample = MFGetAttributeUINT32(pAudioType, MF_MT_AUDIO_BITS_PER_SAMPLE, 16);   // Bits per sample
+    UINT32 cChannels = MFGetAttributeUINT32(pAudioType, MF_MT_AUDIO_NUM_CHANNELS, 0);           // Number of channels
+
+    // A rate set with SetSampleRate replaces the encoder type's; the
+    // transcode topology inserts the resampler. An encoder type used
+    // as-is keeps its bitrate, which the encoder may not offer at the
+    // new rate; the topology then fails.
+    if (SUCCEEDED(hr) && outputSampleRate != 0 && outputSampleRate != sampleRate)
+    {
+        sampleRate = outputSampleRate;
+
+        hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, sampleRate);
+    }
+
+    if (SUCCEEDED(hr) && pFormat->audioSetup == AudioSetup_PCM && subtype != MFAudioFormat_PCM)
+    {
+        // Calculate derived values.
+        UINT32 blockAlign = cChannels * (bitsPerSample / 8);
+        UINT32 bytesPerSecond = blockAlign * sampleRate;
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_NUM_CHANNELS, cChannels);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, sampleRate);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_BLOCK_ALIGNMENT, blockAlign);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_AVG_BYTES_PER_SECOND, bytesPerSecond);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_BITS_PER_SAMPLE, bitsPerSample);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, TRUE);
+        }
+    }
+    else if (SUCCEEDED(hr) && pFormat->audioSetup == AudioSetup_AAC)
+    {
+        // AAC-LC settings used for the MPEG-4 container.
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_BITS_PER_SAMPLE, 16);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, sampleRate);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_NUM_CHANNELS, cChannels);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_AVG_BYTES_PER_SECOND, 20000);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AAC_PAYLOAD_TYPE, 0);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AAC_AUDIO_PROFILE_LEVEL_INDICATION, 0x29);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AUDIO_BLOCK_ALIGNMENT, 1);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_ALL_SAMPLES_INDEPENDENT, 0);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pAudioAttrs->SetUINT32(MF_MT_AVG_BITRATE, 160000);
+        }
+    }
+
+    if (SUCCEEDED(hr) && (pFormat->dwFlags & FORMAT_FLAG_MP4_SAMPLE_ENTRY))
+    {
+        // 8-bit or 16-bit big-endian PCM audio || The MPEG-4 file source converts the audio data to little-endian format.
+        hr = pAudioAttrs->SetUINT32(MF_MT_MPEG4_CURRENT_SAMPLE_ENTRY, 0x00000000);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        *ppAttrs = pAudioAttrs;
+        (*ppAttrs)->AddRef();
+    }
+
+    SafeRelease(&pAudioType);
+    SafeRelease(&pAudioAttrs);
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ConfigureVideo
+//        
+//  Configures the Video stream attributes.  
+//  These values are stored in the transcode profile.
+//
+//  Audio-only formats have no video profile; nothing is configured.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::ConfigureVideo(const OutputFormat *pFormat)
+{
+    if (m_fProfileKept && pFormat == m_pProfileFormat)
+    {
+        return S_OK;
+    }
+
+    const ProfileSettings *pSettings = NULL;
+
+    HRESULT hr = GetProfileSettings(pFormat, &pSettings);
+
+    if (SUCCEEDED(hr) && pSettings->pVideo)
+    {
+        hr = m_pProfile->SetVideoAttributes(pSettings->pVideo);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CreateVideoAttributes
+//
+//  *ppAttrs is NULL for audio-only formats.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::CreateVideoAttributes(const OutputFormat *pFormat, IMFAttributes **ppAttrs)
+{
+    assert (pFormat);
+
+    *ppAttrs = NULL;
+
+    if (pFormat->iVideoProfile == FORMAT_NO_VIDEO)
+    {
+        return S_OK;
+    }
+
+    const H264ProfileInfo *pInfo = GetVideoProfile(pFormat);
+
+    if (pInfo == NULL)
+    {
+        return E_INVALIDARG;
+    }
+
+    const H264ProfileInfo& info = *pInfo;
+
+    HRESULT hr = S_OK;
+
+    IMFAttributes* pVideoAttrs = NULL;
+
+    // Configure the video stream
+
+    // Create a new attribute store.
+    if (SUCCEEDED(hr))
+    {
+        hr = MFCreateAttributes(&pVideoAttrs, 5);
+    }
+
+    // Set the encoder to be the H.264 video encoder, so that the appropriate MFTs are added to the topology.
+    if (SUCCEEDED(hr))
+    {
+        hr = pVideoAttrs->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_H264);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pVideoAttrs->SetUINT32(MF_MT_MPEG2_PROFILE, info.profile);
+    }
+
+    //Set the frame size.
+    if (SUCCEEDED(hr))
+    {
+        hr = MFSetAttributeSize(
+            pVideoAttrs, MF_MT_FRAME_SIZE,
+            info.frame_size.Numerator, info.frame_size.Denominator);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = MFSetAttributeRatio(
+            pVideoAttrs, MF_MT_FRAME_RATE,
+            info.fps.Numerator, info.fps.Denominator);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pVideoAttrs->SetUINT32(MF_MT_AVG_BITRATE, info.bitrate);
+    }
+
+    // A fixed keyframe interval, so that ladder renditions can be
+    // switched at the same points.
+    if (SUCCEEDED(hr) && info.keyframeSpacing != 0)
+    {
+        hr = pVideoAttrs->SetUINT32(MF_MT_MAX_KEYFRAME_SPACING, info.keyframeSpacing);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        *ppAttrs = pVideoAttrs;
+        (*ppAttrs)->AddRef();
+    }
+
+    SafeRelease(&pVideoAttrs);
+    return hr;
+}
+
+
+//-------------------------------------------------------------------
+//  ConfigureContainer
+//        
+//  Configures the container attributes.  
+//  These values are stored in the transcode profile.
+//  
+//  Note: Setting the container type does not insert the required 
+//  MFT node in the transcode topology. The MFT node is based on the 
+//  stream settings stored in the transcode profile.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::ConfigureContainer(const OutputFormat *pFormat)
+{
+    if (m_fProfileKept && pFormat == m_pProfileFormat)
+    {
+        return S_OK;
+    }
+
+    const ProfileSettings *pSettings = NULL;
+
+    HRESULT hr = GetProfileSettings(pFormat, &pSettings);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pProfile->SetContainerAttributes(pSettings->pContainer);
+    }
+
+    // Audio, video and container settings now all come from pFormat.
+    if (SUCCEEDED(hr) && pFormat == m_pFormat)
+    {
+        m_pProfileFormat = pFormat;
+        m_profileSampleRate = m_sampleRate;
+    }
+    return hr;
+}
+
+HRESULT CMFTranscodeSession::CreateContainerAttributes(const OutputFormat *pFormat, IMFAttributes **ppAttrs)
+{
+    assert (pFormat);
+
+    // The fMP4 sink writes one file; segmenting it for HLS or DASH is
+    // left to the portable backend.
+    if (pFormat->dwFlags & (FORMAT_FLAG_HLS | FORMAT_FLAG_DASH))
+    {
+        return MF_E_TOPO_CODEC_NOT_FOUND;
+    }
+    
+    HRESULT hr = S_OK;
+    
+    IMFAttributes* pContainerAttrs = NULL;
+
+    //Set container attributes
+    hr = MFCreateAttributes( &pContainerAttrs, 3 );
+
+    //Set the output container type from the format registry
+    if (SUCCEEDED(hr))
+    {
+        hr = pContainerAttrs->SetGUID(
+            MF_TRANSCODE_CONTAINERTYPE, 
+            GetContainerGuid(pFormat->container)
+            );
+    }
+
+    // Use the default setting. Media Foundation will use the stream 
+    // settings set in ConfigureAudio and ConfigureVideo.
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pContainerAttrs->SetUINT32(
+            MF_TRANSCODE_ADJUST_PROFILE, 
+            MF_TRANSCODE_ADJUST_PROFILE_DEFAULT
+            );
+    }
+
+    if (SUCCEEDED(hr) && pFormat->container == Container_MPEG4)
+    {
+        hr = pContainerAttrs->SetUINT32(MPEG4SINK_MOOV_BEFORE_MDAT, TRUE);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        *ppAttrs = pContainerAttrs;
+        (*ppAttrs)->AddRef();
+    }
+
+    SafeRelease(&pContainerAttrs);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  SetStreamCopy
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::SetStreamCopy(BOOL fAllow)
+{
+    if (m_pTopology)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    m_fStreamCopy = fAllow;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  SetSampleRate
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::SetSampleRate(UINT32 sampleRate)
+{
+    if (m_pTopology)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    m_sampleRate = sampleRate;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  SetStopTime
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::SetStopTime(LONGLONG hnsStop)
+{
+    if (hnsStop < 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_pTopology)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    m_hnsStop = hnsStop;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  GetMediaInfo
+//
+//  The duration comes from the presentation descriptor of the source
+//  and the sample rate from the audio attributes of the profile.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::GetMediaInfo(MediaInfo *pInfo)
+{
+    assert (m_pSource);
+    assert (m_pProfile);
+
+    if (!pInfo)
+    {
+        return E_POINTER;
+    }
+
+    IMFPresentationDescriptor *pPD = NULL;
+    IMFAttributes *pAudioAttrs = NULL;
+
+    HRESULT hr = m_pSource->CreatePresentationDescriptor(&pPD);
+
+    if (SUCCEEDED(hr))
+    {
+        pInfo->hnsDuration = (LONGLONG)MFGetAttributeUINT64(pPD, MF_PD_DURATION, 0);
+
+        hr = m_pProfile->GetAudioAttributes(&pAudioAttrs);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        pInfo->audioSampleRate = MFGetAttributeUINT32(pAudioAttrs, MF_MT_AUDIO_SAMPLES_PER_SECOND, 0);
+
+        // The copy topology is only chosen in SetOutput; the encoders'
+        // frames are on the grid a segmented encode assumes.
+        pInfo->cCopyFrameSamples = 0;
+    }
+
+    SafeRelease(&pAudioAttrs);
+    SafeRelease(&pPD);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ApplyStopTime
+//
+//  Sets the stop time on every source node of the topology, so the
+//  source raises end of stream there.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::ApplyStopTime()
+{
+    assert (m_pTopology);
+
+    if (m_hnsStop == 0)
+    {
+        return S_OK;
+    }
+
+    IMFCollection *pSourceNodes = NULL;
+    DWORD cNodes = 0;
+
+    HRESULT hr = m_pTopology->GetSourceNodeCollection(&pSourceNodes);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pSourceNodes->GetElementCount(&cNodes);
+    }
+
+    for (DWORD i = 0; SUCCEEDED(hr) && i < cNodes; i++)
+    {
+        IUnknown *pUnk = NULL;
+        IMFTopologyNode *pNode = NULL;
+
+        hr = pSourceNodes->GetElement(i, &pUnk);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pUnk->QueryInterface(IID_PPV_ARGS(&pNode));
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pNode->SetUINT64(MF_TOPONODE_MEDIASTOP, (UINT64)m_hnsStop);
+        }
+
+        SafeRelease(&pNode);
+        SafeRelease(&pUnk);
+    }
+
+    SafeRelease(&pSourceNodes);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  AddOutput
+//
+//  Configures a transcode profile of its own for the output; the
+//  topology for it is built by SetOutput.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::AddOutput(const OutputFormat *pFormat, const WCHAR *sURL)
+{
+    if (!pFormat || !sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_pTopology || m_cExtraOutputs == ARRAYSIZE(m_pExtraProfiles))
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (wcscpy_s(m_szExtraURLs[m_cExtraOutputs], MAX_PATH, sURL) != 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    IMFTranscodeProfile *pProfile = NULL;
+
+    HRESULT hr = MFCreateTranscodeProfile(&pProfile);
+
+    const ProfileSettings *pSettings = NULL;
+
+    if (SUCCEEDED(hr))
+    {
+        hr = GetProfileSettings(pFormat, &pSettings);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = ApplyProfileSettings(pProfile, pSettings);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_pExtraProfiles[m_cExtraOutputs++] = pProfile;
+        pProfile->AddRef();
+    }
+
+    SafeRelease(&pProfile);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  SetOutput
+//        
+//  Builds the transcode topology based on the input source,
+//  configured transcode profile, and the output container settings,
+//  and sets it on the media session.
+//
+//  If stream copy is allowed and the source audio can be written to
+//  the output container as-is, a copy topology is used instead. With
+//  added outputs or a sample rate set, a transcode or tee topology is
+//  used and nothing is copied.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::SetOutput(const WCHAR *sURL)
+{
+    assert (m_pSession);
+    assert (m_pSource);
+    assert (m_pProfile);
+    
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = S_FALSE;
+
+    if (m_cExtraOutputs > 0)
+    {
+        hr = CreateTeeTopology(sURL);
+    }
+    else if (m_fStreamCopy && m_pFormat && m_sampleRate == 0)
+    {
+        hr = CreateCopyTopology(sURL);
+    }
+
+    //Create the transcode topology
+    if (hr == S_FALSE)
+    {
+        hr = MFCreateTranscodeTopology( m_pSource, sURL, m_pProfile, &m_pTopology );
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = ApplyStopTime();
+    }
+
+    // Set the topology on the media session.
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pSession->SetTopology(0, m_pTopology);
+    }
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  SetOutputSink
+//
+//  Writing a transcode topology to a byte stream of our own needs
+//  MFCreateTranscodeTopologyFromByteStream, which is Windows 8 and
+//  later; the sample targets Windows 7, so outputs are files only.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::SetOutputSink(IOutputSink *pSink)
+{
+    return pSink ? E_NOTIMPL : E_INVALIDARG;
+}
+
+//-------------------------------------------------------------------
+//  CreateContainerSink
+//
+//  Creates the media sink for the output container with pType as the
+//  audio stream type. Returns S_FALSE for containers that are only
+//  written by the transcode topology.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::CreateContainerSink(IMFByteStream *pByteStream, IMFMediaType *pType)
+{
+    switch (m_pFormat->container)
+    {
+    case Container_ADTS:
+        return MFCreateADTSMediaSink(pByteStream, pType, &m_pSink);
+
+    case Container_MP3:
+        return MFCreateMP3MediaSink(pByteStream, &m_pSink);
+
+    case Container_MPEG4:
+    {
+        HRESULT hr = MFCreateMPEG4MediaSink(pByteStream, NULL, pType, &m_pSink);
+
+        IMFAttributes *pSinkAttrs = NULL;
+
+        // Best effort, as for the transcode profile.
+        if (SUCCEEDED(hr) && SUCCEEDED(m_pSink->QueryInterface(IID_PPV_ARGS(&pSinkAttrs))))
+        {
+            (void)pSinkAttrs->SetUINT32(MPEG4SINK_MOOV_BEFORE_MDAT, TRUE);
+        }
+
+        SafeRelease(&pSinkAttrs);
+        return hr;
+    }
+
+    case Container_FMPEG4:
+        return MFCreateFMPEG4MediaSink(pByteStream, NULL, pType, &m_pSink);
+
+    default:
+        return S_FALSE;
+    }
+}
+
+//-------------------------------------------------------------------
+//  CreateCopyTopology
+//
+//  Builds a topology that connects the first audio stream of the
+//  source directly to the stream sink of the output container, so the
+//  compressed samples are rewrapped without a decoder or encoder.
+//
+//  Returns S_FALSE, and keeps nothing, if the output format has
+//  video, the source audio has a different codec, or the container
+//  sink does not accept the source media type (for example ADTS
+//  framed AAC for MP4).
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::CreateCopyTopology(const WCHAR *sURL)
+{
+    if (m_pFormat->iVideoProfile != FORMAT_NO_VIDEO)
+    {
+        return S_FALSE;
+    }
+
+    IMFPresentationDescriptor   *pPD = NULL;
+    IMFStreamDescriptor         *pSD = NULL;
+    IMFMediaTypeHandler         *pHandler = NULL;
+    IMFMediaType                *pType = NULL;
+    IMFByteStream               *pByteStream = NULL;
+    IMFStreamSink               *pStreamSink = NULL;
+    IMFMediaTypeHandler         *pSinkHandler = NULL;
+    IMFTopology                 *pTopology = NULL;
+    IMFTopologyNode             *pSourceNode = NULL;
+    IMFTopologyNode             *pOutputNode = NULL;
+
+    DWORD cStreams = 0;
+
+    HRESULT hr = m_pSource->CreatePresentationDescriptor(&pPD);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pPD->GetStreamDescriptorCount(&cStreams);
+    }
+
+    // Find the first audio stream and deselect all the others; only
+    // the audio stream gets a branch in the topology.
+    for (DWORD i = 0; SUCCEEDED(hr) && i < cStreams; i++)
+    {
+        IMFStreamDescriptor *pStreamSD = NULL;
+        BOOL fSelected = FALSE;
+        GUID majortype = GUID_NULL;
+
+        hr = pPD->GetStreamDescriptorByIndex(i, &fSelected, &pStreamSD);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pStreamSD->GetMediaTypeHandler(&pHandler);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pHandler->GetMajorType(&majortype);
+        }
+
+        if (SUCCEEDED(hr) && !pSD && majortype == MFMediaType_Audio)
+        {
+            hr = pPD->SelectStream(i);
+
+            if (SUCCEEDED(hr))
+            {
+                hr = pHandler->GetCurrentMediaType(&pType);
+            }
+            if (SUCCEEDED(hr))
+            {
+                pSD = pStreamSD;
+                pSD->AddRef();
+            }
+        }
+        else if (SUCCEEDED(hr))
+        {
+            hr = pPD->DeselectStream(i);
+        }
+
+        SafeRelease(&pHandler);
+        SafeRelease(&pStreamSD);
+    }
+
+    GUID subtype = GUID_NULL;
+
+    if (SUCCEEDED(hr) && pType)
+    {
+        hr = pType->GetGUID(MF_MT_SUBTYPE, &subtype);
+    }
+
+    if (SUCCEEDED(hr) && (!pType || subtype != GetAudioSubtype(m_pFormat->audioCodec)))
+    {
+        hr = S_FALSE;
+    }
+
+    // Create the output file and the container sink.
+    if (hr == S_OK)
+    {
+        hr = MFCreateFile(MF_ACCESSMODE_READWRITE, MF_OPENMODE_DELETE_IF_EXIST,
+            MF_FILEFLAGS_NONE, sURL, &pByteStream);
+    }
+    if (hr == S_OK)
+    {
+        hr = CreateContainerSink(pByteStream, pType);
+    }
+    if (hr == S_OK)
+    {
+        hr = m_pSink->GetStreamSinkByIndex(0, &pStreamSink);
+    }
+    if (hr == S_OK)
+    {
+        hr = pStreamSink->GetMediaTypeHandler(&pSinkHandler);
+    }
+    if (hr == S_OK && pSinkHandler->IsMediaTypeSupported(pType, NULL) != S_OK)
+    {
+        hr = S_FALSE;
+    }
+    if (hr == S_OK)
+    {
+        hr = pSinkHandler->SetCurrentMediaType(pType);
+    }
+
+    // Source node -> output node. The types match, so the topology
+    // loader inserts no transforms.
+    if (hr == S_OK)
+    {
+        hr = MFCreateTopology(&pTopology);
+    }
+    if (hr == S_OK)
+    {
+        hr = MFCreateTopologyNode(MF_TOPOLOGY_SOURCESTREAM_NODE, &pSourceNode);
+    }
+    if (hr == S_OK)
+    {
+        hr = pSourceNode->SetUnknown(MF_TOPONODE_SOURCE, m_pSource);
+    }
+    if (hr == S_OK)
+    {
+        hr = pSourceNode->SetUnknown(MF_TOPONODE_PRESENTATION_DESCRIPTOR, pPD);
+    }
+    if (hr == S_OK)
+    {
+        hr = pSourceNode->SetUnknown(MF_TOPONODE_STREAM_DESCRIPTOR, pSD);
+    }
+    if (hr == S_OK)
+    {
+        hr = pTopology->AddNode(pSourceNode);
+    }
+    if (hr == S_OK)
+    {
+        hr = MFCreateTopologyNode(MF_TOPOLOGY_OUTPUT_NODE, &pOutputNode);
+    }
+    if (hr == S_OK)
+    {
+        hr = pOutputNode->SetObject(pStreamSink);
+    }
+    if (hr == S_OK)
+    {
+        hr = pTopology->AddNode(pOutputNode);
+    }
+    if (hr == S_OK)
+    {
+        hr = pSourceNode->ConnectOutput(0, pOutputNode, 0);
+    }
+
+    if (hr == S_OK)
+    {
+        m_pTopology = pTopology;
+        m_pTopology->AddRef();
+    }
+    else if (m_pSink)
+    {
+        // Falling back to the transcode topology; it creates the
+        // output file again.
+        m_pSink->Shutdown();
+        SafeRelease(&m_pSink);
+    }
+
+    if (pByteStream && hr != S_OK)
+    {
+        pByteStream->Close();
+    }
+
+    SafeRelease(&pOutputNode);
+    SafeRelease(&pSourceNode);
+    SafeRelease(&pTopology);
+    SafeRelease(&pSinkHandler);
+    SafeRelease(&pStreamSink);
+    SafeRelease(&pByteStream);
+    SafeRelease(&pType);
+    SafeRelease(&pSD);
+    SafeRelease(&pPD);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Tee topology
+//
+//  Each output gets a transcode topology of its own, built by
+//  MFCreateTranscodeTopology from the same source. The topology of the
+//  main output is kept, and every source node in it is rewired as
+//
+//      source -> decoder -> tee -> main output branch
+//                               -> branch of added output 1
+//                               -> ...
+//
+//  where each added branch is the chain of nodes that follows the
+//  source node for the same stream in that output's topology, moved
+//  into the main topology. The topology loader then resolves each
+//  branch from the decoded type, inserting the resampler or color
+//  converter that branch needs, so the source is decoded once.
+//-------------------------------------------------------------------
+
+#define TEE_MAX_STREAMS     16
+
+struct TeeStream
+{
+    DWORD               dwStreamId;
+    IMFTopologyNode*    pTee;
+    DWORD               cOutputs;       // Tee outputs connected so far
+};
+
+//-------------------------------------------------------------------
+//  GetSourceNodes
+//
+//  Returns the source nodes of a topology and their count.
+//-------------------------------------------------------------------
+
+static HRESULT GetSourceNodes(IMFTopology *pTopology, IMFCollection **ppNodes, DWORD *pcNodes)
+{
+    HRESULT hr = pTopology->GetSourceNodeCollection(ppNodes);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = (*ppNodes)->GetElementCount(pcNodes);
+    }
+    return hr;
+}
+
+static HRESULT GetNode(IMFCollection *pNodes, DWORD i, IMFTopologyNode **ppNode)
+{
+    IUnknown *pUnk = NULL;
+
+    HRESULT hr = pNodes->GetElement(i, &pUnk);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pUnk->QueryInterface(IID_PPV_ARGS(ppNode));
+    }
+
+    SafeRelease(&pUnk);
+    return hr;
+}
+
+static HRESULT GetStreamDescriptor(IMFTopologyNode *pSourceNode, IMFStreamDescriptor **ppSD)
+{
+    return pSourceNode->GetUnknown(MF_TOPONODE_STREAM_DESCRIPTOR, IID_PPV_ARGS(ppSD));
+}
+
+//-------------------------------------------------------------------
+//  CreateDecoderNode
+//
+//  Creates a transform node for the first decoder registered for the
+//  current type of the stream. Returns S_FALSE, and no node, if the
+//  stream is not compressed or no decoder is found; the tee then
+//  carries the source samples and the topology loader decodes them
+//  once per branch.
+//-------------------------------------------------------------------
+
+static HRESULT CreateDecoderNode(IMFStreamDescriptor *pSD, IMFTopologyNode **ppNode)
+{
+    IMFMediaTypeHandler *pHandler = NULL;
+    IMFMediaType        *pType = NULL;
+    IMFActivate         **ppActivate = NULL;
+    UINT32              cActivate = 0;
+    BOOL                fCompressed = FALSE;
+
+    MFT_REGISTER_TYPE_INFO info = { GUID_NULL, GUID_NULL };
+
+    *ppNode = NULL;
+
+    HRESULT hr = pSD->GetMediaTypeHandler(&pHandler);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pHandler->GetCurrentMediaType(&pType);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pType->GetGUID(MF_MT_MAJOR_TYPE, &info.guidMajorType);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pType->GetGUID(MF_MT_SUBTYPE, &info.guidSubtype);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pType->IsCompressedFormat(&fCompressed);
+    }
+
+    if (SUCCEEDED(hr) && fCompressed &&
+        (info.guidMajorType == MFMediaType_Audio || info.guidMajorType == MFMediaType_Video))
+    {
+        hr = MFTEnumEx(
+            info.guidMajorType == MFMediaType_Audio ? MFT_CATEGORY_AUDIO_DECODER : MFT_CATEGORY_VIDEO_DECODER,
+            MFT_ENUM_FLAG_SYNCMFT | MFT_ENUM_FLAG_SORTANDFILTER,
+            &info,
+            NULL,
+            &ppActivate,
+            &cActivate
+            );
+    }
+
+    if (SUCCEEDED(hr) && cActivate == 0)
+    {
+        hr = S_FALSE;
+    }
+
+    // The topology loader activates the decoder.
+    if (hr == S_OK)
+    {
+        hr = MFCreateTopologyNode(MF_TOPOLOGY_TRANSFORM_NODE, ppNode);
+    }
+    if (hr == S_OK)
+    {
+        hr = (*ppNode)->SetObject(ppActivate[0]);
+    }
+
+    if (FAILED(hr))
+    {
+        SafeRelease(ppNode);
+    }
+
+    for (UINT32 i = 0; i < cActivate; i++)
+    {
+        SafeRelease(&ppActivate[i]);
+    }
+    CoTaskMemFree(ppActivate);
+
+    SafeRelease(&pType);
+    SafeRelease(&pHandler);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  InsertTee
+//
+//  Rewires a source node of the main topology as source -> decoder ->
+//  tee, with tee output 0 connected to what the source node fed.
+//-------------------------------------------------------------------
+
+static HRESULT InsertTee(IMFTopology *pTopology, IMFTopologyNode *pSourceNode, TeeStream *pStream)
+{
+    IMFStreamDescriptor *pSD = NULL;
+    IMFTopologyNode     *pDecoder = NULL;
+    IMFTopologyNode     *pDownstream = NULL;
+    DWORD               iDownstreamInput = 0;
+
+    HRESULT hr = GetStreamDescriptor(pSourceNode, &pSD);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pSD->GetStreamIdentifier(&pStream->dwStreamId);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pSourceNode->GetOutput(0, &pDownstream, &iDownstreamInput);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = CreateDecoderNode(pSD, &pDecoder);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = MFCreateTopologyNode(MF_TOPOLOGY_TEE_NODE, &pStream->pTee);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pTopology->AddNode(pStream->pTee);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pSourceNode->DisconnectOutput(0);
+    }
+
+    if (SUCCEEDED(hr) && pDecoder)
+    {
+        hr = pTopology->AddNode(pDecoder);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pSourceNode->ConnectOutput(0, pDecoder, 0);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pDecoder->ConnectOutput(0, pStream->pTee, 0);
+        }
+    }
+    else if (SUCCEEDED(hr))
+    {
+        hr = pSourceNode->ConnectOutput(0, pStream->pTee, 0);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pStream->pTee->ConnectOutput(0, pDownstream, iDownstreamInput);
+    }
+    if (SUCCEEDED(hr))
+    {
+        pStream->cOutputs = 1;
+    }
+
+    SafeRelease(&pDownstream);
+    SafeRelease(&pDecoder);
+    SafeRelease(&pSD);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  AddChain
+//
+//  Adds pNode and every node downstream of it to pTopology, keeping
+//  their connections. Nodes already in pTopology are skipped.
+//-------------------------------------------------------------------
+
+static HRESULT AddChain(IMFTopology *pTopology, IMFTopologyNode *pNode)
+{
+    IMFTopologyNode *pExisting = NULL;
+    TOPOID id = 0;
+    DWORD cOutputs = 0;
+
+    HRESULT hr = pNode->GetTopoNodeID(&id);
+
+    if (SUCCEEDED(hr) && SUCCEEDED(pTopology->GetNodeByID(id, &pExisting)))
+    {
+        SafeRelease(&pExisting);
+        return S_OK;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTopology->AddNode(pNode);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = pNode->GetOutputCount(&cOutputs);
+    }
+
+    for (DWORD i = 0; SUCCEEDED(hr) && i < cOutputs; i++)
+    {
+        IMFTopologyNode *pNext = NULL;
+        DWORD iInput = 0;
+
+        if (SUCCEEDED(pNode->GetOutput(i, &pNext, &iInput)))
+        {
+            hr = AddChain(pTopology, pNext);
+        }
+        SafeRelease(&pNext);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  AttachBranch
+//
+//  Moves the nodes that follow each source node of pBranch into the
+//  main topology, on a new output of the tee for the same stream.
+//  Fails with MF_E_INVALIDREQUEST if the main output does not encode
+//  a stream that the added output does.
+//-------------------------------------------------------------------
+
+static HRESULT AttachBranch(IMFTopology *pTopology, IMFTopology *pBranch, TeeStream *pStreams, DWORD cStreams)
+{
+    IMFCollection *pSourceNodes = NULL;
+    DWORD cNodes = 0;
+
+    HRESULT hr = GetSourceNodes(pBranch, &pSourceNodes, &cNodes);
+
+    for (DWORD i = 0; SUCCEEDED(hr) && i < cNodes; i++)
+    {
+        IMFTopologyNode     *pSourceNode = NULL;
+        IMFStreamDescriptor *pSD = NULL;
+        IMFTopologyNode     *pDownstream = NULL;
+        DWORD               iDownstreamInput = 0;
+        DWORD               dwStreamId = 0;
+        TeeStream           *pStream = NULL;
+
+        hr = GetNode(pSourceNodes, i, &pSourceNode);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = GetStreamDescriptor(pSourceNode, &pSD);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pSD->GetStreamIdentifier(&dwStreamId);
+        }
+
+        for (DWORD j = 0; SUCCEEDED(hr) && j < cStreams && !pStream; j++)
+        {
+            if (pStreams[j].dwStreamId == dwStreamId)
+            {
+                pStream = &pStreams[j];
+            }
+        }
+
+        if (SUCCEEDED(hr) && !pStream)
+        {
+            hr = MF_E_INVALIDREQUEST;
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pSourceNode->GetOutput(0, &pDownstream, &iDownstreamInput);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pSourceNode->DisconnectOutput(0);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = AddChain(pTopology, pDownstream);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = pStream->pTee->ConnectOutput(pStream->cOutputs, pDownstream, iDownstreamInput);
+        }
+        if (SUCCEEDED(hr))
+        {
+            pStream->cOutputs++;
+        }
+
+        SafeRelease(&pDownstream);
+        SafeRelease(&pSD);
+        SafeRelease(&pSourceNode);
+    }
+
+    SafeRelease(&pSourceNodes);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CreateTeeTopology
+//
+//  Builds the tee topology for the main output and the added ones.
+//  The sinks of every output are created by the topology loader and
+//  shut down by the media session, as for a single output.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::CreateTeeTopology(const WCHAR *sURL)
+{
+    IMFTopology     *pTopology = NULL;
+    IMFCollection   *pSourceNodes = NULL;
+    DWORD           cStreams = 0;
+
+    TeeStream streams[TEE_MAX_STREAMS];
+    memset(streams, 0, sizeof(streams));
+
+    HRESULT hr = MFCreateTranscodeTopology(m_pSource, sURL, m_pProfile, &pTopology);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = GetSourceNodes(pTopology, &pSourceNodes, &cStreams);
+    }
+    if (SUCCEEDED(hr) && cStreams > TEE_MAX_STREAMS)
+    {
+        hr = MF_E_INVALIDREQUEST;
+    }
+
+    for (DWORD i = 0; SUCCEEDED(hr) && i < cStreams; i++)
+    {
+        IMFTopologyNode *pSourceNode = NULL;
+
+        hr = GetNode(pSourceNodes, i, &pSourceNode);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = InsertTee(pTopology, pSourceNode, &streams[i]);
+        }
+        SafeRelease(&pSourceNode);
+    }
+
+    for (DWORD i = 0; SUCCEEDED(hr) && i < m_cExtraOutputs; i++)
+    {
+        IMFTopology *pBranch = NULL;
+
+        hr = MFCreateTranscodeTopology(m_pSource, m_szExtraURLs[i], m_pExtraProfiles[i], &pBranch);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = AttachBranch(pTopology, pBranch, streams, cStreams);
+        }
+        SafeRelease(&pBranch);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_pTopology = pTopology;
+        m_pTopology->AddRef();
+    }
+
+    for (DWORD i = 0; i < cStreams && i < TEE_MAX_STREAMS; i++)
+    {
+        SafeRelease(&streams[i].pTee);
+    }
+
+    SafeRelease(&pSourceNodes);
+    SafeRelease(&pTopology);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Start
+//
+//  Starts the encoding session and keeps its presentation clock for
+//  GetPosition. The session has a clock once the topology is set.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::Start(LONGLONG hnsStart)
+{
+    assert(m_pSession != NULL);
+
+    PROPVARIANT varStart;
+    PropVariantInit(&varStart);
+
+    if (hnsStart != 0)
+    {
+        varStart.vt = VT_I8;
+        varStart.hVal.QuadPart = hnsStart;
+    }
+
+    if (m_pClock == NULL)
+    {
+        IMFClock *pClock = NULL;
+
+        // Without a clock the position is unknown; the encode is not
+        // affected.
+        if (SUCCEEDED(m_pSession->GetClock(&pClock)))
+        {
+            (void)pClock->QueryInterface(IID_PPV_ARGS(&m_pClock));
+        }
+        SafeRelease(&pClock);
+    }
+
+    return m_pSession->Start(&GUID_NULL, &varStart);
+}
+
+//-------------------------------------------------------------------
+//  GetPosition
+//
+//  The presentation clock runs on the sink's timeline, which the
+//  transcode sinks drive as fast as they consume samples, so its time
+//  is the position of the encode. IMFPresentationClock::GetTime is
+//  free-threaded and does not wait for the pipeline.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::GetPosition(LONGLONG *phnsPosition)
+{
+    if (!phnsPosition)
+    {
+        return E_POINTER;
+    }
+
+    if (m_pClock == NULL)
+    {
+        return MF_E_NO_CLOCK;
+    }
+
+    MFTIME hnsTime = 0;
+
+    HRESULT hr = m_pClock->GetTime(&hnsTime);
+
+    if (SUCCEEDED(hr))
+    {
+        *phnsPosition = hnsTime;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  MapSessionEvent
+//
+//  Maps a media session event to a SessionEvent.
+//-------------------------------------------------------------------
+
+static HRESULT MapSessionEvent(IMFMediaEvent *pMFEvent, SessionEvent *pEvent)
+{
+    MediaEventType meType = MEUnknown;  // Event type
+
+    HRESULT hr = S_OK;
+    HRESULT hrStatus = S_OK;            // Event status
+
+    // Get the event type.
+    hr = pMFEvent->GetType(&meType);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pMFEvent->GetStatus(&hrStatus);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        pEvent->hrStatus = hrStatus;
+
+        switch (meType)
+        {
+        case MESessionTopologySet:  pEvent->type = SessionEvent_TopologySet;    break;
+        case MESessionStarted:      pEvent->type = SessionEvent_Started;        break;
+        case MESessionEnded:        pEvent->type = SessionEvent_Ended;          break;
+        case MESessionClosed:       pEvent->type = SessionEvent_Closed;         break;
+        default:                    pEvent->type = SessionEvent_Other;          break;
+        }
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CMFEventCallback
+//
+//  IMFAsyncCallback for one IMFMediaEventGenerator::BeginGetEvent
+//  request. Invoke runs on a Media Foundation work queue thread; it
+//  ends the request and passes the mapped event to the
+//  ISessionEventCallback.
+//-------------------------------------------------------------------
+
+class CMFEventCallback : public IMFAsyncCallback
+{
+public:
+    CMFEventCallback(IMFMediaSession *pSession, ISessionEventCallback *pCallback) :
+        m_cRef(1),
+        m_pSession(pSession),
+        m_pCallback(pCallback)
+    {
+        m_pSession->AddRef();
+    }
+
+    // IUnknown
+    STDMETHODIMP QueryInterface(REFIID riid, void **ppv)
+    {
+        if (!ppv)
+        {
+            return E_POINTER;
+        }
+
+        if (riid == __uuidof(IUnknown) || riid == __uuidof(IMFAsyncCallback))
+        {
+            *ppv = static_cast<IMFAsyncCallback*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppv = NULL;
+        return E_NOINTERFACE;
+    }
+
+    STDMETHODIMP_(ULONG) AddRef()
+    {
+        return InterlockedIncrement(&m_cRef);
+    }
+
+    STDMETHODIMP_(ULONG) Release()
+    {
+        ULONG cRef = InterlockedDecrement(&m_cRef);
+        if (cRef == 0)
+        {
+            delete this;
+        }
+        return cRef;
+    }
+
+    // IMFAsyncCallback
+    STDMETHODIMP GetParameters(DWORD*, DWORD*)
+    {
+        // Implementation of this method is optional.
+        return E_NOTIMPL;
+    }
+
+    STDMETHODIMP Invoke(IMFAsyncResult *pResult)
+    {
+        IMFMediaEvent *pMFEvent = NULL;
+        SessionEvent event = { SessionEvent_Other, S_OK };
+
+        HRESULT hr = m_pSession->EndGetEvent(pResult, &pMFEvent);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = MapSessionEvent(pMFEvent, &event);
+        }
+
+        SafeRelease(&pMFEvent);
+
+        m_pCallback->OnSessionEvent(hr, event);
+        return S_OK;
+    }
+
+private:
+
+    ~CMFEventCallback()
+    {
+        SafeRelease(&m_pSession);
+    }
+
+    long                    m_cRef;
+    IMFMediaSession*        m_pSession;
+    ISessionEventCallback*  m_pCallback;
+};
+
+//-------------------------------------------------------------------
+//  BeginGetEvent
+//
+//  Requests the next media session event asynchronously.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::BeginGetEvent(ISessionEventCallback *pCallback)
+{
+    assert (m_pSession);
+
+    if (!pCallback)
+    {
+        return E_POINTER;
+    }
+
+    CMFEventCallback *pMFCallback = new (std::nothrow) CMFEventCallback(m_pSession, pCallback);
+
+    if (pMFCallback == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    HRESULT hr = m_pSession->BeginGetEvent(pMFCallback, NULL);
+
+    pMFCallback->Release();
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Close
+//
+//  Closes the media session. The media session raises
+//  MESessionClosed once the output file is finalized.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::Close()
+{
+    assert (m_pSession);
+
+    return m_pSession->Close();
+}
+
+//-------------------------------------------------------------------
+//  Shutdown
+//
+//  Handler for the MESessionClosed event.
+//  Shuts down the media session, the media source and, for stream
+//  copy, the container sink. The media session finalized the sink
+//  during Close but only shuts down sinks it created itself.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::Shutdown()
+{
+    HRESULT hr = S_OK;
+
+    if (m_pSink)
+    {
+        (void)m_pSink->Shutdown();
+    }
+
+    // Shut down the media source
+    if (m_pSource)
+    {
+        hr = m_pSource->Shutdown();
+    }
+
+    // Shut down the media session. (Synchronous operation, no events.)
+    if (SUCCEEDED(hr))
+    {
+        if (m_pSession)
+        {
+            hr = m_pSession->Shutdown();
+        }
+    }
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Reset
+//
+//  A media session cannot be started again once it is shut down, so
+//  the next job gets a new one, created here rather than in
+//  OpenSource. The transcode profile holds nothing of the source and
+//  is kept if a job completed its configuration; ConfigureAudio
+//  decides whether the next job can use it.
+//-------------------------------------------------------------------
+
+HRESULT CMFTranscodeSession::Reset()
+{
+    for (DWORD i = 0; i < m_cExtraOutputs; i++)
+    {
+        SafeRelease(&m_pExtraProfiles[i]);
+    }
+    m_cExtraOutputs = 0;
+
+    SafeRelease(&m_pClock);
+    SafeRelease(&m_pSink);
+    SafeRelease(&m_pTopology);
+    SafeRelease(&m_pSource);
+    SafeRelease(&m_pSession);
+
+    if (m_pProfileFormat == NULL)
+    {
+        SafeRelease(&m_pProfile);
+    }
+
+    m_pFormat = NULL;
+    m_pSettings = NULL;
+    m_fStreamCopy = TRUE;
+    m_sampleRate = 0;
+    m_hnsStop = 0;
+    m_fProfileKept = FALSE;
+
+    return CreateSessionAndProfile();
+}
+
+//-------------------------------------------------------------------
+//  CMFBackend
+//
+//  Starts Media Foundation for the process and creates media sessions.
+//-------------------------------------------------------------------
+
+class CMFBackend : public IMediaBackend
+{
+public:
+    CMFBackend()
+    {
+        m_szCacheFile[0] = L'\0';
+    }
+
+    const WCHAR* GetName() const
+    {
+        return L"mf";
+    }
+
+    HRESULT SetCacheFile(const WCHAR *sPath)
+    {
+        if (!sPath)
+        {
+            return E_INVALIDARG;
+        }
+
+        return wcscpy_s(m_szCacheFile, MAX_PATH, sPath) == 0 ?
+            S_OK : HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    HRESULT Startup()
+    {
+        HRESULT hr = MFStartup(MF_VERSION);
+
+        // A cache file that cannot be read only costs the enumeration.
+        if (SUCCEEDED(hr) && m_szCacheFile[0])
+        {
+            (void)m_typeCache.Load(m_szCacheFile);
+        }
+        return hr;
+    }
+
+    HRESULT Shutdown()
+    {
+        if (m_szCacheFile[0])
+        {
+            (void)m_typeCache.Save(m_szCacheFile);
+        }
+
+        // Profiles of sessions still alive keep their own references.
+        m_profileCache.Clear();
+
+        return MFShutdown();
+    }
+
+    HRESULT CreateSession(ITranscodeSession **ppSession)
+    {
+        if (!ppSession)
+        {
+            return E_POINTER;
+        }
+
+        *ppSession = new (std::nothrow) CMFTranscodeSession(&m_typeCache, &m_profileCache);
+
+        return *ppSession ? S_OK : E_OUTOFMEMORY;
+    }
+
+    HRESULT GetProfileCacheStats(ProfileCacheStats *pStats)
+    {
+        if (!pStats)
+        {
+            return E_POINTER;
+        }
+
+        m_profileCache.GetStats(pStats);
+        return S_OK;
+    }
+
+private:
+
+    CAudioTypeCache m_typeCache;
+    CProfileCache   m_profileCache;
+    WCHAR           m_szCacheFile[MAX_PATH];
+};
+
+HRESULT CreateMFBackend(IMediaBackend **ppBackend)
+{
+    if (!ppBackend)
+    {
+        return E_POINTER;
+    }
+
+    *ppBackend = new (std::nothrow) CMFBackend();
+
+    return *ppBackend ? S_OK : E_OUTOFMEMORY;
+}
+
+///////////////////////////////////////////////////////////////////////
+//  CreateMediaSource
+//
+//  Creates a media source from a URL.
+///////////////////////////////////////////////////////////////////////
+
+HRESULT CreateMediaSource(
+    const WCHAR *sURL,  // The URL of the file to open.
+    IMFMediaSource** ppMediaSource // Receives a pointer to the media source.
+    )
+{
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!ppMediaSource)
+    {
+        return E_POINTER;
+    }
+
+    HRESULT hr = S_OK;
+    
+    MF_OBJECT_TYPE ObjectType = MF_OBJECT_INVALID;
+
+    IMFSourceResolver* pSourceResolver = NULL;
+    IUnknown* pUnkSource = NULL;
+
+    // Create the source resolver.
+    hr = MFCreateSourceResolver(&pSourceResolver);
+
+
+    // Use the source resolver to create the media source.
+    
+    if (SUCCEEDED(hr))
+    {
+        hr = pSourceResolver->CreateObjectFromURL(
+            sURL,                       // URL of the source.
+            MF_RESOLUTION_MEDIASOURCE,  // Create a source object.
+            NULL,                       // Optional property store.
+            &ObjectType,                // Receives the created object type. 
+            &pUnkSource                 // Receives a pointer to the media source.
+            );
+    }
+
+    // Get the IMFMediaSource from the IUnknown pointer.
+    if (SUCCEEDED(hr))
+    {
+        hr = pUnkSource->QueryInterface(IID_PPV_ARGS(ppMediaSource));
+    }
+
+    SafeRelease(&pSourceResolver);
+    SafeRelease(&pUnkSource);
+    return hr;
+}
+
+///////////////////////////////////////////////////////////////////////
+//  CreateMediaSourceFromMemory
+//
+//  Creates a media source from a file held in memory. SHCreateMemStream
+//  copies the bytes, so the caller's buffer is not referenced after
+//  this returns.
+///////////////////////////////////////////////////////////////////////
+
+HRESULT CreateMediaSourceFromMemory(
+    const BYTE *pData,  // The file.
+    UINT64 cbData,      // Its size in bytes.
+    IMFMediaSource** ppMediaSource // Receives a pointer to the media source.
+    )
+{
+    if (!pData || cbData == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!ppMediaSource)
+    {
+        return E_POINTER;
+    }
+
+    if (cbData > 0xFFFFFFFF)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILE_TOO_LARGE);
+    }
+
+    HRESULT hr = S_OK;
+
+    MF_OBJECT_TYPE ObjectType = MF_OBJECT_INVALID;
+
+    IStream* pStream = NULL;
+    IMFByteStream* pByteStream = NULL;
+    IMFSourceResolver* pSourceResolver = NULL;
+    IUnknown* pUnkSource = NULL;
+
+    pStream = SHCreateMemStream(pData, (UINT)cbData);
+
+    if (pStream == NULL)
+    {
+        hr = E_OUTOFMEMORY;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = MFCreateMFByteStreamOnStream(pStream, &pByteStream);
+    }
+
+    // Create the source resolver.
+    if (SUCCEEDED(hr))
+    {
+        hr = MFCreateSourceResolver(&pSourceResolver);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pSourceResolver->CreateObjectFromByteStream(
+            pByteStream,                // The file in memory.
+            NULL,                       // No URL to take a hint from.
+            MF_RESOLUTION_MEDIASOURCE |
+            MF_RESOLUTION_CONTENT_DOES_NOT_HAVE_TO_MATCH_EXTENSION_OR_MIME_TYPE,
+            NULL,                       // Optional property store.
+            &ObjectType,                // Receives the created object type.
+            &pUnkSource                 // Receives a pointer to the media source.
+            );
+    }
+
+    // Get the IMFMediaSource from the IUnknown pointer.
+    if (SUCCEEDED(hr))
+    {
+        hr = pUnkSource->QueryInterface(IID_PPV_ARGS(ppMediaSource));
+    }
+
+    SafeRelease(&pStream);
+    SafeRelease(&pByteStream);
+    SafeRelease(&pSourceResolver);
+    SafeRelease(&pUnkSource);
+    return hr;
+}
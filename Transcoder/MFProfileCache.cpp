@@ -0,0 +1,147 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MFProfileCache.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "MFProfileCache.h"
+
+#include <assert.h>
+
+CProfileCache::CProfileCache() :
+    m_cHits(0),
+    m_cMisses(0)
+{
+
+}
+
+CProfileCache::~CProfileCache()
+{
+    Clear();
+}
+
+//-------------------------------------------------------------------
+//  MakeKey
+//
+//  Formats that differ only in name, extension or description share
+//  an entry. A ladder rendition's video settings are part of the key,
+//  not the index of the profile they replace.
+//-------------------------------------------------------------------
+
+void CProfileCache::MakeKey(const OutputFormat *pFormat, UINT32 sampleRate, CacheKey *pKey)
+{
+    memset(pKey, 0, sizeof(*pKey));
+
+    pKey->container = pFormat->container;
+    pKey->dwFlags = pFormat->dwFlags;
+    pKey->enumCodec = pFormat->enumCodec;
+    pKey->audioCodec = pFormat->audioCodec;
+    pKey->audioSetup = pFormat->audioSetup;
+    pKey->sampleRate = sampleRate;
+    pKey->iVideoProfile = pFormat->iVideoProfile;
+
+    const H264ProfileInfo *pVideo = GetVideoProfile(pFormat);
+
+    if (pVideo)
+    {
+        pKey->video = *pVideo;
+    }
+}
+
+void CProfileCache::ReleaseSettings(ProfileSettings *pSettings)
+{
+    SafeRelease(&pSettings->pAudio);
+    SafeRelease(&pSettings->pVideo);
+    SafeRelease(&pSettings->pContainer);
+}
+
+//-------------------------------------------------------------------
+//  GetSettings
+//
+//  The lock is held while building, as in CAudioTypeCache, so that
+//  each format is built once even when many jobs start together.
+//  Failures are not cached; the next job tries again.
+//-------------------------------------------------------------------
+
+HRESULT CProfileCache::GetSettings(const OutputFormat *pFormat, UINT32 sampleRate, PFN_BUILD_PROFILE pfnBuild,
+    void *pContext, const ProfileSettings **ppSettings)
+{
+    if (!pFormat || !pfnBuild)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!ppSettings)
+    {
+        return E_POINTER;
+    }
+
+    *ppSettings = NULL;
+
+    CacheKey key;
+    MakeKey(pFormat, sampleRate, &key);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    ProfileMap::iterator it = m_profiles.find(key);
+
+    if (it != m_profiles.end())
+    {
+        m_cHits++;
+        *ppSettings = &it->second;
+        return S_OK;
+    }
+
+    m_cMisses++;
+
+    ProfileSettings settings = { NULL, NULL, NULL };
+
+    HRESULT hr = pfnBuild(pFormat, sampleRate, pContext, &settings);
+
+    if (SUCCEEDED(hr))
+    {
+        try
+        {
+            it = m_profiles.insert(ProfileMap::value_type(key, settings)).first;
+            *ppSettings = &it->second;
+        }
+        catch (const std::exception&)
+        {
+            hr = E_OUTOFMEMORY;
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        ReleaseSettings(&settings);
+    }
+    return hr;
+}
+
+void CProfileCache::GetStats(ProfileCacheStats *pStats)
+{
+    assert (pStats);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    pStats->cHits = m_cHits;
+    pStats->cMisses = m_cMisses;
+}
+
+void CProfileCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (ProfileMap::iterator it = m_profiles.begin(); it != m_profiles.end(); ++it)
+    {
+        ReleaseSettings(&it->second);
+    }
+    m_profiles.clear();
+    m_cHits = 0;
+    m_cMisses = 0;
+}
@@ -0,0 +1,95 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MFProfileCache.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Cache of transcode profile settings for the Media Foundation backend.
+//
+// The audio, video and container attribute stores of a transcode
+// profile depend only on the output format and the sample rate, yet
+// every job used to build them again: a media type from the type cache,
+// a copy of its attributes and the settings of the format on top. The
+// cache builds them once per format and hands the same stores to every
+// profile. They are never written once cached, so any number of jobs
+// may share them.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "Formats.h"
+#include "Backend.h"
+
+#include <mfidl.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+
+// Attribute stores of one transcode profile. Read-only once cached.
+struct ProfileSettings
+{
+    IMFAttributes*  pAudio;
+    IMFAttributes*  pVideo;         // NULL for audio-only formats
+    IMFAttributes*  pContainer;
+};
+
+// Builds the stores for pFormat at sampleRate (0 keeps the encoder
+// type's rate). pContext is the value passed to GetSettings.
+typedef HRESULT (*PFN_BUILD_PROFILE)(const OutputFormat *pFormat, UINT32 sampleRate, void *pContext,
+    ProfileSettings *pSettings);
+
+class CProfileCache
+{
+public:
+    CProfileCache();
+    ~CProfileCache();
+
+    // Returns the settings for pFormat at sampleRate, built with
+    // pfnBuild the first time they are asked for. The settings stay
+    // valid until Clear.
+    HRESULT GetSettings(const OutputFormat *pFormat, UINT32 sampleRate, PFN_BUILD_PROFILE pfnBuild,
+        void *pContext, const ProfileSettings **ppSettings);
+
+    // Lookups since the cache was created or cleared.
+    void    GetStats(ProfileCacheStats *pStats);
+
+    // Releases every entry. No profile built from them may be in use.
+    void    Clear();
+
+private:
+
+    // Everything of a format that reaches the profile. Compared as
+    // bytes; MakeKey zeroes it first.
+    struct CacheKey
+    {
+        ContainerType   container;
+        DWORD           dwFlags;
+        AudioCodec      enumCodec;
+        AudioCodec      audioCodec;
+        AudioSetup      audioSetup;
+        UINT32          sampleRate;
+        int             iVideoProfile;
+        H264ProfileInfo video;          // Zero without video
+
+        bool operator<(const CacheKey &other) const
+        {
+            return memcmp(this, &other, sizeof(CacheKey)) < 0;
+        }
+    };
+
+    typedef std::map<CacheKey, ProfileSettings> ProfileMap;
+
+    static void MakeKey(const OutputFormat *pFormat, UINT32 sampleRate, CacheKey *pKey);
+    static void ReleaseSettings(ProfileSettings *pSettings);
+
+    std::mutex  m_lock;
+    ProfileMap  m_profiles;
+    UINT64      m_cHits;
+    UINT64      m_cMisses;
+};
@@ -0,0 +1,448 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MFTypeCache.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "MFTypeCache.h"
+
+#include <errno.h>
+#include <mferror.h>
+#include <mftransform.h>
+
+// Cache file layout (little-endian):
+//
+//  DWORD   magic               TYPE_CACHE_MAGIC
+//  DWORD   version             TYPE_CACHE_VERSION
+//  UINT64  system key          See GetSystemKey
+//  DWORD   entry count
+//  Entries:
+//      GUID    subtype
+//      DWORD   enum flags
+//      DWORD   blob size
+//      BYTE    blob[]          MFGetAttributesAsBlob
+//
+#define TYPE_CACHE_MAGIC        0x50414354  // 'TCAP'
+#define TYPE_CACHE_VERSION      1
+#define TYPE_CACHE_MAX_BLOB     4096
+
+#define FNV_OFFSET_BASIS        0xCBF29CE484222325ULL
+#define FNV_PRIME               0x00000100000001B3ULL
+
+static UINT64 HashBytes(UINT64 hash, const void *pData, size_t cb)
+{
+    const BYTE *p = (const BYTE*)pData;
+    for (size_t i = 0; i < cb; i++)
+    {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// The CRT does not set errno for every failure, such as a short
+// fwrite; a failure must not become S_OK.
+static HRESULT ErrnoToHResult()
+{
+    return errno != 0 ? HRESULT_FROM_ERRNO(errno) : E_FAIL;
+}
+
+CAudioTypeCache::CAudioTypeCache() : m_fDirty(FALSE)
+{
+
+}
+
+CAudioTypeCache::~CAudioTypeCache()
+{
+
+}
+
+//-------------------------------------------------------------------
+//  Enumerate
+//
+//  Asks the encoders for their output types and serializes the first
+//  one. An empty blob records that there are none.
+//-------------------------------------------------------------------
+
+HRESULT CAudioTypeCache::Enumerate(REFGUID subtype, DWORD dwFlags, std::vector<BYTE> *pBlob)
+{
+    HRESULT hr = S_OK;
+    DWORD dwMTCount = 0;
+    UINT32 cbBlob = 0;
+
+    IMFCollection   *pAvailableTypes = NULL;
+    IUnknown        *pUnkAudioType = NULL;
+    IMFMediaType    *pAudioType = NULL;
+
+    pBlob->clear();
+
+    hr = MFTranscodeGetAudioOutputAvailableTypes(subtype, dwFlags, NULL, &pAvailableTypes);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pAvailableTypes->GetElementCount(&dwMTCount);
+    }
+
+    if (SUCCEEDED(hr) && dwMTCount > 0)
+    {
+        // The first type in the collection is the encoder's preferred one.
+        hr = pAvailableTypes->GetElement(0, &pUnkAudioType);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pUnkAudioType->QueryInterface(IID_PPV_ARGS(&pAudioType));
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = MFGetAttributesAsBlobSize(pAudioType, &cbBlob);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            pBlob->resize(cbBlob);
+            hr = MFGetAttributesAsBlob(pAudioType, &(*pBlob)[0], cbBlob);
+        }
+    }
+
+    SafeRelease(&pAvailableTypes);
+    SafeRelease(&pUnkAudioType);
+    SafeRelease(&pAudioType);
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  GetFirstOutputType
+//
+//  The lock is held while enumerating so that each key is enumerated
+//  once even when many jobs start together.
+//-------------------------------------------------------------------
+
+HRESULT CAudioTypeCache::GetFirstOutputType(REFGUID subtype, DWORD dwFlags, IMFMediaType **ppType)
+{
+    if (!ppType)
+    {
+        return E_POINTER;
+    }
+
+    *ppType = NULL;
+
+    CacheKey key = { subtype, dwFlags };
+
+    HRESULT hr = S_OK;
+    IMFMediaType *pType = NULL;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    TypeMap::iterator it = m_types.find(key);
+
+    if (it == m_types.end())
+    {
+        std::vector<BYTE> blob;
+
+        hr = Enumerate(subtype, dwFlags, &blob);
+
+        // Failures are not cached; the next job tries again.
+        if (SUCCEEDED(hr))
+        {
+            it = m_types.insert(TypeMap::value_type(key, blob)).first;
+            m_fDirty = TRUE;
+        }
+    }
+
+    if (SUCCEEDED(hr) && it->second.empty())
+    {
+        hr = E_UNEXPECTED;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = MFCreateMediaType(&pType);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = MFInitAttributesFromBlob(pType, &it->second[0], (UINT)it->second.size());
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        *ppType = pType;
+        (*ppType)->AddRef();
+    }
+
+    SafeRelease(&pType);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  GetSystemKey
+//
+//  Hashes what the cached types depend on: the OS version, the Media
+//  Foundation version, and the CLSID and module file of each
+//  registered audio encoder. An updated encoder usually keeps its
+//  CLSID, so the size and write time of the DLL registered for it
+//  are hashed too. Listing the encoders reads the registration only;
+//  no MFT is created.
+//-------------------------------------------------------------------
+
+typedef LONG (WINAPI *PFN_RTL_GET_VERSION)(OSVERSIONINFOW*);
+
+// Hashes the path, size and last write time of the InprocServer32
+// module of clsid. An encoder with no such registration, such as one
+// registered locally by an application, adds nothing.
+static UINT64 HashEncoderModule(UINT64 key, REFGUID clsid)
+{
+    WCHAR szClsid[40];
+    WCHAR szKey[MAX_PATH];
+    WCHAR szModule[MAX_PATH];
+    DWORD cbModule = sizeof(szModule);
+
+    if (StringFromGUID2(clsid, szClsid, ARRAYSIZE(szClsid)) == 0 ||
+        swprintf_s(szKey, MAX_PATH, L"CLSID\\%ls\\InprocServer32", szClsid) < 0)
+    {
+        return key;
+    }
+
+    // REG_EXPAND_SZ paths are expanded.
+    if (RegGetValueW(HKEY_CLASSES_ROOT, szKey, NULL, RRF_RT_REG_SZ | RRF_RT_REG_EXPAND_SZ,
+        NULL, szModule, &cbModule) != ERROR_SUCCESS)
+    {
+        return key;
+    }
+
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    // A bare DLL name is found on the search path at load time; the
+    // name alone still tells a moved registration apart.
+    key = HashBytes(key, szModule, wcslen(szModule) * sizeof(WCHAR));
+
+    if (GetFileAttributesExW(szModule, GetFileExInfoStandard, &data))
+    {
+        key = HashBytes(key, &data.nFileSizeHigh, sizeof(data.nFileSizeHigh));
+        key = HashBytes(key, &data.nFileSizeLow, sizeof(data.nFileSizeLow));
+        key = HashBytes(key, &data.ftLastWriteTime, sizeof(data.ftLastWriteTime));
+    }
+    return key;
+}
+
+HRESULT CAudioTypeCache::GetSystemKey(UINT64 *pKey)
+{
+    UINT64 key = FNV_OFFSET_BASIS;
+
+    // GetVersionEx reports the version the application is manifested
+    // for; RtlGetVersion reports the real one.
+    OSVERSIONINFOW osvi = { sizeof(osvi) };
+
+    HMODULE hNtdll = GetModuleHandleW(L"ntdll.dll");
+    PFN_RTL_GET_VERSION pfnRtlGetVersion = hNtdll ?
+        (PFN_RTL_GET_VERSION)GetProcAddress(hNtdll, "RtlGetVersion") : NULL;
+
+    if (pfnRtlGetVersion && pfnRtlGetVersion(&osvi) == 0)
+    {
+        key = HashBytes(key, &osvi.dwMajorVersion, sizeof(osvi.dwMajorVersion));
+        key = HashBytes(key, &osvi.dwMinorVersion, sizeof(osvi.dwMinorVersion));
+        key = HashBytes(key, &osvi.dwBuildNumber, sizeof(osvi.dwBuildNumber));
+    }
+
+    ULONG mfVersion = MF_VERSION;
+    key = HashBytes(key, &mfVersion, sizeof(mfVersion));
+
+    IMFActivate **ppActivate = NULL;
+    UINT32 cActivate = 0;
+
+    HRESULT hr = MFTEnumEx(MFT_CATEGORY_AUDIO_ENCODER, MFT_ENUM_FLAG_ALL, NULL, NULL, &ppActivate, &cActivate);
+
+    if (SUCCEEDED(hr))
+    {
+        for (UINT32 i = 0; i < cActivate; i++)
+        {
+            GUID clsid = GUID_NULL;
+
+            if (SUCCEEDED(ppActivate[i]->GetGUID(MFT_TRANSFORM_CLSID_Attribute, &clsid)))
+            {
+                key = HashBytes(key, &clsid, sizeof(clsid));
+                key = HashEncoderModule(key, clsid);
+            }
+            ppActivate[i]->Release();
+        }
+        CoTaskMemFree(ppActivate);
+
+        *pKey = key;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Load
+//-------------------------------------------------------------------
+
+HRESULT CAudioTypeCache::Load(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    UINT64 systemKey = 0;
+
+    HRESULT hr = GetSystemKey(&systemKey);
+
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    FILE *pFile = OpenFileW(sPath, "rb");
+
+    if (pFile == NULL)
+    {
+        return S_FALSE;
+    }
+
+    TypeMap types;
+    DWORD header[2] = { 0 };
+    UINT64 fileKey = 0;
+    DWORD cEntries = 0;
+
+    BOOL fValid =
+        fread(header, sizeof(header), 1, pFile) == 1 &&
+        header[0] == TYPE_CACHE_MAGIC &&
+        header[1] == TYPE_CACHE_VERSION &&
+        fread(&fileKey, sizeof(fileKey), 1, pFile) == 1 &&
+        fileKey == systemKey &&
+        fread(&cEntries, sizeof(cEntries), 1, pFile) == 1;
+
+    for (DWORD i = 0; fValid && i < cEntries; i++)
+    {
+        CacheKey key;
+        DWORD cbBlob = 0;
+
+        fValid = fread(&key.subtype, sizeof(key.subtype), 1, pFile) == 1 &&
+            fread(&key.dwFlags, sizeof(key.dwFlags), 1, pFile) == 1 &&
+            fread(&cbBlob, sizeof(cbBlob), 1, pFile) == 1 &&
+            cbBlob <= TYPE_CACHE_MAX_BLOB;
+
+        if (fValid)
+        {
+            std::vector<BYTE> blob(cbBlob);
+
+            fValid = cbBlob == 0 || fread(&blob[0], cbBlob, 1, pFile) == 1;
+
+            if (fValid)
+            {
+                types[key] = blob;
+            }
+        }
+    }
+
+    fclose(pFile);
+
+    if (!fValid)
+    {
+        // Missing, stale or damaged: start over and rewrite on Save.
+        return S_FALSE;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_types.swap(types);
+    m_fDirty = FALSE;
+
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  Save
+//
+//  Writes a temporary file and moves it over sPath, so that processes
+//  loading the cache at the same time never see a partial file.
+//-------------------------------------------------------------------
+
+HRESULT CAudioTypeCache::Save(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (!m_fDirty)
+    {
+        return S_FALSE;
+    }
+
+    UINT64 systemKey = 0;
+    WCHAR szTemp[MAX_PATH];
+
+    HRESULT hr = GetSystemKey(&systemKey);
+
+    if (SUCCEEDED(hr) && swprintf_s(szTemp, MAX_PATH, L"%ls.%lu.tmp", sPath, GetCurrentProcessId()) < 0)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    FILE *pFile = NULL;
+
+    if (SUCCEEDED(hr))
+    {
+        pFile = OpenFileW(szTemp, "wb");
+        if (pFile == NULL)
+        {
+            hr = ErrnoToHResult();
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        DWORD header[2] = { TYPE_CACHE_MAGIC, TYPE_CACHE_VERSION };
+        DWORD cEntries = (DWORD)m_types.size();
+
+        BOOL fOk = fwrite(header, sizeof(header), 1, pFile) == 1 &&
+            fwrite(&systemKey, sizeof(systemKey), 1, pFile) == 1 &&
+            fwrite(&cEntries, sizeof(cEntries), 1, pFile) == 1;
+
+        for (TypeMap::const_iterator it = m_types.begin(); fOk && it != m_types.end(); ++it)
+        {
+            DWORD cbBlob = (DWORD)it->second.size();
+
+            fOk = fwrite(&it->first.subtype, sizeof(GUID), 1, pFile) == 1 &&
+                fwrite(&it->first.dwFlags, sizeof(DWORD), 1, pFile) == 1 &&
+                fwrite(&cbBlob, sizeof(cbBlob), 1, pFile) == 1 &&
+                (cbBlob == 0 || fwrite(&it->second[0], cbBlob, 1, pFile) == 1);
+        }
+
+        if (fclose(pFile) != 0)
+        {
+            fOk = FALSE;
+        }
+
+        if (!fOk)
+        {
+            hr = ErrnoToHResult();
+        }
+    }
+
+    if (SUCCEEDED(hr) && !MoveFileExW(szTemp, sPath, MOVEFILE_REPLACE_EXISTING))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    if (FAILED(hr) && pFile)
+    {
+        DeleteFileW(szTemp);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_fDirty = FALSE;
+    }
+    return hr;
+}
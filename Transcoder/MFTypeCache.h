@@ -0,0 +1,74 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MFTypeCache.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Cache of encoder output types for the Media Foundation backend.
+//
+// MFTranscodeGetAudioOutputAvailableTypes enumerates and instantiates
+// every matching encoder MFT, which makes it one of the slowest steps
+// of a job. Its result depends only on the target subtype, the enum
+// flags and the codecs installed, so it is computed once per process.
+// The cache can also be kept in a file between runs; the file is
+// ignored when the OS version or the set of registered audio encoders
+// changes.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+#include <mfapi.h>
+#include <mfidl.h>
+#include <string.h>
+#include <map>
+#include <mutex>
+#include <vector>
+
+class CAudioTypeCache
+{
+public:
+    CAudioTypeCache();
+    ~CAudioTypeCache();
+
+    // Returns a copy of the first output type that
+    // MFTranscodeGetAudioOutputAvailableTypes reports for subtype and
+    // dwFlags. Fails with E_UNEXPECTED if the encoder has no types.
+    HRESULT GetFirstOutputType(REFGUID subtype, DWORD dwFlags, IMFMediaType **ppType);
+
+    // Loads entries saved by an earlier run. Returns S_FALSE, leaving
+    // the cache empty, if the file is missing or out of date.
+    HRESULT Load(const WCHAR *sPath);
+
+    // Saves the cache if it changed since it was loaded.
+    HRESULT Save(const WCHAR *sPath);
+
+private:
+
+    struct CacheKey
+    {
+        GUID    subtype;
+        DWORD   dwFlags;
+
+        bool operator<(const CacheKey &other) const
+        {
+            int cmp = memcmp(&subtype, &other.subtype, sizeof(GUID));
+            return cmp < 0 || (cmp == 0 && dwFlags < other.dwFlags);
+        }
+    };
+
+    typedef std::map<CacheKey, std::vector<BYTE> > TypeMap;
+
+    static HRESULT Enumerate(REFGUID subtype, DWORD dwFlags, std::vector<BYTE> *pBlob);
+    static HRESULT GetSystemKey(UINT64 *pKey);
+
+    std::mutex  m_lock;
+    TypeMap     m_types;        // Serialized media types (MFGetAttributesAsBlob)
+    BOOL        m_fDirty;
+};
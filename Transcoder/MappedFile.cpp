@@ -0,0 +1,445 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MappedFile.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#include <new>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::CMappedFile() :
+#ifdef _WIN32
+    m_hFile(INVALID_HANDLE_VALUE),
+    m_hMapping(NULL),
+#else
+    m_fd(-1),
+#endif
+    m_fOpen(FALSE),
+    m_pView(NULL),
+    m_fMemory(FALSE),
+    m_cbFile(0),
+    m_pBuffer(NULL),
+    m_cbBuffer(0),
+    m_fStream(FALSE),
+    m_fEnd(FALSE),
+    m_iWindow(0),
+    m_cbWindow(0),
+    m_windowOffset(0)
+{
+
+}
+
+CMappedFile::~CMappedFile()
+{
+    Close();
+}
+
+void CMappedFile::Close()
+{
+#ifdef _WIN32
+    if (m_pView && !m_fMemory)
+    {
+        UnmapViewOfFile(m_pView);
+    }
+    if (m_hMapping)
+    {
+        CloseHandle(m_hMapping);
+        m_hMapping = NULL;
+    }
+    if (m_hFile != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_pView && !m_fMemory)
+    {
+        munmap((void*)m_pView, (size_t)m_cbFile);
+    }
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+#endif
+
+    delete [] m_pBuffer;
+
+    m_fOpen = FALSE;
+    m_pView = NULL;
+    m_fMemory = FALSE;
+    m_cbFile = 0;
+    m_pBuffer = NULL;
+    m_cbBuffer = 0;
+    m_fStream = FALSE;
+    m_fEnd = FALSE;
+    m_iWindow = 0;
+    m_cbWindow = 0;
+    m_windowOffset = 0;
+}
+
+//-------------------------------------------------------------------
+//  Open
+//
+//  Maps the whole file. If the mapping fails, the file stays open and
+//  View reads from it instead. "-" is a handle of its own on standard
+//  input, so Close leaves standard input open. Pipes and devices are
+//  read as streams.
+//-------------------------------------------------------------------
+
+HRESULT CMappedFile::Open(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    Close();
+
+#ifdef _WIN32
+    if (IsStdStreamPath(sPath))
+    {
+        if (!DuplicateHandle(GetCurrentProcess(), GetStdHandle(STD_INPUT_HANDLE),
+            GetCurrentProcess(), &m_hFile, 0, FALSE, DUPLICATE_SAME_ACCESS))
+        {
+            m_hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+    else
+    {
+        m_hFile = CreateFileW(sPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+            FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    }
+
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    m_fStream = GetFileType(m_hFile) != FILE_TYPE_DISK;
+
+    LARGE_INTEGER size;
+    size.QuadPart = 0;
+
+    if (!m_fStream && !GetFileSizeEx(m_hFile, &size))
+    {
+        HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        Close();
+        return hr;
+    }
+
+    m_cbFile = (UINT64)size.QuadPart;
+
+    if (m_cbFile > 0 && m_cbFile <= (SIZE_T)-1)
+    {
+        m_hMapping = CreateFileMappingW(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+
+        if (m_hMapping)
+        {
+            m_pView = (const BYTE*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+#else
+    if (IsStdStreamPath(sPath))
+    {
+        m_fd = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0);
+    }
+    else
+    {
+        char szPath[MAX_PATH * 4];
+
+        if (WideToNarrow(sPath, szPath, sizeof(szPath)) < 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+        }
+
+        m_fd = open(szPath, O_RDONLY | O_CLOEXEC);
+    }
+
+    if (m_fd < 0)
+    {
+        return errno == ENOENT ? HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) : HRESULT_FROM_ERRNO(errno);
+    }
+
+    struct stat st;
+
+    if (fstat(m_fd, &st) != 0)
+    {
+        HRESULT hr = HRESULT_FROM_ERRNO(errno);
+        Close();
+        return hr;
+    }
+
+    m_fStream = !S_ISREG(st.st_mode);
+    m_cbFile = m_fStream ? 0 : (UINT64)st.st_size;
+
+    if (m_cbFile > 0 && m_cbFile <= (size_t)-1)
+    {
+        void *pView = mmap(NULL, (size_t)m_cbFile, PROT_READ, MAP_PRIVATE, m_fd, 0);
+
+        if (pView != MAP_FAILED)
+        {
+            // The readers walk the file front to back: read ahead
+            // aggressively and let pages behind go.
+            madvise(pView, (size_t)m_cbFile, MADV_SEQUENTIAL);
+            m_pView = (const BYTE*)pView;
+        }
+    }
+
+    if (m_pView == NULL && !m_fStream)
+    {
+        posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+
+    m_fOpen = TRUE;
+    return S_OK;
+}
+
+HRESULT CMappedFile::Open(const BYTE *pData, UINT64 cbData)
+{
+    if (!pData && cbData > 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    Close();
+
+    m_pView = pData;
+    m_fMemory = TRUE;
+    m_cbFile = cbData;
+    m_fOpen = TRUE;
+    return S_OK;
+}
+
+HRESULT CMappedFile::View(UINT64 offset, DWORD cb, const BYTE **ppData, DWORD *pcb)
+{
+    if (!ppData || !pcb)
+    {
+        return E_POINTER;
+    }
+
+    *ppData = NULL;
+    *pcb = 0;
+
+    if (!m_fOpen)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (m_fStream && cb > 0)
+    {
+        HRESULT hr = ReadStream(offset, cb);
+
+        // Past the end of the stream, there is nothing to view.
+        if (SUCCEEDED(hr) && offset < m_windowOffset + m_cbWindow)
+        {
+            UINT64 cbAhead = m_windowOffset + m_cbWindow - offset;
+
+            *ppData = m_pBuffer + m_iWindow + (DWORD)(offset - m_windowOffset);
+            *pcb = cbAhead < cb ? (DWORD)cbAhead : cb;
+        }
+        return hr;
+    }
+
+    if (offset >= m_cbFile || cb == 0)
+    {
+        return S_OK;
+    }
+
+    if (cb > m_cbFile - offset)
+    {
+        cb = (DWORD)(m_cbFile - offset);
+    }
+
+    if (m_pView)
+    {
+        *ppData = m_pView + offset;
+        *pcb = cb;
+        return S_OK;
+    }
+
+    HRESULT hr = ReadBuffered(offset, cb, pcb);
+
+    if (SUCCEEDED(hr))
+    {
+        *ppData = m_pBuffer;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ReadBuffered
+//
+//  Reads into m_pBuffer, growing it to the largest view asked for. A
+//  short read (the file shrank) is returned as such.
+//-------------------------------------------------------------------
+
+HRESULT CMappedFile::ReadBuffered(UINT64 offset, DWORD cb, DWORD *pcb)
+{
+    if (cb > m_cbBuffer)
+    {
+        delete [] m_pBuffer;
+
+        m_cbBuffer = 0;
+        m_pBuffer = new (std::nothrow) BYTE[cb];
+
+        if (m_pBuffer == NULL)
+        {
+            return E_OUTOFMEMORY;
+        }
+        m_cbBuffer = cb;
+    }
+
+    DWORD cbRead = 0;
+
+    while (cbRead < cb)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped;
+        DWORD cbChunk = 0;
+
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset = (DWORD)(offset + cbRead);
+        overlapped.OffsetHigh = (DWORD)((offset + cbRead) >> 32);
+
+        if (!ReadFile(m_hFile, m_pBuffer + cbRead, cb - cbRead, &cbChunk, &overlapped))
+        {
+            DWORD dwError = GetLastError();
+
+            if (dwError == ERROR_HANDLE_EOF)
+            {
+                break;
+            }
+            return HRESULT_FROM_WIN32(dwError);
+        }
+#else
+        ssize_t cbChunk = pread(m_fd, m_pBuffer + cbRead, cb - cbRead, (off_t)(offset + cbRead));
+
+        if (cbChunk < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return HRESULT_FROM_ERRNO(errno);
+        }
+#endif
+        if (cbChunk == 0)
+        {
+            break;
+        }
+        cbRead += (DWORD)cbChunk;
+    }
+
+    *pcb = cbRead;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  ReadStream
+//
+//  Reads the stream until the window holds offset to offset + cb, or
+//  the stream ends. Bytes before offset are dropped only when the
+//  buffer is full; the window then moves to the front of the buffer,
+//  which grows if a single view does not fit.
+//-------------------------------------------------------------------
+
+HRESULT CMappedFile::ReadStream(UINT64 offset, DWORD cb)
+{
+    if (offset < m_windowOffset)
+    {
+        return MF_E_INVALIDREQUEST;     // Already dropped
+    }
+
+    while (!m_fEnd && m_windowOffset + m_cbWindow < offset + cb)
+    {
+        if (m_iWindow + m_cbWindow == m_cbBuffer)
+        {
+            UINT64 cbDrop = offset - m_windowOffset;
+
+            if (cbDrop > m_cbWindow)
+            {
+                cbDrop = m_cbWindow;
+            }
+
+            m_iWindow += (DWORD)cbDrop;
+            m_cbWindow -= (DWORD)cbDrop;
+            m_windowOffset += cbDrop;
+
+            DWORD cbNeeded = cb > MAPPED_STREAM_BUFFER_SIZE ? cb : MAPPED_STREAM_BUFFER_SIZE;
+
+            if (cbNeeded > m_cbBuffer)
+            {
+                BYTE *pBuffer = new (std::nothrow) BYTE[cbNeeded];
+
+                if (pBuffer == NULL)
+                {
+                    return E_OUTOFMEMORY;
+                }
+
+                if (m_cbWindow > 0)
+                {
+                    memcpy(pBuffer, m_pBuffer + m_iWindow, m_cbWindow);
+                }
+                delete [] m_pBuffer;
+
+                m_pBuffer = pBuffer;
+                m_cbBuffer = cbNeeded;
+            }
+            else
+            {
+                memmove(m_pBuffer, m_pBuffer + m_iWindow, m_cbWindow);
+            }
+            m_iWindow = 0;
+        }
+
+        BYTE *pFree = m_pBuffer + m_iWindow + m_cbWindow;
+        DWORD cbFree = m_cbBuffer - m_iWindow - m_cbWindow;
+
+#ifdef _WIN32
+        DWORD cbChunk = 0;
+
+        if (!ReadFile(m_hFile, pFree, cbFree, &cbChunk, NULL))
+        {
+            DWORD dwError = GetLastError();
+
+            if (dwError != ERROR_BROKEN_PIPE && dwError != ERROR_HANDLE_EOF)
+            {
+                return HRESULT_FROM_WIN32(dwError);
+            }
+        }
+#else
+        ssize_t cbChunk = read(m_fd, pFree, cbFree);
+
+        if (cbChunk < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return HRESULT_FROM_ERRNO(errno);
+        }
+#endif
+        if (cbChunk == 0)
+        {
+            m_fEnd = TRUE;
+        }
+        m_cbWindow += (DWORD)cbChunk;
+    }
+    return S_OK;
+}
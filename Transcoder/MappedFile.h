@@ -0,0 +1,79 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// MappedFile.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Read-only input file for the portable backend's readers. The file is
+// mapped into memory (a file mapping on Windows, mmap with a sequential
+// access hint elsewhere), so the readers hand out pointers into the
+// page cache instead of copying every block into a buffer of their own.
+// Files that cannot be mapped (empty, or too large for the address
+// space) are read into an internal buffer instead, behind the same
+// interface. The path "-" opens standard input; unless it is
+// redirected from a file, it is read as a stream through a window that
+// only moves forward. A span of memory can be opened too; it is viewed
+// in place, like a mapping.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+#define MAPPED_STREAM_BUFFER_SIZE   (1024 * 1024)
+
+class CMappedFile
+{
+public:
+    CMappedFile();
+    ~CMappedFile();
+
+    HRESULT Open(const WCHAR *sPath);
+
+    // Views cbData bytes at pData, which the caller keeps valid and
+    // unchanged until Close.
+    HRESULT Open(const BYTE *pData, UINT64 cbData);
+    void    Close();
+
+    BOOL    IsOpen() const { return m_fOpen; }
+    BOOL    IsMapped() const { return m_pView != NULL; }
+    BOOL    IsStream() const { return m_fStream; }
+
+    // Size of the file; 0 for a stream, whose size is not known.
+    UINT64  Size() const { return m_cbFile; }
+
+    // Points *ppData at up to cb bytes starting at offset. *pcb is less
+    // than cb at the end of the file, and 0 past it. A mapped view stays
+    // valid until Close; a buffered one only until the next View. A
+    // stream keeps what it has read until its buffer needs the room, so
+    // views may go back only that far; further back they fail.
+    HRESULT View(UINT64 offset, DWORD cb, const BYTE **ppData, DWORD *pcb);
+
+private:
+
+    HRESULT ReadBuffered(UINT64 offset, DWORD cb, DWORD *pcb);
+    HRESULT ReadStream(UINT64 offset, DWORD cb);
+
+#ifdef _WIN32
+    HANDLE      m_hFile;
+    HANDLE      m_hMapping;
+#else
+    int         m_fd;
+#endif
+    BOOL        m_fOpen;
+    const BYTE* m_pView;        // Whole file, if mapped
+    BOOL        m_fMemory;      // m_pView is the caller's
+    UINT64      m_cbFile;
+    BYTE*       m_pBuffer;      // If not mapped
+    DWORD       m_cbBuffer;
+    BOOL        m_fStream;
+    BOOL        m_fEnd;         // The stream has no more data
+    DWORD       m_iWindow;      // Stream bytes held in m_pBuffer
+    DWORD       m_cbWindow;
+    UINT64      m_windowOffset; // Stream offset of m_iWindow
+};
@@ -0,0 +1,349 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Mp3.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Mp3.h"
+#include "Id3.h"
+#include "Pcm.h"
+
+#include <string.h>
+
+// Bitrates in kbps by [MPEG-1 ? 0 : 1][layer - 1][index].
+static const UINT32 mp3_bitrates[2][3][15] =
+{
+    {
+        { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+        { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+    },
+    {
+        { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+        { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+    },
+};
+
+// MPEG-1 sample rates; MPEG-2 halves them and MPEG-2.5 quarters them.
+static const UINT32 mp3_sample_rates[3] = { 44100, 48000, 32000 };
+
+BOOL IsMp3Header(const BYTE *pData, DWORD cb)
+{
+    // 11-bit sync, version not reserved, layer not reserved.
+    return cb >= 2 && pData[0] == 0xFF && (pData[1] & 0xE0) == 0xE0 &&
+        (pData[1] & 0x18) != 0x08 && (pData[1] & 0x06) != 0x00;
+}
+
+HRESULT ParseMp3Header(const BYTE *pData, DWORD cb, Mp3Header *pHeader)
+{
+    if (!pData || !pHeader)
+    {
+        return E_POINTER;
+    }
+
+    if (cb < MP3_HEADER_SIZE || !IsMp3Header(pData, cb))
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    UINT32 versionBits = (pData[1] >> 3) & 0x03;
+    UINT32 bitrateIndex = pData[2] >> 4;
+    UINT32 rateIndex = (pData[2] >> 2) & 0x03;
+    UINT32 padding = (pData[2] >> 1) & 0x01;
+
+    if (bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    BOOL fMpeg1 = (versionBits == 3);
+
+    pHeader->version = fMpeg1 ? 1 : (versionBits == 2 ? 2 : 25);
+    pHeader->layer = 4 - ((pData[1] >> 1) & 0x03);
+    pHeader->bitrate = mp3_bitrates[fMpeg1 ? 0 : 1][pHeader->layer - 1][bitrateIndex] * 1000;
+    pHeader->sampleRate = mp3_sample_rates[rateIndex] >> (fMpeg1 ? 0 : (versionBits == 2 ? 1 : 2));
+    pHeader->channels = (pData[3] >> 6) == 3 ? 1 : 2;
+
+    switch (pHeader->layer)
+    {
+    case 1:
+        pHeader->cSamples = 384;
+        pHeader->cbFrame = (12 * pHeader->bitrate / pHeader->sampleRate + padding) * 4;
+        break;
+
+    case 2:
+        pHeader->cSamples = 1152;
+        pHeader->cbFrame = 144 * pHeader->bitrate / pHeader->sampleRate + padding;
+        break;
+
+    default:
+        pHeader->cSamples = fMpeg1 ? 1152 : 576;
+        pHeader->cbFrame = (fMpeg1 ? 144 : 72) * pHeader->bitrate / pHeader->sampleRate + padding;
+        break;
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  CMp3Reader
+//-------------------------------------------------------------------
+
+CMp3Reader::CMp3Reader() : m_pFile(NULL), m_cbStart(0), m_cbPosition(0), m_iSample(0)
+{
+    memset(&m_first, 0, sizeof(m_first));
+}
+
+CMp3Reader::~CMp3Reader()
+{
+    Close();
+}
+
+void CMp3Reader::Close()
+{
+    m_pFile = NULL;
+    m_file.Close();
+}
+
+//-------------------------------------------------------------------
+//  Open
+//
+//  Opens the file and parses the first frame header. An ID3v2 tag in
+//  front of the first frame is skipped.
+//-------------------------------------------------------------------
+
+HRESULT CMp3Reader::Open(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    Close();
+
+    HRESULT hr = m_file.Open(sPath);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Open(&m_file);
+    }
+
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+HRESULT CMp3Reader::Open(CMappedFile *pFile)
+{
+    if (!pFile)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (pFile != &m_file)
+    {
+        Close();
+    }
+
+    m_pFile = pFile;
+
+    const BYTE *pHeader = NULL;
+    DWORD cbHeader = 0;
+
+    m_cbStart = 0;
+    m_iSample = 0;
+
+    HRESULT hr = m_pFile->View(0, ID3_HEADER_SIZE, &pHeader, &cbHeader);
+
+    if (SUCCEEDED(hr) && cbHeader != ID3_HEADER_SIZE)
+    {
+        hr = MF_E_UNSUPPORTED_BYTESTREAM_TYPE;
+    }
+
+    if (SUCCEEDED(hr) && Id3TagSize(pHeader, cbHeader) > 0)
+    {
+        m_cbStart = Id3TagSize(pHeader, cbHeader);
+
+        hr = m_pFile->View(m_cbStart, MP3_HEADER_SIZE, &pHeader, &cbHeader);
+    }
+
+    if (SUCCEEDED(hr) && !IsMp3Header(pHeader, cbHeader))
+    {
+        hr = MF_E_UNSUPPORTED_BYTESTREAM_TYPE;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = ParseMp3Header(pHeader, cbHeader, &m_first);
+    }
+
+    m_cbPosition = m_cbStart;
+
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  SkipToSample
+//
+//  Positions the reader at the frame that contains sample iTarget, or
+//  at the end of the stream. The frame duration is fixed by the
+//  header, so the position advances without decoding.
+//-------------------------------------------------------------------
+
+HRESULT CMp3Reader::SkipToSample(UINT64 iTarget)
+{
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    m_cbPosition = m_cbStart;
+    m_iSample = 0;
+
+    while (m_iSample < iTarget)
+    {
+        const BYTE *pHeader = NULL;
+        DWORD cbHeader = 0;
+        Mp3Header frame;
+
+        HRESULT hr = m_pFile->View(m_cbPosition, MP3_HEADER_SIZE, &pHeader, &cbHeader);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        if (cbHeader != MP3_HEADER_SIZE ||
+            !IsMp3Header(pHeader, cbHeader))
+        {
+            break;
+        }
+
+        hr = ParseMp3Header(pHeader, cbHeader, &frame);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        UINT64 cSamples = frame.cSamples;
+
+        if (m_iSample + cSamples > iTarget)
+        {
+            break;  // This frame contains the target; read it next.
+        }
+
+        m_iSample += cSamples;
+        m_cbPosition += frame.cbFrame;
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  SeekToTime
+//
+//  The position is counted in samples, so frame boundaries stay exact
+//  however long the stream is.
+//-------------------------------------------------------------------
+
+HRESULT CMp3Reader::SeekToTime(LONGLONG hnsStart)
+{
+    return SkipToSample(HnsToSamples(hnsStart, m_first.sampleRate));
+}
+
+HRESULT CMp3Reader::GetDuration(LONGLONG *phnsDuration)
+{
+    if (!phnsDuration)
+    {
+        return E_POINTER;
+    }
+
+    if (m_pFile && m_pFile->IsStream())
+    {
+        *phnsDuration = 0;
+        return S_OK;
+    }
+
+    UINT64 cbPosition = m_cbPosition;
+    UINT64 iSample = m_iSample;
+
+    HRESULT hr = SkipToSample((UINT64)-1);
+
+    if (SUCCEEDED(hr))
+    {
+        *phnsDuration = SamplesToHns(m_iSample, m_first.sampleRate);
+    }
+
+    m_cbPosition = cbPosition;
+    m_iSample = iSample;
+
+    return hr;
+}
+
+HRESULT CMp3Reader::ReadFrame(const BYTE **ppFrame, DWORD *pcbFrame, Mp3Header *pHeader)
+{
+    if (!ppFrame || !pcbFrame || !pHeader)
+    {
+        return E_POINTER;
+    }
+
+    *ppFrame = NULL;
+    *pcbFrame = 0;
+
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    const BYTE *pFrame = NULL;
+    DWORD cbRead = 0;
+
+    HRESULT hr = m_pFile->View(m_cbPosition, MP3_HEADER_SIZE, &pFrame, &cbRead);
+
+    if (FAILED(hr) || cbRead == 0)
+    {
+        return hr;      // End of stream
+    }
+
+    if (cbRead >= 3 && memcmp(pFrame, "TAG", 3) == 0)
+    {
+        return S_OK;    // ID3v1 tag after the last frame
+    }
+
+    if (cbRead != MP3_HEADER_SIZE)
+    {
+        return MF_E_INVALID_FORMAT;
+    }
+
+    hr = ParseMp3Header(pFrame, cbRead, pHeader);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pFile->View(m_cbPosition, pHeader->cbFrame, &pFrame, &cbRead);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        if (cbRead != pHeader->cbFrame)
+        {
+            // A truncated last frame ends the stream.
+            return S_OK;
+        }
+
+        *ppFrame = pFrame;
+        *pcbFrame = pHeader->cbFrame;
+        m_cbPosition += pHeader->cbFrame;
+        m_iSample += pHeader->cSamples;
+    }
+    return hr;
+}
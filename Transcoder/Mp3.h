@@ -0,0 +1,94 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Mp3.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// MPEG audio (MP3 and its Layer I/II siblings) frame parsing for the
+// portable backend.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "MappedFile.h"
+
+#define MP3_HEADER_SIZE         4
+#define MP3_MAX_FRAME_SIZE      2881    // Layer II, 160 kbps at 8 kHz, padded
+
+struct Mp3Header
+{
+    UINT32  version;            // 1, 2, or 25 for MPEG-2.5
+    UINT32  layer;              // 1 to 3
+    UINT32  bitrate;            // Bits per second
+    UINT32  sampleRate;
+    UINT32  channels;
+    UINT32  cSamples;           // Samples per channel in the frame
+    UINT32  cbFrame;            // Header and payload
+};
+
+// Returns TRUE if the first cb bytes start with an MPEG audio frame
+// sync word. ADTS headers, which share the sync word, are rejected.
+BOOL    IsMp3Header(const BYTE *pData, DWORD cb);
+
+// Parses the frame header at pData. Free-format frames are rejected,
+// since their size cannot be told from the header.
+HRESULT ParseMp3Header(const BYTE *pData, DWORD cb, Mp3Header *pHeader);
+
+//-------------------------------------------------------------------
+//  CMp3Reader
+//
+//  Reads an MPEG audio stream one frame at a time.
+//-------------------------------------------------------------------
+
+class CMp3Reader
+{
+public:
+    CMp3Reader();
+    ~CMp3Reader();
+
+    HRESULT Open(const WCHAR *sPath);
+
+    // Reads from pFile, which the caller keeps open until Close.
+    HRESULT Open(CMappedFile *pFile);
+    void    Close();
+
+    // Header of the first frame.
+    const Mp3Header& Format() const { return m_first; }
+
+    // Skips whole frames until the frame that contains hnsStart.
+    HRESULT SeekToTime(LONGLONG hnsStart);
+
+    // Sample position of the next frame.
+    UINT64  Position() const { return m_iSample; }
+
+    // Bytes from the first frame to the end of the file; 0 if the
+    // input is a stream.
+    UINT64  StreamSize() const { return m_pFile->IsStream() ? 0 : m_pFile->Size() - m_cbStart; }
+
+    // Walks the frame headers to the end of the stream. The read
+    // position is kept. The duration of an input stream, which cannot
+    // be walked and then read again, is 0.
+    HRESULT GetDuration(LONGLONG *phnsDuration);
+
+    // Points *ppFrame at the next frame, header included, in the file's
+    // mapping. *pcbFrame is 0 at the end of the stream, including at a
+    // trailing ID3v1 tag. The frame stays valid until the next ReadFrame.
+    HRESULT ReadFrame(const BYTE **ppFrame, DWORD *pcbFrame, Mp3Header *pHeader);
+
+private:
+
+    HRESULT SkipToSample(UINT64 iTarget);
+
+    CMappedFile m_file;         // If opened by path
+    CMappedFile* m_pFile;       // m_file or the caller's
+    Mp3Header   m_first;
+    UINT64      m_cbStart;      // Offset of the first frame
+    UINT64      m_cbPosition;   // Offset of the next frame
+    UINT64      m_iSample;      // Sample position of the next frame
+};
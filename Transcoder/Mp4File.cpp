@@ -0,0 +1,977 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Mp4File.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Mp4File.h"
+#include "Adts.h"
+
+#include <string.h>
+
+#define MP4_OBJECT_AAC          0x40    // ISO/IEC 14496-3 audio
+#define MP4_OBJECT_MPEG2_AUDIO  0x69    // ISO/IEC 13818-3
+#define MP4_OBJECT_MPEG1_AUDIO  0x6B    // ISO/IEC 11172-3
+#define MP4_STREAM_AUDIO        0x15    // streamType 5, upStream 0, reserved 1
+
+#define MP4_FTYP_SIZE           28
+#define MP4_MDAT_HEADER_SIZE    8
+#define MP4_MDAT_LARGE_SIZE     16      // With a 64-bit size
+#define MP4_MOVIE_TIMESCALE     1000
+
+HRESULT Mp4AacFormat(UINT32 profile, UINT32 sampleRateIndex, UINT32 channelConfig, Mp4AudioFormat *pFormat)
+{
+    if (!pFormat)
+    {
+        return E_POINTER;
+    }
+
+    if (channelConfig == 0 || channelConfig > 7 || AdtsSampleRate(sampleRateIndex) == 0)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    UINT32 objectType = profile + 1;
+
+    memset(pFormat, 0, sizeof(*pFormat));
+    pFormat->codec = AudioCodec_AAC;
+    pFormat->objectType = MP4_OBJECT_AAC;
+    pFormat->sampleRate = AdtsSampleRate(sampleRateIndex);
+    pFormat->channels = (channelConfig == 7) ? 8 : channelConfig;
+    pFormat->samplesPerFrame = ADTS_SAMPLES_PER_FRAME;
+
+    // AudioSpecificConfig: object type, frequency index, channel
+    // configuration and a GASpecificConfig of zeros.
+    pFormat->config[0] = (BYTE)((objectType << 3) | (sampleRateIndex >> 1));
+    pFormat->config[1] = (BYTE)(((sampleRateIndex & 1) << 7) | (channelConfig << 3));
+    pFormat->cbConfig = 2;
+    return S_OK;
+}
+
+HRESULT Mp4MpegAudioFormat(UINT32 version, UINT32 sampleRate, UINT32 channels, UINT32 samplesPerFrame, Mp4AudioFormat *pFormat)
+{
+    if (!pFormat)
+    {
+        return E_POINTER;
+    }
+
+    memset(pFormat, 0, sizeof(*pFormat));
+    pFormat->codec = AudioCodec_MP3;
+    pFormat->objectType = (version == 1) ? MP4_OBJECT_MPEG1_AUDIO : MP4_OBJECT_MPEG2_AUDIO;
+    pFormat->sampleRate = sampleRate;
+    pFormat->channels = channels;
+    pFormat->samplesPerFrame = samplesPerFrame;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  Box building. Sizes are written as 0 and patched by EndBox.
+//-------------------------------------------------------------------
+
+static void WriteBE32(BYTE *p, UINT32 v)
+{
+    p[0] = (BYTE)(v >> 24);
+    p[1] = (BYTE)(v >> 16);
+    p[2] = (BYTE)(v >> 8);
+    p[3] = (BYTE)v;
+}
+
+static void WriteBE64(BYTE *p, UINT64 v)
+{
+    WriteBE32(p, (UINT32)(v >> 32));
+    WriteBE32(p + 4, (UINT32)v);
+}
+
+static void Put8(std::vector<BYTE> *p, UINT32 v)
+{
+    p->push_back((BYTE)v);
+}
+
+static void Put16(std::vector<BYTE> *p, UINT32 v)
+{
+    p->push_back((BYTE)(v >> 8));
+    p->push_back((BYTE)v);
+}
+
+static void Put32(std::vector<BYTE> *p, UINT32 v)
+{
+    BYTE b[4];
+    WriteBE32(b, v);
+    p->insert(p->end(), b, b + 4);
+}
+
+static void Put64(std::vector<BYTE> *p, UINT64 v)
+{
+    BYTE b[8];
+    WriteBE64(b, v);
+    p->insert(p->end(), b, b + 8);
+}
+
+static void PutZeros(std::vector<BYTE> *p, size_t cb)
+{
+    p->insert(p->end(), cb, 0);
+}
+
+static void PutFourCC(std::vector<BYTE> *p, const char *sType)
+{
+    p->insert(p->end(), (const BYTE*)sType, (const BYTE*)sType + 4);
+}
+
+// Unity transformation matrix of mvhd and tkhd.
+static void PutMatrix(std::vector<BYTE> *p)
+{
+    static const UINT32 matrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+
+    for (UINT32 i = 0; i < 9; i++)
+    {
+        Put32(p, matrix[i]);
+    }
+}
+
+static size_t BeginBox(std::vector<BYTE> *p, const char *sType)
+{
+    size_t iBox = p->size();
+    Put32(p, 0);
+    PutFourCC(p, sType);
+    return iBox;
+}
+
+static size_t BeginFullBox(std::vector<BYTE> *p, const char *sType, UINT32 version, UINT32 flags)
+{
+    size_t iBox = BeginBox(p, sType);
+    Put32(p, (version << 24) | flags);
+    return iBox;
+}
+
+static void EndBox(std::vector<BYTE> *p, size_t iBox)
+{
+    WriteBE32(&(*p)[iBox], (UINT32)(p->size() - iBox));
+}
+
+// ftyp of a whole file, or of a CMAF track file. Both are
+// MP4_FTYP_SIZE bytes.
+static void FormatFileType(std::vector<BYTE> *p, BOOL fFragmented)
+{
+    size_t iBox = BeginBox(p, "ftyp");
+    PutFourCC(p, fFragmented ? "iso6" : "isom");
+    Put32(p, fFragmented ? 0 : 0x200);
+    PutFourCC(p, fFragmented ? "iso6" : "isom");
+    PutFourCC(p, fFragmented ? "cmfc" : "iso2");
+    PutFourCC(p, "mp41");
+    EndBox(p, iBox);
+}
+
+//-------------------------------------------------------------------
+//  FormatMovie
+//
+//  Formats moov for the samples in sizes, all in one chunk at
+//  cbMediaOffset. Durations that do not fit 32 bits use version 1
+//  boxes. The moov of a fragmented file has no samples; it ends with
+//  mvex instead, and the fragments give the sample durations and
+//  sizes.
+//-------------------------------------------------------------------
+
+static void FormatMovie(const Mp4AudioFormat &format, const std::vector<UINT32> &sizes, UINT64 cbMediaOffset, BOOL fFragmented, std::vector<BYTE> *pMovie)
+{
+    const UINT32 cSamples = (UINT32)sizes.size();
+    const UINT64 duration = (UINT64)cSamples * format.samplesPerFrame;
+    const UINT64 movieDuration = duration * MP4_MOVIE_TIMESCALE / format.sampleRate;
+    const UINT32 movieVersion = movieDuration > 0xFFFFFFFF ? 1 : 0;
+    const UINT32 mediaVersion = duration > 0xFFFFFFFF ? 1 : 0;
+
+    UINT64 cbMedia = 0;
+    UINT32 cbMaxSample = 0;
+
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        cbMedia += sizes[i];
+        cbMaxSample = sizes[i] > cbMaxSample ? sizes[i] : cbMaxSample;
+    }
+
+    UINT64 avgBitrate = duration ? cbMedia * 8 * format.sampleRate / duration : 0;
+    UINT64 maxBitrate = (UINT64)cbMaxSample * 8 * format.sampleRate / format.samplesPerFrame;
+
+    std::vector<BYTE> &m = *pMovie;
+
+    m.reserve(1024 + (size_t)cSamples * 4);
+
+    size_t iMoov = BeginBox(&m, "moov");
+
+    size_t iBox = BeginFullBox(&m, "mvhd", movieVersion, 0);
+    if (movieVersion)
+    {
+        PutZeros(&m, 16);                           // Creation and modification time
+        Put32(&m, MP4_MOVIE_TIMESCALE);
+        Put64(&m, movieDuration);
+    }
+    else
+    {
+        PutZeros(&m, 8);
+        Put32(&m, MP4_MOVIE_TIMESCALE);
+        Put32(&m, (UINT32)movieDuration);
+    }
+    Put32(&m, 0x00010000);                          // Rate 1.0
+    Put16(&m, 0x0100);                              // Volume 1.0
+    PutZeros(&m, 10);
+    PutMatrix(&m);
+    PutZeros(&m, 24);                               // pre_defined
+    Put32(&m, 2);                                   // next_track_ID
+    EndBox(&m, iBox);
+
+    size_t iTrak = BeginBox(&m, "trak");
+
+    iBox = BeginFullBox(&m, "tkhd", movieVersion, 0x000003);   // Enabled, in movie
+    if (movieVersion)
+    {
+        PutZeros(&m, 16);
+        Put32(&m, 1);                               // track_ID
+        Put32(&m, 0);
+        Put64(&m, movieDuration);
+    }
+    else
+    {
+        PutZeros(&m, 8);
+        Put32(&m, 1);
+        Put32(&m, 0);
+        Put32(&m, (UINT32)movieDuration);
+    }
+    PutZeros(&m, 8);
+    Put16(&m, 0);                                   // layer
+    Put16(&m, 0);                                   // alternate_group
+    Put16(&m, 0x0100);                              // Volume 1.0
+    Put16(&m, 0);
+    PutMatrix(&m);
+    Put32(&m, 0);                                   // Width and height
+    Put32(&m, 0);
+    EndBox(&m, iBox);
+
+    size_t iMdia = BeginBox(&m, "mdia");
+
+    iBox = BeginFullBox(&m, "mdhd", mediaVersion, 0);
+    if (mediaVersion)
+    {
+        PutZeros(&m, 16);
+        Put32(&m, format.sampleRate);
+        Put64(&m, duration);
+    }
+    else
+    {
+        PutZeros(&m, 8);
+        Put32(&m, format.sampleRate);
+        Put32(&m, (UINT32)duration);
+    }
+    Put16(&m, 0x55C4);                              // Language "und"
+    Put16(&m, 0);
+    EndBox(&m, iBox);
+
+    iBox = BeginFullBox(&m, "hdlr", 0, 0);
+    Put32(&m, 0);
+    PutFourCC(&m, "soun");
+    PutZeros(&m, 12);
+    m.insert(m.end(), (const BYTE*)"SoundHandler", (const BYTE*)"SoundHandler" + 13);
+    EndBox(&m, iBox);
+
+    size_t iMinf = BeginBox(&m, "minf");
+
+    iBox = BeginFullBox(&m, "smhd", 0, 0);
+    Put32(&m, 0);                                   // Balance, reserved
+    EndBox(&m, iBox);
+
+    size_t iDinf = BeginBox(&m, "dinf");
+    size_t iDref = BeginFullBox(&m, "dref", 0, 0);
+    Put32(&m, 1);
+    iBox = BeginFullBox(&m, "url ", 0, 0x000001);   // Media in this file
+    EndBox(&m, iBox);
+    EndBox(&m, iDref);
+    EndBox(&m, iDinf);
+
+    size_t iStbl = BeginBox(&m, "stbl");
+
+    size_t iStsd = BeginFullBox(&m, "stsd", 0, 0);
+    Put32(&m, 1);
+
+    size_t iEntry = BeginBox(&m, "mp4a");
+    PutZeros(&m, 6);
+    Put16(&m, 1);                                   // data_reference_index
+    PutZeros(&m, 8);
+    Put16(&m, format.channels);
+    Put16(&m, 16);                                  // samplesize
+    Put32(&m, 0);
+    Put32(&m, format.sampleRate <= 0xFFFF ? format.sampleRate << 16 : 0);
+
+    // esds: ES_Descriptor, DecoderConfigDescriptor, DecoderSpecificInfo
+    // and SLConfigDescriptor, each with a one-byte length.
+    UINT32 cbDecoderConfig = 13 + (format.cbConfig ? 2 + format.cbConfig : 0);
+
+    iBox = BeginFullBox(&m, "esds", 0, 0);
+    Put8(&m, 0x03);
+    Put8(&m, 3 + 2 + cbDecoderConfig + 3);
+    Put16(&m, 0);                                   // ES_ID
+    Put8(&m, 0);                                    // Flags
+    Put8(&m, 0x04);
+    Put8(&m, cbDecoderConfig);
+    Put8(&m, format.objectType);
+    Put8(&m, MP4_STREAM_AUDIO);
+    Put8(&m, (cbMaxSample >> 16) & 0xFF);           // bufferSizeDB, 24 bits
+    Put16(&m, cbMaxSample & 0xFFFF);
+    Put32(&m, maxBitrate > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)maxBitrate);
+    Put32(&m, avgBitrate > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)avgBitrate);
+    if (format.cbConfig)
+    {
+        Put8(&m, 0x05);
+        Put8(&m, format.cbConfig);
+        m.insert(m.end(), format.config, format.config + format.cbConfig);
+    }
+    Put8(&m, 0x06);
+    Put8(&m, 1);
+    Put8(&m, 0x02);                                 // Predefined for MP4 files
+    EndBox(&m, iBox);
+
+    EndBox(&m, iEntry);
+    EndBox(&m, iStsd);
+
+    iBox = BeginFullBox(&m, "stts", 0, 0);
+    Put32(&m, cSamples ? 1 : 0);
+    if (cSamples)
+    {
+        Put32(&m, cSamples);
+        Put32(&m, format.samplesPerFrame);
+    }
+    EndBox(&m, iBox);
+
+    iBox = BeginFullBox(&m, "stsc", 0, 0);
+    Put32(&m, cSamples ? 1 : 0);
+    if (cSamples)
+    {
+        Put32(&m, 1);                               // first_chunk
+        Put32(&m, cSamples);
+        Put32(&m, 1);                               // sample_description_index
+    }
+    EndBox(&m, iBox);
+
+    iBox = BeginFullBox(&m, "stsz", 0, 0);
+    Put32(&m, 0);                                   // Sizes vary
+    Put32(&m, cSamples);
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        Put32(&m, sizes[i]);
+    }
+    EndBox(&m, iBox);
+
+    // Last, so that WriteHeader can patch the offset.
+    iBox = BeginFullBox(&m, "stco", 0, 0);
+    Put32(&m, fFragmented ? 0 : 1);
+    if (!fFragmented)
+    {
+        Put32(&m, (UINT32)cbMediaOffset);
+    }
+    EndBox(&m, iBox);
+
+    EndBox(&m, iStbl);
+    EndBox(&m, iMinf);
+    EndBox(&m, iMdia);
+    EndBox(&m, iTrak);
+
+    if (fFragmented)
+    {
+        size_t iMvex = BeginBox(&m, "mvex");
+        iBox = BeginFullBox(&m, "trex", 0, 0);
+        Put32(&m, 1);                               // track_ID
+        Put32(&m, 1);                               // default_sample_description_index
+        Put32(&m, format.samplesPerFrame);          // default_sample_duration
+        Put32(&m, 0);                               // default_sample_size
+        Put32(&m, 0);                               // default_sample_flags: sync samples
+        EndBox(&m, iBox);
+        EndBox(&m, iMvex);
+    }
+
+    EndBox(&m, iMoov);
+}
+
+//-------------------------------------------------------------------
+//  CMp4Writer
+//-------------------------------------------------------------------
+
+CMp4Writer::CMp4Writer() :
+    m_fHeader(FALSE),
+    m_fIndexed(FALSE),
+    m_cbMedia(0),
+    m_cSamples(0),
+    m_cbHeader(0)
+{
+    memset(&m_format, 0, sizeof(m_format));
+}
+
+CMp4Writer::~CMp4Writer()
+{
+
+}
+
+HRESULT CMp4Writer::Create(const WCHAR *sPath, const Mp4AudioFormat &format, UINT64 cbExpected)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_file.Create(sPath, cbExpected);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Begin(format);
+    }
+    return hr;
+}
+
+HRESULT CMp4Writer::Create(IOutputSink *pSink, const Mp4AudioFormat &format, UINT64 cbExpected)
+{
+    if (!pSink)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_file.Open(pSink, cbExpected);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Begin(format);
+    }
+    return hr;
+}
+
+HRESULT CMp4Writer::Begin(const Mp4AudioFormat &format)
+{
+    if (format.sampleRate == 0 || format.samplesPerFrame == 0 || format.cbConfig > sizeof(format.config))
+    {
+        (void)m_file.Close();
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    m_format = format;
+    m_fHeader = FALSE;
+    m_fIndexed = FALSE;
+    m_sizes.clear();
+    m_cbMedia = 0;
+    m_cSamples = 0;
+    m_cbHeader = 0;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  SetSampleSizes
+//
+//  Writes ftyp, moov and the mdat header at once; the samples that
+//  follow are the rest of the file.
+//-------------------------------------------------------------------
+
+HRESULT CMp4Writer::SetSampleSizes(const std::vector<UINT32> &sizes)
+{
+    if (!m_file.IsOpen() || m_fHeader)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    UINT64 cbMedia = 0;
+
+    for (size_t i = 0; i < sizes.size(); i++)
+    {
+        cbMedia += sizes[i];
+    }
+
+    if (sizes.size() > 0xFFFFFFFF)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    try
+    {
+        m_sizes = sizes;
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    m_fIndexed = TRUE;
+
+    return WriteHeader(cbMedia);
+}
+
+//-------------------------------------------------------------------
+//  WriteHeader
+//
+//  Writes ftyp, then moov if the samples are indexed, then the mdat
+//  header. Without an index the size of mdat is not known; it gets a
+//  64-bit size that Finalize patches.
+//-------------------------------------------------------------------
+
+HRESULT CMp4Writer::WriteHeader(UINT64 cbMedia)
+{
+    std::vector<BYTE> header;
+
+    try
+    {
+        header.reserve(MP4_FTYP_SIZE + MP4_MDAT_LARGE_SIZE);
+
+        FormatFileType(&header, FALSE);
+
+        BOOL fLarge = !m_fIndexed || cbMedia + MP4_MDAT_HEADER_SIZE > 0xFFFFFFFFULL;
+        UINT64 cbMdatHeader = fLarge ? MP4_MDAT_LARGE_SIZE : MP4_MDAT_HEADER_SIZE;
+
+        if (m_fIndexed)
+        {
+            std::vector<BYTE> movie;
+
+            FormatMovie(m_format, m_sizes, 0, FALSE, &movie);
+
+            // stco is the last box of moov, and its one entry the last
+            // four bytes: the offset of the first sample, after moov.
+            UINT64 cbMediaOffset = header.size() + movie.size() + cbMdatHeader;
+
+            if (cbMediaOffset > 0xFFFFFFFFULL)
+            {
+                return MF_E_INVALIDREQUEST;
+            }
+
+            WriteBE32(&movie[movie.size() - 4], (UINT32)cbMediaOffset);
+            header.insert(header.end(), movie.begin(), movie.end());
+        }
+
+        if (fLarge)
+        {
+            Put32(&header, 1);
+            PutFourCC(&header, "mdat");
+            Put64(&header, cbMedia + MP4_MDAT_LARGE_SIZE);  // Patched in Finalize if not indexed
+        }
+        else
+        {
+            Put32(&header, (UINT32)(cbMedia + MP4_MDAT_HEADER_SIZE));
+            PutFourCC(&header, "mdat");
+        }
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    HRESULT hr = m_file.Write(&header[0], (DWORD)header.size());
+
+    if (SUCCEEDED(hr))
+    {
+        m_fHeader = TRUE;
+        m_cbHeader = header.size();
+    }
+    return hr;
+}
+
+HRESULT CMp4Writer::WriteSample(const BYTE *pData, DWORD cbData)
+{
+    if (!m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = S_OK;
+
+    if (!m_fHeader)
+    {
+        // moov goes at the end, so mdat must be patched.
+        hr = m_file.IsStream() ? MF_E_INVALIDREQUEST : WriteHeader(0);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        if (m_fIndexed)
+        {
+            if (m_cSamples >= m_sizes.size() || m_sizes[m_cSamples] != cbData)
+            {
+                hr = MF_E_INVALIDREQUEST;
+            }
+        }
+        else
+        {
+            try
+            {
+                m_sizes.push_back(cbData);
+            }
+            catch (const std::exception&)
+            {
+                hr = E_OUTOFMEMORY;
+            }
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_file.Write(pData, cbData);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_cbMedia += cbData;
+        m_cSamples++;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Finalize
+//
+//  An indexed file is complete once every sample is written. Otherwise
+//  the mdat size is patched and moov appended.
+//-------------------------------------------------------------------
+
+HRESULT CMp4Writer::Finalize()
+{
+    if (!m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = S_OK;
+
+    if (!m_fHeader)
+    {
+        hr = m_file.IsStream() ? MF_E_INVALIDREQUEST : WriteHeader(0);
+    }
+
+    if (SUCCEEDED(hr) && m_fIndexed && m_cSamples != m_sizes.size())
+    {
+        hr = MF_E_INVALIDREQUEST;
+    }
+
+    if (SUCCEEDED(hr) && !m_fIndexed)
+    {
+        BYTE size[8];
+        WriteBE64(size, m_cbMedia + MP4_MDAT_LARGE_SIZE);
+
+        hr = m_file.WriteAt(MP4_FTYP_SIZE + 8, size, sizeof(size));
+
+        std::vector<BYTE> movie;
+
+        if (SUCCEEDED(hr))
+        {
+            try
+            {
+                FormatMovie(m_format, m_sizes, m_cbHeader, FALSE, &movie);
+            }
+            catch (const std::exception&)
+            {
+                hr = E_OUTOFMEMORY;
+            }
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = m_file.Write(&movie[0], (DWORD)movie.size());
+        }
+    }
+
+    HRESULT hrClose = m_file.Close();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = hrClose;
+    }
+    return hr;
+}
+
+UINT32 Mp4FragmentSamples(const Mp4AudioFormat &format, LONGLONG hnsFragment)
+{
+    UINT64 perFragment = (UINT64)format.samplesPerFrame * 10000000;
+    UINT64 cSamples = hnsFragment > 0 && perFragment ?
+        ((UINT64)hnsFragment * format.sampleRate + perFragment - 1) / perFragment : 1;
+
+    return cSamples > 0xFFFF ? 0xFFFF : (UINT32)cSamples;
+}
+
+HRESULT FormatMp4InitSegment(const Mp4AudioFormat &format, std::vector<BYTE> *pSegment)
+{
+    if (!pSegment)
+    {
+        return E_POINTER;
+    }
+
+    try
+    {
+        pSegment->clear();
+
+        FormatFileType(pSegment, TRUE);
+        FormatMovie(format, std::vector<UINT32>(), 0, TRUE, pSegment);
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  FormatMp4Fragment
+//
+//  The sample offsets in trun count from the start of moof
+//  (default-base-is-moof), so each fragment stands on its own and can
+//  be a segment file of its own.
+//-------------------------------------------------------------------
+
+HRESULT FormatMp4Fragment(UINT32 iSequence, UINT64 decodeTime, const std::vector<UINT32> &sizes, std::vector<BYTE> *pHeader)
+{
+    if (!pHeader)
+    {
+        return E_POINTER;
+    }
+
+    const UINT32 cSamples = (UINT32)sizes.size();
+
+    UINT64 cbData = 0;
+
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        cbData += sizes[i];
+    }
+
+    if (cSamples == 0 || cbData > 0xFFFFFFFF - MP4_MDAT_HEADER_SIZE)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    std::vector<BYTE> &header = *pHeader;
+
+    try
+    {
+        header.clear();
+        header.reserve(128 + (size_t)cSamples * 4);
+
+        size_t iMoof = BeginBox(&header, "moof");
+
+        size_t iBox = BeginFullBox(&header, "mfhd", 0, 0);
+        Put32(&header, iSequence);
+        EndBox(&header, iBox);
+
+        size_t iTraf = BeginBox(&header, "traf");
+
+        iBox = BeginFullBox(&header, "tfhd", 0, 0x020000);     // default-base-is-moof
+        Put32(&header, 1);                                      // track_ID
+        EndBox(&header, iBox);
+
+        iBox = BeginFullBox(&header, "tfdt", 1, 0);
+        Put64(&header, decodeTime);                             // baseMediaDecodeTime
+        EndBox(&header, iBox);
+
+        iBox = BeginFullBox(&header, "trun", 0, 0x000201);     // data-offset, sample-size
+        Put32(&header, cSamples);
+        size_t iDataOffset = header.size();
+        Put32(&header, 0);
+        for (UINT32 i = 0; i < cSamples; i++)
+        {
+            Put32(&header, sizes[i]);
+        }
+        EndBox(&header, iBox);
+
+        EndBox(&header, iTraf);
+        EndBox(&header, iMoof);
+
+        WriteBE32(&header[iDataOffset], (UINT32)(header.size() + MP4_MDAT_HEADER_SIZE));
+
+        Put32(&header, (UINT32)(cbData + MP4_MDAT_HEADER_SIZE));
+        PutFourCC(&header, "mdat");
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  CMp4FragmentWriter
+//-------------------------------------------------------------------
+
+CMp4FragmentWriter::CMp4FragmentWriter() :
+    m_cFragmentSamples(0),
+    m_iSequence(1),
+    m_decodeTime(0)
+{
+    memset(&m_format, 0, sizeof(m_format));
+}
+
+CMp4FragmentWriter::~CMp4FragmentWriter()
+{
+
+}
+
+HRESULT CMp4FragmentWriter::Create(const WCHAR *sPath, const Mp4AudioFormat &format, UINT64 cbExpected, LONGLONG hnsFragment)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_file.Create(sPath, cbExpected);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Begin(format, hnsFragment);
+    }
+    return hr;
+}
+
+HRESULT CMp4FragmentWriter::Create(IOutputSink *pSink, const Mp4AudioFormat &format, UINT64 cbExpected, LONGLONG hnsFragment)
+{
+    if (!pSink)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_file.Open(pSink, cbExpected);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Begin(format, hnsFragment);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Begin
+//
+//  Writes the init segment.
+//-------------------------------------------------------------------
+
+HRESULT CMp4FragmentWriter::Begin(const Mp4AudioFormat &format, LONGLONG hnsFragment)
+{
+    if (format.sampleRate == 0 || format.samplesPerFrame == 0 || format.cbConfig > sizeof(format.config) ||
+        hnsFragment <= 0)
+    {
+        (void)m_file.Close();
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    m_format = format;
+    m_cFragmentSamples = Mp4FragmentSamples(format, hnsFragment);
+    m_iSequence = 1;
+    m_decodeTime = 0;
+    m_sizes.clear();
+    m_data.clear();
+
+    std::vector<BYTE> header;
+
+    HRESULT hr = FormatMp4InitSegment(m_format, &header);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_file.Write(&header[0], (DWORD)header.size());
+    }
+
+    if (FAILED(hr))
+    {
+        (void)m_file.Close();
+    }
+    return hr;
+}
+
+HRESULT CMp4FragmentWriter::WriteSample(const BYTE *pData, DWORD cbData)
+{
+    if (!m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    try
+    {
+        m_sizes.push_back(cbData);
+        m_data.insert(m_data.end(), pData, pData + cbData);
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    if (m_sizes.size() >= m_cFragmentSamples)
+    {
+        return WriteFragment();
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  WriteFragment
+//
+//  Writes the pending samples as moof and mdat.
+//-------------------------------------------------------------------
+
+HRESULT CMp4FragmentWriter::WriteFragment()
+{
+    const UINT32 cSamples = (UINT32)m_sizes.size();
+
+    if (cSamples == 0)
+    {
+        return S_OK;
+    }
+
+    std::vector<BYTE> header;
+
+    HRESULT hr = FormatMp4Fragment(m_iSequence, m_decodeTime, m_sizes, &header);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_file.Write(&header[0], (DWORD)header.size());
+    }
+
+    if (SUCCEEDED(hr) && !m_data.empty())
+    {
+        hr = m_file.Write(&m_data[0], (DWORD)m_data.size());
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_iSequence++;
+        m_decodeTime += (UINT64)cSamples * m_format.samplesPerFrame;
+        m_sizes.clear();
+        m_data.clear();
+    }
+    return hr;
+}
+
+HRESULT CMp4FragmentWriter::Finalize()
+{
+    if (!m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = WriteFragment();
+
+    HRESULT hrClose = m_file.Close();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = hrClose;
+    }
+    return hr;
+}
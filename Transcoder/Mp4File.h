@@ -0,0 +1,160 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Mp4File.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// MPEG-4 (ISO base media file format) audio writers used by the portable
+// backend: a whole file, or fragments for streaming (CMAF).
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "Formats.h"
+#include "OutputFile.h"
+
+#include <vector>
+
+// Default duration of a CMAF fragment.
+#define MP4_FRAGMENT_DURATION   (2 * 10000000LL)    // 2 seconds
+
+// The one audio track of an MP4 file.
+struct Mp4AudioFormat
+{
+    AudioCodec  codec;              // AudioCodec_AAC or AudioCodec_MP3
+    UINT32      objectType;         // ISO/IEC 14496-1 objectTypeIndication
+    UINT32      sampleRate;
+    UINT32      channels;
+    UINT32      samplesPerFrame;    // Duration of every sample
+    BYTE        config[2];          // AAC AudioSpecificConfig
+    DWORD       cbConfig;           // 0 for MP3
+};
+
+// Fills in the track format of raw AAC access units with the given ADTS
+// fields. Fails for channel configuration 0, which ADTS leaves to a
+// program config element in the stream.
+HRESULT Mp4AacFormat(UINT32 profile, UINT32 sampleRateIndex, UINT32 channelConfig, Mp4AudioFormat *pFormat);
+
+// Fills in the track format of MPEG audio frames.
+HRESULT Mp4MpegAudioFormat(UINT32 version, UINT32 sampleRate, UINT32 channels, UINT32 samplesPerFrame, Mp4AudioFormat *pFormat);
+
+//-------------------------------------------------------------------
+//  CMp4Writer
+//
+//  Writes one audio track, all its samples in one chunk. Given the
+//  sample sizes up front (SetSampleSizes), the file is written in one
+//  sequential pass with the movie box before the media data, so it
+//  plays while it downloads (fast start). Otherwise the movie box is
+//  appended when the file is finalized, which needs an output that
+//  can be rewritten.
+//-------------------------------------------------------------------
+
+class CMp4Writer
+{
+public:
+    CMp4Writer();
+    ~CMp4Writer();
+
+    // cbExpected is the estimated size of the samples, reserved on
+    // disk; 0 reserves nothing.
+    HRESULT Create(const WCHAR *sPath, const Mp4AudioFormat &format, UINT64 cbExpected = 0);
+
+    // Writes to pSink, which the caller keeps until Finalize.
+    HRESULT Create(IOutputSink *pSink, const Mp4AudioFormat &format, UINT64 cbExpected = 0);
+
+    // Sizes of every sample that will be written, in order. Called
+    // before the first WriteSample; writes the header and the index.
+    HRESULT SetSampleSizes(const std::vector<UINT32> &sizes);
+
+    // Appends one access unit or MP3 frame.
+    HRESULT WriteSample(const BYTE *pData, DWORD cbData);
+
+    HRESULT Finalize();
+
+    BOOL    IsOpen() const { return m_file.IsOpen(); }
+
+    // Closes the file as it is.
+    void    Close() { (void)m_file.Close(); }
+
+private:
+
+    HRESULT Begin(const Mp4AudioFormat &format);
+    HRESULT WriteHeader(UINT64 cbMedia);
+
+    COutputFile             m_file;
+    Mp4AudioFormat          m_format;
+    BOOL                    m_fHeader;      // ftyp and mdat header written
+    BOOL                    m_fIndexed;     // m_sizes given up front
+    std::vector<UINT32>     m_sizes;
+    UINT64                  m_cbMedia;      // Sample bytes written
+    UINT32                  m_cSamples;     // Samples written
+    UINT64                  m_cbHeader;     // ftyp, moov if indexed, and mdat header
+};
+
+// Samples in a fragment of hnsFragment, rounded up; at least one.
+UINT32  Mp4FragmentSamples(const Mp4AudioFormat &format, LONGLONG hnsFragment);
+
+// Formats the init segment of a fragmented file: ftyp and a moov with
+// no samples.
+HRESULT FormatMp4InitSegment(const Mp4AudioFormat &format, std::vector<BYTE> *pSegment);
+
+// Formats the moof of fragment iSequence (from 1) with samples of the
+// given sizes, starting at decodeTime in samples, and the header of
+// the mdat that follows it with the samples.
+HRESULT FormatMp4Fragment(UINT32 iSequence, UINT64 decodeTime, const std::vector<UINT32> &sizes, std::vector<BYTE> *pHeader);
+
+//-------------------------------------------------------------------
+//  CMp4FragmentWriter
+//
+//  Writes one audio track as a CMAF track file: an init segment (ftyp
+//  and a moov without samples) and then a moof and mdat per fragment.
+//  Samples are held until their fragment reaches its duration, so the
+//  memory used depends on the fragment duration, not the length of the
+//  track, and the output is written strictly in order (it can be a
+//  stream).
+//-------------------------------------------------------------------
+
+class CMp4FragmentWriter
+{
+public:
+    CMp4FragmentWriter();
+    ~CMp4FragmentWriter();
+
+    // hnsFragment is the duration of every fragment but the last,
+    // rounded up to whole samples.
+    HRESULT Create(const WCHAR *sPath, const Mp4AudioFormat &format, UINT64 cbExpected = 0, LONGLONG hnsFragment = MP4_FRAGMENT_DURATION);
+
+    // Writes to pSink, which the caller keeps until Finalize.
+    HRESULT Create(IOutputSink *pSink, const Mp4AudioFormat &format, UINT64 cbExpected = 0, LONGLONG hnsFragment = MP4_FRAGMENT_DURATION);
+
+    // Appends one access unit or MP3 frame, writing the fragment once it
+    // is complete.
+    HRESULT WriteSample(const BYTE *pData, DWORD cbData);
+
+    // Writes the last fragment and closes the file.
+    HRESULT Finalize();
+
+    BOOL    IsOpen() const { return m_file.IsOpen(); }
+
+    // Closes the file as it is.
+    void    Close() { (void)m_file.Close(); }
+
+private:
+
+    HRESULT Begin(const Mp4AudioFormat &format, LONGLONG hnsFragment);
+    HRESULT WriteFragment();
+
+    COutputFile             m_file;
+    Mp4AudioFormat          m_format;
+    UINT32                  m_cFragmentSamples; // Samples per fragment
+    UINT32                  m_iSequence;        // Of the next fragment, from 1
+    UINT64                  m_decodeTime;       // Of the next fragment, in samples
+    std::vector<UINT32>     m_sizes;            // Of the pending fragment
+    std::vector<BYTE>       m_data;             // Pending samples
+};
@@ -0,0 +1,546 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// OutputFile.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "OutputFile.h"
+#include "WorkQueue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Descriptor kept for the output file named "-" by
+// ReserveStdoutForOutput; -1 until then.
+static int s_fdStdout = -1;
+
+//-------------------------------------------------------------------
+//  ReserveStdoutForOutput
+//
+//  Keeps a duplicate of standard output, then points descriptor 1 at
+//  standard error, so that wprintf_s from anywhere in the process goes
+//  to the console rather than into the output.
+//-------------------------------------------------------------------
+
+HRESULT ReserveStdoutForOutput()
+{
+    if (s_fdStdout >= 0)
+    {
+        return S_OK;
+    }
+
+    fflush(stdout);
+
+#ifdef _WIN32
+    int fd = _dup(_fileno(stdout));
+
+    if (fd < 0 || _dup2(_fileno(stderr), _fileno(stdout)) != 0)
+#else
+    int fd = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+#endif
+    {
+        HRESULT hr = HRESULT_FROM_ERRNO(errno);
+
+        if (fd >= 0)
+        {
+#ifdef _WIN32
+            _close(fd);
+#else
+            close(fd);
+#endif
+        }
+        return hr;
+    }
+
+    s_fdStdout = fd;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  GetIoQueue
+//
+//  The I/O thread, started on first use. If it cannot be started,
+//  Put fails and the buffers are written on the caller's thread.
+//-------------------------------------------------------------------
+
+static CWorkQueue* GetIoQueue()
+{
+    static CWorkQueue queue;
+    static std::once_flag once;
+
+    std::call_once(once, []() { (void)queue.Start(1); });
+
+    return &queue;
+}
+
+static BYTE* AllocateBuffer()
+{
+#ifdef _WIN32
+    return (BYTE*)_aligned_malloc(OUTPUT_BUFFER_SIZE, OUTPUT_BUFFER_ALIGNMENT);
+#else
+    void *p = NULL;
+    return posix_memalign(&p, OUTPUT_BUFFER_ALIGNMENT, OUTPUT_BUFFER_SIZE) == 0 ? (BYTE*)p : NULL;
+#endif
+}
+
+static void FreeBuffer(BYTE *p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+//-------------------------------------------------------------------
+//  COutputFile
+//-------------------------------------------------------------------
+
+COutputFile::COutputFile() :
+#ifdef _WIN32
+    m_hFile(INVALID_HANDLE_VALUE),
+#else
+    m_fd(-1),
+#endif
+    m_pSink(NULL),
+    m_fOpen(FALSE),
+    m_fStream(FALSE),
+    m_fReserved(FALSE),
+    m_iFill(0),
+    m_cbFill(0),
+    m_cbSize(0),
+    m_cbFlushed(0),
+    m_fWriting(FALSE),
+    m_iWrite(0),
+    m_writeOffset(0),
+    m_cbWrite(0),
+    m_hrWrite(S_OK)
+{
+    m_pBuffers[0] = NULL;
+    m_pBuffers[1] = NULL;
+}
+
+COutputFile::~COutputFile()
+{
+    (void)Close();
+
+    FreeBuffer(m_pBuffers[0]);
+    FreeBuffer(m_pBuffers[1]);
+}
+
+HRESULT COutputFile::Create(const WCHAR *sPath, UINT64 cbExpected)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_fOpen)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    for (DWORD i = 0; i < 2; i++)
+    {
+        if (m_pBuffers[i] == NULL)
+        {
+            m_pBuffers[i] = AllocateBuffer();
+
+            if (m_pBuffers[i] == NULL)
+            {
+                return E_OUTOFMEMORY;
+            }
+        }
+    }
+
+#ifdef _WIN32
+    if (IsStdStreamPath(sPath))
+    {
+        HANDLE hStdout = (s_fdStdout >= 0) ?
+            (HANDLE)_get_osfhandle(s_fdStdout) : GetStdHandle(STD_OUTPUT_HANDLE);
+
+        if (!DuplicateHandle(GetCurrentProcess(), hStdout, GetCurrentProcess(), &m_hFile,
+            0, FALSE, DUPLICATE_SAME_ACCESS))
+        {
+            m_hFile = INVALID_HANDLE_VALUE;
+        }
+    }
+    else
+    {
+        m_hFile = CreateFileW(sPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    }
+
+    if (m_hFile == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    m_fStream = GetFileType(m_hFile) != FILE_TYPE_DISK;
+
+    if (cbExpected > 0 && !m_fStream)
+    {
+        // Reserves clusters without moving the end of the file; NTFS
+        // frees what is left over when the handle is closed.
+        FILE_ALLOCATION_INFO allocation;
+        allocation.AllocationSize.QuadPart = (LONGLONG)cbExpected;
+
+        m_fReserved = SetFileInformationByHandle(m_hFile, FileAllocationInfo, &allocation, sizeof(allocation));
+    }
+#else
+    if (IsStdStreamPath(sPath))
+    {
+        m_fd = fcntl(s_fdStdout >= 0 ? s_fdStdout : STDOUT_FILENO, F_DUPFD_CLOEXEC, 0);
+    }
+    else
+    {
+        char szPath[MAX_PATH * 4];
+
+        if (WideToNarrow(sPath, szPath, sizeof(szPath)) < 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+        }
+
+        m_fd = open(szPath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    }
+
+    if (m_fd < 0)
+    {
+        return HRESULT_FROM_ERRNO(errno);
+    }
+
+    struct stat st;
+
+    m_fStream = fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode);
+
+#ifdef __linux__
+    // Reserves blocks without moving the end of the file. Close trims
+    // what is left over. File systems without fallocate just skip it.
+    if (cbExpected > 0 && !m_fStream)
+    {
+        m_fReserved = fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)cbExpected) == 0;
+    }
+#else
+    (void)cbExpected;
+#endif
+#endif
+
+    m_fOpen = TRUE;
+    m_iFill = 0;
+    m_cbFill = 0;
+    m_cbSize = 0;
+    m_cbFlushed = 0;
+    m_hrWrite = S_OK;
+
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  Open
+//
+//  A sink that can rewrite its output is written straight through.
+//  One that cannot, typically a callback passing the output on, gets
+//  whole buffers rather than every header and frame.
+//-------------------------------------------------------------------
+
+HRESULT COutputFile::Open(IOutputSink *pSink, UINT64 cbExpected)
+{
+    if (!pSink)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_fOpen)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (!pSink->CanWriteAt() && m_pBuffers[0] == NULL)
+    {
+        m_pBuffers[0] = AllocateBuffer();
+
+        if (m_pBuffers[0] == NULL)
+        {
+            return E_OUTOFMEMORY;
+        }
+    }
+
+    if (cbExpected > 0)
+    {
+        pSink->Reserve(cbExpected);
+    }
+
+    m_pSink = pSink;
+    m_fOpen = TRUE;
+    m_fStream = !pSink->CanWriteAt();
+    m_iFill = 0;
+    m_cbFill = 0;
+    m_cbSize = 0;
+    m_cbFlushed = 0;
+    m_hrWrite = S_OK;
+
+    return S_OK;
+}
+
+HRESULT COutputFile::Write(const BYTE *pData, DWORD cbData)
+{
+    if (!m_fOpen)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (m_pSink && !m_fStream)
+    {
+        HRESULT hrSink = m_pSink->Write(pData, cbData);
+
+        if (SUCCEEDED(hrSink))
+        {
+            m_cbSize += cbData;
+            m_cbFlushed = m_cbSize;
+        }
+        return hrSink;
+    }
+
+    HRESULT hr = S_OK;
+
+    while (cbData > 0 && SUCCEEDED(hr))
+    {
+        DWORD cbCopy = OUTPUT_BUFFER_SIZE - m_cbFill;
+
+        if (cbCopy > cbData)
+        {
+            cbCopy = cbData;
+        }
+
+        memcpy(m_pBuffers[m_iFill] + m_cbFill, pData, cbCopy);
+
+        m_cbFill += cbCopy;
+        m_cbSize += cbCopy;
+        pData += cbCopy;
+        cbData -= cbCopy;
+
+        if (m_cbFill == OUTPUT_BUFFER_SIZE)
+        {
+            hr = Flush();
+        }
+    }
+    return hr;
+}
+
+HRESULT COutputFile::WriteAt(UINT64 offset, const BYTE *pData, DWORD cbData)
+{
+    if (!m_fOpen || m_fStream)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = Flush();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WaitForWrite();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WriteFileAt(offset, pData, cbData);
+    }
+
+    if (SUCCEEDED(hr) && offset + cbData > m_cbSize)
+    {
+        m_cbSize = offset + cbData;
+        m_cbFlushed = m_cbSize;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Close
+//
+//  Waits for the last buffer and trims the reserved space to the
+//  size of the file.
+//-------------------------------------------------------------------
+
+HRESULT COutputFile::Close()
+{
+    if (!m_fOpen)
+    {
+        return S_OK;
+    }
+
+    HRESULT hr = Flush();
+    HRESULT hrWait = WaitForWrite();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = hrWait;
+    }
+
+    if (m_pSink)
+    {
+        m_pSink = NULL;
+    }
+    else
+    {
+#ifdef _WIN32
+        if (!CloseHandle(m_hFile) && SUCCEEDED(hr))
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+        }
+        m_hFile = INVALID_HANDLE_VALUE;
+#else
+        if (m_fReserved && ftruncate(m_fd, (off_t)m_cbSize) != 0 && SUCCEEDED(hr))
+        {
+            hr = HRESULT_FROM_ERRNO(errno);
+        }
+
+        if (close(m_fd) != 0 && SUCCEEDED(hr))
+        {
+            hr = HRESULT_FROM_ERRNO(errno);
+        }
+        m_fd = -1;
+#endif
+    }
+
+    m_fOpen = FALSE;
+    m_fStream = FALSE;
+    m_fReserved = FALSE;
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Flush
+//
+//  Hands the buffer being filled to the I/O thread and starts filling
+//  the other one, once its earlier write has finished. The write is
+//  described by members rather than captured, so that queueing it
+//  does not allocate. A sink is written on the caller's thread.
+//-------------------------------------------------------------------
+
+HRESULT COutputFile::Flush()
+{
+    HRESULT hr = WaitForWrite();
+
+    if (FAILED(hr) || m_cbFill == 0)
+    {
+        return hr;
+    }
+
+    if (m_pSink)
+    {
+        hr = m_pSink->Write(m_pBuffers[m_iFill], m_cbFill);
+
+        m_cbFlushed += m_cbFill;
+        m_cbFill = 0;
+        return hr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_fWriting = TRUE;
+        m_iWrite = m_iFill;
+        m_writeOffset = m_cbFlushed;
+        m_cbWrite = m_cbFill;
+    }
+
+    if (FAILED(GetIoQueue()->Put([this]() { WriteBuffer(); })))
+    {
+        WriteBuffer();
+    }
+
+    m_cbFlushed += m_cbFill;
+    m_iFill ^= 1;
+    m_cbFill = 0;
+
+    return S_OK;
+}
+
+HRESULT COutputFile::WaitForWrite()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    while (m_fWriting)
+    {
+        m_cvWritten.wait(lock);
+    }
+    return m_hrWrite;
+}
+
+// Runs on the I/O thread.
+void COutputFile::WriteBuffer()
+{
+    HRESULT hr = WriteFileAt(m_writeOffset, m_pBuffers[m_iWrite], m_cbWrite);
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (FAILED(hr) && SUCCEEDED(m_hrWrite))
+    {
+        m_hrWrite = hr;
+    }
+    m_fWriting = FALSE;
+    m_cvWritten.notify_all();
+}
+
+//-------------------------------------------------------------------
+//  WriteFileAt
+//
+//  A stream is only ever appended to, so its writes ignore the offset.
+//-------------------------------------------------------------------
+
+HRESULT COutputFile::WriteFileAt(UINT64 offset, const BYTE *pData, DWORD cb)
+{
+    if (m_pSink)
+    {
+        return m_pSink->WriteAt(offset, pData, cb);
+    }
+
+    while (cb > 0)
+    {
+#ifdef _WIN32
+        OVERLAPPED overlapped;
+        DWORD cbWritten = 0;
+
+        memset(&overlapped, 0, sizeof(overlapped));
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+        if (!WriteFile(m_hFile, pData, cb, &cbWritten, m_fStream ? NULL : &overlapped))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+#else
+        ssize_t cbWritten = m_fStream ?
+            write(m_fd, pData, cb) : pwrite(m_fd, pData, cb, (off_t)offset);
+
+        if (cbWritten < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return HRESULT_FROM_ERRNO(errno);
+        }
+#endif
+        offset += (DWORD)cbWritten;
+        pData += cbWritten;
+        cb -= (DWORD)cbWritten;
+    }
+    return S_OK;
+}
@@ -0,0 +1,104 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// OutputFile.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Write-behind output file for the portable backend's writers. Writes
+// are gathered in two large page-aligned buffers: while the job fills
+// one, the other is written to disk by a dedicated I/O thread shared
+// by every output file in the process, so the job only waits for the
+// disk when it gets a whole buffer ahead of it. The expected size of
+// the file is reserved up front, so the file system can lay it out in
+// one piece; space the file does not use is given back on Close. The
+// path "-" writes to standard output; unless it is redirected to a
+// file, it is a stream, written in order and never rewritten. An
+// IOutputSink may stand in for the file: a sink that can rewrite gets
+// every write as it is made, one that cannot gets whole buffers, on
+// the job's thread.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "OutputSink.h"
+
+#include <condition_variable>
+#include <mutex>
+
+#define OUTPUT_BUFFER_SIZE          (1024 * 1024)
+#define OUTPUT_BUFFER_ALIGNMENT     4096
+
+// Moves what the process prints to standard error, and keeps standard
+// output for the output file named "-". Call before printing anything.
+HRESULT ReserveStdoutForOutput();
+
+class COutputFile
+{
+public:
+    COutputFile();
+    ~COutputFile();
+
+    // Creates or truncates sPath, or opens standard output for "-".
+    // cbExpected is the estimated final size of the file, reserved on
+    // disk; 0 reserves nothing.
+    HRESULT Create(const WCHAR *sPath, UINT64 cbExpected);
+
+    // Writes to pSink, which the caller keeps until Close, instead of a
+    // file. cbExpected is passed to IOutputSink::Reserve.
+    HRESULT Open(IOutputSink *pSink, UINT64 cbExpected);
+
+    // Appends cbData bytes. A failed background write is returned by the
+    // next Write, WriteAt or Close.
+    HRESULT Write(const BYTE *pData, DWORD cbData);
+
+    // Overwrites bytes already written, such as a header whose sizes are
+    // only known at the end. Waits for the buffered data to be written.
+    // Fails on a stream.
+    HRESULT WriteAt(UINT64 offset, const BYTE *pData, DWORD cbData);
+
+    // Writes what is buffered and closes the file. Returns the first
+    // failure of any write.
+    HRESULT Close();
+
+    BOOL    IsOpen() const { return m_fOpen; }
+    BOOL    IsStream() const { return m_fStream; }
+
+    // Size of the file so far, buffered bytes included.
+    UINT64  Size() const { return m_cbSize; }
+
+private:
+
+    HRESULT Flush();
+    HRESULT WaitForWrite();
+    void    WriteBuffer();
+    HRESULT WriteFileAt(UINT64 offset, const BYTE *pData, DWORD cb);
+
+#ifdef _WIN32
+    HANDLE                  m_hFile;
+#else
+    int                     m_fd;
+#endif
+    IOutputSink*            m_pSink;        // Instead of a file
+    BOOL                    m_fOpen;
+    BOOL                    m_fStream;      // Sequential writes only
+    BOOL                    m_fReserved;    // Space was reserved past the data
+    BYTE*                   m_pBuffers[2];
+    DWORD                   m_iFill;        // Buffer being filled
+    DWORD                   m_cbFill;
+    UINT64                  m_cbSize;
+    UINT64                  m_cbFlushed;    // Bytes handed to the I/O thread
+
+    std::mutex              m_lock;
+    std::condition_variable m_cvWritten;
+    BOOL                    m_fWriting;     // The other buffer is in flight
+    DWORD                   m_iWrite;       // The write in flight
+    UINT64                  m_writeOffset;
+    DWORD                   m_cbWrite;
+    HRESULT                 m_hrWrite;      // First failed write
+};
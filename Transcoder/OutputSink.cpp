@@ -0,0 +1,180 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// OutputSink.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "OutputSink.h"
+
+#include <new>
+#include <string.h>
+
+#define MEMORY_OUTPUT_MIN_GROWTH    (64 * 1024)
+
+//-------------------------------------------------------------------
+//  CMemoryOutput
+//-------------------------------------------------------------------
+
+CMemoryOutput::CMemoryOutput(BYTE *pBuffer, size_t cbBuffer) :
+    m_pCallerBuffer(pBuffer),
+    m_cbCallerBuffer(pBuffer ? cbBuffer : 0),
+    m_pData(pBuffer),
+    m_cbCapacity(pBuffer ? cbBuffer : 0),
+    m_cbData(0)
+{
+
+}
+
+CMemoryOutput::~CMemoryOutput()
+{
+    Clear();
+}
+
+void CMemoryOutput::Clear()
+{
+    if (m_pData != m_pCallerBuffer)
+    {
+        delete [] m_pData;
+    }
+
+    m_pData = m_pCallerBuffer;
+    m_cbCapacity = m_cbCallerBuffer;
+    m_cbData = 0;
+}
+
+//-------------------------------------------------------------------
+//  Reserve
+//
+//  Allocates the expected size at once, so the output is not copied
+//  as it grows. Failing to is not an error; Write grows the buffer.
+//-------------------------------------------------------------------
+
+void CMemoryOutput::Reserve(UINT64 cb)
+{
+    if (cb > m_cbCapacity)
+    {
+        (void)Grow(cb);
+    }
+}
+
+//-------------------------------------------------------------------
+//  Grow
+//
+//  Moves the output to a buffer of at least cb bytes, twice the
+//  current capacity if that is more.
+//-------------------------------------------------------------------
+
+HRESULT CMemoryOutput::Grow(UINT64 cb)
+{
+    UINT64 cbCapacity = (UINT64)m_cbCapacity * 2;
+
+    if (cbCapacity < cb)
+    {
+        cbCapacity = cb;
+    }
+
+    if (cbCapacity < MEMORY_OUTPUT_MIN_GROWTH)
+    {
+        cbCapacity = MEMORY_OUTPUT_MIN_GROWTH;
+    }
+
+    if (cbCapacity > (size_t)-1)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    BYTE *pData = new (std::nothrow) BYTE[(size_t)cbCapacity];
+
+    if (pData == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    if (m_cbData > 0)
+    {
+        memcpy(pData, m_pData, m_cbData);
+    }
+
+    if (m_pData != m_pCallerBuffer)
+    {
+        delete [] m_pData;
+    }
+
+    m_pData = pData;
+    m_cbCapacity = (size_t)cbCapacity;
+    return S_OK;
+}
+
+HRESULT CMemoryOutput::Write(const BYTE *pData, DWORD cbData)
+{
+    return WriteAt(m_cbData, pData, cbData);
+}
+
+HRESULT CMemoryOutput::WriteAt(UINT64 offset, const BYTE *pData, DWORD cbData)
+{
+    if (!pData && cbData > 0)
+    {
+        return E_POINTER;
+    }
+
+    if (offset > m_cbData)
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = S_OK;
+
+    if (offset + cbData > m_cbCapacity)
+    {
+        hr = Grow(offset + cbData);
+    }
+
+    if (SUCCEEDED(hr) && cbData > 0)
+    {
+        memcpy(m_pData + offset, pData, cbData);
+
+        if (offset + cbData > m_cbData)
+        {
+            m_cbData = (size_t)(offset + cbData);
+        }
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CCallbackOutput
+//-------------------------------------------------------------------
+
+CCallbackOutput::CCallbackOutput(PFN_OUTPUT_CHUNK pfnChunk, void *pContext) :
+    m_pfnChunk(pfnChunk),
+    m_pContext(pContext),
+    m_cbData(0)
+{
+
+}
+
+HRESULT CCallbackOutput::Write(const BYTE *pData, DWORD cbData)
+{
+    if (m_pfnChunk == NULL)
+    {
+        return E_POINTER;
+    }
+
+    if (cbData == 0)
+    {
+        return S_OK;
+    }
+
+    HRESULT hr = m_pfnChunk(pData, cbData, m_pContext);
+
+    if (SUCCEEDED(hr))
+    {
+        m_cbData += cbData;
+    }
+    return hr;
+}
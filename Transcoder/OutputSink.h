@@ -0,0 +1,112 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// OutputSink.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Outputs that are not files. A session writes its main output into an
+// IOutputSink given to CTranscoder::EncodeToFile instead of a URL:
+// CMemoryOutput gathers it in a growable buffer, CCallbackOutput hands
+// each piece to a callback as it is written.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+//-------------------------------------------------------------------
+//  IOutputSink
+//
+//  Called on the session's job thread only, one call at a time.
+//-------------------------------------------------------------------
+
+class IOutputSink
+{
+public:
+    virtual ~IOutputSink() {}
+
+    // TRUE if WriteAt can rewrite bytes already written. Without it the
+    // output is written strictly in order, as to a pipe: a WAVE header
+    // keeps the 0xFFFFFFFF streaming sizes.
+    virtual BOOL    CanWriteAt() const = 0;
+
+    // The output is expected to be about cb bytes. A hint only.
+    virtual void    Reserve(UINT64 cb) = 0;
+
+    virtual HRESULT Write(const BYTE *pData, DWORD cbData) = 0;
+    virtual HRESULT WriteAt(UINT64 offset, const BYTE *pData, DWORD cbData) = 0;
+
+    // Bytes written so far.
+    virtual UINT64  Size() const = 0;
+};
+
+//-------------------------------------------------------------------
+//  CMemoryOutput
+//
+//  Writes into the caller's buffer, if one is given, until it is full,
+//  then moves to a buffer of its own that doubles as it fills.
+//-------------------------------------------------------------------
+
+class CMemoryOutput : public IOutputSink
+{
+public:
+    CMemoryOutput(BYTE *pBuffer = NULL, size_t cbBuffer = 0);
+    ~CMemoryOutput();
+
+    // The output so far; the caller's buffer while it is large enough.
+    const BYTE* Data() const { return m_pData; }
+
+    // Forgets the output and goes back to the caller's buffer.
+    void    Clear();
+
+    // IOutputSink
+    BOOL    CanWriteAt() const { return TRUE; }
+    void    Reserve(UINT64 cb);
+    HRESULT Write(const BYTE *pData, DWORD cbData);
+    HRESULT WriteAt(UINT64 offset, const BYTE *pData, DWORD cbData);
+    UINT64  Size() const { return m_cbData; }
+
+private:
+
+    HRESULT Grow(UINT64 cb);
+
+    BYTE*       m_pCallerBuffer;
+    size_t      m_cbCallerBuffer;
+    BYTE*       m_pData;            // m_pCallerBuffer or owned
+    size_t      m_cbCapacity;
+    size_t      m_cbData;
+};
+
+// Receives the next cbData bytes of the output, in order. A failure
+// fails the encode.
+typedef HRESULT (*PFN_OUTPUT_CHUNK)(const BYTE *pData, DWORD cbData, void *pContext);
+
+//-------------------------------------------------------------------
+//  CCallbackOutput
+//
+//  Passes every write straight to a callback, without copying it.
+//-------------------------------------------------------------------
+
+class CCallbackOutput : public IOutputSink
+{
+public:
+    CCallbackOutput(PFN_OUTPUT_CHUNK pfnChunk, void *pContext);
+
+    // IOutputSink
+    BOOL    CanWriteAt() const { return FALSE; }
+    void    Reserve(UINT64) { }
+    HRESULT Write(const BYTE *pData, DWORD cbData);
+    HRESULT WriteAt(UINT64, const BYTE*, DWORD) { return MF_E_INVALIDREQUEST; }
+    UINT64  Size() const { return m_cbData; }
+
+private:
+
+    PFN_OUTPUT_CHUNK    m_pfnChunk;
+    void*               m_pContext;
+    UINT64              m_cbData;
+};
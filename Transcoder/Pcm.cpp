@@ -0,0 +1,156 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Pcm.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Pcm.h"
+
+#include <string.h>
+
+BOOL IsSupportedPcmFormat(const PcmFormat &fmt)
+{
+    if (fmt.sampleRate == 0 || fmt.channels == 0)
+    {
+        return FALSE;
+    }
+
+    if (fmt.fFloat)
+    {
+        return fmt.bitsPerSample == 32;
+    }
+
+    return fmt.bitsPerSample == 8 || fmt.bitsPerSample == 16 ||
+        fmt.bitsPerSample == 24 || fmt.bitsPerSample == 32;
+}
+
+//-------------------------------------------------------------------
+//  GetPcmSampleType
+//-------------------------------------------------------------------
+
+PcmSampleType GetPcmSampleType(const PcmFormat &fmt)
+{
+    if (fmt.fFloat)
+    {
+        return PcmSample_Float32;
+    }
+
+    switch (fmt.bitsPerSample)
+    {
+    case 8:     return PcmSample_UInt8;
+    case 16:    return PcmSample_Int16;
+    case 24:    return PcmSample_Int24;
+    default:    return PcmSample_Int32;
+    }
+}
+
+//-------------------------------------------------------------------
+//  ConvertPcm
+//
+//  Converts sample depth and, for mono <-> stereo, channel count.
+//  Samples go through a float buffer a chunk at a time; formats that
+//  match are copied as they are.
+//-------------------------------------------------------------------
+
+HRESULT ConvertPcm(
+    const PcmFormat &srcFormat, const BYTE *pSrc,
+    const PcmFormat &dstFormat, BYTE *pDst,
+    UINT32 cFrames,
+    const PcmKernels *pKernels
+    )
+{
+    if (!pSrc || !pDst)
+    {
+        return E_POINTER;
+    }
+
+    if (!IsSupportedPcmFormat(srcFormat) || !IsSupportedPcmFormat(dstFormat) ||
+        srcFormat.sampleRate != dstFormat.sampleRate)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    if (srcFormat.channels != dstFormat.channels &&
+        !(srcFormat.channels == 1 && dstFormat.channels == 2) &&
+        !(srcFormat.channels == 2 && dstFormat.channels == 1))
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    if (srcFormat.channels == dstFormat.channels &&
+        srcFormat.bitsPerSample == dstFormat.bitsPerSample &&
+        srcFormat.fFloat == dstFormat.fFloat)
+    {
+        memcpy(pDst, pSrc, (size_t)cFrames * PcmBlockAlign(srcFormat));
+        return S_OK;
+    }
+
+    if (!pKernels)
+    {
+        pKernels = GetPcmKernels();
+    }
+
+    PFN_PCM_TO_FLOAT pfnToFloat = pKernels->pfnToFloat[GetPcmSampleType(srcFormat)];
+    PFN_PCM_FROM_FLOAT pfnFromFloat = pKernels->pfnFromFloat[GetPcmSampleType(dstFormat)];
+
+    const UINT32 cbSrcSample = srcFormat.bitsPerSample / 8;
+    const UINT32 cbDstSample = dstFormat.bitsPerSample / 8;
+
+    float samples[PCM_CHUNK_SAMPLES];
+    float mixed[PCM_CHUNK_SAMPLES];
+
+    if (srcFormat.channels == dstFormat.channels)
+    {
+        // Channels do not matter: convert the samples in a row.
+        UINT64 cSamples = (UINT64)cFrames * srcFormat.channels;
+
+        while (cSamples > 0)
+        {
+            UINT32 cChunk = cSamples < PCM_CHUNK_SAMPLES ? (UINT32)cSamples : PCM_CHUNK_SAMPLES;
+
+            pfnToFloat(pSrc, samples, cChunk);
+            pfnFromFloat(samples, pDst, cChunk);
+
+            pSrc += cChunk * cbSrcSample;
+            pDst += cChunk * cbDstSample;
+            cSamples -= cChunk;
+        }
+    }
+    else if (srcFormat.channels == 1)
+    {
+        while (cFrames > 0)
+        {
+            UINT32 cChunk = cFrames < PCM_CHUNK_SAMPLES / 2 ? cFrames : PCM_CHUNK_SAMPLES / 2;
+
+            pfnToFloat(pSrc, samples, cChunk);
+            pKernels->pfnMonoToStereo(samples, mixed, cChunk);
+            pfnFromFloat(mixed, pDst, 2 * cChunk);
+
+            pSrc += cChunk * cbSrcSample;
+            pDst += 2 * cChunk * cbDstSample;
+            cFrames -= cChunk;
+        }
+    }
+    else
+    {
+        while (cFrames > 0)
+        {
+            UINT32 cChunk = cFrames < PCM_CHUNK_SAMPLES / 2 ? cFrames : PCM_CHUNK_SAMPLES / 2;
+
+            pfnToFloat(pSrc, samples, 2 * cChunk);
+            pKernels->pfnStereoToMono(samples, mixed, cChunk);
+            pfnFromFloat(mixed, pDst, cChunk);
+
+            pSrc += 2 * cChunk * cbSrcSample;
+            pDst += cChunk * cbDstSample;
+            cFrames -= cChunk;
+        }
+    }
+
+    return S_OK;
+}
@@ -0,0 +1,72 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Pcm.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Uncompressed audio formats and sample conversion for the portable
+// backend.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "PcmKernels.h"
+
+// Samples ConvertPcm converts at a time through its float buffers.
+#define PCM_CHUNK_SAMPLES   2048
+
+// Interleaved little-endian PCM. Integer samples are 8 (unsigned),
+// 16, 24 or 32 bits; float samples are 32 bits.
+struct PcmFormat
+{
+    UINT32  sampleRate;
+    UINT32  channels;
+    UINT32  bitsPerSample;
+    BOOL    fFloat;
+};
+
+inline UINT32 PcmBlockAlign(const PcmFormat &fmt)
+{
+    return fmt.channels * (fmt.bitsPerSample / 8);
+}
+
+inline UINT32 PcmBytesPerSecond(const PcmFormat &fmt)
+{
+    return PcmBlockAlign(fmt) * fmt.sampleRate;
+}
+
+// Converts a time in 100-nanosecond units to a sample position,
+// rounding down.
+inline UINT64 HnsToSamples(LONGLONG hns, UINT32 sampleRate)
+{
+    return hns > 0 ? (UINT64)hns * sampleRate / 10000000 : 0;
+}
+
+// Converts a sample position to 100-nanosecond units, rounding up so
+// that HnsToSamples gives back the same position.
+inline LONGLONG SamplesToHns(UINT64 iSample, UINT32 sampleRate)
+{
+    return (LONGLONG)((iSample * 10000000 + sampleRate - 1) / sampleRate);
+}
+
+// Returns TRUE if the sample layout is one ConvertPcm understands.
+BOOL    IsSupportedPcmFormat(const PcmFormat &fmt);
+
+// Returns the kernel sample type of a supported format.
+PcmSampleType GetPcmSampleType(const PcmFormat &fmt);
+
+// Converts cFrames frames from srcFormat to dstFormat. The sample rate
+// must match; the channel count may differ only for mono <-> stereo.
+// pKernels selects a kernel set; NULL uses the fastest one.
+HRESULT ConvertPcm(
+    const PcmFormat &srcFormat, const BYTE *pSrc,
+    const PcmFormat &dstFormat, BYTE *pDst,
+    UINT32 cFrames,
+    const PcmKernels *pKernels = NULL
+    );
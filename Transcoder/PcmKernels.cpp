@@ -0,0 +1,811 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PcmKernels.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "PcmKernels.h"
+
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define PCM_KERNELS_X86
+#endif
+
+#ifdef PCM_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// The vector sets are built into this file without raising the
+// instruction set of the rest of the program; GCC and clang need
+// each function marked with the instructions it may use.
+#if defined(PCM_KERNELS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define PCM_TARGET_SSE2     __attribute__((target("sse2")))
+#define PCM_TARGET_AVX2     __attribute__((target("avx2")))
+#else
+#define PCM_TARGET_SSE2
+#define PCM_TARGET_AVX2
+#endif
+
+//-------------------------------------------------------------------
+//  Scalar kernels
+//
+//  These define the results. Float samples are clamped with the
+//  comparisons SSE max/min make, so NaN is written as -1, and then
+//  truncated toward zero.
+//-------------------------------------------------------------------
+
+static inline float ClampSample(float f)
+{
+    f = f > -1.0f ? f : -1.0f;
+    return f < 1.0f ? f : 1.0f;
+}
+
+static inline void StoreInt16(BYTE *p, float f)
+{
+    int v = (int)(ClampSample(f) * 32768.0f);
+    v = v > 32767 ? 32767 : v;
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+}
+
+static inline void StoreInt24(BYTE *p, float f)
+{
+    int v = (int)(ClampSample(f) * 8388608.0f);
+    v = v > 8388607 ? 8388607 : v;
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+}
+
+static inline void StoreInt32(BYTE *p, float f)
+{
+    float s = ClampSample(f) * 2147483648.0f;
+    INT32 v = s >= 2147483648.0f ? 2147483647 : (INT32)s;
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+static inline float LoadInt16(const BYTE *p)
+{
+    return (INT16)(p[0] | (p[1] << 8)) * (1.0f / 32768.0f);
+}
+
+static inline float LoadInt24(const BYTE *p)
+{
+    return (INT32)((UINT32)(p[0] << 8 | p[1] << 16 | p[2] << 24)) * (1.0f / 2147483648.0f);
+}
+
+static inline float LoadInt32(const BYTE *p)
+{
+    return (INT32)((UINT32)(p[0] | p[1] << 8 | p[2] << 16 | (UINT32)p[3] << 24)) * (1.0f / 2147483648.0f);
+}
+
+static void UInt8ToFloat_Scalar(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        pDst[i] = ((int)pSrc[i] - 128) * (1.0f / 128.0f);
+    }
+}
+
+static void Int16ToFloat_Scalar(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        pDst[i] = LoadInt16(pSrc + 2 * i);
+    }
+}
+
+static void Int24ToFloat_Scalar(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        pDst[i] = LoadInt24(pSrc + 3 * i);
+    }
+}
+
+static void Int32ToFloat_Scalar(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        pDst[i] = LoadInt32(pSrc + 4 * i);
+    }
+}
+
+static void Float32ToFloat(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    memcpy(pDst, pSrc, (size_t)cSamples * sizeof(float));
+}
+
+static void FloatToUInt8_Scalar(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        int v = (int)(ClampSample(pSrc[i]) * 128.0f) + 128;
+        pDst[i] = (BYTE)(v > 255 ? 255 : v);
+    }
+}
+
+static void FloatToInt16_Scalar(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        StoreInt16(pDst + 2 * i, pSrc[i]);
+    }
+}
+
+static void FloatToInt24_Scalar(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        StoreInt24(pDst + 3 * i, pSrc[i]);
+    }
+}
+
+static void FloatToInt32_Scalar(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    for (UINT32 i = 0; i < cSamples; i++)
+    {
+        StoreInt32(pDst + 4 * i, pSrc[i]);
+    }
+}
+
+static void FloatToFloat32(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    memcpy(pDst, pSrc, (size_t)cSamples * sizeof(float));
+}
+
+static void StereoToMono_Scalar(const float *pSrc, float *pDst, UINT32 cFrames)
+{
+    for (UINT32 i = 0; i < cFrames; i++)
+    {
+        pDst[i] = 0.5f * (pSrc[2 * i] + pSrc[2 * i + 1]);
+    }
+}
+
+static void MonoToStereo_Scalar(const float *pSrc, float *pDst, UINT32 cFrames)
+{
+    for (UINT32 i = 0; i < cFrames; i++)
+    {
+        pDst[2 * i] = pSrc[i];
+        pDst[2 * i + 1] = pSrc[i];
+    }
+}
+
+static void Interleave2_Scalar(const float *pLeft, const float *pRight, float *pDst, UINT32 cFrames)
+{
+    for (UINT32 i = 0; i < cFrames; i++)
+    {
+        pDst[2 * i] = pLeft[i];
+        pDst[2 * i + 1] = pRight[i];
+    }
+}
+
+static void Deinterleave2_Scalar(const float *pSrc, float *pLeft, float *pRight, UINT32 cFrames)
+{
+    for (UINT32 i = 0; i < cFrames; i++)
+    {
+        pLeft[i] = pSrc[2 * i];
+        pRight[i] = pSrc[2 * i + 1];
+    }
+}
+
+static float DotProduct_Scalar(const float *pA, const float *pB, UINT32 c)
+{
+    float s[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+    UINT32 i = 0;
+
+    for (; i + 8 <= c; i += 8)
+    {
+        for (int k = 0; k < 8; k++)
+        {
+            s[k] += pA[i + k] * pB[i + k];
+        }
+    }
+
+    float sum = ((s[0] + s[4]) + (s[2] + s[6])) + ((s[1] + s[5]) + (s[3] + s[7]));
+
+    for (; i < c; i++)
+    {
+        sum += pA[i] * pB[i];
+    }
+    return sum;
+}
+
+static const PcmKernels scalar_kernels =
+{
+    "scalar",
+    { UInt8ToFloat_Scalar, Int16ToFloat_Scalar, Int24ToFloat_Scalar, Int32ToFloat_Scalar, Float32ToFloat },
+    { FloatToUInt8_Scalar, FloatToInt16_Scalar, FloatToInt24_Scalar, FloatToInt32_Scalar, FloatToFloat32 },
+    StereoToMono_Scalar,
+    MonoToStereo_Scalar,
+    Interleave2_Scalar,
+    Deinterleave2_Scalar,
+    DotProduct_Scalar,
+};
+
+#ifdef PCM_KERNELS_X86
+
+//-------------------------------------------------------------------
+//  SSE2 kernels
+//
+//  Four samples at a time; the remainder goes through the scalar
+//  code. 8-bit samples stay scalar in every set.
+//-------------------------------------------------------------------
+
+PCM_TARGET_SSE2 static inline __m128 Clamp_SSE2(__m128 x)
+{
+    return _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+
+PCM_TARGET_SSE2 static void Int16ToFloat_SSE2(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    UINT32 i = 0;
+
+    for (; i + 8 <= cSamples; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(pSrc + 2 * i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+        _mm_storeu_ps(pDst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(pDst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+
+    Int16ToFloat_Scalar(pSrc + 2 * i, pDst + i, cSamples - i);
+}
+
+PCM_TARGET_SSE2 static void Int24ToFloat_SSE2(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    UINT32 i = 0;
+
+    // Each sample is read as 4 bytes, so the last one in a group of
+    // four must not be the last of the buffer.
+    for (; i + 5 <= cSamples; i += 4)
+    {
+        INT32 s[4];
+        memcpy(&s[0], pSrc + 3 * i, 4);
+        memcpy(&s[1], pSrc + 3 * i + 3, 4);
+        memcpy(&s[2], pSrc + 3 * i + 6, 4);
+        memcpy(&s[3], pSrc + 3 * i + 9, 4);
+
+        __m128i v = _mm_slli_epi32(_mm_loadu_si128((const __m128i*)s), 8);
+
+        _mm_storeu_ps(pDst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+
+    Int24ToFloat_Scalar(pSrc + 3 * i, pDst + i, cSamples - i);
+}
+
+PCM_TARGET_SSE2 static void Int32ToFloat_SSE2(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    UINT32 i = 0;
+
+    for (; i + 4 <= cSamples; i += 4)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*)(pSrc + 4 * i));
+
+        _mm_storeu_ps(pDst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+
+    Int32ToFloat_Scalar(pSrc + 4 * i, pDst + i, cSamples - i);
+}
+
+PCM_TARGET_SSE2 static void FloatToInt16_SSE2(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    UINT32 i = 0;
+
+    for (; i + 8 <= cSamples; i += 8)
+    {
+        __m128i lo = _mm_cvttps_epi32(_mm_mul_ps(Clamp_SSE2(_mm_loadu_ps(pSrc + i)), scale));
+        __m128i hi = _mm_cvttps_epi32(_mm_mul_ps(Clamp_SSE2(_mm_loadu_ps(pSrc + i + 4)), scale));
+
+        // Saturation turns +32768 into 32767.
+        _mm_storeu_si128((__m128i*)(pDst + 2 * i), _mm_packs_epi32(lo, hi));
+    }
+
+    FloatToInt16_Scalar(pSrc + i, pDst + 2 * i, cSamples - i);
+}
+
+PCM_TARGET_SSE2 static void FloatToInt24_SSE2(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    const __m128 scale = _mm_set1_ps(8388608.0f);
+    const __m128 limit = _mm_set1_ps(8388607.0f);
+    UINT32 i = 0;
+
+    for (; i + 4 <= cSamples; i += 4)
+    {
+        INT32 s[4];
+        __m128 x = _mm_min_ps(_mm_mul_ps(Clamp_SSE2(_mm_loadu_ps(pSrc + i)), scale), limit);
+
+        _mm_storeu_si128((__m128i*)s, _mm_cvttps_epi32(x));
+
+        for (int k = 0; k < 4; k++)
+        {
+            BYTE *p = pDst + 3 * (i + k);
+            p[0] = (BYTE)s[k];
+            p[1] = (BYTE)(s[k] >> 8);
+            p[2] = (BYTE)(s[k] >> 16);
+        }
+    }
+
+    FloatToInt24_Scalar(pSrc + i, pDst + 3 * i, cSamples - i);
+}
+
+PCM_TARGET_SSE2 static void FloatToInt32_SSE2(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    const __m128 scale = _mm_set1_ps(2147483648.0f);
+    UINT32 i = 0;
+
+    for (; i + 4 <= cSamples; i += 4)
+    {
+        __m128 x = _mm_mul_ps(Clamp_SSE2(_mm_loadu_ps(pSrc + i)), scale);
+
+        // +1.0 converts to 0x80000000; flipping every bit gives INT_MAX.
+        __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(x, scale));
+
+        _mm_storeu_si128((__m128i*)(pDst + 4 * i), _mm_xor_si128(_mm_cvttps_epi32(x), overflow));
+    }
+
+    FloatToInt32_Scalar(pSrc + i, pDst + 4 * i, cSamples - i);
+}
+
+PCM_TARGET_SSE2 static void StereoToMono_SSE2(const float *pSrc, float *pDst, UINT32 cFrames)
+{
+    const __m128 half = _mm_set1_ps(0.5f);
+    UINT32 i = 0;
+
+    for (; i + 4 <= cFrames; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(pSrc + 2 * i);
+        __m128 b = _mm_loadu_ps(pSrc + 2 * i + 4);
+        __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+
+        _mm_storeu_ps(pDst + i, _mm_mul_ps(half, _mm_add_ps(l, r)));
+    }
+
+    StereoToMono_Scalar(pSrc + 2 * i, pDst + i, cFrames - i);
+}
+
+PCM_TARGET_SSE2 static void MonoToStereo_SSE2(const float *pSrc, float *pDst, UINT32 cFrames)
+{
+    UINT32 i = 0;
+
+    for (; i + 4 <= cFrames; i += 4)
+    {
+        __m128 m = _mm_loadu_ps(pSrc + i);
+
+        _mm_storeu_ps(pDst + 2 * i, _mm_unpacklo_ps(m, m));
+        _mm_storeu_ps(pDst + 2 * i + 4, _mm_unpackhi_ps(m, m));
+    }
+
+    MonoToStereo_Scalar(pSrc + i, pDst + 2 * i, cFrames - i);
+}
+
+PCM_TARGET_SSE2 static void Interleave2_SSE2(const float *pLeft, const float *pRight, float *pDst, UINT32 cFrames)
+{
+    UINT32 i = 0;
+
+    for (; i + 4 <= cFrames; i += 4)
+    {
+        __m128 l = _mm_loadu_ps(pLeft + i);
+        __m128 r = _mm_loadu_ps(pRight + i);
+
+        _mm_storeu_ps(pDst + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(pDst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+
+    Interleave2_Scalar(pLeft + i, pRight + i, pDst + 2 * i, cFrames - i);
+}
+
+PCM_TARGET_SSE2 static void Deinterleave2_SSE2(const float *pSrc, float *pLeft, float *pRight, UINT32 cFrames)
+{
+    UINT32 i = 0;
+
+    for (; i + 4 <= cFrames; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(pSrc + 2 * i);
+        __m128 b = _mm_loadu_ps(pSrc + 2 * i + 4);
+
+        _mm_storeu_ps(pLeft + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(pRight + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+
+    Deinterleave2_Scalar(pSrc + 2 * i, pLeft + i, pRight + i, cFrames - i);
+}
+
+PCM_TARGET_SSE2 static float DotProduct_SSE2(const float *pA, const float *pB, UINT32 c)
+{
+    __m128 lo = _mm_setzero_ps();
+    __m128 hi = _mm_setzero_ps();
+    UINT32 i = 0;
+
+    for (; i + 8 <= c; i += 8)
+    {
+        lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(pA + i), _mm_loadu_ps(pB + i)));
+        hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(pA + i + 4), _mm_loadu_ps(pB + i + 4)));
+    }
+
+    // (s0 + s4, s1 + s5, s2 + s6, s3 + s7), then the pairs.
+    __m128 s = _mm_add_ps(lo, hi);
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+
+    float sum = _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1))));
+
+    for (; i < c; i++)
+    {
+        sum += pA[i] * pB[i];
+    }
+    return sum;
+}
+
+static const PcmKernels sse2_kernels =
+{
+    "sse2",
+    { UInt8ToFloat_Scalar, Int16ToFloat_SSE2, Int24ToFloat_SSE2, Int32ToFloat_SSE2, Float32ToFloat },
+    { FloatToUInt8_Scalar, FloatToInt16_SSE2, FloatToInt24_SSE2, FloatToInt32_SSE2, FloatToFloat32 },
+    StereoToMono_SSE2,
+    MonoToStereo_SSE2,
+    Interleave2_SSE2,
+    Deinterleave2_SSE2,
+    DotProduct_SSE2,
+};
+
+//-------------------------------------------------------------------
+//  AVX2 kernels
+//
+//  Eight samples at a time. Packs and shuffles work within each
+//  128-bit lane, so results that cross lanes are put back in order
+//  with a permute.
+//-------------------------------------------------------------------
+
+PCM_TARGET_AVX2 static inline __m256 Clamp_AVX2(__m256 x)
+{
+    return _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-1.0f)), _mm256_set1_ps(1.0f));
+}
+
+PCM_TARGET_AVX2 static void Int16ToFloat_AVX2(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 32768.0f);
+    UINT32 i = 0;
+
+    for (; i + 8 <= cSamples; i += 8)
+    {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(pSrc + 2 * i)));
+
+        _mm256_storeu_ps(pDst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    Int16ToFloat_Scalar(pSrc + 2 * i, pDst + i, cSamples - i);
+}
+
+PCM_TARGET_AVX2 static void Int24ToFloat_AVX2(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+
+    // Moves the 3 bytes of each sample to the top of a 32-bit lane.
+    const __m256i spread = _mm256_setr_epi8(
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    UINT32 i = 0;
+
+    // The second 16-byte load of each group reads 28 bytes in.
+    for (; i + 10 <= cSamples; i += 8)
+    {
+        const BYTE *p = pSrc + 3 * i;
+        __m256i v = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)p)),
+            _mm_loadu_si128((const __m128i*)(p + 12)), 1);
+
+        v = _mm256_shuffle_epi8(v, spread);
+
+        _mm256_storeu_ps(pDst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    Int24ToFloat_SSE2(pSrc + 3 * i, pDst + i, cSamples - i);
+}
+
+PCM_TARGET_AVX2 static void Int32ToFloat_AVX2(const BYTE *pSrc, float *pDst, UINT32 cSamples)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+    UINT32 i = 0;
+
+    for (; i + 8 <= cSamples; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(pSrc + 4 * i));
+
+        _mm256_storeu_ps(pDst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    Int32ToFloat_Scalar(pSrc + 4 * i, pDst + i, cSamples - i);
+}
+
+PCM_TARGET_AVX2 static void FloatToInt16_AVX2(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    UINT32 i = 0;
+
+    for (; i + 16 <= cSamples; i += 16)
+    {
+        __m256i lo = _mm256_cvttps_epi32(_mm256_mul_ps(Clamp_AVX2(_mm256_loadu_ps(pSrc + i)), scale));
+        __m256i hi = _mm256_cvttps_epi32(_mm256_mul_ps(Clamp_AVX2(_mm256_loadu_ps(pSrc + i + 8)), scale));
+
+        __m256i v = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), _MM_SHUFFLE(3, 1, 2, 0));
+
+        _mm256_storeu_si256((__m256i*)(pDst + 2 * i), v);
+    }
+
+    FloatToInt16_SSE2(pSrc + i, pDst + 2 * i, cSamples - i);
+}
+
+PCM_TARGET_AVX2 static void FloatToInt24_AVX2(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    const __m256 scale = _mm256_set1_ps(8388608.0f);
+    const __m256 limit = _mm256_set1_ps(8388607.0f);
+
+    // Packs the low 3 bytes of each sample into the first 12 bytes of
+    // its lane.
+    const __m256i pack = _mm256_setr_epi8(
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    UINT32 i = 0;
+
+    // Each group writes 16 bytes at 12 bytes in; the 4 bytes past the
+    // group are rewritten by the next one.
+    for (; i + 10 <= cSamples; i += 8)
+    {
+        __m256 x = _mm256_min_ps(_mm256_mul_ps(Clamp_AVX2(_mm256_loadu_ps(pSrc + i)), scale), limit);
+        __m256i v = _mm256_shuffle_epi8(_mm256_cvttps_epi32(x), pack);
+        BYTE *p = pDst + 3 * i;
+
+        _mm_storeu_si128((__m128i*)p, _mm256_castsi256_si128(v));
+        _mm_storeu_si128((__m128i*)(p + 12), _mm256_extracti128_si256(v, 1));
+    }
+
+    FloatToInt24_SSE2(pSrc + i, pDst + 3 * i, cSamples - i);
+}
+
+PCM_TARGET_AVX2 static void FloatToInt32_AVX2(const float *pSrc, BYTE *pDst, UINT32 cSamples)
+{
+    const __m256 scale = _mm256_set1_ps(2147483648.0f);
+    UINT32 i = 0;
+
+    for (; i + 8 <= cSamples; i += 8)
+    {
+        __m256 x = _mm256_mul_ps(Clamp_AVX2(_mm256_loadu_ps(pSrc + i)), scale);
+        __m256i overflow = _mm256_castps_si256(_mm256_cmp_ps(x, scale, _CMP_GE_OQ));
+
+        _mm256_storeu_si256((__m256i*)(pDst + 4 * i), _mm256_xor_si256(_mm256_cvttps_epi32(x), overflow));
+    }
+
+    FloatToInt32_Scalar(pSrc + i, pDst + 4 * i, cSamples - i);
+}
+
+PCM_TARGET_AVX2 static void StereoToMono_AVX2(const float *pSrc, float *pDst, UINT32 cFrames)
+{
+    const __m256 half = _mm256_set1_ps(0.5f);
+    UINT32 i = 0;
+
+    for (; i + 8 <= cFrames; i += 8)
+    {
+        __m256 a = _mm256_loadu_ps(pSrc + 2 * i);
+        __m256 b = _mm256_loadu_ps(pSrc + 2 * i + 8);
+        __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 m = _mm256_mul_ps(half, _mm256_add_ps(l, r));
+
+        m = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(m), _MM_SHUFFLE(3, 1, 2, 0)));
+
+        _mm256_storeu_ps(pDst + i, m);
+    }
+
+    StereoToMono_SSE2(pSrc + 2 * i, pDst + i, cFrames - i);
+}
+
+PCM_TARGET_AVX2 static void MonoToStereo_AVX2(const float *pSrc, float *pDst, UINT32 cFrames)
+{
+    UINT32 i = 0;
+
+    for (; i + 8 <= cFrames; i += 8)
+    {
+        __m256 m = _mm256_loadu_ps(pSrc + i);
+        __m256 lo = _mm256_unpacklo_ps(m, m);
+        __m256 hi = _mm256_unpackhi_ps(m, m);
+
+        _mm256_storeu_ps(pDst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(pDst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+
+    MonoToStereo_SSE2(pSrc + i, pDst + 2 * i, cFrames - i);
+}
+
+PCM_TARGET_AVX2 static void Interleave2_AVX2(const float *pLeft, const float *pRight, float *pDst, UINT32 cFrames)
+{
+    UINT32 i = 0;
+
+    for (; i + 8 <= cFrames; i += 8)
+    {
+        __m256 l = _mm256_loadu_ps(pLeft + i);
+        __m256 r = _mm256_loadu_ps(pRight + i);
+        __m256 lo = _mm256_unpacklo_ps(l, r);
+        __m256 hi = _mm256_unpackhi_ps(l, r);
+
+        _mm256_storeu_ps(pDst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(pDst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+
+    Interleave2_SSE2(pLeft + i, pRight + i, pDst + 2 * i, cFrames - i);
+}
+
+PCM_TARGET_AVX2 static void Deinterleave2_AVX2(const float *pSrc, float *pLeft, float *pRight, UINT32 cFrames)
+{
+    UINT32 i = 0;
+
+    for (; i + 8 <= cFrames; i += 8)
+    {
+        __m256 a = _mm256_loadu_ps(pSrc + 2 * i);
+        __m256 b = _mm256_loadu_ps(pSrc + 2 * i + 8);
+        __m256d l = _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        __m256d r = _mm256_castps_pd(_mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+
+        _mm256_storeu_ps(pLeft + i, _mm256_castpd_ps(_mm256_permute4x64_pd(l, _MM_SHUFFLE(3, 1, 2, 0))));
+        _mm256_storeu_ps(pRight + i, _mm256_castpd_ps(_mm256_permute4x64_pd(r, _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+
+    Deinterleave2_SSE2(pSrc + 2 * i, pLeft + i, pRight + i, cFrames - i);
+}
+
+PCM_TARGET_AVX2 static float DotProduct_AVX2(const float *pA, const float *pB, UINT32 c)
+{
+    __m256 s8 = _mm256_setzero_ps();
+    UINT32 i = 0;
+
+    for (; i + 8 <= c; i += 8)
+    {
+        s8 = _mm256_add_ps(s8, _mm256_mul_ps(_mm256_loadu_ps(pA + i), _mm256_loadu_ps(pB + i)));
+    }
+
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(s8), _mm256_extractf128_ps(s8, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+
+    float sum = _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1))));
+
+    for (; i < c; i++)
+    {
+        sum += pA[i] * pB[i];
+    }
+    return sum;
+}
+
+static const PcmKernels avx2_kernels =
+{
+    "avx2",
+    { UInt8ToFloat_Scalar, Int16ToFloat_AVX2, Int24ToFloat_AVX2, Int32ToFloat_AVX2, Float32ToFloat },
+    { FloatToUInt8_Scalar, FloatToInt16_AVX2, FloatToInt24_AVX2, FloatToInt32_AVX2, FloatToFloat32 },
+    StereoToMono_AVX2,
+    MonoToStereo_AVX2,
+    Interleave2_AVX2,
+    Deinterleave2_AVX2,
+    DotProduct_AVX2,
+};
+
+//-------------------------------------------------------------------
+//  CPU detection
+//
+//  AVX2 also needs the operating system to save the YMM registers.
+//-------------------------------------------------------------------
+
+static BOOL CpuHasSse2()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+    return TRUE;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+static BOOL CpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+
+    if (info[0] < 7)
+    {
+        return FALSE;
+    }
+
+    __cpuid(info, 1);
+
+    const int osxsave_avx = (1 << 27) | (1 << 28);
+
+    if ((info[2] & osxsave_avx) != osxsave_avx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return FALSE;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // PCM_KERNELS_X86
+
+//-------------------------------------------------------------------
+//  Kernel sets
+//-------------------------------------------------------------------
+
+struct PcmKernelList
+{
+    const PcmKernels*   pSets[3];
+    UINT32              cSets;
+};
+
+static PcmKernelList FindPcmKernels()
+{
+    PcmKernelList list;
+    memset(&list, 0, sizeof(list));
+
+    list.pSets[list.cSets++] = &scalar_kernels;
+
+#ifdef PCM_KERNELS_X86
+    if (CpuHasSse2())
+    {
+        list.pSets[list.cSets++] = &sse2_kernels;
+
+        if (CpuHasAvx2())
+        {
+            list.pSets[list.cSets++] = &avx2_kernels;
+        }
+    }
+#endif
+
+    return list;
+}
+
+static const PcmKernelList& GetPcmKernelList()
+{
+    static const PcmKernelList list = FindPcmKernels();
+    return list;
+}
+
+const PcmKernels* GetPcmKernels()
+{
+    const PcmKernelList &list = GetPcmKernelList();
+    return list.pSets[list.cSets - 1];
+}
+
+UINT32 GetPcmKernelSetCount()
+{
+    return GetPcmKernelList().cSets;
+}
+
+const PcmKernels* GetPcmKernelSet(UINT32 index)
+{
+    const PcmKernelList &list = GetPcmKernelList();
+    return index < list.cSets ? list.pSets[index] : NULL;
+}
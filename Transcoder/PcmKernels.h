@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PcmKernels.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Sample conversion kernels. Each kernel set implements the same
+// functions: integer and float samples to and from 32-bit float,
+// mono <-> stereo mixing, stereo interleaving and the dot product of
+// the resampler's filters. The scalar set
+// runs everywhere; on x86 there are SSE2 and AVX2 sets, and the best
+// one the processor supports is chosen at run time.
+//
+// Every set gives bit-identical results: the vector code performs the
+// same float operations, in the same order, as the scalar code.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+// Sample layouts of PcmFormat.
+enum PcmSampleType
+{
+    PcmSample_UInt8,
+    PcmSample_Int16,
+    PcmSample_Int24,
+    PcmSample_Int32,
+    PcmSample_Float32,
+    PcmSample_Count,
+};
+
+// cSamples counts samples, not frames; the kernels do not care about
+// channels. Buffers need no particular alignment. Integer samples are
+// mapped to [-1, 1); float samples are clamped to [-1, 1] when they
+// are written as integers, and copied as-is otherwise.
+typedef void (*PFN_PCM_TO_FLOAT)(const BYTE *pSrc, float *pDst, UINT32 cSamples);
+typedef void (*PFN_PCM_FROM_FLOAT)(const float *pSrc, BYTE *pDst, UINT32 cSamples);
+
+struct PcmKernels
+{
+    const char*         sName;          // "scalar", "sse2" or "avx2"
+    PFN_PCM_TO_FLOAT    pfnToFloat[PcmSample_Count];
+    PFN_PCM_FROM_FLOAT  pfnFromFloat[PcmSample_Count];
+
+    // (l + r) / 2, and the mono sample on both channels.
+    void (*pfnStereoToMono)(const float *pSrc, float *pDst, UINT32 cFrames);
+    void (*pfnMonoToStereo)(const float *pSrc, float *pDst, UINT32 cFrames);
+
+    void (*pfnInterleave2)(const float *pLeft, const float *pRight, float *pDst, UINT32 cFrames);
+    void (*pfnDeinterleave2)(const float *pSrc, float *pLeft, float *pRight, UINT32 cFrames);
+
+    // Sum of pA[i] * pB[i]. The products are added into eight partial
+    // sums, element i into sum i % 8, which are then added pairwise, so
+    // the result does not depend on the vector width.
+    float (*pfnDotProduct)(const float *pA, const float *pB, UINT32 c);
+};
+
+// The fastest kernel set the processor supports. The choice is made on
+// the first call.
+const PcmKernels* GetPcmKernels();
+
+// Every kernel set the processor supports, the scalar set first, for
+// benchmarks and tests.
+UINT32            GetPcmKernelSetCount();
+const PcmKernels* GetPcmKernelSet(UINT32 index);
@@ -0,0 +1,279 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Platform.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Platform.h"
+
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+//-------------------------------------------------------------------
+//  WideToNarrow
+//-------------------------------------------------------------------
+
+int WideToNarrow(const WCHAR *sWide, char *sNarrow, size_t cbNarrow)
+{
+    if (!sWide || !sNarrow || cbNarrow == 0)
+    {
+        return -1;
+    }
+
+#ifdef _WIN32
+    int cb = WideCharToMultiByte(CP_UTF8, 0, sWide, -1, sNarrow, (int)cbNarrow, NULL, NULL);
+    return cb > 0 ? cb - 1 : -1;
+#else
+    size_t cb = wcstombs(sNarrow, sWide, cbNarrow);
+    if (cb == (size_t)-1 || cb >= cbNarrow)
+    {
+        sNarrow[0] = '\0';
+        return -1;
+    }
+    return (int)cb;
+#endif
+}
+
+//-------------------------------------------------------------------
+//  OpenFileW
+//-------------------------------------------------------------------
+
+FILE* OpenFileW(const WCHAR *sPath, const char *sMode)
+{
+    if (!sPath || !sMode)
+    {
+        return NULL;
+    }
+
+    FILE *pFile = NULL;
+
+#ifdef _WIN32
+    WCHAR szMode[16];
+    size_t i = 0;
+    for (; sMode[i] && i < ARRAYSIZE(szMode) - 1; i++)
+    {
+        szMode[i] = (WCHAR)sMode[i];
+    }
+    szMode[i] = L'\0';
+
+    if (_wfopen_s(&pFile, sPath, szMode) != 0)
+    {
+        pFile = NULL;
+    }
+#else
+    char szPath[MAX_PATH * 4];
+    if (WideToNarrow(sPath, szPath, sizeof(szPath)) >= 0)
+    {
+        pFile = fopen(szPath, sMode);
+    }
+#endif
+
+    return pFile;
+}
+
+//-------------------------------------------------------------------
+//  FileSeek64 / FileTell64
+//-------------------------------------------------------------------
+
+int FileSeek64(FILE *pFile, INT64 offset, int origin)
+{
+#ifdef _WIN32
+    return _fseeki64(pFile, offset, origin);
+#else
+    return fseeko(pFile, (off_t)offset, origin);
+#endif
+}
+
+INT64 FileTell64(FILE *pFile)
+{
+#ifdef _WIN32
+    return _ftelli64(pFile);
+#else
+    return (INT64)ftello(pFile);
+#endif
+}
+
+//-------------------------------------------------------------------
+//  IsStdStreamPath
+//-------------------------------------------------------------------
+
+BOOL IsStdStreamPath(const WCHAR *sPath)
+{
+    return sPath && wcscmp(sPath, L"-") == 0;
+}
+
+//-------------------------------------------------------------------
+//  SplitPathName
+//-------------------------------------------------------------------
+
+void SplitPathName(const WCHAR *sPath, size_t *piName, size_t *piExtension)
+{
+    // Both separators are accepted on every platform, as are drive
+    // letters, so a path written for Windows splits the same way.
+    size_t iName = 0;
+    size_t cch = 0;
+
+    for (; sPath[cch]; cch++)
+    {
+        if (sPath[cch] == L'\\' || sPath[cch] == L'/' || sPath[cch] == L':')
+        {
+            iName = cch + 1;
+        }
+    }
+
+    const WCHAR *pDot = wcsrchr(sPath + iName, L'.');
+
+    *piName = iName;
+    *piExtension = pDot ? (size_t)(pDot - sPath) : cch;
+}
+
+//-------------------------------------------------------------------
+//  IsSameFile
+//-------------------------------------------------------------------
+
+#ifdef _WIN32
+
+static BOOL GetFileId(const WCHAR *sPath, BY_HANDLE_FILE_INFORMATION *pInfo)
+{
+    // No access is needed to read the file's identity.
+    HANDLE hFile = CreateFileW(sPath, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        return FALSE;
+    }
+
+    BOOL fOk = GetFileInformationByHandle(hFile, pInfo);
+
+    CloseHandle(hFile);
+    return fOk;
+}
+
+#endif
+
+BOOL IsSameFile(const WCHAR *sPath1, const WCHAR *sPath2)
+{
+    if (!sPath1 || !sPath2 || IsStdStreamPath(sPath1) || IsStdStreamPath(sPath2))
+    {
+        return FALSE;
+    }
+
+#ifdef _WIN32
+    BY_HANDLE_FILE_INFORMATION info1;
+    BY_HANDLE_FILE_INFORMATION info2;
+
+    return GetFileId(sPath1, &info1) && GetFileId(sPath2, &info2) &&
+        info1.dwVolumeSerialNumber == info2.dwVolumeSerialNumber &&
+        info1.nFileIndexHigh == info2.nFileIndexHigh &&
+        info1.nFileIndexLow == info2.nFileIndexLow;
+#else
+    char szPath1[MAX_PATH * 4];
+    char szPath2[MAX_PATH * 4];
+    struct stat st1;
+    struct stat st2;
+
+    return WideToNarrow(sPath1, szPath1, sizeof(szPath1)) >= 0 &&
+        WideToNarrow(sPath2, szPath2, sizeof(szPath2)) >= 0 &&
+        stat(szPath1, &st1) == 0 && stat(szPath2, &st2) == 0 &&
+        st1.st_dev == st2.st_dev && st1.st_ino == st2.st_ino;
+#endif
+}
+
+//-------------------------------------------------------------------
+//  GetPathSize
+//-------------------------------------------------------------------
+
+UINT64 GetPathSize(const WCHAR *sPath)
+{
+    if (IsStdStreamPath(sPath))
+    {
+        return 0;
+    }
+
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+
+    if (!GetFileAttributesExW(sPath, GetFileExInfoStandard, &data))
+    {
+        return 0;
+    }
+    return ((UINT64)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+    char szPath[MAX_PATH * 4];
+    struct stat st;
+
+    if (WideToNarrow(sPath, szPath, sizeof(szPath)) < 0 || stat(szPath, &st) != 0)
+    {
+        return 0;
+    }
+    return (UINT64)st.st_size;
+#endif
+}
+
+//-------------------------------------------------------------------
+//  RemoveFile
+//-------------------------------------------------------------------
+
+BOOL RemoveFile(const WCHAR *sPath)
+{
+#ifdef _WIN32
+    return DeleteFileW(sPath);
+#else
+    char szPath[MAX_PATH * 4];
+    return WideToNarrow(sPath, szPath, sizeof(szPath)) >= 0 && remove(szPath) == 0;
+#endif
+}
+
+//-------------------------------------------------------------------
+//  RenameFile
+//-------------------------------------------------------------------
+
+BOOL RenameFile(const WCHAR *sFrom, const WCHAR *sTo)
+{
+#ifdef _WIN32
+    return MoveFileExW(sFrom, sTo, MOVEFILE_REPLACE_EXISTING);
+#else
+    char szFrom[MAX_PATH * 4];
+    char szTo[MAX_PATH * 4];
+    return WideToNarrow(sFrom, szFrom, sizeof(szFrom)) >= 0 &&
+        WideToNarrow(sTo, szTo, sizeof(szTo)) >= 0 &&
+        rename(szFrom, szTo) == 0;
+#endif
+}
+
+//-------------------------------------------------------------------
+//  PathExists / PathIsDirectory
+//-------------------------------------------------------------------
+
+BOOL PathExists(const WCHAR *sPath)
+{
+#ifdef _WIN32
+    return GetFileAttributesW(sPath) != INVALID_FILE_ATTRIBUTES;
+#else
+    char szPath[MAX_PATH * 4];
+    struct stat st;
+    return WideToNarrow(sPath, szPath, sizeof(szPath)) >= 0 && stat(szPath, &st) == 0;
+#endif
+}
+
+BOOL PathIsDirectory(const WCHAR *sPath)
+{
+#ifdef _WIN32
+    DWORD dwAttrs = GetFileAttributesW(sPath);
+    return dwAttrs != INVALID_FILE_ATTRIBUTES && (dwAttrs & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    char szPath[MAX_PATH * 4];
+    struct stat st;
+    return WideToNarrow(sPath, szPath, sizeof(szPath)) >= 0 &&
+        stat(szPath, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
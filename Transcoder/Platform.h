@@ -0,0 +1,187 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Platform.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Minimal platform layer. On Windows this is <windows.h>; elsewhere
+// it supplies the Win32 types, HRESULT codes and wide-string CRT
+// functions the transcoder uses, so that everything outside the Media
+// Foundation backend compiles unchanged on Linux.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdio.h>
+
+#ifdef _WIN32
+
+#ifndef WINVER
+#define WINVER _WIN32_WINNT_WIN7
+#endif
+
+#include <windows.h>
+#include <mferror.h>
+
+#define PATH_SEPARATOR  L'\\'
+
+#else // !_WIN32
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include <errno.h>
+
+typedef int32_t         HRESULT;
+typedef int16_t         INT16;
+typedef uint16_t        UINT16;
+typedef int32_t         INT32;
+typedef int64_t         INT64;
+typedef int32_t         LONG;
+typedef uint32_t        ULONG;
+typedef uint32_t        DWORD;
+typedef uint32_t        UINT32;
+typedef uint16_t        WORD;
+typedef uint8_t         BYTE;
+typedef int64_t         LONGLONG;
+typedef uint64_t        ULONGLONG;
+typedef uint64_t        UINT64;
+typedef uint64_t        QWORD;
+typedef int             BOOL;
+typedef wchar_t         WCHAR;
+
+#ifndef TRUE
+#define TRUE    1
+#define FALSE   0
+#endif
+
+#define MAX_PATH        260
+#define PATH_SEPARATOR  L'/'
+
+#define ARRAYSIZE(a)    (sizeof(a) / sizeof((a)[0]))
+
+#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)      (((HRESULT)(hr)) < 0)
+
+#define S_OK            ((HRESULT)0x00000000L)
+#define S_FALSE         ((HRESULT)0x00000001L)
+#define E_NOTIMPL       ((HRESULT)0x80004001L)
+#define E_POINTER       ((HRESULT)0x80004003L)
+#define E_ABORT         ((HRESULT)0x80004004L)
+#define E_FAIL          ((HRESULT)0x80004005L)
+#define E_PENDING       ((HRESULT)0x8000000AL)
+#define E_UNEXPECTED    ((HRESULT)0x8000FFFFL)
+#define E_OUTOFMEMORY   ((HRESULT)0x8007000EL)
+#define E_INVALIDARG    ((HRESULT)0x80070057L)
+
+#define ERROR_FILE_NOT_FOUND        2L
+#define ERROR_SHARING_VIOLATION     32L
+#define ERROR_FILENAME_EXCED_RANGE  206L
+
+#define HRESULT_FROM_WIN32(x) \
+    ((HRESULT)(x) <= 0 ? (HRESULT)(x) : (HRESULT)(((x) & 0x0000FFFF) | 0x80070000))
+
+// Media Foundation error codes raised by the portable backend, with
+// the same values as in mferror.h.
+#define MF_E_BUFFERTOOSMALL                 ((HRESULT)0xC00D36B1L)
+#define MF_E_INVALIDREQUEST                 ((HRESULT)0xC00D36B2L)
+#define MF_E_INVALIDMEDIATYPE               ((HRESULT)0xC00D36B4L)
+#define MF_E_UNSUPPORTED_BYTESTREAM_TYPE    ((HRESULT)0xC00D36C4L)
+#define MF_E_INVALID_FORMAT                 ((HRESULT)0xC00D3E8CL)
+#define MF_E_SHUTDOWN                       ((HRESULT)0xC00D3E85L)
+#define MF_E_MULTIPLE_BEGIN                 ((HRESULT)0xC00D36D9L)
+#define MF_E_TOPO_CODEC_NOT_FOUND           ((HRESULT)0xC00D5212L)
+
+#define wprintf_s       wprintf
+#define swprintf_s      swprintf
+#define _wcsicmp        wcscasecmp
+#define _wcsnicmp       wcsncasecmp
+
+inline int wcscpy_s(WCHAR *dst, size_t cch, const WCHAR *src)
+{
+    size_t len = wcslen(src);
+    if (len >= cch)
+    {
+        if (cch)
+        {
+            dst[0] = L'\0';
+        }
+        return ERANGE;
+    }
+    wmemcpy(dst, src, len + 1);
+    return 0;
+}
+
+inline int _wtoi(const WCHAR *s)
+{
+    return (int)wcstol(s, NULL, 10);
+}
+
+#endif // _WIN32
+
+// errno values are reported in the Win32 facility.
+#define HRESULT_FROM_ERRNO(e)   HRESULT_FROM_WIN32((DWORD)(e))
+
+template <class T> void SafeRelease(T **ppT)
+{
+    if (*ppT)
+    {
+        (*ppT)->Release();
+        *ppT = NULL;
+    }
+}
+
+template <class T> void SafeDelete(T **ppT)
+{
+    delete *ppT;
+    *ppT = NULL;
+}
+
+// Opens a file with a wide-character path. sMode is an fopen mode.
+FILE*   OpenFileW(const WCHAR *sPath, const char *sMode);
+
+// 64-bit file positioning.
+int     FileSeek64(FILE *pFile, INT64 offset, int origin);
+INT64   FileTell64(FILE *pFile);
+
+// Path queries. Both return FALSE when the path does not exist.
+BOOL    PathExists(const WCHAR *sPath);
+BOOL    PathIsDirectory(const WCHAR *sPath);
+
+// TRUE for "-", which names standard input or standard output.
+BOOL    IsStdStreamPath(const WCHAR *sPath);
+
+// Offsets into sPath of its file name, after the last '\\', '/' or ':',
+// and of the extension, from the last '.' of the file name. Without an
+// extension *piExtension is the length of sPath.
+void    SplitPathName(const WCHAR *sPath, size_t *piName, size_t *piExtension);
+
+// TRUE if both paths exist and name the same file, however they are
+// spelled: the same device and inode, or on Windows the same volume
+// and file index. Standard streams are never the same file.
+BOOL    IsSameFile(const WCHAR *sPath1, const WCHAR *sPath2);
+
+// Size of a file in bytes; 0 if it does not exist or is a standard
+// stream.
+UINT64  GetPathSize(const WCHAR *sPath);
+
+// Deletes a file. Returns FALSE if it could not be deleted.
+BOOL    RemoveFile(const WCHAR *sPath);
+
+// Renames sFrom to sTo, replacing sTo if it exists, in one step: a
+// reader of sTo sees the old file or the new one. Returns FALSE if it
+// could not be renamed.
+BOOL    RenameFile(const WCHAR *sFrom, const WCHAR *sTo);
+
+// Converts a wide string to UTF-8 (or the current locale encoding on
+// Linux). Returns the number of bytes written, excluding the terminator,
+// or -1 if the buffer is too small.
+int     WideToNarrow(const WCHAR *sWide, char *sNarrow, size_t cbNarrow);
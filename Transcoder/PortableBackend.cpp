@@ -0,0 +1,1568 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PortableBackend.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Portable backend. There are no encoders, so only the paths that
+// need none are supported:
+//
+//  WAV  -> wav     PCM converted to 16-bit at the source rate, or at
+//                  the rate set with SetSampleRate (see Resampler.h).
+//                  16-bit input at the source rate is copied without
+//                  conversion.
+//  ADTS -> aac     Frames copied as-is (stream copy), at the source rate.
+//  MP3  -> mp3     Frames copied as-is (stream copy), at the source rate.
+//
+// Any other combination, or a stream copy path when stream copy is
+// disallowed, fails in SetOutput with MF_E_TOPO_CODEC_NOT_FOUND, the
+// error a media session reports when no encoder matches the profile.
+// Every output added with AddOutput must be a supported path from the
+// source; the source is read once and each block or frame is written
+// to all of them.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "PortableBackend.h"
+#include "WavFile.h"
+#include "Adts.h"
+#include "Latm.h"
+#include "Mp4File.h"
+#include "StreamPackager.h"
+#include "Mp3.h"
+#include "Resampler.h"
+
+#include <assert.h>
+#include <string.h>
+#include <new>
+
+#define PCM_BLOCK_SIZE  (64 * 1024)
+
+//-------------------------------------------------------------------
+//  CQueuedSession
+//-------------------------------------------------------------------
+
+CQueuedSession::CQueuedSession(CWorkQueue *pQueue) :
+    m_state(State_Idle),
+    m_hnsStart(0),
+    m_hnsStop(0),
+    m_fStreamCopy(TRUE),
+    m_outputSampleRate(0),
+    m_cExtraOutputs(0),
+    m_pOutputSink(NULL),
+    m_pQueue(pQueue),
+    m_pCallback(NULL),
+    m_fProcessing(FALSE),
+    m_fAbort(false),
+    m_hnsPosition(0)
+{
+
+}
+
+CQueuedSession::~CQueuedSession()
+{
+
+}
+
+void CQueuedSession::QueueEvent(SessionEventType type, HRESULT hrStatus)
+{
+    SessionEvent event = { type, hrStatus };
+    m_events.push_back(event);
+}
+
+HRESULT CQueuedSession::SetStreamCopy(BOOL fAllow)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state != State_Idle)
+    {
+        return m_state == State_Shutdown ? MF_E_SHUTDOWN : MF_E_INVALIDREQUEST;
+    }
+
+    m_fStreamCopy = fAllow;
+    return S_OK;
+}
+
+HRESULT CQueuedSession::SetSampleRate(UINT32 sampleRate)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state != State_Idle)
+    {
+        return m_state == State_Shutdown ? MF_E_SHUTDOWN : MF_E_INVALIDREQUEST;
+    }
+
+    m_outputSampleRate = sampleRate;
+    return S_OK;
+}
+
+HRESULT CQueuedSession::SetStopTime(LONGLONG hnsStop)
+{
+    if (hnsStop < 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state != State_Idle)
+    {
+        return m_state == State_Shutdown ? MF_E_SHUTDOWN : MF_E_INVALIDREQUEST;
+    }
+
+    m_hnsStop = hnsStop;
+    return S_OK;
+}
+
+HRESULT CQueuedSession::AddOutput(const OutputFormat *pFormat, const WCHAR *sURL)
+{
+    if (!pFormat || !sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state != State_Idle)
+    {
+        return m_state == State_Shutdown ? MF_E_SHUTDOWN : MF_E_INVALIDREQUEST;
+    }
+
+    if (m_cExtraOutputs == ARRAYSIZE(m_extraOutputs))
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    ExtraOutput *pOutput = &m_extraOutputs[m_cExtraOutputs];
+
+    if (wcscpy_s(pOutput->szURL, MAX_PATH, sURL) != 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    pOutput->pFormat = pFormat;
+    m_cExtraOutputs++;
+    return S_OK;
+}
+
+HRESULT CQueuedSession::SetOutput(const WCHAR *sURL)
+{
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    return BeginOutput(sURL, NULL);
+}
+
+HRESULT CQueuedSession::SetOutputSink(IOutputSink *pSink)
+{
+    if (!pSink)
+    {
+        return E_INVALIDARG;
+    }
+
+    return BeginOutput(NULL, pSink);
+}
+
+HRESULT CQueuedSession::BeginOutput(const WCHAR *sURL, IOutputSink *pSink)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state != State_Idle)
+    {
+        return m_state == State_Shutdown ? MF_E_SHUTDOWN : MF_E_INVALIDREQUEST;
+    }
+
+    m_pOutputSink = pSink;
+
+    HRESULT hr = CreateOutput(sURL);
+
+    if (SUCCEEDED(hr))
+    {
+        m_state = State_Ready;
+        QueueEvent(SessionEvent_TopologySet, S_OK);
+    }
+    return hr;
+}
+
+HRESULT CQueuedSession::Start(LONGLONG hnsStart)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state != State_Ready)
+    {
+        return m_state == State_Shutdown ? MF_E_SHUTDOWN : MF_E_INVALIDREQUEST;
+    }
+
+    m_hnsStart = hnsStart;
+    m_hnsPosition = hnsStart;
+    m_state = State_Running;
+    QueueEvent(SessionEvent_Started, S_OK);
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  GetPosition
+//
+//  Reads the position Process last published; takes no lock, so a
+//  poller never waits for the job.
+//-------------------------------------------------------------------
+
+HRESULT CQueuedSession::GetPosition(LONGLONG *phnsPosition)
+{
+    if (!phnsPosition)
+    {
+        return E_POINTER;
+    }
+
+    *phnsPosition = m_hnsPosition;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  BeginGetEvent
+//
+//  Completes the request on the work queue with the next queued
+//  event. If none is queued and the session is running, the job runs
+//  as a work item and completes the request with SessionEvent_Ended.
+//-------------------------------------------------------------------
+
+HRESULT CQueuedSession::BeginGetEvent(ISessionEventCallback *pCallback)
+{
+    if (!pCallback)
+    {
+        return E_POINTER;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state == State_Shutdown)
+    {
+        return MF_E_SHUTDOWN;
+    }
+
+    if (m_pCallback)
+    {
+        return MF_E_MULTIPLE_BEGIN;
+    }
+
+    if (!m_events.empty())
+    {
+        SessionEvent event = m_events.front();
+
+        HRESULT hr = m_pQueue->Put([pCallback, event]() {
+            pCallback->OnSessionEvent(S_OK, event);
+        });
+
+        if (SUCCEEDED(hr))
+        {
+            m_events.pop_front();
+        }
+        return hr;
+    }
+
+    if (m_state != State_Running || m_fProcessing)
+    {
+        // Nothing would ever arrive.
+        return MF_E_INVALIDREQUEST;
+    }
+
+    m_pCallback = pCallback;
+    m_fProcessing = TRUE;
+
+    HRESULT hr = m_pQueue->Put([this]() { RunProcess(); });
+
+    if (FAILED(hr))
+    {
+        m_pCallback = NULL;
+        m_fProcessing = FALSE;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  RunProcess
+//
+//  Work item that runs the job. The session is not touched after the
+//  request is completed, since the callback may shut it down and
+//  delete it.
+//-------------------------------------------------------------------
+
+void CQueuedSession::RunProcess()
+{
+    SessionEvent event = { SessionEvent_Ended, Process() };
+    ISessionEventCallback *pCallback = NULL;
+    BOOL fAborted = FALSE;
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if (m_state == State_Running)
+        {
+            m_state = State_Ended;
+        }
+
+        pCallback = m_pCallback;
+        fAborted = m_fAbort;
+        m_pCallback = NULL;
+        m_fProcessing = FALSE;
+
+        // Notify under the lock: Shutdown may delete the session as
+        // soon as it wakes.
+        m_cvIdle.notify_all();
+    }
+
+    // A request outstanding at Shutdown is dropped, as its owner is
+    // tearing the session down.
+    if (!fAborted)
+    {
+        pCallback->OnSessionEvent(S_OK, event);
+    }
+}
+
+HRESULT CQueuedSession::Close()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state == State_Shutdown)
+    {
+        return MF_E_SHUTDOWN;
+    }
+
+    HRESULT hrStatus = S_OK;
+
+    if (m_state != State_Idle && m_state != State_Closed && !m_fProcessing)
+    {
+        hrStatus = FinalizeOutput();
+    }
+
+    m_state = State_Closed;
+    QueueEvent(SessionEvent_Closed, hrStatus);
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  Shutdown
+//
+//  Aborts a running job and waits for its work item to finish before
+//  releasing the files.
+//-------------------------------------------------------------------
+
+HRESULT CQueuedSession::Shutdown()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    if (m_state != State_Shutdown)
+    {
+        m_fAbort = true;
+
+        while (m_fProcessing)
+        {
+            m_cvIdle.wait(lock);
+        }
+
+        ReleaseResources();
+        m_events.clear();
+        m_state = State_Shutdown;
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  Reset
+//
+//  Returns a new or shut down session to State_Idle. The buffers the
+//  outputs grew during the last job are kept for the next.
+//-------------------------------------------------------------------
+
+HRESULT CQueuedSession::Reset()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (m_state != State_Idle && m_state != State_Shutdown)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    ReleaseResources();
+    ResetJob();
+
+    m_events.clear();
+    m_state = State_Idle;
+    m_hnsStart = 0;
+    m_hnsStop = 0;
+    m_fStreamCopy = TRUE;
+    m_outputSampleRate = 0;
+    m_cExtraOutputs = 0;
+    m_pOutputSink = NULL;
+    m_fAbort = false;
+    m_hnsPosition = 0;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  CPortableSession
+//-------------------------------------------------------------------
+
+class CPortableSession : public CQueuedSession
+{
+public:
+    CPortableSession(CWorkQueue *pQueue);
+    virtual ~CPortableSession();
+
+    HRESULT OpenSource(const WCHAR *sURL);
+    HRESULT OpenSourceMemory(const BYTE *pData, UINT64 cbData);
+    HRESULT ConfigureAudio(const OutputFormat *pFormat);
+    HRESULT ConfigureVideo(const OutputFormat *pFormat);
+    HRESULT ConfigureContainer(const OutputFormat *pFormat);
+    HRESULT GetMediaInfo(MediaInfo *pInfo);
+
+protected:
+
+    HRESULT CreateOutput(const WCHAR *sURL);
+    HRESULT Process();
+    HRESULT FinalizeOutput();
+    void    ReleaseResources();
+    void    ResetJob();
+
+private:
+
+    enum SourceType
+    {
+        Source_None,
+        Source_Wav,
+        Source_Adts,
+        Source_Loas,
+        Source_Mp3,
+    };
+
+    // Writer of a compressed output.
+    enum FrameWriter
+    {
+        Writer_File,                // Frames as they are
+        Writer_Mp4,                 // MPEG-4 samples
+        Writer_Fragments,           // Fragmented MPEG-4 samples
+        Writer_Packager,            // HLS or DASH segments
+    };
+
+    // One per output; the first is the main output.
+    struct OutputBranch
+    {
+        CWavWriter          wavWriter;      // WAV source
+        COutputFile         file;           // ADTS, LOAS and MP3 sources
+        CMp4Writer          mp4Writer;      // The same, in MPEG-4
+        CMp4FragmentWriter  fragmentWriter; // The same, in fragmented MPEG-4
+        CStreamPackager     packager;       // The same, in segment files
+        FrameWriter         writer;
+
+        OutputBranch() : writer(Writer_File) { }
+    };
+
+    HRESULT OpenReader();
+    HRESULT CheckBranch(OutputBranch *pBranch, const OutputFormat *pFormat, IOutputSink *pSink);
+    HRESULT GetMp4Format(Mp4AudioFormat *pFormat) const;
+    HRESULT CreateBranch(OutputBranch *pBranch, const OutputFormat *pFormat, const WCHAR *sURL, IOutputSink *pSink);
+    UINT64  ExpectedOutputSize() const;
+    HRESULT ProcessWav();
+    HRESULT WritePcm(const BYTE *pData, DWORD cbData);
+    HRESULT ProcessAdts();
+    HRESULT ProcessLoas();
+    HRESULT ProcessMp3();
+    UINT64  StopSample(UINT32 sampleRate) const;
+    HRESULT IndexMp4Outputs();
+    template <class Reader, class Header>
+    HRESULT ReadFrameSizes(Reader &reader, std::vector<UINT32> *pSizes);
+    HRESULT WriteFrame(const BYTE *pFrame, DWORD cbFrame, const AdtsHeader *pAdts);
+
+    SourceType          m_source;
+    const OutputFormat* m_pFormat;
+
+    CMappedFile         m_input;            // Read by the source's reader
+    CWavReader          m_wavReader;
+    PcmFormat           m_outputFormat;
+    CResampler          m_resampler;        // If the output rate differs
+
+    CAdtsReader         m_adtsReader;
+    CLoasReader         m_loasReader;       // Repacks LATM as ADTS
+    CMp3Reader          m_mp3Reader;
+
+    OutputBranch        m_outputs[SESSION_MAX_OUTPUTS];
+    DWORD               m_cOutputs;
+};
+
+CPortableSession::CPortableSession(CWorkQueue *pQueue) :
+    CQueuedSession(pQueue),
+    m_source(Source_None),
+    m_pFormat(NULL),
+    m_cOutputs(0)
+{
+    memset(&m_outputFormat, 0, sizeof(m_outputFormat));
+}
+
+CPortableSession::~CPortableSession()
+{
+    ReleaseResources();
+}
+
+//-------------------------------------------------------------------
+//  OpenSource
+//
+//  Opens a WAVE, ADTS, LOAS or MP3 file, chosen from the first bytes of
+//  the file rather than its extension. Behind an ID3v2 tag, ADTS is tried
+//  first. The readers share one open input, so that standard input
+//  ("-") is read only once.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::OpenSource(const WCHAR *sURL)
+{
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_source != Source_None)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_input.Open(sURL);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = OpenReader();
+    }
+    return hr;
+}
+
+HRESULT CPortableSession::OpenSourceMemory(const BYTE *pData, UINT64 cbData)
+{
+    if (m_source != Source_None)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_input.Open(pData, cbData);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = OpenReader();
+    }
+    return hr;
+}
+
+HRESULT CPortableSession::OpenReader()
+{
+    const BYTE *header = NULL;
+    DWORD cbHeader = 0;
+
+    HRESULT hr = m_input.View(0, 12, &header, &cbHeader);
+
+    if (FAILED(hr))
+    {
+        m_input.Close();
+        return hr;
+    }
+
+    if (IsWavHeader(header, cbHeader))
+    {
+        hr = m_wavReader.Open(&m_input);
+        if (SUCCEEDED(hr))
+        {
+            m_source = Source_Wav;
+        }
+    }
+    else if (IsLoasHeader(header, cbHeader))
+    {
+        hr = m_loasReader.Open(&m_input);
+        if (SUCCEEDED(hr))
+        {
+            m_source = Source_Loas;
+        }
+    }
+    else if (IsAdtsHeader(header, cbHeader) || IsMp3Header(header, cbHeader) ||
+        (cbHeader >= 3 && memcmp(header, "ID3", 3) == 0))
+    {
+        hr = m_adtsReader.Open(&m_input);
+        if (SUCCEEDED(hr))
+        {
+            m_source = Source_Adts;
+        }
+        else if (hr == MF_E_UNSUPPORTED_BYTESTREAM_TYPE)
+        {
+            hr = m_mp3Reader.Open(&m_input);
+            if (SUCCEEDED(hr))
+            {
+                m_source = Source_Mp3;
+            }
+        }
+    }
+    else
+    {
+        hr = MF_E_UNSUPPORTED_BYTESTREAM_TYPE;
+    }
+
+    if (FAILED(hr))
+    {
+        m_input.Close();
+    }
+    return hr;
+}
+
+HRESULT CPortableSession::ConfigureAudio(const OutputFormat *pFormat)
+{
+    if (!pFormat)
+    {
+        return E_INVALIDARG;
+    }
+
+    m_pFormat = pFormat;
+    return S_OK;
+}
+
+HRESULT CPortableSession::ConfigureVideo(const OutputFormat *pFormat)
+{
+    // The supported sources carry no video stream.
+    return pFormat ? S_OK : E_INVALIDARG;
+}
+
+HRESULT CPortableSession::ConfigureContainer(const OutputFormat *pFormat)
+{
+    if (!pFormat)
+    {
+        return E_INVALIDARG;
+    }
+
+    m_pFormat = pFormat;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  GetMediaInfo
+//
+//  The output rate is the rate set with SetSampleRate, if any, and
+//  otherwise the source rate. The duration of an ADTS or MP3 source
+//  is found by walking its frame headers; that of an input stream is
+//  not known and is 0. Compressed frames are copied, so their length
+//  is that of the first frame.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::GetMediaInfo(MediaInfo *pInfo)
+{
+    if (!pInfo)
+    {
+        return E_POINTER;
+    }
+
+    HRESULT hr = S_OK;
+
+    pInfo->cCopyFrameSamples = 0;
+
+    switch (m_source)
+    {
+    case Source_Wav:
+        pInfo->hnsDuration = m_wavReader.Duration();
+        pInfo->audioSampleRate = m_wavReader.Format().sampleRate;
+        break;
+
+    case Source_Adts:
+        hr = m_adtsReader.GetDuration(&pInfo->hnsDuration);
+        pInfo->audioSampleRate = m_adtsReader.Format().sampleRate;
+        pInfo->cCopyFrameSamples = m_adtsReader.Format().cRawBlocks * ADTS_SAMPLES_PER_FRAME;
+        break;
+
+    case Source_Loas:
+        hr = m_loasReader.GetDuration(&pInfo->hnsDuration);
+        pInfo->audioSampleRate = m_loasReader.Format().sampleRate;
+        pInfo->cCopyFrameSamples = m_loasReader.Format().cRawBlocks * ADTS_SAMPLES_PER_FRAME;
+        break;
+
+    case Source_Mp3:
+        hr = m_mp3Reader.GetDuration(&pInfo->hnsDuration);
+        pInfo->audioSampleRate = m_mp3Reader.Format().sampleRate;
+        pInfo->cCopyFrameSamples = m_mp3Reader.Format().cSamples;
+        break;
+
+    default:
+        hr = MF_E_INVALIDREQUEST;
+        break;
+    }
+
+    if (m_outputSampleRate != 0)
+    {
+        pInfo->audioSampleRate = m_outputSampleRate;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CreateOutput
+//
+//  Checks every output before any file is created, so that an
+//  unsupported added output leaves no main output behind. Then creates
+//  the main output and the added ones. Files already created when one
+//  cannot be are closed by ReleaseResources.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::CreateOutput(const WCHAR *sURL)
+{
+    if (m_pFormat == NULL || m_source == Source_None)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = S_OK;
+
+    if (m_source == Source_Wav)
+    {
+        const PcmFormat &srcFormat = m_wavReader.Format();
+
+        m_outputFormat = srcFormat;
+        m_outputFormat.bitsPerSample = 16;
+        m_outputFormat.fFloat = FALSE;
+
+        if (m_outputSampleRate != 0 && m_outputSampleRate != srcFormat.sampleRate)
+        {
+            m_outputFormat.sampleRate = m_outputSampleRate;
+
+            hr = m_resampler.Initialize(srcFormat.sampleRate, m_outputSampleRate, srcFormat.channels);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = CheckBranch(&m_outputs[0], m_pFormat, m_pOutputSink);
+    }
+
+    for (DWORD i = 0; i < m_cExtraOutputs && SUCCEEDED(hr); i++)
+    {
+        hr = CheckBranch(&m_outputs[i + 1], m_extraOutputs[i].pFormat, NULL);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = CreateBranch(&m_outputs[0], m_pFormat, sURL, m_pOutputSink);
+    }
+
+    for (DWORD i = 0; i < m_cExtraOutputs && SUCCEEDED(hr); i++)
+    {
+        hr = CreateBranch(&m_outputs[i + 1], m_extraOutputs[i].pFormat, m_extraOutputs[i].szURL, NULL);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        m_cOutputs = m_cExtraOutputs + 1;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CheckBranch
+//
+//  Checks that the source and pFormat form a supported path and
+//  chooses the writer of pBranch, without creating anything.
+//  Compressed sources are only ever copied, so they need stream copy
+//  and keep their rate. AAC and MP3 can also be copied into MPEG-4,
+//  whole, fragmented or in HLS or DASH segments; any video settings of
+//  the format are ignored, since the source has no video.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::CheckBranch(OutputBranch *pBranch, const OutputFormat *pFormat, IOutputSink *pSink)
+{
+    pBranch->writer = Writer_File;
+
+    if (m_source == Source_Wav)
+    {
+        return (pFormat->audioCodec == AudioCodec_PCM && pFormat->container == Container_WAVE) ?
+            S_OK : MF_E_TOPO_CODEC_NOT_FOUND;
+    }
+
+    UINT32 sourceRate = m_mp3Reader.Format().sampleRate;
+
+    if (m_source == Source_Adts)
+    {
+        sourceRate = m_adtsReader.Format().sampleRate;
+    }
+    else if (m_source == Source_Loas)
+    {
+        sourceRate = m_loasReader.Format().sampleRate;
+    }
+
+    const BOOL fAac = (m_source == Source_Adts || m_source == Source_Loas) && pFormat->audioCodec == AudioCodec_AAC;
+    const BOOL fMp3 = (m_source == Source_Mp3) && pFormat->audioCodec == AudioCodec_MP3;
+
+    if (!m_fStreamCopy ||
+        (m_outputSampleRate != 0 && m_outputSampleRate != sourceRate) ||
+        !(fAac || fMp3))
+    {
+        return MF_E_TOPO_CODEC_NOT_FOUND;
+    }
+
+    if ((fAac && pFormat->container == Container_ADTS) ||
+        (fMp3 && pFormat->container == Container_MP3))
+    {
+        return S_OK;
+    }
+
+    if (pFormat->container != Container_MPEG4 && pFormat->container != Container_FMPEG4)
+    {
+        return MF_E_TOPO_CODEC_NOT_FOUND;
+    }
+
+    if (pFormat->container == Container_MPEG4)
+    {
+        pBranch->writer = Writer_Mp4;
+    }
+    else if (pFormat->dwFlags & (FORMAT_FLAG_HLS | FORMAT_FLAG_DASH))
+    {
+        // Segment files cannot go to a sink.
+        if (pSink)
+        {
+            return MF_E_INVALIDREQUEST;
+        }
+        pBranch->writer = Writer_Packager;
+    }
+    else
+    {
+        pBranch->writer = Writer_Fragments;
+    }
+
+    // Refused here rather than by Mp4SampleSize once the job runs,
+    // so that no empty output is left behind.
+    if (fAac)
+    {
+        const AdtsHeader &first = (m_source == Source_Adts) ? m_adtsReader.Format() : m_loasReader.Format();
+
+        if (first.cRawBlocks != 1)
+        {
+            return MF_E_INVALIDMEDIATYPE;
+        }
+    }
+
+    Mp4AudioFormat format;
+
+    return GetMp4Format(&format);
+}
+
+//-------------------------------------------------------------------
+//  GetMp4Format
+//
+//  The MPEG-4 sample entry of the source's compressed audio.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::GetMp4Format(Mp4AudioFormat *pFormat) const
+{
+    if (m_source == Source_Adts || m_source == Source_Loas)
+    {
+        const AdtsHeader &first = (m_source == Source_Adts) ? m_adtsReader.Format() : m_loasReader.Format();
+
+        return Mp4AacFormat(first.profile, first.sampleRateIndex, first.channels, pFormat);
+    }
+
+    const Mp3Header &first = m_mp3Reader.Format();
+
+    return Mp4MpegAudioFormat(first.version, first.sampleRate, first.channels, first.cSamples, pFormat);
+}
+
+//-------------------------------------------------------------------
+//  CreateBranch
+//
+//  Creates the output file of a branch that CheckBranch accepted at
+//  sURL, or writes to pSink if given.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::CreateBranch(OutputBranch *pBranch, const OutputFormat *pFormat, const WCHAR *sURL, IOutputSink *pSink)
+{
+    if (m_source == Source_Wav)
+    {
+        return pSink ?
+            pBranch->wavWriter.Create(pSink, m_outputFormat, ExpectedOutputSize()) :
+            pBranch->wavWriter.Create(sURL, m_outputFormat, ExpectedOutputSize());
+    }
+
+    if (pBranch->writer == Writer_File)
+    {
+        return pSink ?
+            pBranch->file.Open(pSink, ExpectedOutputSize()) :
+            pBranch->file.Create(sURL, ExpectedOutputSize());
+    }
+
+    Mp4AudioFormat format;
+
+    HRESULT hr = GetMp4Format(&format);
+
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    switch (pBranch->writer)
+    {
+    case Writer_Mp4:
+        return pSink ?
+            pBranch->mp4Writer.Create(pSink, format, ExpectedOutputSize()) :
+            pBranch->mp4Writer.Create(sURL, format, ExpectedOutputSize());
+
+    case Writer_Fragments:
+        return pSink ?
+            pBranch->fragmentWriter.Create(pSink, format, ExpectedOutputSize()) :
+            pBranch->fragmentWriter.Create(sURL, format, ExpectedOutputSize());
+
+    default:
+        return pBranch->packager.Create(sURL, (pFormat->dwFlags & FORMAT_FLAG_HLS) ? Manifest_HLS : Manifest_DASH, format);
+    }
+}
+
+//-------------------------------------------------------------------
+//  ExpectedOutputSize
+//
+//  Size of the samples or frames the job will write, to reserve on
+//  disk. The job ends at m_hnsStop at the latest; the start is not
+//  known yet, so a segment reserves from the start of the source and
+//  gives the rest back when it is closed. A copy with a stop time is
+//  sized from the bitrate of the first frame.
+//-------------------------------------------------------------------
+
+UINT64 CPortableSession::ExpectedOutputSize() const
+{
+    if (m_source == Source_Wav)
+    {
+        const PcmFormat &srcFormat = m_wavReader.Format();
+
+        UINT64 cFrames = m_wavReader.FrameCount();
+        UINT64 iStop = StopSample(srcFormat.sampleRate);
+
+        if (iStop < cFrames)
+        {
+            cFrames = iStop;
+        }
+        return cFrames * m_outputFormat.sampleRate / srcFormat.sampleRate * PcmBlockAlign(m_outputFormat);
+    }
+
+    UINT64 cbStream = 0;
+    UINT64 cbPerSecond = 0;
+
+    if (m_source == Source_Adts || m_source == Source_Loas)
+    {
+        const AdtsHeader &first = (m_source == Source_Adts) ? m_adtsReader.Format() : m_loasReader.Format();
+
+        cbStream = (m_source == Source_Adts) ? m_adtsReader.StreamSize() : m_loasReader.StreamSize();
+        cbPerSecond = (UINT64)first.cbFrame * first.sampleRate / (first.cRawBlocks * ADTS_SAMPLES_PER_FRAME);
+    }
+    else
+    {
+        cbStream = m_mp3Reader.StreamSize();
+        cbPerSecond = m_mp3Reader.Format().bitrate / 8;
+    }
+
+    if (m_hnsStop > 0)
+    {
+        UINT64 cbStop = cbPerSecond * (UINT64)m_hnsStop / 10000000;
+
+        if (cbStop < cbStream)
+        {
+            cbStream = cbStop;
+        }
+    }
+    return cbStream;
+}
+
+HRESULT CPortableSession::Process()
+{
+    if (m_source != Source_Wav)
+    {
+        HRESULT hr = IndexMp4Outputs();
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    switch (m_source)
+    {
+    case Source_Wav:    return ProcessWav();
+    case Source_Adts:   return ProcessAdts();
+    case Source_Loas:   return ProcessLoas();
+    default:            return ProcessMp3();
+    }
+}
+
+//-------------------------------------------------------------------
+//  StopSample
+//
+//  Sample position at which the job ends; no stop time runs to the
+//  end of the source.
+//-------------------------------------------------------------------
+
+UINT64 CPortableSession::StopSample(UINT32 sampleRate) const
+{
+    return m_hnsStop > 0 ? HnsToSamples(m_hnsStop, sampleRate) : (UINT64)-1;
+}
+
+//-------------------------------------------------------------------
+//  ProcessWav
+//
+//  Takes the source a block at a time from the reader's mapping and
+//  converts it to the output format; copied blocks are written from
+//  the mapping as they are. With a rate change, samples go through the
+//  resampler in float, and its tail is drained at the end of the range.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::ProcessWav()
+{
+    const PcmFormat &srcFormat = m_wavReader.Format();
+
+    UINT32 cbSrcFrame = PcmBlockAlign(srcFormat);
+    UINT32 cbDstFrame = PcmBlockAlign(m_outputFormat);
+    UINT32 cFramesPerBlock = PCM_BLOCK_SIZE / cbSrcFrame;
+
+    if (cFramesPerBlock == 0)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    BOOL fResample = m_outputFormat.sampleRate != srcFormat.sampleRate;
+
+    // Samples already in the output format are written as read.
+    BOOL fCopy = m_fStreamCopy && !fResample &&
+        srcFormat.bitsPerSample == m_outputFormat.bitsPerSample &&
+        srcFormat.fFloat == m_outputFormat.fFloat;
+
+    PcmFormat floatFormat = srcFormat;
+    floatFormat.bitsPerSample = 32;
+    floatFormat.fFloat = TRUE;
+    floatFormat.sampleRate = m_outputFormat.sampleRate;
+
+    // With a rate change, the output block is the resampler's largest.
+    UINT32 cOutFramesMax = fResample ? m_resampler.MaxOutputFrames(cFramesPerBlock) : cFramesPerBlock;
+
+    BYTE *pDst = fCopy ? NULL : new (std::nothrow) BYTE[cOutFramesMax * cbDstFrame];
+    float *pFloat = NULL;
+    float *pResampled = NULL;
+
+    if (fResample)
+    {
+        pFloat = new (std::nothrow) float[cFramesPerBlock * srcFormat.channels];
+        pResampled = new (std::nothrow) float[cOutFramesMax * srcFormat.channels];
+    }
+
+    HRESULT hr = ((fCopy || pDst) && (!fResample || (pFloat && pResampled))) ? S_OK : E_OUTOFMEMORY;
+
+    UINT64 iFrame = HnsToSamples(m_hnsStart, srcFormat.sampleRate);
+    UINT64 iStop = StopSample(srcFormat.sampleRate);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_wavReader.SeekToFrame(iFrame);
+    }
+
+    while (SUCCEEDED(hr) && iFrame < iStop)
+    {
+        const BYTE *pSrc = NULL;
+        DWORD cbRead = 0;
+        UINT64 cFramesLeft = iStop - iFrame;
+
+        if (IsAborted())
+        {
+            hr = E_ABORT;
+            break;
+        }
+
+        hr = m_wavReader.Read(
+            (DWORD)(cFramesLeft < cFramesPerBlock ? cFramesLeft : cFramesPerBlock) * cbSrcFrame,
+            &pSrc, &cbRead);
+
+        if (FAILED(hr) || cbRead == 0)
+        {
+            break;
+        }
+
+        UINT32 cFrames = cbRead / cbSrcFrame;
+        iFrame += cFrames;
+
+        SetPosition(SamplesToHns(iFrame, srcFormat.sampleRate));
+
+        if (fResample)
+        {
+            PcmFormat srcFloat = floatFormat;
+            srcFloat.sampleRate = srcFormat.sampleRate;
+
+            hr = ConvertPcm(srcFormat, pSrc, srcFloat, (BYTE*)pFloat, cFrames);
+
+            if (SUCCEEDED(hr))
+            {
+                hr = m_resampler.Process(pFloat, cFrames, pResampled, cOutFramesMax, &cFrames);
+            }
+
+            if (SUCCEEDED(hr))
+            {
+                hr = ConvertPcm(floatFormat, (const BYTE*)pResampled, m_outputFormat, pDst, cFrames);
+            }
+        }
+        else if (!fCopy)
+        {
+            hr = ConvertPcm(srcFormat, pSrc, m_outputFormat, pDst, cFrames);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = WritePcm(fCopy ? pSrc : pDst, cFrames * cbDstFrame);
+        }
+    }
+
+    if (SUCCEEDED(hr) && fResample)
+    {
+        UINT32 cFrames = 0;
+
+        hr = m_resampler.Drain(pResampled, cOutFramesMax, &cFrames);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = ConvertPcm(floatFormat, (const BYTE*)pResampled, m_outputFormat, pDst, cFrames);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = WritePcm(pDst, cFrames * cbDstFrame);
+        }
+    }
+
+    delete [] pResampled;
+    delete [] pFloat;
+    delete [] pDst;
+
+    return hr;
+}
+
+// Writes converted samples to every output.
+HRESULT CPortableSession::WritePcm(const BYTE *pData, DWORD cbData)
+{
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < m_cOutputs && SUCCEEDED(hr); i++)
+    {
+        hr = m_outputs[i].wavWriter.Write(pData, cbData);
+    }
+    return hr;
+}
+
+HRESULT CPortableSession::ProcessAdts()
+{
+    HRESULT hr = m_adtsReader.SeekToTime(m_hnsStart);
+
+    UINT64 iStop = StopSample(m_adtsReader.Format().sampleRate);
+
+    while (SUCCEEDED(hr) && m_adtsReader.Position() < iStop)
+    {
+        AdtsHeader header;
+        const BYTE *pFrame = NULL;
+        DWORD cbFrame = 0;
+
+        if (IsAborted())
+        {
+            hr = E_ABORT;
+            break;
+        }
+
+        hr = m_adtsReader.ReadFrame(&pFrame, &cbFrame, &header);
+
+        if (FAILED(hr) || cbFrame == 0)
+        {
+            break;
+        }
+
+        hr = WriteFrame(pFrame, cbFrame, &header);
+
+        SetPosition(SamplesToHns(m_adtsReader.Position(), m_adtsReader.Format().sampleRate));
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ProcessLoas
+//
+//  Copies the AAC access units of a LOAS stream into ADTS frames.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::ProcessLoas()
+{
+    HRESULT hr = m_loasReader.SeekToTime(m_hnsStart);
+
+    UINT64 iStop = StopSample(m_loasReader.Format().sampleRate);
+
+    while (SUCCEEDED(hr) && m_loasReader.Position() < iStop)
+    {
+        AdtsHeader header;
+        const BYTE *pFrame = NULL;
+        DWORD cbFrame = 0;
+
+        if (IsAborted())
+        {
+            hr = E_ABORT;
+            break;
+        }
+
+        hr = m_loasReader.ReadFrame(&pFrame, &cbFrame, &header);
+
+        if (FAILED(hr) || cbFrame == 0)
+        {
+            break;
+        }
+
+        hr = WriteFrame(pFrame, cbFrame, &header);
+
+        SetPosition(SamplesToHns(m_loasReader.Position(), m_loasReader.Format().sampleRate));
+    }
+    return hr;
+}
+
+HRESULT CPortableSession::ProcessMp3()
+{
+    HRESULT hr = m_mp3Reader.SeekToTime(m_hnsStart);
+
+    UINT64 iStop = StopSample(m_mp3Reader.Format().sampleRate);
+
+    while (SUCCEEDED(hr) && m_mp3Reader.Position() < iStop)
+    {
+        Mp3Header header;
+        const BYTE *pFrame = NULL;
+        DWORD cbFrame = 0;
+
+        if (IsAborted())
+        {
+            hr = E_ABORT;
+            break;
+        }
+
+        hr = m_mp3Reader.ReadFrame(&pFrame, &cbFrame, &header);
+
+        if (FAILED(hr) || cbFrame == 0)
+        {
+            break;
+        }
+
+        hr = WriteFrame(pFrame, cbFrame, NULL);
+
+        SetPosition(SamplesToHns(m_mp3Reader.Position(), m_mp3Reader.Format().sampleRate));
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Mp4SampleSize
+//
+//  Size of the MP4 sample that a frame becomes: the raw data block of
+//  an ADTS frame, or a whole MP3 frame. An ADTS frame of several raw
+//  data blocks cannot be split without parsing them, and is refused.
+//-------------------------------------------------------------------
+
+static HRESULT Mp4SampleSize(const AdtsHeader &header, DWORD cbFrame, UINT32 *pcbSample)
+{
+    if (header.cRawBlocks != 1)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    *pcbSample = cbFrame - header.cbHeader;
+    return S_OK;
+}
+
+static HRESULT Mp4SampleSize(const Mp3Header&, DWORD cbFrame, UINT32 *pcbSample)
+{
+    *pcbSample = cbFrame;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  IndexMp4Outputs
+//
+//  Walks the frames of the job's range once before it runs, so that
+//  the MP4 outputs can write their index ahead of the samples (fast
+//  start) in a single pass. The frames are only viewed in the input's
+//  mapping. An input stream cannot be walked twice; its MP4 outputs
+//  write the index at the end instead.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::IndexMp4Outputs()
+{
+    BOOL fMp4 = FALSE;
+
+    for (DWORD i = 0; i < m_cOutputs; i++)
+    {
+        fMp4 = fMp4 || m_outputs[i].writer == Writer_Mp4;
+    }
+
+    if (!fMp4 || m_input.IsStream())
+    {
+        return S_OK;
+    }
+
+    std::vector<UINT32> sizes;
+    HRESULT hr = S_OK;
+
+    switch (m_source)
+    {
+    case Source_Adts:   hr = ReadFrameSizes<CAdtsReader, AdtsHeader>(m_adtsReader, &sizes); break;
+    case Source_Loas:   hr = ReadFrameSizes<CLoasReader, AdtsHeader>(m_loasReader, &sizes); break;
+    default:            hr = ReadFrameSizes<CMp3Reader, Mp3Header>(m_mp3Reader, &sizes); break;
+    }
+
+    for (DWORD i = 0; i < m_cOutputs && SUCCEEDED(hr); i++)
+    {
+        if (m_outputs[i].writer == Writer_Mp4)
+        {
+            hr = m_outputs[i].mp4Writer.SetSampleSizes(sizes);
+        }
+    }
+    return hr;
+}
+
+template <class Reader, class Header>
+HRESULT CPortableSession::ReadFrameSizes(Reader &reader, std::vector<UINT32> *pSizes)
+{
+    HRESULT hr = reader.SeekToTime(m_hnsStart);
+
+    UINT64 iStop = StopSample(reader.Format().sampleRate);
+
+    while (SUCCEEDED(hr) && reader.Position() < iStop)
+    {
+        Header header;
+        const BYTE *pFrame = NULL;
+        DWORD cbFrame = 0;
+        UINT32 cbSample = 0;
+
+        if (IsAborted())
+        {
+            hr = E_ABORT;
+            break;
+        }
+
+        hr = reader.ReadFrame(&pFrame, &cbFrame, &header);
+
+        if (FAILED(hr) || cbFrame == 0)
+        {
+            break;
+        }
+
+        hr = Mp4SampleSize(header, cbFrame, &cbSample);
+
+        if (SUCCEEDED(hr))
+        {
+            try
+            {
+                pSizes->push_back(cbSample);
+            }
+            catch (const std::exception&)
+            {
+                hr = E_OUTOFMEMORY;
+            }
+        }
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  WriteFrame
+//
+//  Writes a frame to every output. pAdts is the frame's ADTS header,
+//  which MPEG-4 outputs leave out, or NULL for an MP3 frame.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::WriteFrame(const BYTE *pFrame, DWORD cbFrame, const AdtsHeader *pAdts)
+{
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < m_cOutputs && SUCCEEDED(hr); i++)
+    {
+        OutputBranch &branch = m_outputs[i];
+
+        if (branch.writer == Writer_File)
+        {
+            hr = branch.file.Write(pFrame, cbFrame);
+            continue;
+        }
+
+        UINT32 cbSample = cbFrame;
+
+        if (pAdts)
+        {
+            hr = Mp4SampleSize(*pAdts, cbFrame, &cbSample);
+        }
+
+        const BYTE *pSample = pFrame + cbFrame - cbSample;
+
+        if (SUCCEEDED(hr))
+        {
+            switch (branch.writer)
+            {
+            case Writer_Mp4:        hr = branch.mp4Writer.WriteSample(pSample, cbSample); break;
+            case Writer_Fragments:  hr = branch.fragmentWriter.WriteSample(pSample, cbSample); break;
+            default:                hr = branch.packager.WriteSample(pSample, cbSample); break;
+            }
+        }
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  FinalizeOutput
+//
+//  Finalizes every output, and returns the first failure.
+//-------------------------------------------------------------------
+
+HRESULT CPortableSession::FinalizeOutput()
+{
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < m_cOutputs; i++)
+    {
+        HRESULT hrOutput = S_OK;
+
+        if (m_source == Source_Wav)
+        {
+            hrOutput = m_outputs[i].wavWriter.Finalize();
+        }
+        else
+        {
+            switch (m_outputs[i].writer)
+            {
+            case Writer_Mp4:        hrOutput = m_outputs[i].mp4Writer.Finalize(); break;
+            case Writer_Fragments:  hrOutput = m_outputs[i].fragmentWriter.Finalize(); break;
+            case Writer_Packager:   hrOutput = m_outputs[i].packager.Finalize(); break;
+            default:                hrOutput = m_outputs[i].file.Close(); break;
+            }
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = hrOutput;
+        }
+    }
+    return hr;
+}
+
+void CPortableSession::ReleaseResources()
+{
+    m_wavReader.Close();
+    m_adtsReader.Close();
+    m_loasReader.Close();
+    m_mp3Reader.Close();
+    m_input.Close();
+
+    // Outputs that were not finalized are closed as they are.
+    for (DWORD i = 0; i < SESSION_MAX_OUTPUTS; i++)
+    {
+        m_outputs[i].wavWriter.Close();
+        (void)m_outputs[i].file.Close();
+        m_outputs[i].mp4Writer.Close();
+        m_outputs[i].fragmentWriter.Close();
+        m_outputs[i].packager.Close();
+    }
+}
+
+void CPortableSession::ResetJob()
+{
+    m_source = Source_None;
+    m_pFormat = NULL;
+    memset(&m_outputFormat, 0, sizeof(m_outputFormat));
+
+    for (DWORD i = 0; i < SESSION_MAX_OUTPUTS; i++)
+    {
+        m_outputs[i].writer = Writer_File;
+    }
+    m_cOutputs = 0;
+}
+
+//-------------------------------------------------------------------
+//  CPortableBackend
+//-------------------------------------------------------------------
+
+class CPortableBackend : public IMediaBackend
+{
+public:
+    CPortableBackend(BOOL fFake) : m_fFake(fFake)
+    {
+
+    }
+
+    ~CPortableBackend()
+    {
+        m_queue.Stop();
+    }
+
+    const WCHAR* GetName() const
+    {
+        return m_fFake ? L"fake" : L"portable";
+    }
+
+    HRESULT SetCacheFile(const WCHAR *sPath)
+    {
+        // Nothing is enumerated, so there is nothing to cache.
+        return sPath ? S_OK : E_INVALIDARG;
+    }
+
+    // Jobs run on a work queue with one thread per processor, so at
+    // most that many run at once however many sessions are open.
+    HRESULT Startup()
+    {
+        return m_queue.Start(0);
+    }
+
+    HRESULT Shutdown()
+    {
+        m_queue.Stop();
+        return S_OK;
+    }
+
+    HRESULT CreateSession(ITranscodeSession **ppSession)
+    {
+        if (!ppSession)
+        {
+            return E_POINTER;
+        }
+
+        if (m_fFake)
+        {
+            return CreateFakeSession(&m_queue, ppSession);
+        }
+
+        *ppSession = new (std::nothrow) CPortableSession(&m_queue);
+
+        return *ppSession ? S_OK : E_OUTOFMEMORY;
+    }
+
+    HRESULT GetProfileCacheStats(ProfileCacheStats *pStats)
+    {
+        if (!pStats)
+        {
+            return E_POINTER;
+        }
+
+        // There are no transcode profiles to cache.
+        pStats->cHits = 0;
+        pStats->cMisses = 0;
+        return S_OK;
+    }
+
+private:
+
+    BOOL        m_fFake;
+    CWorkQueue  m_queue;
+};
+
+HRESULT CreatePortableBackend(BOOL fFake, IMediaBackend **ppBackend)
+{
+    if (!ppBackend)
+    {
+        return E_POINTER;
+    }
+
+    *ppBackend = new (std::nothrow) CPortableBackend(fFake);
+
+    return *ppBackend ? S_OK : E_OUTOFMEMORY;
+}
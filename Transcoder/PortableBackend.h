@@ -0,0 +1,123 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// PortableBackend.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Sessions of the portable and fake backends. Both raise the same
+// event sequence as a media session and run the job on the backend's
+// work queue.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Backend.h"
+#include "WorkQueue.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+
+//-------------------------------------------------------------------
+//  CQueuedSession
+//
+//  Event queue and state machine shared by the in-process sessions.
+//  Events are delivered on the work queue. When the caller asks for
+//  the event that follows SessionEvent_Started, the job (Process) runs
+//  as a work item and completes the request with SessionEvent_Ended.
+//-------------------------------------------------------------------
+
+class CQueuedSession : public ITranscodeSession
+{
+public:
+    CQueuedSession(CWorkQueue *pQueue);
+    virtual ~CQueuedSession();
+
+    HRESULT SetStreamCopy(BOOL fAllow);
+    HRESULT SetSampleRate(UINT32 sampleRate);
+    HRESULT SetStopTime(LONGLONG hnsStop);
+    HRESULT AddOutput(const OutputFormat *pFormat, const WCHAR *sURL);
+    HRESULT SetOutput(const WCHAR *sURL);
+    HRESULT SetOutputSink(IOutputSink *pSink);
+    HRESULT Start(LONGLONG hnsStart);
+    HRESULT GetPosition(LONGLONG *phnsPosition);
+    HRESULT BeginGetEvent(ISessionEventCallback *pCallback);
+    HRESULT Close();
+    HRESULT Shutdown();
+    HRESULT Reset();
+
+protected:
+
+    enum SessionState
+    {
+        State_Idle,         // No output yet.
+        State_Ready,        // Output created; waiting for Start.
+        State_Running,      // Started; the job runs on the next request.
+        State_Ended,
+        State_Closed,
+        State_Shutdown,
+    };
+
+    // Output added with AddOutput.
+    struct ExtraOutput
+    {
+        const OutputFormat* pFormat;
+        WCHAR               szURL[MAX_PATH];
+    };
+
+    // Creates the main output, at sURL or, if sURL is NULL, into
+    // m_pOutputSink, and every output in m_extraOutputs. Called by
+    // SetOutput and SetOutputSink.
+    virtual HRESULT CreateOutput(const WCHAR *sURL) = 0;
+
+    // Runs the job from m_hnsStart to m_hnsStop, or to the end of the
+    // source if m_hnsStop is 0. Called on a work queue thread. Returns
+    // E_ABORT early if IsAborted().
+    virtual HRESULT Process() = 0;
+
+    // Finalizes the output. Called by Close.
+    virtual HRESULT FinalizeOutput() = 0;
+
+    // Releases the source and any output that was not finalized.
+    virtual void    ReleaseResources() = 0;
+
+    // Forgets the source and outputs of the last job. Called by Reset,
+    // after ReleaseResources.
+    virtual void    ResetJob() = 0;
+
+    BOOL    IsAborted() const { return m_fAbort; }
+
+    // Called by Process as the job advances, for GetPosition.
+    void    SetPosition(LONGLONG hnsPosition) { m_hnsPosition = hnsPosition; }
+
+    SessionState                m_state;
+    LONGLONG                    m_hnsStart;
+    LONGLONG                    m_hnsStop;
+    BOOL                        m_fStreamCopy;
+    UINT32                      m_outputSampleRate; // 0 keeps the source rate
+    ExtraOutput                 m_extraOutputs[SESSION_MAX_OUTPUTS - 1];
+    DWORD                       m_cExtraOutputs;
+    IOutputSink*                m_pOutputSink;      // Main output, if not a file
+
+private:
+
+    HRESULT BeginOutput(const WCHAR *sURL, IOutputSink *pSink);
+    void    QueueEvent(SessionEventType type, HRESULT hrStatus);
+    void    RunProcess();
+
+    CWorkQueue*                 m_pQueue;
+    std::mutex                  m_lock;
+    std::condition_variable     m_cvIdle;
+    std::deque<SessionEvent>    m_events;
+    ISessionEventCallback*      m_pCallback;    // Request waiting for Process
+    BOOL                        m_fProcessing;
+    std::atomic<bool>           m_fAbort;
+    std::atomic<LONGLONG>       m_hnsPosition;
+};
+
+HRESULT CreateFakeSession(CWorkQueue *pQueue, ITranscodeSession **ppSession);
@@ -0,0 +1,115 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Progress.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Progress.h"
+#include "Transcode.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+CProgressMonitor::CProgressMonitor() : m_msInterval(0), m_fStopping(FALSE)
+{
+
+}
+
+CProgressMonitor::~CProgressMonitor()
+{
+    Stop();
+}
+
+HRESULT CProgressMonitor::Start(DWORD msInterval)
+{
+    if (msInterval == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_thread.joinable())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_msInterval = msInterval;
+        m_fStopping = FALSE;
+    }
+
+    try
+    {
+        m_thread = std::thread(&CProgressMonitor::ThreadProc, this);
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+void CProgressMonitor::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_fStopping = TRUE;
+        m_cvStop.notify_all();
+    }
+
+    if (m_thread.joinable())
+    {
+        m_thread.join();
+    }
+}
+
+void CProgressMonitor::Add(CTranscoder *pTranscoder)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (std::find(m_transcoders.begin(), m_transcoders.end(), pTranscoder) == m_transcoders.end())
+    {
+        m_transcoders.push_back(pTranscoder);
+    }
+}
+
+void CProgressMonitor::Remove(CTranscoder *pTranscoder)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    m_transcoders.erase(std::remove(m_transcoders.begin(), m_transcoders.end(), pTranscoder),
+        m_transcoders.end());
+}
+
+//-------------------------------------------------------------------
+//  ThreadProc
+//
+//  Polls under the lock, which is what makes Remove wait for a poll
+//  in progress. A poll only reads a clock and formats a report.
+//-------------------------------------------------------------------
+
+void CProgressMonitor::ThreadProc()
+{
+    std::unique_lock<std::mutex> lock(m_lock);
+
+    while (!m_fStopping)
+    {
+        m_cvStop.wait_for(lock, std::chrono::milliseconds(m_msInterval));
+
+        if (m_fStopping)
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < m_transcoders.size(); i++)
+        {
+            m_transcoders[i]->PollProgress();
+        }
+    }
+}
@@ -0,0 +1,61 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Progress.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Progress polling. One thread samples the position of every running
+// transcoder at a fixed interval, so that a scheduler can tell a slow
+// job from a hung one. Polling reads the session's presentation time
+// and never waits for the session's work queues.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CTranscoder;
+
+//-------------------------------------------------------------------
+//  CProgressMonitor
+//
+//  Transcoders add themselves when their session starts and remove
+//  themselves before it closes. Remove waits for a poll of that
+//  transcoder in progress, so the transcoder may be deleted as soon
+//  as it returns.
+//-------------------------------------------------------------------
+
+class CProgressMonitor
+{
+public:
+    CProgressMonitor();
+    ~CProgressMonitor();
+
+    // Starts the polling thread. msInterval is the time between polls.
+    HRESULT Start(DWORD msInterval);
+    void    Stop();
+
+    void    Add(CTranscoder *pTranscoder);
+    void    Remove(CTranscoder *pTranscoder);
+
+private:
+
+    void    ThreadProc();
+
+    std::mutex                  m_lock;
+    std::condition_variable     m_cvStop;
+    std::vector<CTranscoder*>   m_transcoders;
+    std::thread                 m_thread;
+    DWORD                       m_msInterval;
+    BOOL                        m_fStopping;
+};
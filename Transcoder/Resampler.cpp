@@ -0,0 +1,392 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Resampler.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Resampler.h"
+
+#include <math.h>
+#include <string.h>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#define RESAMPLER_HALF_TAPS     (RESAMPLER_TAPS / 2)
+#define RESAMPLER_KAISER_BETA   8.0     // About 80 dB stopband
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Coefficients of every phase, phase-major. Phase p holds the taps for
+// input frames base - RESAMPLER_HALF_TAPS + 1 .. base + RESAMPLER_HALF_TAPS
+// of an output at position base + p / L.
+struct ResamplerBank
+{
+    UINT32  L;
+    UINT32  M;
+    float   coefs[1];   // L * RESAMPLER_TAPS
+};
+
+static UINT32 Gcd(UINT32 a, UINT32 b)
+{
+    while (b != 0)
+    {
+        UINT32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// Modified Bessel function of the first kind, order 0.
+static double BesselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 50 && term > sum * 1e-12; k++)
+    {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+//-------------------------------------------------------------------
+//  CreateBank
+//
+//  The cutoff is at the lower of the two Nyquist frequencies, less
+//  the transition band of the window, so nothing above the output's
+//  Nyquist frequency aliases. Each phase is scaled to unit DC gain.
+//-------------------------------------------------------------------
+
+static ResamplerBank* CreateBank(UINT32 L, UINT32 M)
+{
+    size_t cb = sizeof(ResamplerBank) + ((size_t)L * RESAMPLER_TAPS - 1) * sizeof(float);
+
+    ResamplerBank *pBank = (ResamplerBank*)new (std::nothrow) BYTE[cb];
+
+    if (pBank == NULL)
+    {
+        return NULL;
+    }
+
+    pBank->L = L;
+    pBank->M = M;
+
+    // Kaiser transition width, as a fraction of the input rate.
+    const double transition = (RESAMPLER_KAISER_BETA / 0.1102 + 8.7 - 7.95) / (14.36 * RESAMPLER_TAPS);
+    const double fc = (L < M ? (double)L / M : 1.0) - transition;
+    const double i0Beta = BesselI0(RESAMPLER_KAISER_BETA);
+
+    for (UINT32 p = 0; p < L; p++)
+    {
+        float *pCoefs = &pBank->coefs[(size_t)p * RESAMPLER_TAPS];
+        double sum = 0;
+        double taps[RESAMPLER_TAPS];
+
+        for (UINT32 k = 0; k < RESAMPLER_TAPS; k++)
+        {
+            double x = (double)p / L + (RESAMPLER_HALF_TAPS - 1) - (double)k;
+            double u = x / RESAMPLER_HALF_TAPS;
+            double sinc = (x == 0) ? 1.0 : sin(M_PI * fc * x) / (M_PI * fc * x);
+            double window = (u * u < 1) ? BesselI0(RESAMPLER_KAISER_BETA * sqrt(1 - u * u)) / i0Beta : 0;
+
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+
+        for (UINT32 k = 0; k < RESAMPLER_TAPS; k++)
+        {
+            pCoefs[k] = (float)(taps[k] / sum);
+        }
+    }
+
+    return pBank;
+}
+
+//-------------------------------------------------------------------
+//  GetBank
+//
+//  Banks are kept for the life of the process; a process sees only
+//  a few distinct ratios. The list is never destroyed either, so the
+//  banks stay reachable, and are not reported by leak checkers, at
+//  exit.
+//-------------------------------------------------------------------
+
+static const ResamplerBank* GetBank(UINT32 L, UINT32 M)
+{
+    static std::mutex lock;
+    static std::vector<ResamplerBank*> &banks = *new std::vector<ResamplerBank*>();
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    for (size_t i = 0; i < banks.size(); i++)
+    {
+        if (banks[i]->L == L && banks[i]->M == M)
+        {
+            return banks[i];
+        }
+    }
+
+    ResamplerBank *pBank = CreateBank(L, M);
+
+    if (pBank)
+    {
+        banks.push_back(pBank);
+    }
+    return pBank;
+}
+
+//-------------------------------------------------------------------
+//  CResampler
+//-------------------------------------------------------------------
+
+CResampler::CResampler() :
+    m_pBank(NULL),
+    m_pKernels(NULL),
+    m_channels(0),
+    m_pHistory(NULL),
+    m_cCapacity(0),
+    m_cHistory(0),
+    m_iBase(0),
+    m_phase(0),
+    m_cInput(0),
+    m_cOutput(0)
+{
+
+}
+
+CResampler::~CResampler()
+{
+    delete [] m_pHistory;
+}
+
+HRESULT CResampler::Initialize(UINT32 inRate, UINT32 outRate, UINT32 channels, const PcmKernels *pKernels)
+{
+    if (inRate == 0 || outRate == 0 || channels == 0 || channels > RESAMPLER_MAX_CHANNELS)
+    {
+        return E_INVALIDARG;
+    }
+
+    UINT32 gcd = Gcd(inRate, outRate);
+    UINT32 L = outRate / gcd;
+    UINT32 M = inRate / gcd;
+
+    if (L > RESAMPLER_MAX_PHASES || M > (UINT64)L * RESAMPLER_MAX_DECIMATION)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    const ResamplerBank *pBank = GetBank(L, M);
+
+    if (pBank == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    UINT32 cCapacity = RESAMPLER_TAPS + RESAMPLER_BLOCK_FRAMES;
+
+    if (m_channels != channels)
+    {
+        delete [] m_pHistory;
+
+        m_channels = 0;
+        m_pHistory = new (std::nothrow) float[(size_t)cCapacity * channels];
+
+        if (m_pHistory == NULL)
+        {
+            return E_OUTOFMEMORY;
+        }
+        m_channels = channels;
+    }
+
+    m_pBank = pBank;
+    m_pKernels = pKernels ? pKernels : GetPcmKernels();
+    m_cCapacity = cCapacity;
+
+    Reset();
+    return S_OK;
+}
+
+void CResampler::Reset()
+{
+    // Frames before the start of the stream are silence.
+    m_cHistory = RESAMPLER_HALF_TAPS - 1;
+    m_iBase = RESAMPLER_HALF_TAPS - 1;
+    m_phase = 0;
+    m_cInput = 0;
+    m_cOutput = 0;
+
+    if (m_pHistory)
+    {
+        for (UINT32 c = 0; c < m_channels; c++)
+        {
+            memset(m_pHistory + (size_t)c * m_cCapacity, 0, m_cHistory * sizeof(float));
+        }
+    }
+}
+
+UINT32 CResampler::MaxOutputFrames(UINT32 cInFrames) const
+{
+    if (m_pBank == NULL)
+    {
+        return 0;
+    }
+
+    UINT64 cOut = ((UINT64)cInFrames + RESAMPLER_TAPS) * m_pBank->L / m_pBank->M + 2;
+
+    return cOut > 0xFFFFFFFF ? 0xFFFFFFFF : (UINT32)cOut;
+}
+
+HRESULT CResampler::Process(const float *pIn, UINT32 cInFrames, float *pOut, UINT32 cOutMax, UINT32 *pcOut)
+{
+    if (!pIn || !pOut || !pcOut)
+    {
+        return E_POINTER;
+    }
+
+    if (cOutMax < MaxOutputFrames(cInFrames))
+    {
+        return MF_E_BUFFERTOOSMALL;
+    }
+
+    return Filter(pIn, cInFrames, pOut, cOutMax, pcOut);
+}
+
+HRESULT CResampler::Drain(float *pOut, UINT32 cOutMax, UINT32 *pcOut)
+{
+    if (!pOut || !pcOut)
+    {
+        return E_POINTER;
+    }
+
+    if (cOutMax < MaxOutputFrames(0))
+    {
+        return MF_E_BUFFERTOOSMALL;
+    }
+
+    // Silence after the end lets the last outputs be computed; m_cInput
+    // keeps them from going past it.
+    HRESULT hr = Filter(NULL, RESAMPLER_HALF_TAPS + 1, pOut, cOutMax, pcOut);
+
+    if (SUCCEEDED(hr))
+    {
+        Reset();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Filter
+//
+//  Appends the input (silence if pIn is NULL) to the history a block
+//  at a time and computes every output whose taps are all present.
+//-------------------------------------------------------------------
+
+HRESULT CResampler::Filter(const float *pIn, UINT32 cInFrames, float *pOut, UINT32 cOutMax, UINT32 *pcOut)
+{
+    if (m_pBank == NULL)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    const UINT32 L = m_pBank->L;
+    const UINT32 M = m_pBank->M;
+
+    UINT32 cOut = 0;
+
+    while (cInFrames > 0)
+    {
+        UINT32 cBlock = cInFrames < RESAMPLER_BLOCK_FRAMES ? cInFrames : RESAMPLER_BLOCK_FRAMES;
+
+        // The rows are split here, so stereo takes the fast path.
+        if (pIn == NULL)
+        {
+            for (UINT32 c = 0; c < m_channels; c++)
+            {
+                memset(m_pHistory + (size_t)c * m_cCapacity + m_cHistory, 0, cBlock * sizeof(float));
+            }
+        }
+        else if (m_channels == 2)
+        {
+            m_pKernels->pfnDeinterleave2(pIn, m_pHistory + m_cHistory, m_pHistory + m_cCapacity + m_cHistory, cBlock);
+        }
+        else
+        {
+            for (UINT32 c = 0; c < m_channels; c++)
+            {
+                float *pRow = m_pHistory + (size_t)c * m_cCapacity + m_cHistory;
+
+                for (UINT32 i = 0; i < cBlock; i++)
+                {
+                    pRow[i] = pIn[(size_t)i * m_channels + c];
+                }
+            }
+        }
+
+        m_cHistory += cBlock;
+
+        if (pIn)
+        {
+            m_cInput += cBlock;
+            pIn += (size_t)cBlock * m_channels;
+        }
+        cInFrames -= cBlock;
+
+        while (m_iBase + RESAMPLER_HALF_TAPS < m_cHistory && m_cOutput * M < m_cInput * L)
+        {
+            if (cOut == cOutMax)
+            {
+                return MF_E_BUFFERTOOSMALL;
+            }
+
+            const float *pCoefs = &m_pBank->coefs[(size_t)m_phase * RESAMPLER_TAPS];
+            const UINT32 iFirst = m_iBase + 1 - RESAMPLER_HALF_TAPS;
+
+            for (UINT32 c = 0; c < m_channels; c++)
+            {
+                pOut[(size_t)cOut * m_channels + c] = m_pKernels->pfnDotProduct(
+                    m_pHistory + (size_t)c * m_cCapacity + iFirst, pCoefs, RESAMPLER_TAPS);
+            }
+
+            cOut++;
+            m_cOutput++;
+
+            m_phase += M;
+            m_iBase += m_phase / L;
+            m_phase %= L;
+        }
+
+        // Keep only the frames the next output needs.
+        UINT32 cDiscard = m_iBase + 1 - RESAMPLER_HALF_TAPS;
+
+        if (cDiscard > m_cHistory)
+        {
+            cDiscard = m_cHistory;
+        }
+
+        if (cDiscard > 0)
+        {
+            for (UINT32 c = 0; c < m_channels; c++)
+            {
+                float *pRow = m_pHistory + (size_t)c * m_cCapacity;
+
+                memmove(pRow, pRow + cDiscard, (m_cHistory - cDiscard) * sizeof(float));
+            }
+
+            m_cHistory -= cDiscard;
+            m_iBase -= cDiscard;
+        }
+    }
+
+    *pcOut = cOut;
+    return S_OK;
+}
@@ -0,0 +1,80 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Resampler.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Polyphase sample-rate converter. The ratio of the rates is reduced
+// to L/M (44100 -> 48000 is 160/147); output sample n lies at input
+// position n * M / L and is computed with phase (n * M) % L of a
+// Kaiser-windowed sinc filter, RESAMPLER_TAPS input samples long, that
+// is split into L phases. The filter banks are built once per ratio
+// and shared by every resampler in the process.
+//
+// The resampler streams: Process may be called with blocks of any
+// size and keeps the last RESAMPLER_TAPS input frames between calls,
+// so the output lags the input by RESAMPLER_TAPS / 2 frames. Drain
+// flushes that tail at the end of the stream; in total, N input
+// frames give ceil(N * L / M) output frames, aligned with the input.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "PcmKernels.h"
+
+#define RESAMPLER_TAPS          192     // Per phase; a multiple of 8
+#define RESAMPLER_MAX_PHASES    1024    // Largest L
+#define RESAMPLER_MAX_DECIMATION 4      // Largest input rate / output rate
+#define RESAMPLER_BLOCK_FRAMES  4096    // Input frames filtered at a time
+#define RESAMPLER_MAX_CHANNELS  8
+
+struct ResamplerBank;
+
+class CResampler
+{
+public:
+    CResampler();
+    ~CResampler();
+
+    // Fails with MF_E_INVALIDMEDIATYPE if the reduced ratio needs more
+    // than RESAMPLER_MAX_PHASES phases or the input rate is more than
+    // RESAMPLER_MAX_DECIMATION times the output rate. pKernels selects
+    // a kernel set; NULL uses the fastest one.
+    HRESULT Initialize(UINT32 inRate, UINT32 outRate, UINT32 channels, const PcmKernels *pKernels = NULL);
+
+    // Output frames that Process may write for cInFrames input frames.
+    UINT32  MaxOutputFrames(UINT32 cInFrames) const;
+
+    // Filters cInFrames interleaved float frames and writes the output
+    // frames that are complete. cOutMax must be at least
+    // MaxOutputFrames(cInFrames).
+    HRESULT Process(const float *pIn, UINT32 cInFrames, float *pOut, UINT32 cOutMax, UINT32 *pcOut);
+
+    // Writes the last output frames at the end of the stream and
+    // starts a new one. cOutMax must be at least MaxOutputFrames(0).
+    HRESULT Drain(float *pOut, UINT32 cOutMax, UINT32 *pcOut);
+
+    // Starts a new stream with the same rates.
+    void    Reset();
+
+private:
+
+    HRESULT Filter(const float *pIn, UINT32 cInFrames, float *pOut, UINT32 cOutMax, UINT32 *pcOut);
+
+    const ResamplerBank*    m_pBank;
+    const PcmKernels*       m_pKernels;
+    UINT32                  m_channels;
+    float*                  m_pHistory;     // One row of m_cCapacity frames per channel
+    UINT32                  m_cCapacity;
+    UINT32                  m_cHistory;     // Frames in each row
+    UINT32                  m_iBase;        // Row index of the next output's input position
+    UINT32                  m_phase;        // Phase of the next output, < L
+    UINT64                  m_cInput;       // Input frames so far, not counting Drain
+    UINT64                  m_cOutput;      // Output frames so far
+};
@@ -0,0 +1,373 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Segment.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Segment.h"
+#include "WavFile.h"
+#include "Adts.h"
+
+#include <string.h>
+#include <chrono>
+
+// Segment boundaries fall on this grid of samples, one AAC frame,
+// unless the source's frames are copied and are longer.
+#define SEGMENT_GRID_SAMPLES        ADTS_SAMPLES_PER_FRAME
+
+// AAC encoders prime with up to 2112 samples, and the first kept frame
+// also needs the frame before it for the MDCT overlap.
+#define SEGMENT_AAC_PREROLL_FRAMES  4
+
+#define SEGMENT_COPY_BLOCK_SIZE     (64 * 1024)
+
+BOOL CanSegmentFormat(const OutputFormat *pFormat)
+{
+    return pFormat && pFormat->iVideoProfile == FORMAT_NO_VIDEO &&
+        ((pFormat->audioCodec == AudioCodec_PCM && pFormat->container == Container_WAVE) ||
+         (pFormat->audioCodec == AudioCodec_AAC && pFormat->container == Container_ADTS));
+}
+
+//-------------------------------------------------------------------
+//  CSegmentedEncode constructor
+//-------------------------------------------------------------------
+
+CSegmentedEncode::CSegmentedEncode() :
+    m_pFormat(NULL),
+    m_cSegments(0),
+    m_cInFlight(0)
+{
+    m_szOutput[0] = L'\0';
+}
+
+CSegmentedEncode::~CSegmentedEncode()
+{
+
+}
+
+//-------------------------------------------------------------------
+//  Plan
+//
+//  Splits the source into ranges of whole grid frames. Segment i keeps
+//  the frames [F(i), F(i+1)); it is encoded from F(i) minus the
+//  pre-roll, and up to F(i+1) unless it is the last one.
+//-------------------------------------------------------------------
+
+HRESULT CSegmentedEncode::Plan(const OutputFormat *pFormat, const MediaInfo &info, DWORD cSegments, const WCHAR *sOutput)
+{
+    if (!pFormat || !sOutput || cSegments == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!CanSegmentFormat(pFormat))
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    if (info.audioSampleRate == 0)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (wcscpy_s(m_szOutput, MAX_PATH, sOutput) != 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    m_pFormat = pFormat;
+
+    // A copied frame cannot be cut, and a seek lands at the start of
+    // the frame that holds the time, so the grid is the copied frame.
+    const UINT64 cGridSamples = info.cCopyFrameSamples ? info.cCopyFrameSamples : SEGMENT_GRID_SAMPLES;
+
+    UINT64 cFrames = HnsToSamples(info.hnsDuration, info.audioSampleRate) / cGridSamples;
+    UINT64 cMinFrames = (UINT64)SEGMENT_MIN_SECONDS * info.audioSampleRate / cGridSamples;
+
+    UINT64 cMax = cMinFrames ? cFrames / cMinFrames : cFrames;
+
+    if (cSegments > SEGMENT_MAX_COUNT)
+    {
+        cSegments = SEGMENT_MAX_COUNT;
+    }
+    if (cSegments > cMax)
+    {
+        cSegments = cMax ? (DWORD)cMax : 1;
+    }
+
+    UINT64 cPrerollFrames = (pFormat->audioCodec == AudioCodec_AAC) ? SEGMENT_AAC_PREROLL_FRAMES : 0;
+
+    for (DWORD i = 0; i < cSegments; i++)
+    {
+        SegmentJob *pJob = &m_segments[i];
+
+        UINT64 iFirst = cFrames * i / cSegments;
+        UINT64 iEnd = cFrames * (i + 1) / cSegments;
+        UINT64 iEncodeFirst = iFirst > cPrerollFrames ? iFirst - cPrerollFrames : 0;
+
+        BOOL fLast = (i == cSegments - 1);
+
+        pJob->hnsStart = SamplesToHns(iEncodeFirst * cGridSamples, info.audioSampleRate);
+        pJob->hnsStop = fLast ? 0 : SamplesToHns(iEnd * cGridSamples, info.audioSampleRate);
+        pJob->cSkipSamples = (iFirst - iEncodeFirst) * cGridSamples;
+        pJob->cKeepSamples = fLast ? 0 : (iEnd - iFirst) * cGridSamples;
+        pJob->hr = E_PENDING;
+        pJob->pOwner = this;
+
+        if (swprintf_s(pJob->szOutput, MAX_PATH, L"%ls.part%02u", sOutput, i) < 0)
+        {
+            return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+        }
+    }
+
+    m_cSegments = cSegments;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  CompleteSegment
+//
+//  Records the segment result. Called on the thread that finished the
+//  segment.
+//-------------------------------------------------------------------
+
+void CSegmentedEncode::CompleteSegment(SegmentJob *pJob, HRESULT hr)
+{
+    pJob->pOwner->OnSegmentComplete(pJob, hr);
+}
+
+void CSegmentedEncode::OnSegmentComplete(SegmentJob *pJob, HRESULT hr)
+{
+    pJob->hr = hr;
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_cInFlight--;
+    m_cvComplete.notify_all();
+}
+
+//-------------------------------------------------------------------
+//  Run
+//
+//  Starts all the segments at once; the plan already bounds their
+//  number. Returns the first segment failure, if any.
+//-------------------------------------------------------------------
+
+HRESULT CSegmentedEncode::Run(PFN_BEGIN_SEGMENT pfnBegin, void *pContext)
+{
+    if (!pfnBegin)
+    {
+        return E_POINTER;
+    }
+
+    if (m_cSegments == 0)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    std::chrono::steady_clock::time_point tStart = std::chrono::steady_clock::now();
+
+    for (DWORD i = 0; i < m_cSegments; i++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_cInFlight++;
+        }
+
+        HRESULT hrBegin = pfnBegin(&m_segments[i], pContext);
+
+        if (FAILED(hrBegin))
+        {
+            OnSegmentComplete(&m_segments[i], hrBegin);
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        while (m_cInFlight > 0)
+        {
+            m_cvComplete.wait(lock);
+        }
+    }
+
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < m_cSegments && SUCCEEDED(hr); i++)
+    {
+        hr = m_segments[i].hr;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Join();
+    }
+
+    DeleteParts();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+
+    if (SUCCEEDED(hr))
+    {
+        wprintf_s(L"Joined %u segments in %.3f s.\n", m_cSegments, seconds);
+    }
+    return hr;
+}
+
+HRESULT CSegmentedEncode::Join()
+{
+    return m_pFormat->container == Container_WAVE ? JoinWav() : JoinAdts();
+}
+
+//-------------------------------------------------------------------
+//  JoinWav
+//
+//  Appends the kept frames of every part to one data chunk. The parts
+//  share the format of the first one.
+//-------------------------------------------------------------------
+
+HRESULT CSegmentedEncode::JoinWav()
+{
+    CWavReader reader;
+    CWavWriter writer;
+
+    HRESULT hr = S_OK;
+
+    PcmFormat format;
+    memset(&format, 0, sizeof(format));
+
+    for (DWORD i = 0; i < m_cSegments && SUCCEEDED(hr); i++)
+    {
+        const SegmentJob *pJob = &m_segments[i];
+
+        hr = reader.Open(pJob->szOutput);
+
+        if (SUCCEEDED(hr) && i == 0)
+        {
+            format = reader.Format();
+            hr = writer.Create(m_szOutput, format, PartsSize());
+        }
+        else if (SUCCEEDED(hr) && memcmp(&format, &reader.Format(), sizeof(format)) != 0)
+        {
+            hr = MF_E_INVALIDMEDIATYPE;
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = reader.SeekToFrame(pJob->cSkipSamples);
+        }
+
+        UINT32 cbFrame = PcmBlockAlign(format);
+        UINT64 cFramesLeft = pJob->cKeepSamples ? pJob->cKeepSamples : (UINT64)-1;
+
+        while (SUCCEEDED(hr) && cFramesLeft > 0)
+        {
+            const BYTE *pBlock = NULL;
+            DWORD cbWanted = SEGMENT_COPY_BLOCK_SIZE;
+            DWORD cbRead = 0;
+
+            if (cFramesLeft < cbWanted / cbFrame)
+            {
+                cbWanted = (DWORD)cFramesLeft * cbFrame;
+            }
+
+            hr = reader.Read(cbWanted, &pBlock, &cbRead);
+
+            if (FAILED(hr) || cbRead == 0)
+            {
+                break;
+            }
+
+            hr = writer.Write(pBlock, cbRead);
+            cFramesLeft -= cbRead / cbFrame;
+        }
+
+        reader.Close();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = writer.Finalize();
+    }
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  JoinAdts
+//
+//  Copies the kept frames of every part. A frame is kept if it starts
+//  inside the kept range; the grid makes frame starts and range
+//  boundaries coincide.
+//-------------------------------------------------------------------
+
+HRESULT CSegmentedEncode::JoinAdts()
+{
+    COutputFile output;
+    CAdtsReader reader;
+
+    HRESULT hr = output.Create(m_szOutput, PartsSize());
+
+    for (DWORD i = 0; i < m_cSegments && SUCCEEDED(hr); i++)
+    {
+        const SegmentJob *pJob = &m_segments[i];
+
+        UINT64 iEnd = pJob->cKeepSamples ? pJob->cSkipSamples + pJob->cKeepSamples : (UINT64)-1;
+
+        hr = reader.Open(pJob->szOutput);
+
+        while (SUCCEEDED(hr) && reader.Position() < iEnd)
+        {
+            AdtsHeader header;
+            const BYTE *pFrame = NULL;
+            DWORD cbFrame = 0;
+            UINT64 iFrame = reader.Position();
+
+            hr = reader.ReadFrame(&pFrame, &cbFrame, &header);
+
+            if (FAILED(hr) || cbFrame == 0)
+            {
+                break;
+            }
+
+            if (iFrame >= pJob->cSkipSamples)
+            {
+                hr = output.Write(pFrame, cbFrame);
+            }
+        }
+
+        reader.Close();
+    }
+
+    HRESULT hrClose = output.Close();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = hrClose;
+    }
+    return hr;
+}
+
+// The parts overlap a little, so their sizes bound the joined file.
+UINT64 CSegmentedEncode::PartsSize() const
+{
+    UINT64 cb = 0;
+
+    for (DWORD i = 0; i < m_cSegments; i++)
+    {
+        cb += GetPathSize(m_segments[i].szOutput);
+    }
+    return cb;
+}
+
+void CSegmentedEncode::DeleteParts()
+{
+    for (DWORD i = 0; i < m_cSegments; i++)
+    {
+        (void)RemoveFile(m_segments[i].szOutput);
+    }
+}
@@ -0,0 +1,101 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Segment.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Segmented encode of one long input. The source is cut into time
+// ranges on boundaries of the output frame grid, the ranges are
+// encoded concurrently to part files, and the parts are joined into
+// the output file, so that one file can keep every core busy.
+//
+// An encoder delays its output by a few frames of priming. Every
+// segment but the first therefore starts a few frames early
+// (pre-roll); the joiner drops those frames, and the padding frames
+// past the end of each segment but the last, so that each kept frame
+// is the frame a single encode would have produced at that position.
+//
+// Only formats that can be joined by concatenating frames are
+// segmented: PCM in WAVE and AAC in ADTS. MP3 frames may borrow bits
+// from the frames before them (bit reservoir), which the join would
+// break, and the MPEG-4 and ASF containers need a muxer.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "Formats.h"
+#include "Backend.h"
+
+#include <condition_variable>
+#include <mutex>
+
+#define SEGMENT_MAX_COUNT       64
+#define SEGMENT_MIN_SECONDS     30      // Shorter ranges do not pay for the session and pre-roll.
+
+class CSegmentedEncode;
+
+struct SegmentJob
+{
+    LONGLONG            hnsStart;       // Encode range, pre-roll included.
+    LONGLONG            hnsStop;        // 0 for the last segment.
+    UINT64              cSkipSamples;   // Pre-roll dropped from the front of the part.
+    UINT64              cKeepSamples;   // Samples kept after the pre-roll; 0 keeps the rest.
+    WCHAR               szOutput[MAX_PATH];     // Part file.
+    HRESULT             hr;
+    CSegmentedEncode    *pOwner;
+};
+
+// Starts encoding [pJob->hnsStart, pJob->hnsStop) of the input to
+// pJob->szOutput. If it succeeds, the segment must later be finished,
+// on any thread, with CSegmentedEncode::CompleteSegment. pContext is
+// the value passed to CSegmentedEncode::Run.
+typedef HRESULT (*PFN_BEGIN_SEGMENT)(SegmentJob *pJob, void *pContext);
+
+// Returns TRUE if parts encoded in pFormat can be joined.
+BOOL CanSegmentFormat(const OutputFormat *pFormat);
+
+class CSegmentedEncode
+{
+public:
+    CSegmentedEncode();
+    ~CSegmentedEncode();
+
+    // Cuts a source described by info into at most cSegments ranges of
+    // at least SEGMENT_MIN_SECONDS each. The parts are named after
+    // sOutput. A short source gets a single segment.
+    HRESULT Plan(const OutputFormat *pFormat, const MediaInfo &info, DWORD cSegments, const WCHAR *sOutput);
+
+    DWORD   SegmentCount() const { return m_cSegments; }
+
+    // Starts every segment, waits for them and joins the parts into
+    // the output file. The part files are deleted.
+    HRESULT Run(PFN_BEGIN_SEGMENT pfnBegin, void *pContext);
+
+    // Records the result of a segment started by PFN_BEGIN_SEGMENT.
+    static void CompleteSegment(SegmentJob *pJob, HRESULT hr);
+
+private:
+
+    void    OnSegmentComplete(SegmentJob *pJob, HRESULT hr);
+
+    HRESULT Join();
+    HRESULT JoinWav();
+    HRESULT JoinAdts();
+    UINT64  PartsSize() const;
+    void    DeleteParts();
+
+    const OutputFormat*     m_pFormat;
+    WCHAR                   m_szOutput[MAX_PATH];
+    SegmentJob              m_segments[SEGMENT_MAX_COUNT];
+    DWORD                   m_cSegments;
+
+    std::mutex              m_lock;
+    std::condition_variable m_cvComplete;
+    DWORD                   m_cInFlight;
+};
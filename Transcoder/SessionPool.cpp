@@ -0,0 +1,170 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SessionPool.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "SessionPool.h"
+
+#include <assert.h>
+
+CSessionPool::CSessionPool(IMediaBackend *pBackend, DWORD cMaxIdle) :
+    m_pBackend(pBackend),
+    m_cMaxIdle(cMaxIdle)
+{
+
+}
+
+CSessionPool::~CSessionPool()
+{
+    Clear();
+}
+
+//-------------------------------------------------------------------
+//  Reserve
+//
+//  Sessions are created and reset outside the lock; for Media
+//  Foundation that is where the media session and profile are made.
+//-------------------------------------------------------------------
+
+HRESULT CSessionPool::Reserve(DWORD cSessions)
+{
+    assert (m_pBackend);
+
+    HRESULT hr = S_OK;
+
+    if (cSessions > m_cMaxIdle)
+    {
+        cSessions = m_cMaxIdle;
+    }
+
+    while (SUCCEEDED(hr))
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            if (m_idle.size() >= cSessions)
+            {
+                break;
+            }
+        }
+
+        ITranscodeSession *pSession = NULL;
+
+        hr = m_pBackend->CreateSession(&pSession);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pSession->Reset();
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            try
+            {
+                m_idle.push_back(pSession);
+                pSession = NULL;
+            }
+            catch (const std::exception&)
+            {
+                hr = E_OUTOFMEMORY;
+            }
+        }
+
+        SafeDelete(&pSession);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Acquire
+//-------------------------------------------------------------------
+
+HRESULT CSessionPool::Acquire(ITranscodeSession **ppSession)
+{
+    assert (m_pBackend);
+
+    if (!ppSession)
+    {
+        return E_POINTER;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if (!m_idle.empty())
+        {
+            *ppSession = m_idle.back();
+            m_idle.pop_back();
+            return S_OK;
+        }
+    }
+
+    return m_pBackend->CreateSession(ppSession);
+}
+
+//-------------------------------------------------------------------
+//  Release
+//-------------------------------------------------------------------
+
+void CSessionPool::Release(ITranscodeSession *pSession)
+{
+    if (pSession == NULL)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        if (m_idle.size() >= m_cMaxIdle)
+        {
+            delete pSession;
+            return;
+        }
+    }
+
+    HRESULT hr = pSession->Reset();
+
+    if (SUCCEEDED(hr))
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        try
+        {
+            if (m_idle.size() < m_cMaxIdle)
+            {
+                m_idle.push_back(pSession);
+                pSession = NULL;
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Deleted below.
+        }
+    }
+
+    SafeDelete(&pSession);
+}
+
+//-------------------------------------------------------------------
+//  Clear
+//-------------------------------------------------------------------
+
+void CSessionPool::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    for (size_t i = 0; i < m_idle.size(); i++)
+    {
+        delete m_idle[i];
+    }
+    m_idle.clear();
+}
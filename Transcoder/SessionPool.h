@@ -0,0 +1,58 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// SessionPool.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Idle transcode sessions kept between jobs. With the Media Foundation
+// backend, creating the media session and the transcode profile is a
+// fixed cost of every job, large next to the encode of a short clip; a
+// pooled session has its media session created ahead and keeps its
+// profile for the next job in the same format.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Backend.h"
+
+#include <mutex>
+#include <vector>
+
+class CSessionPool
+{
+public:
+    // pBackend: Creates the sessions. Not owned; it must outlive the
+    // pool, and the pool must be cleared before the backend shuts down.
+    // cMaxIdle: Sessions kept at most; the rest are deleted as they
+    // come back.
+    CSessionPool(IMediaBackend *pBackend, DWORD cMaxIdle);
+    ~CSessionPool();
+
+    // Creates sessions until cSessions are idle, so that the first
+    // jobs do not wait for them either.
+    HRESULT Reserve(DWORD cSessions);
+
+    // Takes the idle session returned last, or creates one if none is
+    // idle. The session returned last is the most likely to keep the
+    // profile the caller configures next.
+    HRESULT Acquire(ITranscodeSession **ppSession);
+
+    // Takes back a session that was shut down. It is reset for the next
+    // Acquire, or deleted if the pool is full or the reset fails.
+    void    Release(ITranscodeSession *pSession);
+
+    // Deletes the idle sessions.
+    void    Clear();
+
+private:
+
+    IMediaBackend*                      m_pBackend;
+    DWORD                               m_cMaxIdle;
+    std::mutex                          m_lock;
+    std::vector<ITranscodeSession*>     m_idle;
+};
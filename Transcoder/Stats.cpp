@@ -0,0 +1,214 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Stats.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Stats.h"
+
+#include <errno.h>
+
+#ifdef _WIN32
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+static const char *phase_names[Phase_Count] =
+{
+    "open",
+    "configure",
+    "topology",
+    "start",
+    "encode",
+    "finalize",
+};
+
+const char* GetPhaseName(TranscodePhase phase)
+{
+    return (phase >= 0 && phase < Phase_Count) ? phase_names[phase] : "unknown";
+}
+
+UINT64 GetPeakMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    {
+        return 0;
+    }
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    return (UINT64)usage.ru_maxrss * 1024;     // Kilobytes on Linux
+#endif
+}
+
+//-------------------------------------------------------------------
+//  AppendJsonString
+//
+//  Appends sValue as a quoted JSON string in UTF-8.
+//-------------------------------------------------------------------
+
+static void AppendJsonString(std::string &record, const WCHAR *sValue)
+{
+    char szValue[MAX_PATH * 4];
+
+    if (!sValue || WideToNarrow(sValue, szValue, sizeof(szValue)) < 0)
+    {
+        szValue[0] = '\0';
+    }
+
+    record += '"';
+
+    for (const char *p = szValue; *p; p++)
+    {
+        char szEscape[8];
+
+        switch (*p)
+        {
+        case '"':   record += "\\\"";   break;
+        case '\\':  record += "\\\\";   break;
+        case '\n':  record += "\\n";    break;
+        case '\r':  record += "\\r";    break;
+        case '\t':  record += "\\t";    break;
+        default:
+            if ((unsigned char)*p < 0x20)
+            {
+                snprintf(szEscape, sizeof(szEscape), "\\u%04x", (unsigned char)*p);
+                record += szEscape;
+            }
+            else
+            {
+                record += *p;
+            }
+            break;
+        }
+    }
+
+    record += '"';
+}
+
+//-------------------------------------------------------------------
+//  CStatsLog
+//-------------------------------------------------------------------
+
+CStatsLog::CStatsLog() : m_pFile(NULL)
+{
+
+}
+
+CStatsLog::~CStatsLog()
+{
+    Close();
+}
+
+HRESULT CStatsLog::Open(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    Close();
+
+    m_pFile = OpenFileW(sPath, "ab");
+
+    return m_pFile ? S_OK : HRESULT_FROM_ERRNO(errno);
+}
+
+void CStatsLog::Close()
+{
+    if (m_pFile)
+    {
+        fclose(m_pFile);
+        m_pFile = NULL;
+    }
+}
+
+HRESULT CStatsLog::Write(const WCHAR *sInput, const WCHAR *sOutput, const WCHAR *sFormat,
+    HRESULT hr, const TranscodeStats &stats)
+{
+    char szField[128];
+    std::string record;
+
+    record += "{\"input\":";
+    AppendJsonString(record, sInput);
+    record += ",\"output\":";
+    AppendJsonString(record, sOutput);
+    record += ",\"format\":";
+    AppendJsonString(record, sFormat);
+
+    snprintf(szField, sizeof(szField), ",\"hr\":\"0x%08X\"", (unsigned int)hr);
+    record += szField;
+
+    for (int i = 0; i < Phase_Count; i++)
+    {
+        snprintf(szField, sizeof(szField), ",\"%s_s\":%.6f",
+            GetPhaseName((TranscodePhase)i), stats.phaseSeconds[i]);
+        record += szField;
+    }
+
+    double mediaSeconds = stats.hnsMedia / 10000000.0;
+
+    snprintf(szField, sizeof(szField), ",\"wall_s\":%.6f,\"bytes_in\":%llu,\"bytes_out\":%llu",
+        stats.wallSeconds, (unsigned long long)stats.cbInput, (unsigned long long)stats.cbOutput);
+    record += szField;
+
+    snprintf(szField, sizeof(szField), ",\"media_s\":%.3f,\"realtime_factor\":%.3f,\"peak_memory_bytes\":%llu",
+        mediaSeconds, stats.wallSeconds > 0 ? mediaSeconds / stats.wallSeconds : 0.0,
+        (unsigned long long)stats.cbPeakMemory);
+    record += szField;
+
+    snprintf(szField, sizeof(szField), ",\"max_stall_s\":%.3f}\n", stats.maxStallSeconds);
+    record += szField;
+
+    return Append(record);
+}
+
+HRESULT CStatsLog::WriteProgress(const WCHAR *sInput, const WCHAR *sOutput, const TranscodeProgress &progress)
+{
+    char szField[192];
+    std::string record;
+
+    record += "{\"event\":\"progress\",\"input\":";
+    AppendJsonString(record, sInput);
+    record += ",\"output\":";
+    AppendJsonString(record, sOutput);
+
+    snprintf(szField, sizeof(szField),
+        ",\"position_s\":%.3f,\"duration_s\":%.3f,\"elapsed_s\":%.3f,\"realtime_factor\":%.3f,"
+        "\"eta_s\":%.3f,\"stalled_s\":%.3f}\n",
+        progress.hnsPosition / 10000000.0, progress.hnsDuration / 10000000.0, progress.elapsedSeconds,
+        progress.realtimeFactor, progress.etaSeconds, progress.stalledSeconds);
+    record += szField;
+
+    return Append(record);
+}
+
+HRESULT CStatsLog::Append(const std::string &record)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (fwrite(record.data(), 1, record.size(), m_pFile) != record.size() || fflush(m_pFile) != 0)
+    {
+        return HRESULT_FROM_ERRNO(errno);
+    }
+    return S_OK;
+}
@@ -0,0 +1,105 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Stats.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Per-job instrumentation. CTranscoder times each phase of a job and
+// counts the bytes it reads and writes; CStatsLog appends one JSON
+// record per job to a file (JSON Lines), for tracking the real-time
+// factor across machines and releases. While a job runs, its progress
+// can be appended to the same file as records with "event":"progress".
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+#include <mutex>
+#include <string>
+
+// Phases of a job, in the order they run.
+enum TranscodePhase
+{
+    Phase_Open,         // OpenFile: session and media source.
+    Phase_Configure,    // Audio, video and container profile.
+    Phase_Topology,     // SetOutput until the topology is set.
+    Phase_Start,        // Topology set until the session has started.
+    Phase_Encode,       // Started until the end of the source.
+    Phase_Finalize,     // Close until the output is finalized.
+    Phase_Count,
+};
+
+struct TranscodeStats
+{
+    double      phaseSeconds[Phase_Count];
+    double      wallSeconds;        // Sum of the phases.
+    UINT64      cbInput;            // Size of the input file.
+    UINT64      cbOutput;           // Size of the output files.
+    LONGLONG    hnsMedia;           // Length of the encoded range; 0 if unknown.
+    UINT64      cbPeakMemory;       // Peak resident memory of the process.
+    double      maxStallSeconds;    // Longest wait for the position to move; 0 without progress polling.
+};
+
+// Progress of a running job, from its session's presentation time.
+struct TranscodeProgress
+{
+    LONGLONG    hnsPosition;        // Encoded so far, from the start of the range.
+    LONGLONG    hnsDuration;        // Length of the range; 0 if unknown.
+    double      elapsedSeconds;     // Since the session started.
+    double      realtimeFactor;     // Media seconds per wall second since the previous report.
+    double      etaSeconds;         // Time left at the average rate so far; -1 if unknown.
+    double      stalledSeconds;     // Time since the position last moved.
+};
+
+// Returns the name of a phase as used in the JSON record, e.g. "open".
+const char* GetPhaseName(TranscodePhase phase);
+
+// Peak resident set (working set on Windows) of the process so far,
+// in bytes, or 0 if it cannot be read.
+UINT64 GetPeakMemoryUsage();
+
+//-------------------------------------------------------------------
+//  CStatsLog
+//
+//  Appends job records to a file. Write may be called from any
+//  thread; records are never interleaved.
+//-------------------------------------------------------------------
+
+class CStatsLog
+{
+public:
+    CStatsLog();
+    ~CStatsLog();
+
+    HRESULT Open(const WCHAR *sPath);
+    void    Close();
+
+    // Appends one record:
+    //
+    //  {"input":"a.wav","output":"a.m4a","format":"mp4","hr":"0x00000000",
+    //   "open_s":0.001,...,"wall_s":1.2,"bytes_in":...,"bytes_out":...,
+    //   "media_s":60.0,"realtime_factor":50.0,"peak_memory_bytes":...,
+    //   "max_stall_s":0.0}
+    HRESULT Write(const WCHAR *sInput, const WCHAR *sOutput, const WCHAR *sFormat,
+        HRESULT hr, const TranscodeStats &stats);
+
+    // Appends one progress record:
+    //
+    //  {"event":"progress","input":"a.wav","output":"a.m4a","position_s":12.0,
+    //   "duration_s":60.0,"elapsed_s":0.3,"realtime_factor":41.2,"eta_s":1.2,
+    //   "stalled_s":0.0}
+    HRESULT WriteProgress(const WCHAR *sInput, const WCHAR *sOutput, const TranscodeProgress &progress);
+
+private:
+
+    HRESULT Append(const std::string &record);
+
+    FILE*       m_pFile;
+    std::mutex  m_lock;
+};
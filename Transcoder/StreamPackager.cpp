@@ -0,0 +1,430 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// StreamPackager.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "StreamPackager.h"
+#include "OutputFile.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <wchar.h>
+
+//-------------------------------------------------------------------
+//  Manifest text
+//-------------------------------------------------------------------
+
+static void AppendText(std::vector<char> *pText, const char *sFormat, ...)
+{
+    char szLine[1024];
+
+    va_list args;
+    va_start(args, sFormat);
+    int cch = vsnprintf(szLine, sizeof(szLine), sFormat, args);
+    va_end(args);
+
+    if (cch > 0)
+    {
+        pText->insert(pText->end(), szLine, szLine + (cch < (int)sizeof(szLine) ? cch : (int)sizeof(szLine) - 1));
+    }
+}
+
+static void FormatUtcTime(time_t t, char *szTime, size_t cchTime)
+{
+    struct tm utc;
+
+#ifdef _WIN32
+    gmtime_s(&utc, &t);
+#else
+    gmtime_r(&t, &utc);
+#endif
+
+    strftime(szTime, cchTime, "%Y-%m-%dT%H:%M:%SZ", &utc);
+}
+
+// Writes a whole file, the data after the header.
+static HRESULT WriteWholeFile(const WCHAR *sPath, const BYTE *pHeader, DWORD cbHeader, const BYTE *pData, DWORD cbData)
+{
+    COutputFile file;
+
+    HRESULT hr = file.Create(sPath, (UINT64)cbHeader + cbData);
+
+    if (SUCCEEDED(hr) && cbHeader)
+    {
+        hr = file.Write(pHeader, cbHeader);
+    }
+
+    if (SUCCEEDED(hr) && cbData)
+    {
+        hr = file.Write(pData, cbData);
+    }
+
+    HRESULT hrClose = file.Close();
+
+    return SUCCEEDED(hr) ? hrClose : hr;
+}
+
+//-------------------------------------------------------------------
+//  CStreamPackager
+//-------------------------------------------------------------------
+
+CStreamPackager::CStreamPackager() :
+    m_fOpen(FALSE),
+    m_type(Manifest_HLS),
+    m_tStart(0),
+    m_cSegmentSamples(0),
+    m_cSegments(0),
+    m_cLastSamples(0),
+    m_maxBitrate(0)
+{
+    memset(&m_format, 0, sizeof(m_format));
+    m_szManifest[0] = L'\0';
+    m_szBase[0] = L'\0';
+    m_szName[0] = '\0';
+}
+
+CStreamPackager::~CStreamPackager()
+{
+
+}
+
+HRESULT CStreamPackager::Create(const WCHAR *sManifest, ManifestType type, const Mp4AudioFormat &format, LONGLONG hnsSegment)
+{
+    if (!sManifest)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_fOpen)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    // Segments are files of their own, next to the manifest.
+    if (IsStdStreamPath(sManifest))
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (format.sampleRate == 0 || format.samplesPerFrame == 0 || format.cbConfig > sizeof(format.config) ||
+        hnsSegment <= 0)
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    size_t iName, cchBase;
+    SplitPathName(sManifest, &iName, &cchBase);
+
+    WCHAR szName[MAX_PATH];
+
+    if (wcscpy_s(m_szManifest, MAX_PATH, sManifest) != 0 ||
+        swprintf_s(m_szBase, MAX_PATH, L"%.*ls", (int)cchBase, sManifest) < 0 ||
+        swprintf_s(szName, MAX_PATH, L"%.*ls", (int)(cchBase - iName), sManifest + iName) < 0 ||
+        WideToNarrow(szName, m_szName, sizeof(m_szName)) < 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    m_type = type;
+    m_format = format;
+    m_tStart = time(NULL);
+    m_cSegmentSamples = Mp4FragmentSamples(format, hnsSegment);
+    m_cSegments = 0;
+    m_cLastSamples = 0;
+    m_maxBitrate = 0;
+    m_sizes.clear();
+    m_data.clear();
+
+    std::vector<BYTE> init;
+    WCHAR szInit[MAX_PATH];
+
+    HRESULT hr = FormatMp4InitSegment(m_format, &init);
+
+    if (SUCCEEDED(hr) && swprintf_s(szInit, MAX_PATH, L"%ls_init.mp4", m_szBase) < 0)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WriteWholeFile(szInit, &init[0], (DWORD)init.size(), NULL, 0);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WriteManifest(FALSE);
+    }
+
+    m_fOpen = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT CStreamPackager::WriteSample(const BYTE *pData, DWORD cbData)
+{
+    if (!m_fOpen)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    try
+    {
+        m_sizes.push_back(cbData);
+        m_data.insert(m_data.end(), pData, pData + cbData);
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    if (m_sizes.size() >= m_cSegmentSamples)
+    {
+        return WriteSegment();
+    }
+    return S_OK;
+}
+
+HRESULT CStreamPackager::Finalize()
+{
+    if (!m_fOpen)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = WriteSegment();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WriteManifest(TRUE);
+    }
+
+    m_fOpen = FALSE;
+    return hr;
+}
+
+HRESULT CStreamPackager::GetSegmentPath(UINT32 iSegment, WCHAR *szPath, size_t cchPath) const
+{
+    return swprintf_s(szPath, cchPath, L"%ls_%u.m4s", m_szBase, iSegment) < 0 ?
+        HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE) : S_OK;
+}
+
+//-------------------------------------------------------------------
+//  WriteSegment
+//
+//  Writes the pending samples as the next segment, one fragment whose
+//  sequence number is the segment number, then the manifest that
+//  lists it.
+//-------------------------------------------------------------------
+
+HRESULT CStreamPackager::WriteSegment()
+{
+    const UINT32 cSamples = (UINT32)m_sizes.size();
+
+    if (cSamples == 0)
+    {
+        return S_OK;
+    }
+
+    const UINT32 iSegment = m_cSegments + 1;
+    const UINT64 decodeTime = (UINT64)m_cSegments * m_cSegmentSamples * m_format.samplesPerFrame;
+
+    std::vector<BYTE> header;
+    WCHAR szPath[MAX_PATH];
+
+    HRESULT hr = FormatMp4Fragment(iSegment, decodeTime, m_sizes, &header);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = GetSegmentPath(iSegment, szPath, MAX_PATH);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WriteWholeFile(szPath, &header[0], (DWORD)header.size(),
+            m_data.empty() ? NULL : &m_data[0], (DWORD)m_data.size());
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        UINT64 bits = (UINT64)(header.size() + m_data.size()) * 8;
+        UINT64 bitrate = bits * m_format.sampleRate / ((UINT64)cSamples * m_format.samplesPerFrame);
+
+        m_maxBitrate = bitrate > m_maxBitrate ? bitrate : m_maxBitrate;
+        m_cSegments = iSegment;
+        m_cLastSamples = cSamples;
+        m_sizes.clear();
+        m_data.clear();
+
+        hr = WriteManifest(FALSE);
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  WriteManifest
+//-------------------------------------------------------------------
+
+HRESULT CStreamPackager::WriteManifest(BOOL fFinal)
+{
+    std::vector<char> text;
+    WCHAR szTemp[MAX_PATH];
+
+    HRESULT hr = (m_type == Manifest_HLS) ? FormatPlaylist(fFinal, &text) : FormatMpd(fFinal, &text);
+
+    if (SUCCEEDED(hr) && swprintf_s(szTemp, MAX_PATH, L"%ls.tmp", m_szManifest) < 0)
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WriteWholeFile(szTemp, NULL, 0, (const BYTE*)&text[0], (DWORD)text.size());
+    }
+
+    if (SUCCEEDED(hr) && !RenameFile(szTemp, m_szManifest))
+    {
+        (void)RemoveFile(szTemp);
+        hr = E_FAIL;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  FormatPlaylist
+//
+//  HLS media playlist, version 7 for fragmented MP4 segments. Every
+//  segment but the last has the same duration.
+//-------------------------------------------------------------------
+
+HRESULT CStreamPackager::FormatPlaylist(BOOL fFinal, std::vector<char> *pText) const
+{
+    const UINT64 segmentDuration = (UINT64)m_cSegmentSamples * m_format.samplesPerFrame;
+
+    try
+    {
+        pText->reserve(256 + (size_t)m_cSegments * 64);
+
+        AppendText(pText, "#EXTM3U\n");
+        AppendText(pText, "#EXT-X-VERSION:7\n");
+        // Segment durations rounded to the nearest second may not
+        // exceed the target duration.
+        UINT64 targetDuration = (segmentDuration + m_format.sampleRate / 2) / m_format.sampleRate;
+
+        AppendText(pText, "#EXT-X-TARGETDURATION:%u\n", (UINT32)(targetDuration ? targetDuration : 1));
+        AppendText(pText, "#EXT-X-MEDIA-SEQUENCE:1\n");
+        AppendText(pText, "#EXT-X-PLAYLIST-TYPE:EVENT\n");
+        AppendText(pText, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+        AppendText(pText, "#EXT-X-MAP:URI=\"%s_init.mp4\"\n", m_szName);
+
+        for (UINT32 i = 1; i <= m_cSegments; i++)
+        {
+            UINT64 duration = (i == m_cSegments) ? (UINT64)m_cLastSamples * m_format.samplesPerFrame : segmentDuration;
+
+            AppendText(pText, "#EXTINF:%.6f,\n", (double)duration / m_format.sampleRate);
+            AppendText(pText, "%s_%u.m4s\n", m_szName, i);
+        }
+
+        if (fFinal)
+        {
+            AppendText(pText, "#EXT-X-ENDLIST\n");
+        }
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  FormatMpd
+//
+//  DASH MPD with one audio representation. The segment timeline is run
+//  length encoded, so the MPD stays the same size however many
+//  segments there are.
+//-------------------------------------------------------------------
+
+HRESULT CStreamPackager::FormatMpd(BOOL fFinal, std::vector<char> *pText) const
+{
+    const UINT64 segmentDuration = (UINT64)m_cSegmentSamples * m_format.samplesPerFrame;
+    const double segmentSeconds = (double)segmentDuration / m_format.sampleRate;
+    const BOOL fPartial = m_cSegments > 0 && m_cLastSamples != m_cSegmentSamples;
+    const UINT32 cFull = fPartial ? m_cSegments - 1 : m_cSegments;
+    const UINT64 lastDuration = (UINT64)m_cLastSamples * m_format.samplesPerFrame;
+    const UINT64 totalDuration = cFull * segmentDuration + (fPartial ? lastDuration : 0);
+
+    char szCodecs[16];
+
+    if (m_format.codec == AudioCodec_AAC)
+    {
+        snprintf(szCodecs, sizeof(szCodecs), "mp4a.40.%u", (UINT32)(m_format.config[0] >> 3));
+    }
+    else
+    {
+        snprintf(szCodecs, sizeof(szCodecs), "mp4a.%02X", m_format.objectType);
+    }
+
+    try
+    {
+        pText->reserve(2048);
+
+        AppendText(pText, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+        AppendText(pText, "<MPD xmlns=\"urn:mpeg:dash:schema:mpd:2011\" profiles=\"urn:mpeg:dash:profile:isoff-live:2011,urn:mpeg:dash:profile:cmaf:2019\"\n");
+
+        if (fFinal)
+        {
+            AppendText(pText, "     type=\"static\" mediaPresentationDuration=\"PT%.3fS\" minBufferTime=\"PT%.3fS\">\n",
+                (double)totalDuration / m_format.sampleRate, segmentSeconds);
+        }
+        else
+        {
+            char szStart[32];
+            char szNow[32];
+
+            FormatUtcTime(m_tStart, szStart, sizeof(szStart));
+            FormatUtcTime(time(NULL), szNow, sizeof(szNow));
+
+            AppendText(pText, "     type=\"dynamic\" availabilityStartTime=\"%s\" publishTime=\"%s\"\n", szStart, szNow);
+            AppendText(pText, "     minimumUpdatePeriod=\"PT%.3fS\" minBufferTime=\"PT%.3fS\">\n", segmentSeconds, segmentSeconds);
+        }
+
+        AppendText(pText, "  <Period id=\"0\" start=\"PT0S\">\n");
+        AppendText(pText, "    <AdaptationSet contentType=\"audio\" mimeType=\"audio/mp4\" segmentAlignment=\"true\" startWithSAP=\"1\">\n");
+        AppendText(pText, "      <Representation id=\"audio\" codecs=\"%s\" bandwidth=\"%u\" audioSamplingRate=\"%u\">\n",
+            szCodecs, (UINT32)(m_maxBitrate > 0xFFFFFFFF ? 0xFFFFFFFF : m_maxBitrate), m_format.sampleRate);
+        AppendText(pText, "        <AudioChannelConfiguration schemeIdUri=\"urn:mpeg:dash:23003:3:audio_channel_configuration:2011\" value=\"%u\"/>\n",
+            m_format.channels);
+        AppendText(pText, "        <SegmentTemplate timescale=\"%u\" initialization=\"%s_init.mp4\" media=\"%s_$Number$.m4s\" startNumber=\"1\">\n",
+            m_format.sampleRate, m_szName, m_szName);
+        AppendText(pText, "          <SegmentTimeline>\n");
+
+        if (cFull > 0)
+        {
+            AppendText(pText, "            <S t=\"0\" d=\"%llu\" r=\"%u\"/>\n", (unsigned long long)segmentDuration, cFull - 1);
+        }
+
+        if (fPartial)
+        {
+            AppendText(pText, "            <S t=\"%llu\" d=\"%llu\"/>\n",
+                (unsigned long long)(cFull * segmentDuration), (unsigned long long)lastDuration);
+        }
+
+        AppendText(pText, "          </SegmentTimeline>\n");
+        AppendText(pText, "        </SegmentTemplate>\n");
+        AppendText(pText, "      </Representation>\n");
+        AppendText(pText, "    </AdaptationSet>\n");
+        AppendText(pText, "  </Period>\n");
+        AppendText(pText, "</MPD>\n");
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
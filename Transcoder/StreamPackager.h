@@ -0,0 +1,92 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// StreamPackager.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// HLS and DASH packaging for the portable backend: CMAF segment files
+// and their playlist or manifest, written as the job runs.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "Mp4File.h"
+
+#include <time.h>
+#include <vector>
+
+enum ManifestType
+{
+    Manifest_HLS,               // Media playlist (.m3u8)
+    Manifest_DASH,              // MPD (.mpd)
+};
+
+//-------------------------------------------------------------------
+//  CStreamPackager
+//
+//  Cuts one audio track into segments of a fixed number of samples;
+//  every audio frame is a sync sample, so any frame can start one. For
+//  a manifest at dir/name.m3u8 (or .mpd) the segments are
+//
+//      dir/name_init.mp4       CMAF header: ftyp and moov
+//      dir/name_1.m4s, ...     One moof and mdat each
+//
+//  The manifest is rewritten after every segment, through a temporary
+//  file so that a player never reads half of it: a player can start as
+//  soon as the first segment is out, long before the job ends. While
+//  the job runs, the HLS playlist is an EVENT playlist and the MPD is
+//  dynamic; Finalize ends the playlist and makes the MPD static.
+//-------------------------------------------------------------------
+
+class CStreamPackager
+{
+public:
+    CStreamPackager();
+    ~CStreamPackager();
+
+    // Writes the init segment and the empty manifest. hnsSegment is the
+    // duration of every segment but the last, rounded up to whole
+    // samples.
+    HRESULT Create(const WCHAR *sManifest, ManifestType type, const Mp4AudioFormat &format, LONGLONG hnsSegment = MP4_FRAGMENT_DURATION);
+
+    // Appends one access unit or MP3 frame, writing the segment once it
+    // is complete.
+    HRESULT WriteSample(const BYTE *pData, DWORD cbData);
+
+    // Writes the last segment and the final manifest.
+    HRESULT Finalize();
+
+    BOOL    IsOpen() const { return m_fOpen; }
+
+    // Stops without finishing the manifest. The segments already
+    // written are kept.
+    void    Close() { m_fOpen = FALSE; }
+
+private:
+
+    HRESULT WriteSegment();
+    HRESULT WriteManifest(BOOL fFinal);
+    HRESULT FormatPlaylist(BOOL fFinal, std::vector<char> *pText) const;
+    HRESULT FormatMpd(BOOL fFinal, std::vector<char> *pText) const;
+    HRESULT GetSegmentPath(UINT32 iSegment, WCHAR *szPath, size_t cchPath) const;
+
+    BOOL                    m_fOpen;
+    ManifestType            m_type;
+    Mp4AudioFormat          m_format;
+    WCHAR                   m_szManifest[MAX_PATH];
+    WCHAR                   m_szBase[MAX_PATH];     // Manifest path without extension
+    char                    m_szName[MAX_PATH * 4]; // Its file name, for segment URIs
+    time_t                  m_tStart;               // DASH availabilityStartTime
+    UINT32                  m_cSegmentSamples;      // Samples per segment
+    UINT32                  m_cSegments;            // Segments written
+    UINT32                  m_cLastSamples;         // Samples in the last one written
+    UINT64                  m_maxBitrate;           // Of any segment so far
+    std::vector<UINT32>     m_sizes;                // Of the pending segment
+    std::vector<BYTE>       m_data;                 // Pending samples
+};
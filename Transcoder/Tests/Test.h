@@ -0,0 +1,101 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Test.h - Checks shared by the test programs.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Each test program is a list of test functions run by TEST_RUN. A
+// failed check prints its file, line and expression and marks the
+// program failed; the test carries on, so that one run reports every
+// failure. The exit code is what ctest reads: 0 if every check passed.
+//
+// Everything is printed with wprintf_s, as the library prints its
+// messages, since a stream takes the width of its first output.
+//
+// TEST_DATA_DIR, the directory of the fixtures, is set by the build.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+#include <stdio.h>
+#include <vector>
+
+#ifndef TEST_DATA_DIR
+#define TEST_DATA_DIR   "Tests/Data"
+#endif
+
+// Path of a fixture, as a wide string literal.
+#define TEST_DATA(name) L"" TEST_DATA_DIR L"/" name
+
+inline int& TestFailures()
+{
+    static int cFailures = 0;
+    return cFailures;
+}
+
+inline bool TestCheck(bool fOk, const char *sExpr, const char *sFile, int line)
+{
+    if (!fOk)
+    {
+        wprintf_s(L"%hs(%d): check failed: %hs\n", sFile, line, sExpr);
+        TestFailures()++;
+    }
+    return fOk;
+}
+
+inline bool TestCheckHr(HRESULT hr, const char *sExpr, const char *sFile, int line)
+{
+    if (FAILED(hr))
+    {
+        wprintf_s(L"%hs(%d): %hs failed (0x%X)\n", sFile, line, sExpr, hr);
+        TestFailures()++;
+    }
+    return SUCCEEDED(hr);
+}
+
+// Both return the result of the check, so that a test can stop when
+// what follows depends on it.
+#define CHECK(expr)     TestCheck(!!(expr), #expr, __FILE__, __LINE__)
+#define CHECK_HR(expr)  TestCheckHr((expr), #expr, __FILE__, __LINE__)
+
+// Runs a test function and reports it.
+#define TEST_RUN(fn) \
+    do \
+    { \
+        int cBefore = TestFailures(); \
+        fn(); \
+        wprintf_s(L"%ls %hs\n", TestFailures() == cBefore ? L"PASS" : L"FAIL", #fn); \
+    } \
+    while (0)
+
+#define TEST_RESULT()   (TestFailures() == 0 ? 0 : 1)
+
+// Reads a whole fixture. Returns FALSE if it cannot be read.
+inline BOOL TestReadFile(const WCHAR *sPath, std::vector<BYTE> *pData)
+{
+    FILE *pFile = OpenFileW(sPath, "rb");
+    if (pFile == NULL)
+    {
+        return FALSE;
+    }
+
+    BYTE buffer[4096];
+    size_t cb = 0;
+
+    pData->clear();
+    while ((cb = fread(buffer, 1, sizeof(buffer), pFile)) > 0)
+    {
+        pData->insert(pData->end(), buffer, buffer + cb);
+    }
+
+    BOOL fOk = !ferror(pFile);
+    fclose(pFile);
+    return fOk;
+}
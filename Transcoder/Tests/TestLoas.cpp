@@ -0,0 +1,244 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TestLoas.cpp - Checks the LOAS reader and the ADTS framer against
+// fixtures.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// The fixtures in Tests/Data hold six AAC LC, 44.1 kHz stereo access
+// units with filler payloads of 200, 300, 255, 40, 520 and 128 bytes,
+// so that the payload lengths take zero, one and two 255 escapes:
+//
+//  Loas1.loas  audioMuxVersion 0, one subframe per LOAS frame, with a
+//              StreamMuxConfig in every other frame
+//  Loas1.aac   The ADTS frames it repacks to, one raw data block each
+//  Loas2.loas  audioMuxVersion 1, two subframes per LOAS frame, each a
+//              PayloadLengthInfo followed by its PayloadMux
+//  Loas2.aac   The ADTS frames it repacks to, two raw data blocks each
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Test.h"
+#include "Latm.h"
+#include "Pcm.h"
+
+#define LOAS_FRAMES             6
+#define LOAS_SAMPLE_RATE        44100
+
+// AudioSpecificConfig of the fixtures: AAC LC, 44.1 kHz, stereo.
+static const BYTE loas_config[] = { 0x12, 0x10 };
+
+//-------------------------------------------------------------------
+//  Repack
+//
+//  Reads every frame of pReader and appends it to pOutput.
+//-------------------------------------------------------------------
+
+static void Repack(CLoasReader *pReader, UINT32 cRawBlocks, std::vector<BYTE> *pOutput)
+{
+    const BYTE *pFrame = NULL;
+    DWORD cbFrame = 0;
+    AdtsHeader header;
+    UINT32 cFrames = 0;
+
+    while (CHECK_HR(pReader->ReadFrame(&pFrame, &cbFrame, &header)) && cbFrame > 0)
+    {
+        CHECK(header.sampleRate == LOAS_SAMPLE_RATE);
+        CHECK(header.channels == 2);
+        CHECK(header.cRawBlocks == cRawBlocks);
+        CHECK(header.cbFrame == cbFrame);
+
+        pOutput->insert(pOutput->end(), pFrame, pFrame + cbFrame);
+        cFrames++;
+    }
+
+    CHECK(cFrames * cRawBlocks == LOAS_FRAMES);
+    CHECK(pReader->Position() == (UINT64)LOAS_FRAMES * ADTS_SAMPLES_PER_FRAME);
+}
+
+//-------------------------------------------------------------------
+//  CheckFixture
+//
+//  Repacks sLoas, opened by path and from memory, and compares the
+//  frames to sExpected byte for byte.
+//-------------------------------------------------------------------
+
+static void CheckFixture(const WCHAR *sLoas, const WCHAR *sExpected, UINT32 cRawBlocks)
+{
+    std::vector<BYTE> loas;
+    std::vector<BYTE> expected;
+    std::vector<BYTE> output;
+
+    if (!CHECK(TestReadFile(sLoas, &loas)) || !CHECK(TestReadFile(sExpected, &expected)))
+    {
+        return;
+    }
+
+    CLoasReader reader;
+    LONGLONG hnsDuration = 0;
+
+    if (CHECK_HR(reader.Open(sLoas)))
+    {
+        CHECK(reader.Format().cRawBlocks == cRawBlocks);
+        CHECK(reader.StreamSize() == loas.size());
+
+        // The duration walk keeps the read position.
+        CHECK_HR(reader.GetDuration(&hnsDuration));
+        CHECK(hnsDuration == SamplesToHns(LOAS_FRAMES * ADTS_SAMPLES_PER_FRAME, LOAS_SAMPLE_RATE));
+        CHECK(reader.Position() == 0);
+
+        Repack(&reader, cRawBlocks, &output);
+        CHECK(output == expected);
+        reader.Close();
+    }
+
+    CMappedFile file;
+
+    output.clear();
+    if (CHECK_HR(file.Open(loas.data(), loas.size())) && CHECK_HR(reader.Open(&file)))
+    {
+        Repack(&reader, cRawBlocks, &output);
+        CHECK(output == expected);
+        reader.Close();
+    }
+}
+
+static void TestSingleSubFrame()
+{
+    CheckFixture(TEST_DATA("Loas1.loas"), TEST_DATA("Loas1.aac"), 1);
+}
+
+static void TestMultipleSubFrames()
+{
+    CheckFixture(TEST_DATA("Loas2.loas"), TEST_DATA("Loas2.aac"), 2);
+}
+
+//-------------------------------------------------------------------
+//  TestSeek
+//
+//  A seek lands on the LOAS frame that holds the time, even when that
+//  frame reuses the StreamMuxConfig of the one before it.
+//-------------------------------------------------------------------
+
+static void TestSeek()
+{
+    std::vector<BYTE> expected;
+    CLoasReader reader;
+
+    if (!CHECK(TestReadFile(TEST_DATA("Loas2.aac"), &expected)) ||
+        !CHECK_HR(reader.Open(TEST_DATA("Loas2.loas"))))
+    {
+        return;
+    }
+
+    // Into the second LOAS frame, samples 2048 to 4095.
+    const BYTE *pFrame = NULL;
+    DWORD cbFrame = 0;
+    AdtsHeader header;
+
+    CHECK_HR(reader.SeekToTime(SamplesToHns(3000, LOAS_SAMPLE_RATE)));
+    CHECK(reader.Position() == 2 * ADTS_SAMPLES_PER_FRAME);
+
+    if (CHECK_HR(reader.ReadFrame(&pFrame, &cbFrame, &header)) && CHECK(cbFrame > 0))
+    {
+        // The first expected frame is 7 + 200 + 300 bytes long.
+        const size_t cbFirst = ADTS_HEADER_SIZE + 200 + 300;
+
+        CHECK(expected.size() >= cbFirst + cbFrame);
+        CHECK(memcmp(pFrame, expected.data() + cbFirst, cbFrame) == 0);
+    }
+}
+
+//-------------------------------------------------------------------
+//  TestAdtsFramer
+//
+//  Wrapping the raw access units in the single-subframe fixture gives
+//  back its ADTS frames.
+//-------------------------------------------------------------------
+
+static void TestAdtsFramer()
+{
+    std::vector<BYTE> expected;
+    CAdtsFramer framer;
+
+    if (!CHECK(TestReadFile(TEST_DATA("Loas1.aac"), &expected)) ||
+        !CHECK_HR(framer.Initialize(loas_config, sizeof(loas_config))))
+    {
+        return;
+    }
+
+    CHECK(framer.Format().sampleRate == LOAS_SAMPLE_RATE);
+    CHECK(framer.Format().channels == 2);
+
+    std::vector<BYTE> output;
+    size_t cbOffset = 0;
+
+    while (cbOffset < expected.size())
+    {
+        AdtsHeader header;
+        const BYTE *pFrame = NULL;
+        DWORD cbFrame = 0;
+
+        if (!CHECK_HR(ParseAdtsHeader(expected.data() + cbOffset, (DWORD)(expected.size() - cbOffset), &header)) ||
+            !CHECK_HR(framer.Frame(expected.data() + cbOffset + header.cbHeader, header.cbFrame - header.cbHeader,
+                &pFrame, &cbFrame)))
+        {
+            return;
+        }
+
+        output.insert(output.end(), pFrame, pFrame + cbFrame);
+        cbOffset += header.cbFrame;
+    }
+
+    CHECK(output == expected);
+}
+
+//-------------------------------------------------------------------
+//  TestTruncated
+//
+//  A LOAS frame cut short fails the read instead of repacking bytes
+//  past the end.
+//-------------------------------------------------------------------
+
+static void TestTruncated()
+{
+    std::vector<BYTE> loas;
+
+    if (!CHECK(TestReadFile(TEST_DATA("Loas2.loas"), &loas)))
+    {
+        return;
+    }
+
+    // Keep the first LOAS frame whole and part of the second.
+    DWORD cbFirst = LOAS_HEADER_SIZE + (((loas[1] & 0x1F) << 8) | loas[2]);
+    loas.resize(cbFirst + (loas.size() - cbFirst) / 4);
+
+    CMappedFile file;
+    CLoasReader reader;
+    const BYTE *pFrame = NULL;
+    DWORD cbFrame = 0;
+    AdtsHeader header;
+
+    if (CHECK_HR(file.Open(loas.data(), loas.size())) && CHECK_HR(reader.Open(&file)))
+    {
+        CHECK_HR(reader.ReadFrame(&pFrame, &cbFrame, &header));
+        CHECK(cbFrame > 0);
+
+        HRESULT hr = reader.ReadFrame(&pFrame, &cbFrame, &header);
+        CHECK(FAILED(hr) || cbFrame == 0);
+    }
+}
+
+int main()
+{
+    TEST_RUN(TestSingleSubFrame);
+    TEST_RUN(TestMultipleSubFrames);
+    TEST_RUN(TestSeek);
+    TEST_RUN(TestAdtsFramer);
+    TEST_RUN(TestTruncated);
+    return TEST_RESULT();
+}
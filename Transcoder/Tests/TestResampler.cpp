@@ -0,0 +1,341 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TestResampler.cpp - Checks CResampler.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Checks the contract in Resampler.h: N input frames give
+// ceil(N * L / M) output frames, the output does not depend on how
+// the input is split into blocks or on the kernel set, and a tone
+// comes out at the new rate with its amplitude and phase, aligned
+// with the input.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Test.h"
+#include "Resampler.h"
+
+#include <math.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define TEST_TONE_HZ            1000
+#define TEST_TONE_AMPLITUDE     0.5
+
+// Largest error allowed on a resampled tone, away from the ends:
+// -80 dB relative to full scale.
+#define TEST_MAX_TONE_ERROR     1e-4
+
+struct RatePair
+{
+    UINT32  inRate;
+    UINT32  outRate;
+};
+
+static const RatePair test_rates[] =
+{
+    { 44100, 48000 },
+    { 48000, 44100 },
+    { 22050, 44100 },
+    { 48000, 16000 },
+    { 8000,  11025 },
+};
+
+//-------------------------------------------------------------------
+//  Helpers
+//-------------------------------------------------------------------
+
+static UINT32 Gcd(UINT32 a, UINT32 b)
+{
+    while (b != 0)
+    {
+        UINT32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// ceil(cInFrames * outRate / inRate), with the ratio reduced as the
+// resampler reduces it.
+static UINT64 ExpectedFrames(UINT64 cInFrames, UINT32 inRate, UINT32 outRate)
+{
+    UINT32 g = Gcd(inRate, outRate);
+    UINT64 L = outRate / g;
+    UINT64 M = inRate / g;
+
+    return (cInFrames * L + M - 1) / M;
+}
+
+// A tone of frequency hz on every channel, with a phase offset per
+// channel so that crossed channels would show.
+static void MakeTone(UINT32 sampleRate, UINT32 channels, UINT32 cFrames, std::vector<float> *pSamples)
+{
+    pSamples->resize((size_t)cFrames * channels);
+
+    for (UINT32 i = 0; i < cFrames; i++)
+    {
+        for (UINT32 c = 0; c < channels; c++)
+        {
+            (*pSamples)[(size_t)i * channels + c] =
+                (float)(TEST_TONE_AMPLITUDE * sin(2 * M_PI * TEST_TONE_HZ * i / sampleRate + c));
+        }
+    }
+}
+
+// Resamples input in blocks of cBlock frames, then drains. Returns
+// the first failure.
+static HRESULT Resample(
+    UINT32 inRate,
+    UINT32 outRate,
+    UINT32 channels,
+    const std::vector<float> &input,
+    UINT32 cBlock,
+    const PcmKernels *pKernels,
+    std::vector<float> *pOutput
+    )
+{
+    CResampler resampler;
+    HRESULT hr = resampler.Initialize(inRate, outRate, channels, pKernels);
+
+    std::vector<float> block;
+    UINT32 cInFrames = (UINT32)(input.size() / channels);
+
+    pOutput->clear();
+
+    try
+    {
+        block.resize((size_t)resampler.MaxOutputFrames(cBlock) * channels);
+    }
+    catch (const std::exception&)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    for (UINT32 i = 0; i < cInFrames && SUCCEEDED(hr); i += cBlock)
+    {
+        UINT32 cIn = (cInFrames - i < cBlock) ? cInFrames - i : cBlock;
+        UINT32 cOut = 0;
+
+        hr = resampler.Process(&input[(size_t)i * channels], cIn, &block[0], (UINT32)(block.size() / channels), &cOut);
+
+        if (SUCCEEDED(hr))
+        {
+            pOutput->insert(pOutput->end(), block.begin(), block.begin() + (size_t)cOut * channels);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        UINT32 cOut = 0;
+
+        hr = resampler.Drain(&block[0], (UINT32)(block.size() / channels), &cOut);
+
+        if (SUCCEEDED(hr))
+        {
+            pOutput->insert(pOutput->end(), block.begin(), block.begin() + (size_t)cOut * channels);
+        }
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  TestOutputLength
+//
+//  N input frames give ceil(N * L / M) output frames, whatever N.
+//-------------------------------------------------------------------
+
+static void TestOutputLength()
+{
+    static const UINT32 frame_counts[] = { 1, 2, 146, 147, 148, 1000, 4096, 4097, 44100 + 7 };
+
+    for (size_t r = 0; r < ARRAYSIZE(test_rates); r++)
+    {
+        for (size_t n = 0; n < ARRAYSIZE(frame_counts); n++)
+        {
+            const RatePair &rates = test_rates[r];
+            std::vector<float> input((size_t)frame_counts[n] * 2, 0.25f);
+            std::vector<float> output;
+
+            if (CHECK_HR(Resample(rates.inRate, rates.outRate, 2, input, 4096, NULL, &output)) &&
+                !CHECK(output.size() / 2 == ExpectedFrames(frame_counts[n], rates.inRate, rates.outRate)))
+            {
+                wprintf_s(L"  %u -> %u Hz, %u frames: %u output frames\n",
+                    rates.inRate, rates.outRate, frame_counts[n], (UINT32)(output.size() / 2));
+            }
+        }
+    }
+
+    // A stream with no input gives no output.
+    CResampler resampler;
+    float out[RESAMPLER_TAPS * 2];
+    UINT32 cOut = 1;
+
+    if (CHECK_HR(resampler.Initialize(44100, 48000, 1)) && CHECK(resampler.MaxOutputFrames(0) <= ARRAYSIZE(out)))
+    {
+        CHECK_HR(resampler.Drain(out, ARRAYSIZE(out), &cOut));
+        CHECK(cOut == 0);
+    }
+}
+
+//-------------------------------------------------------------------
+//  TestToneError
+//
+//  A 1 kHz tone resampled between 44.1 and 48 kHz, among others, is
+//  the same tone sampled at the output rate, to within -80 dB, away
+//  from the edges where the filter sees the silence around the input.
+//-------------------------------------------------------------------
+
+static void TestToneError()
+{
+    for (size_t r = 0; r < ARRAYSIZE(test_rates); r++)
+    {
+        const RatePair &rates = test_rates[r];
+        const UINT32 channels = 2;
+        std::vector<float> input;
+        std::vector<float> output;
+
+        MakeTone(rates.inRate, channels, rates.inRate / 2, &input);
+
+        if (!CHECK_HR(Resample(rates.inRate, rates.outRate, channels, input, 4096, NULL, &output)))
+        {
+            continue;
+        }
+
+        UINT32 cOutFrames = (UINT32)(output.size() / channels);
+        UINT32 cEdge = RESAMPLER_TAPS * rates.outRate / rates.inRate + 1;
+        double maxError = 0;
+
+        for (UINT32 i = cEdge; i + cEdge < cOutFrames; i++)
+        {
+            for (UINT32 c = 0; c < channels; c++)
+            {
+                double expected = TEST_TONE_AMPLITUDE * sin(2 * M_PI * TEST_TONE_HZ * i / rates.outRate + c);
+                double error = fabs(output[(size_t)i * channels + c] - expected);
+
+                maxError = error > maxError ? error : maxError;
+            }
+        }
+
+        if (!CHECK(cOutFrames > 2 * cEdge) || !CHECK(maxError < TEST_MAX_TONE_ERROR))
+        {
+            wprintf_s(L"  %u -> %u Hz: largest error %g\n", rates.inRate, rates.outRate, maxError);
+        }
+    }
+}
+
+//-------------------------------------------------------------------
+//  TestBlockSizes
+//
+//  Any split of the input into blocks gives the same output, bit for
+//  bit, as does every kernel set.
+//-------------------------------------------------------------------
+
+static void TestBlockSizes()
+{
+    static const UINT32 block_sizes[] = { 1, 7, 147, 160, 1000, RESAMPLER_BLOCK_FRAMES, RESAMPLER_BLOCK_FRAMES + 1, 20000 };
+
+    for (size_t r = 0; r < 2; r++)
+    {
+        const RatePair &rates = test_rates[r];
+        const UINT32 channels = 2;
+        std::vector<float> input;
+        std::vector<float> reference;
+
+        MakeTone(rates.inRate, channels, 12345, &input);
+
+        if (!CHECK_HR(Resample(rates.inRate, rates.outRate, channels, input, (UINT32)input.size(),
+            GetPcmKernelSet(0), &reference)))
+        {
+            continue;
+        }
+
+        for (size_t b = 0; b < ARRAYSIZE(block_sizes); b++)
+        {
+            std::vector<float> output;
+
+            if (CHECK_HR(Resample(rates.inRate, rates.outRate, channels, input, block_sizes[b], GetPcmKernelSet(0), &output)) &&
+                !CHECK(output == reference))
+            {
+                wprintf_s(L"  %u -> %u Hz, blocks of %u frames\n", rates.inRate, rates.outRate, block_sizes[b]);
+            }
+        }
+
+        for (UINT32 k = 1; k < GetPcmKernelSetCount(); k++)
+        {
+            std::vector<float> output;
+
+            if (CHECK_HR(Resample(rates.inRate, rates.outRate, channels, input, 1000, GetPcmKernelSet(k), &output)) &&
+                !CHECK(output == reference))
+            {
+                wprintf_s(L"  %u -> %u Hz, kernel set %hs\n", rates.inRate, rates.outRate, GetPcmKernelSet(k)->sName);
+            }
+        }
+    }
+}
+
+//-------------------------------------------------------------------
+//  TestRestart
+//
+//  Drain starts a new stream: a second stream gives the same output as
+//  the first. Unsupported ratios are refused.
+//-------------------------------------------------------------------
+
+static void TestRestart()
+{
+    std::vector<float> input;
+    std::vector<float> first;
+    std::vector<float> second;
+
+    MakeTone(44100, 1, 5000, &input);
+
+    CResampler resampler;
+
+    if (!CHECK_HR(resampler.Initialize(44100, 48000, 1)))
+    {
+        return;
+    }
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<float> &output = pass == 0 ? first : second;
+        std::vector<float> block(resampler.MaxOutputFrames((UINT32)input.size()));
+        UINT32 cOut = 0;
+
+        if (CHECK_HR(resampler.Process(&input[0], (UINT32)input.size(), &block[0], (UINT32)block.size(), &cOut)))
+        {
+            output.assign(block.begin(), block.begin() + cOut);
+        }
+
+        if (CHECK_HR(resampler.Drain(&block[0], (UINT32)block.size(), &cOut)))
+        {
+            output.insert(output.end(), block.begin(), block.begin() + cOut);
+        }
+    }
+
+    CHECK(first.size() == ExpectedFrames(input.size(), 44100, 48000));
+    CHECK(first == second);
+
+    // Too small an output buffer, too many phases, too much decimation.
+    float out[8];
+    UINT32 cOut = 0;
+
+    CHECK(resampler.Process(&input[0], (UINT32)input.size(), out, ARRAYSIZE(out), &cOut) == MF_E_BUFFERTOOSMALL);
+    CHECK(resampler.Initialize(44100, 48001, 1) == MF_E_INVALIDMEDIATYPE);
+    CHECK(resampler.Initialize(48000, 8000, 1) == MF_E_INVALIDMEDIATYPE);
+}
+
+int main()
+{
+    TEST_RUN(TestOutputLength);
+    TEST_RUN(TestToneError);
+    TEST_RUN(TestBlockSizes);
+    TEST_RUN(TestRestart);
+    return TEST_RESULT();
+}
@@ -0,0 +1,869 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// TestTranscoder.cpp - Checks the orchestration layer on the portable
+// and fake backends.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// Runs jobs through CTranscoder from open to close, the event state
+// machine of CQueuedSession on its own, CSessionPool and CBatch, and
+// the ways a job can fail: a missing input, a format the backend
+// cannot write, an output that is the input, and calls made in the
+// wrong state. The sources are 16-bit PCM WAVE tones generated in
+// memory; the tests that need files write them to the working
+// directory and delete them.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Test.h"
+#include "Transcode.h"
+#include "Batch.h"
+#include "WavFile.h"
+
+#include <math.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#define TEST_SAMPLE_RATE        44100
+#define TEST_CHANNELS           2
+#define TEST_FRAMES             (TEST_SAMPLE_RATE / 2)
+#define TEST_TONE_HZ            440
+
+#define TEST_BATCH_JOBS         8
+#define TEST_BATCH_IN_FLIGHT    3
+
+#define TEST_INPUT_PATH         L"TestTranscoder_in.wav"
+#define TEST_OUTPUT_PATH        L"TestTranscoder_out.wav"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+//-------------------------------------------------------------------
+//  Helpers
+//-------------------------------------------------------------------
+
+static PcmFormat TestFormat()
+{
+    PcmFormat format;
+    format.sampleRate = TEST_SAMPLE_RATE;
+    format.channels = TEST_CHANNELS;
+    format.bitsPerSample = 16;
+    format.fFloat = FALSE;
+    return format;
+}
+
+// Writes TEST_FRAMES frames of a -6 dBFS tone as a WAVE file into
+// pWav, and the samples alone into pPcm.
+static HRESULT MakeWav(CMemoryOutput *pWav, std::vector<BYTE> *pPcm)
+{
+    std::vector<INT16> samples(TEST_FRAMES * TEST_CHANNELS);
+
+    for (UINT32 i = 0; i < TEST_FRAMES; i++)
+    {
+        INT16 sample = (INT16)(16383 * sin(2 * M_PI * TEST_TONE_HZ * i / TEST_SAMPLE_RATE));
+
+        for (UINT32 c = 0; c < TEST_CHANNELS; c++)
+        {
+            samples[i * TEST_CHANNELS + c] = sample;
+        }
+    }
+
+    const BYTE *pData = (const BYTE*)&samples[0];
+    DWORD cbData = (DWORD)(samples.size() * sizeof(INT16));
+
+    pPcm->assign(pData, pData + cbData);
+
+    CWavWriter writer;
+    HRESULT hr = writer.Create(pWav, TestFormat());
+
+    if (SUCCEEDED(hr))
+    {
+        hr = writer.Write(pData, cbData);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = writer.Finalize();
+    }
+    return hr;
+}
+
+static HRESULT WriteFile(const WCHAR *sPath, const BYTE *pData, size_t cbData)
+{
+    FILE *pFile = OpenFileW(sPath, "wb");
+
+    if (pFile == NULL)
+    {
+        return E_FAIL;
+    }
+
+    BOOL fOk = fwrite(pData, 1, cbData, pFile) == cbData;
+    fOk = (fclose(pFile) == 0) && fOk;
+    return fOk ? S_OK : E_FAIL;
+}
+
+// Checks that pData is a WAVE file of the test format holding pcm.
+static void CheckWav(const BYTE *pData, UINT64 cbData, const std::vector<BYTE> &pcm)
+{
+    CMappedFile file;
+    CWavReader reader;
+
+    if (!CHECK_HR(file.Open(pData, cbData)) || !CHECK_HR(reader.Open(&file)))
+    {
+        return;
+    }
+
+    CHECK(reader.Format().sampleRate == TEST_SAMPLE_RATE);
+    CHECK(reader.Format().channels == TEST_CHANNELS);
+    CHECK(reader.Format().bitsPerSample == 16);
+    CHECK(reader.FrameCount() == TEST_FRAMES);
+
+    std::vector<BYTE> samples;
+    const BYTE *pSamples = NULL;
+    DWORD cbRead = 0;
+
+    while (CHECK_HR(reader.Read(64 * 1024, &pSamples, &cbRead)) && cbRead > 0)
+    {
+        samples.insert(samples.end(), pSamples, pSamples + cbRead);
+    }
+
+    CHECK(samples == pcm);
+}
+
+static IMediaBackend* StartBackend(const WCHAR *sName)
+{
+    IMediaBackend *pBackend = NULL;
+
+    if (!CHECK_HR(CreateMediaBackend(sName, &pBackend)))
+    {
+        return NULL;
+    }
+
+    if (!CHECK_HR(pBackend->Startup()))
+    {
+        SafeDelete(&pBackend);
+    }
+    return pBackend;
+}
+
+static void StopBackend(IMediaBackend **ppBackend)
+{
+    if (*ppBackend)
+    {
+        CHECK_HR((*ppBackend)->Shutdown());
+        SafeDelete(ppBackend);
+    }
+}
+
+// Opens and configures a job as the command-line tool does. Returns
+// the first failure.
+static HRESULT Prepare(CTranscoder *pTranscoder, const WCHAR *sFormat, const BYTE *pData, UINT64 cbData, const WCHAR *sURL)
+{
+    HRESULT hr = pTranscoder->SetOutputFormat(FindOutputFormat(sFormat));
+
+    if (SUCCEEDED(hr))
+    {
+        hr = sURL ? pTranscoder->OpenFile(sURL) : pTranscoder->OpenFile(pData, cbData);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureAudioOutput();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureVideoOutput();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureContainer();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CompletionWaiter
+//
+//  Completion callback of BeginEncodeToFile that a test can wait on.
+//-------------------------------------------------------------------
+
+struct CompletionWaiter
+{
+    std::mutex              lock;
+    std::condition_variable cvDone;
+    BOOL                    fDone;
+    HRESULT                 hr;
+    DWORD                   cCalls;
+
+    CompletionWaiter() : fDone(FALSE), hr(E_PENDING), cCalls(0) {}
+
+    static void OnComplete(CTranscoder*, HRESULT hr, void *pContext)
+    {
+        CompletionWaiter *pThis = (CompletionWaiter*)pContext;
+        std::lock_guard<std::mutex> lock(pThis->lock);
+
+        pThis->hr = hr;
+        pThis->cCalls++;
+        pThis->fDone = TRUE;
+        pThis->cvDone.notify_all();
+    }
+
+    HRESULT Wait()
+    {
+        std::unique_lock<std::mutex> lock(this->lock);
+
+        while (!fDone)
+        {
+            cvDone.wait(lock);
+        }
+        return hr;
+    }
+};
+
+//-------------------------------------------------------------------
+//  TestPortableEncode
+//
+//  WAVE to wav on the portable backend, from a file and from memory,
+//  to a file and to a sink. The samples come through unchanged.
+//-------------------------------------------------------------------
+
+static void TestPortableEncode()
+{
+    CMemoryOutput wav;
+    std::vector<BYTE> pcm;
+    std::vector<BYTE> output;
+
+    if (!CHECK_HR(MakeWav(&wav, &pcm)) || !CHECK_HR(WriteFile(TEST_INPUT_PATH, wav.Data(), wav.Size())))
+    {
+        return;
+    }
+
+    IMediaBackend *pBackend = StartBackend(L"portable");
+
+    if (pBackend)
+    {
+        CTranscoder transcoder(pBackend);
+        MediaInfo info = { 0, 0, 0 };
+
+        transcoder.SetQuiet(TRUE);
+
+        // File to file.
+        if (CHECK_HR(Prepare(&transcoder, L"wav", NULL, 0, TEST_INPUT_PATH)) &&
+            CHECK_HR(transcoder.GetMediaInfo(&info)) &&
+            CHECK_HR(transcoder.EncodeToFile(TEST_OUTPUT_PATH)) &&
+            CHECK(TestReadFile(TEST_OUTPUT_PATH, &output)))
+        {
+            CHECK(info.audioSampleRate == TEST_SAMPLE_RATE);
+            CHECK(info.hnsDuration == (LONGLONG)TEST_FRAMES * 10000000 / TEST_SAMPLE_RATE);
+            CHECK(transcoder.GetStats().cbOutput == output.size());
+            CHECK(transcoder.GetStats().hnsMedia == info.hnsDuration);
+            CheckWav(output.data(), output.size(), pcm);
+        }
+
+        // Memory to sink, on the same transcoder.
+        CMemoryOutput sink;
+
+        CHECK_HR(transcoder.Reset());
+        if (CHECK_HR(Prepare(&transcoder, L"wav", wav.Data(), wav.Size(), NULL)) &&
+            CHECK_HR(transcoder.EncodeToFile(&sink)))
+        {
+            CHECK(transcoder.GetStats().cbOutput == sink.Size());
+            CheckWav(sink.Data(), sink.Size(), pcm);
+        }
+    }
+
+    StopBackend(&pBackend);
+    RemoveFile(TEST_OUTPUT_PATH);
+    RemoveFile(TEST_INPUT_PATH);
+}
+
+//-------------------------------------------------------------------
+//  TestFailurePaths
+//
+//  A missing input fails OpenFile, a format the portable backend has
+//  no encoder for fails with MF_E_TOPO_CODEC_NOT_FOUND, and an output
+//  that is the input is refused before it is created.
+//-------------------------------------------------------------------
+
+static void TestFailurePaths()
+{
+    CMemoryOutput wav;
+    std::vector<BYTE> pcm;
+    std::vector<BYTE> input;
+
+    if (!CHECK_HR(MakeWav(&wav, &pcm)) || !CHECK_HR(WriteFile(TEST_INPUT_PATH, wav.Data(), wav.Size())))
+    {
+        return;
+    }
+
+    IMediaBackend *pBackend = StartBackend(L"portable");
+
+    if (pBackend)
+    {
+        CTranscoder transcoder(pBackend);
+        CMemoryOutput sink;
+        CompletionWaiter waiter;
+
+        transcoder.SetQuiet(TRUE);
+
+        CHECK(FAILED(Prepare(&transcoder, L"wav", NULL, 0, L"TestTranscoder_missing.wav")));
+
+        CHECK_HR(transcoder.Reset());
+        HRESULT hr = Prepare(&transcoder, L"mp3", wav.Data(), wav.Size(), NULL);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = transcoder.EncodeToFile(&sink);
+        }
+        CHECK(hr == MF_E_TOPO_CODEC_NOT_FOUND);
+
+        CHECK_HR(transcoder.Reset());
+        if (CHECK_HR(Prepare(&transcoder, L"wav", NULL, 0, TEST_INPUT_PATH)))
+        {
+            CHECK(transcoder.AddOutput(FindOutputFormat(L"wav"), TEST_INPUT_PATH) ==
+                HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION));
+            CHECK(transcoder.EncodeToFile(TEST_INPUT_PATH) == HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION));
+            CHECK(transcoder.BeginEncodeToFile(&sink, NULL, NULL) == E_INVALIDARG);
+        }
+
+        // The input is untouched, and the transcoder still works.
+        CHECK(TestReadFile(TEST_INPUT_PATH, &input));
+        CHECK(input.size() == wav.Size() && memcmp(input.data(), wav.Data(), input.size()) == 0);
+
+        if (CHECK_HR(transcoder.BeginEncodeToFile(&sink, CompletionWaiter::OnComplete, &waiter)))
+        {
+            CHECK_HR(waiter.Wait());
+            CHECK(waiter.cCalls == 1);
+            CheckWav(sink.Data(), sink.Size(), pcm);
+        }
+    }
+
+    StopBackend(&pBackend);
+    RemoveFile(TEST_INPUT_PATH);
+}
+
+//-------------------------------------------------------------------
+//  TestDispatcher
+//
+//  With a dispatcher, events wait on it. While they wait the encode
+//  is running: Reset and a second encode are refused. The callback
+//  runs once and the transcoder can then run another job.
+//-------------------------------------------------------------------
+
+static void TestDispatcher()
+{
+    CMemoryOutput wav;
+    std::vector<BYTE> pcm;
+
+    if (!CHECK_HR(MakeWav(&wav, &pcm)))
+    {
+        return;
+    }
+
+    IMediaBackend *pBackend = StartBackend(L"portable");
+    CWorkQueue dispatcher;
+
+    if (pBackend && CHECK_HR(dispatcher.Start(1)))
+    {
+        CTranscoder transcoder(pBackend, &dispatcher);
+        CMemoryOutput sink;
+        CompletionWaiter waiter;
+
+        std::mutex lock;
+        std::condition_variable cvGate;
+        BOOL fOpen = FALSE;
+
+        transcoder.SetQuiet(TRUE);
+
+        // Hold the dispatcher until the checks are done.
+        CHECK_HR(dispatcher.Put([&]() {
+            std::unique_lock<std::mutex> gate(lock);
+            while (!fOpen)
+            {
+                cvGate.wait(gate);
+            }
+        }));
+
+        if (CHECK_HR(Prepare(&transcoder, L"wav", wav.Data(), wav.Size(), NULL)) &&
+            CHECK_HR(transcoder.BeginEncodeToFile(&sink, CompletionWaiter::OnComplete, &waiter)))
+        {
+            CHECK(transcoder.Reset() == MF_E_INVALIDREQUEST);
+            CHECK(transcoder.BeginEncodeToFile(&sink, CompletionWaiter::OnComplete, &waiter) == MF_E_INVALIDREQUEST);
+        }
+
+        {
+            std::lock_guard<std::mutex> gate(lock);
+            fOpen = TRUE;
+            cvGate.notify_all();
+        }
+
+        CHECK_HR(waiter.Wait());
+        CHECK(waiter.cCalls == 1);
+        CheckWav(sink.Data(), sink.Size(), pcm);
+
+        // A second job on the same transcoder.
+        sink.Clear();
+        CHECK_HR(transcoder.Reset());
+        if (CHECK_HR(Prepare(&transcoder, L"wav", wav.Data(), wav.Size(), NULL)) &&
+            CHECK_HR(transcoder.EncodeToFile(&sink)))
+        {
+            CheckWav(sink.Data(), sink.Size(), pcm);
+        }
+    }
+
+    dispatcher.Stop();
+    StopBackend(&pBackend);
+}
+
+//-------------------------------------------------------------------
+//  TestFakeBackend
+//
+//  The fake backend writes every format, the same bytes every time.
+//-------------------------------------------------------------------
+
+static void TestFakeBackend()
+{
+    CMemoryOutput wav;
+    std::vector<BYTE> pcm;
+
+    if (!CHECK_HR(MakeWav(&wav, &pcm)))
+    {
+        return;
+    }
+
+    IMediaBackend *pBackend = StartBackend(L"fake");
+
+    if (pBackend)
+    {
+        CTranscoder transcoder(pBackend);
+
+        transcoder.SetQuiet(TRUE);
+
+        for (UINT32 i = 0; i < GetOutputFormatCount(); i++)
+        {
+            const OutputFormat *pFormat = GetOutputFormat(i);
+            CMemoryOutput first;
+            CMemoryOutput second;
+
+            CHECK_HR(transcoder.Reset());
+            if (CHECK_HR(Prepare(&transcoder, pFormat->sName, wav.Data(), wav.Size(), NULL)))
+            {
+                CHECK_HR(transcoder.EncodeToFile(&first));
+            }
+
+            CHECK_HR(transcoder.Reset());
+            if (CHECK_HR(Prepare(&transcoder, pFormat->sName, wav.Data(), wav.Size(), NULL)))
+            {
+                CHECK_HR(transcoder.EncodeToFile(&second));
+            }
+
+            CHECK(first.Size() > 0);
+            CHECK(first.Size() == second.Size() && memcmp(first.Data(), second.Data(), (size_t)first.Size()) == 0);
+        }
+    }
+
+    StopBackend(&pBackend);
+}
+
+//-------------------------------------------------------------------
+//  EventRecorder
+//
+//  Session event callback that keeps the events in order.
+//-------------------------------------------------------------------
+
+class CEventRecorder : public ISessionEventCallback
+{
+public:
+    CEventRecorder() : m_cEvents(0) {}
+
+    void OnSessionEvent(HRESULT hr, const SessionEvent &event)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        m_hr[m_cEvents] = hr;
+        m_events[m_cEvents] = event;
+        m_cEvents++;
+        m_cvEvent.notify_all();
+    }
+
+    // Waits for event i and checks its type.
+    BOOL Expect(DWORD i, SessionEventType type)
+    {
+        std::unique_lock<std::mutex> lock(m_lock);
+
+        while (m_cEvents <= i)
+        {
+            m_cvEvent.wait(lock);
+        }
+        return CHECK(m_cEvents == i + 1) && CHECK_HR(m_hr[i]) && CHECK_HR(m_events[i].hrStatus) &&
+            CHECK(m_events[i].type == type);
+    }
+
+private:
+
+    std::mutex              m_lock;
+    std::condition_variable m_cvEvent;
+    HRESULT                 m_hr[8];
+    SessionEvent            m_events[8];
+    DWORD                   m_cEvents;
+};
+
+//-------------------------------------------------------------------
+//  TestSessionEvents
+//
+//  A session raises TopologySet, Started, Ended and Closed, one per
+//  request, and refuses calls made out of order.
+//-------------------------------------------------------------------
+
+static void TestSessionEvents()
+{
+    CMemoryOutput wav;
+    std::vector<BYTE> pcm;
+
+    if (!CHECK_HR(MakeWav(&wav, &pcm)))
+    {
+        return;
+    }
+
+    IMediaBackend *pBackend = StartBackend(L"portable");
+    ITranscodeSession *pSession = NULL;
+
+    if (pBackend && CHECK_HR(pBackend->CreateSession(&pSession)))
+    {
+        const OutputFormat *pFormat = FindOutputFormat(L"wav");
+        CEventRecorder events;
+        CMemoryOutput sink;
+
+        if (CHECK_HR(pSession->OpenSourceMemory(wav.Data(), wav.Size())) &&
+            CHECK_HR(pSession->ConfigureAudio(pFormat)) &&
+            CHECK_HR(pSession->ConfigureContainer(pFormat)))
+        {
+            // Nothing to start and no event would ever arrive.
+            CHECK(pSession->Start(0) == MF_E_INVALIDREQUEST);
+            CHECK(pSession->BeginGetEvent(&events) == MF_E_INVALIDREQUEST);
+
+            CHECK_HR(pSession->SetOutputSink(&sink));
+            CHECK(pSession->SetOutputSink(&sink) == MF_E_INVALIDREQUEST);
+            CHECK(pSession->SetStopTime(0) == MF_E_INVALIDREQUEST);
+            CHECK(pSession->Reset() == MF_E_INVALIDREQUEST);
+
+            if (CHECK_HR(pSession->BeginGetEvent(&events)) && events.Expect(0, SessionEvent_TopologySet) &&
+                CHECK_HR(pSession->Start(0)) &&
+                CHECK_HR(pSession->BeginGetEvent(&events)) && events.Expect(1, SessionEvent_Started) &&
+                CHECK_HR(pSession->BeginGetEvent(&events)) && events.Expect(2, SessionEvent_Ended) &&
+                CHECK_HR(pSession->Close()) &&
+                CHECK_HR(pSession->BeginGetEvent(&events)) && events.Expect(3, SessionEvent_Closed))
+            {
+                CheckWav(sink.Data(), sink.Size(), pcm);
+            }
+        }
+
+        CHECK_HR(pSession->Shutdown());
+        CHECK(pSession->BeginGetEvent(&events) == MF_E_SHUTDOWN);
+        CHECK(pSession->Close() == MF_E_SHUTDOWN);
+
+        // Reset readies it for another job.
+        CMemoryOutput second;
+
+        if (CHECK_HR(pSession->Reset()) &&
+            CHECK_HR(pSession->OpenSourceMemory(wav.Data(), wav.Size())) &&
+            CHECK_HR(pSession->ConfigureAudio(pFormat)) &&
+            CHECK_HR(pSession->ConfigureContainer(pFormat)))
+        {
+            CHECK_HR(pSession->SetOutputSink(&second));
+        }
+        CHECK_HR(pSession->Shutdown());
+    }
+
+    SafeDelete(&pSession);
+    StopBackend(&pBackend);
+}
+
+//-------------------------------------------------------------------
+//  TestSessionPool
+//
+//  Reserve fills the pool up to its limit, Acquire takes the session
+//  returned last, and a session returned to a full pool is deleted.
+//-------------------------------------------------------------------
+
+static void TestSessionPool()
+{
+    IMediaBackend *pBackend = StartBackend(L"fake");
+
+    if (!pBackend)
+    {
+        return;
+    }
+
+    {
+        CSessionPool pool(pBackend, 2);
+        ITranscodeSession *pFirst = NULL;
+        ITranscodeSession *pSecond = NULL;
+        ITranscodeSession *pThird = NULL;
+        ITranscodeSession *pSession = NULL;
+
+        // Capped at cMaxIdle: the third Acquire creates a session.
+        CHECK_HR(pool.Reserve(5));
+        CHECK_HR(pool.Acquire(&pFirst));
+        CHECK_HR(pool.Acquire(&pSecond));
+        CHECK_HR(pool.Acquire(&pThird));
+        CHECK(pFirst != pSecond && pSecond != pThird && pFirst != pThird);
+
+        if (pFirst && pSecond && pThird)
+        {
+            pool.Release(pFirst);
+            pool.Release(pSecond);
+            pool.Release(pThird);           // Pool full: deleted
+
+            CHECK_HR(pool.Acquire(&pSession));
+            CHECK(pSession == pSecond);
+            pool.Release(pSession);
+
+            // A session used for a job comes back ready for another.
+            CTranscoder transcoder(pBackend);
+            CMemoryOutput wav;
+            CMemoryOutput sink;
+            std::vector<BYTE> pcm;
+
+            transcoder.SetQuiet(TRUE);
+            transcoder.SetSessionPool(&pool);
+
+            CHECK_HR(MakeWav(&wav, &pcm));
+
+            for (int i = 0; i < 2; i++)
+            {
+                sink.Clear();
+                CHECK_HR(transcoder.Reset());
+                if (CHECK_HR(Prepare(&transcoder, L"wav", wav.Data(), wav.Size(), NULL)))
+                {
+                    CHECK_HR(transcoder.EncodeToFile(&sink));
+                }
+            }
+
+            CHECK_HR(transcoder.Reset());
+            CHECK_HR(pool.Acquire(&pSession));
+            CHECK(pSession == pFirst || pSession == pSecond);
+            pool.Release(pSession);
+        }
+
+        pool.Clear();
+    }
+
+    StopBackend(&pBackend);
+}
+
+//-------------------------------------------------------------------
+//  TestBatch
+//
+//  Jobs start in order with at most cMaxInFlight running, complete on
+//  other threads, and Run returns the first failure after every job
+//  has completed.
+//-------------------------------------------------------------------
+
+struct BatchRun
+{
+    CWorkQueue          queue;
+    std::atomic<DWORD>  cInFlight;
+    std::atomic<DWORD>  cMaxInFlight;
+    BatchJob*           pJobs[TEST_BATCH_JOBS];
+    DWORD               cStarted;
+};
+
+static HRESULT BeginTestJob(BatchJob *pJob, void *pContext)
+{
+    BatchRun *pRun = (BatchRun*)pContext;
+    DWORD iJob = pRun->cStarted++;
+
+    pRun->pJobs[iJob] = pJob;
+
+    // Job 2 fails to start; job 5 fails when it completes.
+    if (iJob == 2)
+    {
+        return E_INVALIDARG;
+    }
+
+    DWORD cInFlight = ++pRun->cInFlight;
+    DWORD cMax = pRun->cMaxInFlight;
+
+    while (cInFlight > cMax && !pRun->cMaxInFlight.compare_exchange_weak(cMax, cInFlight))
+    {
+    }
+
+    return pRun->queue.Put([pRun, pJob, iJob]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        pRun->cInFlight--;
+        CBatch::CompleteJob(pJob, iJob == 5 ? E_FAIL : S_OK);
+    });
+}
+
+static void TestBatch()
+{
+    BatchRun run;
+    CBatch batch;
+
+    run.cInFlight = 0;
+    run.cMaxInFlight = 0;
+    run.cStarted = 0;
+
+    for (DWORD i = 0; i < TEST_BATCH_JOBS; i++)
+    {
+        WCHAR szInput[MAX_PATH];
+        WCHAR szOutput[MAX_PATH];
+
+        swprintf_s(szInput, MAX_PATH, L"in%u.wav", i);
+        swprintf_s(szOutput, MAX_PATH, L"out%u.wav", i);
+        CHECK_HR(batch.AddJob(szInput, szOutput));
+    }
+    CHECK(batch.JobCount() == TEST_BATCH_JOBS);
+
+    if (!CHECK_HR(run.queue.Start(TEST_BATCH_JOBS)))
+    {
+        return;
+    }
+
+    CHECK(batch.Run(BeginTestJob, &run, TEST_BATCH_IN_FLIGHT) == E_INVALIDARG);
+    run.queue.Stop();
+
+    CHECK(run.cStarted == TEST_BATCH_JOBS);
+    CHECK(run.cInFlight == 0);
+    CHECK(run.cMaxInFlight <= TEST_BATCH_IN_FLIGHT);
+
+    for (DWORD i = 0; i < run.cStarted; i++)
+    {
+        HRESULT hrExpected = (i == 2) ? E_INVALIDARG : (i == 5) ? E_FAIL : S_OK;
+
+        CHECK(run.pJobs[i]->hr == hrExpected);
+        CHECK(run.pJobs[i]->pBatch == &batch);
+    }
+
+    // A job whose output is its input is refused.
+    CMemoryOutput wav;
+    std::vector<BYTE> pcm;
+
+    if (CHECK_HR(MakeWav(&wav, &pcm)) && CHECK_HR(WriteFile(TEST_INPUT_PATH, wav.Data(), wav.Size())))
+    {
+        CHECK(batch.AddJob(TEST_INPUT_PATH, L"./" TEST_INPUT_PATH) == HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION));
+        CHECK(batch.JobCount() == TEST_BATCH_JOBS);
+        RemoveFile(TEST_INPUT_PATH);
+    }
+}
+
+//-------------------------------------------------------------------
+//  TestBatchTranscode
+//
+//  A batch of real jobs, each on its own transcoder, with the events
+//  on a shared dispatcher, as the command-line tool runs them.
+//-------------------------------------------------------------------
+
+struct TranscodeRun
+{
+    IMediaBackend*  pBackend;
+    CWorkQueue*     pDispatcher;
+    CSessionPool*   pPool;
+};
+
+static void OnTestJobEncoded(CTranscoder *pTranscoder, HRESULT hr, void *pContext)
+{
+    delete pTranscoder;
+    CBatch::CompleteJob((BatchJob*)pContext, hr);
+}
+
+static HRESULT BeginTranscodeJob(BatchJob *pJob, void *pContext)
+{
+    TranscodeRun *pRun = (TranscodeRun*)pContext;
+    CTranscoder *pTranscoder = new (std::nothrow) CTranscoder(pRun->pBackend, pRun->pDispatcher);
+
+    if (pTranscoder == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    pTranscoder->SetQuiet(TRUE);
+    pTranscoder->SetSessionPool(pRun->pPool);
+
+    HRESULT hr = Prepare(pTranscoder, L"wav", NULL, 0, pJob->szInput);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->BeginEncodeToFile(pJob->szOutput, OnTestJobEncoded, pJob);
+    }
+
+    if (FAILED(hr))
+    {
+        delete pTranscoder;
+    }
+    return hr;
+}
+
+static void TestBatchTranscode()
+{
+    CMemoryOutput wav;
+    std::vector<BYTE> pcm;
+
+    if (!CHECK_HR(MakeWav(&wav, &pcm)) || !CHECK_HR(WriteFile(TEST_INPUT_PATH, wav.Data(), wav.Size())))
+    {
+        return;
+    }
+
+    IMediaBackend *pBackend = StartBackend(L"portable");
+    CWorkQueue dispatcher;
+
+    if (pBackend && CHECK_HR(dispatcher.Start(1)))
+    {
+        CSessionPool pool(pBackend, TEST_BATCH_IN_FLIGHT);
+        TranscodeRun run = { pBackend, &dispatcher, &pool };
+        CBatch batch;
+        WCHAR szOutput[TEST_BATCH_JOBS][MAX_PATH];
+
+        for (DWORD i = 0; i < TEST_BATCH_JOBS; i++)
+        {
+            swprintf_s(szOutput[i], MAX_PATH, L"TestTranscoder_batch%u.wav", i);
+            CHECK_HR(batch.AddJob(TEST_INPUT_PATH, szOutput[i]));
+        }
+
+        // One job with a missing input.
+        CHECK_HR(batch.AddJob(L"TestTranscoder_missing.wav", L"TestTranscoder_missing_out.wav"));
+
+        CHECK_HR(pool.Reserve(TEST_BATCH_IN_FLIGHT));
+        CHECK(FAILED(batch.Run(BeginTranscodeJob, &run, TEST_BATCH_IN_FLIGHT)));
+
+        for (DWORD i = 0; i < TEST_BATCH_JOBS; i++)
+        {
+            std::vector<BYTE> output;
+
+            if (CHECK(TestReadFile(szOutput[i], &output)))
+            {
+                CheckWav(output.data(), output.size(), pcm);
+            }
+            RemoveFile(szOutput[i]);
+        }
+        CHECK(!PathExists(L"TestTranscoder_missing_out.wav"));
+
+        dispatcher.Stop();
+        pool.Clear();
+    }
+
+    StopBackend(&pBackend);
+    RemoveFile(TEST_INPUT_PATH);
+}
+
+int main()
+{
+    TEST_RUN(TestPortableEncode);
+    TEST_RUN(TestFailurePaths);
+    TEST_RUN(TestDispatcher);
+    TEST_RUN(TestFakeBackend);
+    TEST_RUN(TestSessionEvents);
+    TEST_RUN(TestSessionPool);
+    TEST_RUN(TestBatch);
+    TEST_RUN(TestBatchTranscode);
+    return TEST_RESULT();
+}
@@ -0,0 +1,888 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Transcode.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Transcode.h"
+
+#include <condition_variable>
+#include <mutex>
+
+// Stands in for the input or output path of a memory encode in stats.
+#define MEMORY_PATH_NAME    L"(memory)"
+
+// Completion state for the synchronous EncodeToFile.
+struct SyncEncode
+{
+    std::mutex              lock;
+    std::condition_variable cvDone;
+    BOOL                    fDone;
+    HRESULT                 hr;
+};
+
+static void OnSyncEncodeComplete(CTranscoder*, HRESULT hr, void *pContext)
+{
+    SyncEncode *pSync = (SyncEncode*)pContext;
+
+    std::lock_guard<std::mutex> lock(pSync->lock);
+    pSync->hr = hr;
+    pSync->fDone = TRUE;
+    pSync->cvDone.notify_all();
+}
+
+//-------------------------------------------------------------------
+//  CTranscoder constructor
+//
+//  pBackend: Backend that creates the transcode session. Not owned;
+//  it must outlive the transcoder.
+//  pDispatcher: Work queue for session events, or NULL. Not owned.
+//-------------------------------------------------------------------
+
+CTranscoder::CTranscoder(IMediaBackend *pBackend, CWorkQueue *pDispatcher) : 
+    m_pBackend(pBackend),
+    m_pDispatcher(pDispatcher),
+    m_pFormat(NULL),
+    m_hnsStart(0),
+    m_hnsStop(0),
+    m_pSession(NULL),
+    m_pSessionPool(NULL),
+    m_pStatsLog(NULL),
+    m_fQuiet(FALSE),
+    m_pOutputSink(NULL),
+    m_cExtraOutputs(0),
+    m_pProgressMonitor(NULL),
+    m_pfnProgress(NULL),
+    m_pProgressContext(NULL),
+    m_fPolling(FALSE),
+    m_hnsRange(0),
+    m_hnsLastPosition(0),
+    m_pfnComplete(NULL),
+    m_pCompleteContext(NULL)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_szInput[0] = L'\0';
+    m_szOutput[0] = L'\0';
+}
+
+//-------------------------------------------------------------------
+//  CTranscoder destructor
+//-------------------------------------------------------------------
+
+CTranscoder::~CTranscoder()
+{
+    StopProgress();
+
+    ReleaseSession();
+}
+
+//-------------------------------------------------------------------
+//  Reset
+//
+//  The session holds the source and outputs of the job, so it goes
+//  back to the pool; the next OpenFile takes one that is ready.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::Reset()
+{
+    if (m_pfnComplete)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    StopProgress();
+
+    ReleaseSession();
+
+    m_hnsStart = 0;
+    m_hnsStop = 0;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_szInput[0] = L'\0';
+    m_szOutput[0] = L'\0';
+    m_pOutputSink = NULL;
+    m_cExtraOutputs = 0;
+    m_hnsRange = 0;
+    m_hnsLastPosition = 0;
+    return S_OK;
+}
+
+
+//-------------------------------------------------------------------
+//  SetOutputFormat
+//
+//  Selects the registry entry that the Configure* methods apply.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::SetOutputFormat(const OutputFormat *pFormat)
+{
+    if (!pFormat)
+    {
+        return E_INVALIDARG;
+    }
+
+    m_pFormat = pFormat;
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  OpenFile
+//        
+//  Creates a transcode session and opens the media source for the
+//  caller specified URL.
+//
+//  sURL: Input file URL.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::OpenFile(const WCHAR *sURL)
+{
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    return Open(sURL, NULL, 0);
+}
+
+//-------------------------------------------------------------------
+//  OpenFile
+//
+//  Creates a transcode session and opens the media source for a file
+//  held in memory.
+//
+//  pData, cbData: The file. Not copied by the portable and fake
+//  backends; it must stay valid until the transcoder is deleted.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::OpenFile(const BYTE *pData, UINT64 cbData)
+{
+    if (!pData || cbData == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    return Open(NULL, pData, cbData);
+}
+
+//-------------------------------------------------------------------
+//  Open
+//
+//  Opens the source at sURL or, if sURL is NULL, in memory.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::Open(const WCHAR *sURL, const BYTE *pData, UINT64 cbData)
+{
+    assert (m_pBackend);
+
+    if (m_pSession)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = S_OK;
+
+    BeginPhase();
+
+    // Create the session, or take a ready one from the pool.
+    if (m_pSessionPool)
+    {
+        hr = m_pSessionPool->Acquire(&m_pSession);
+    }
+    else
+    {
+        hr = m_pBackend->CreateSession(&m_pSession);
+    }
+
+    // Create the media source.
+    if (SUCCEEDED(hr))
+    {
+        if (sURL)
+        {
+            hr = m_pSession->OpenSource(sURL);
+        }
+        else
+        {
+            hr = m_pSession->OpenSourceMemory(pData, cbData);
+        }
+    }
+
+    EndPhase(Phase_Open);
+
+    (void)wcscpy_s(m_szInput, MAX_PATH, sURL ? sURL : MEMORY_PATH_NAME);
+    m_stats.cbInput = sURL ? GetPathSize(sURL) : cbData;
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ConfigureAudioOutput
+//        
+//  Configures the audio stream attributes.  
+//  These values are stored in the transcode profile.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::ConfigureAudioOutput()
+{
+    assert (m_pSession);
+    assert (m_pFormat);
+
+    BeginPhase();
+
+    HRESULT hr = m_pSession->ConfigureAudio(m_pFormat);
+
+    EndPhase(Phase_Configure);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ConfigureVideoOutput
+//        
+//  Configures the video stream attributes, if the format has video.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::ConfigureVideoOutput()
+{
+    assert (m_pSession);
+    assert (m_pFormat);
+
+    BeginPhase();
+
+    HRESULT hr = m_pSession->ConfigureVideo(m_pFormat);
+
+    EndPhase(Phase_Configure);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ConfigureContainer
+//        
+//  Configures the container attributes.  
+//  These values are stored in the transcode profile.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::ConfigureContainer()
+{
+    assert (m_pSession);
+    assert (m_pFormat);
+
+    BeginPhase();
+
+    HRESULT hr = m_pSession->ConfigureContainer(m_pFormat);
+
+    EndPhase(Phase_Configure);
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  AddOutput
+//
+//  The session configures the added output; its path is kept for the
+//  job statistics.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::AddOutput(const OutputFormat *pFormat, const WCHAR *sURL)
+{
+    assert (m_pSession);
+
+    if (!pFormat || !sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_cExtraOutputs == ARRAYSIZE(m_szExtraOutputs))
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (IsSameFile(m_szInput, sURL))
+    {
+        return HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION);
+    }
+
+    if (wcscpy_s(m_szExtraOutputs[m_cExtraOutputs], MAX_PATH, sURL) != 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    BeginPhase();
+
+    HRESULT hr = m_pSession->AddOutput(pFormat, sURL);
+
+    EndPhase(Phase_Configure);
+
+    if (SUCCEEDED(hr))
+    {
+        m_cExtraOutputs++;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  SetStreamCopy
+//
+//  Allows or disallows stream copy. When the source codec matches the
+//  output codec, a copy only rewraps the compressed packets in the
+//  output container, so it runs at I/O speed and loses no quality.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::SetStreamCopy(BOOL fAllow)
+{
+    assert (m_pSession);
+
+    return m_pSession->SetStreamCopy(fAllow);
+}
+
+//-------------------------------------------------------------------
+//  SetSampleRate
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::SetSampleRate(UINT32 sampleRate)
+{
+    assert (m_pSession);
+
+    return m_pSession->SetSampleRate(sampleRate);
+}
+
+//-------------------------------------------------------------------
+//  SetRange
+//
+//  The start position is passed to the session when it starts; the
+//  stop position makes the session end early.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::SetRange(LONGLONG hnsStart, LONGLONG hnsStop)
+{
+    assert (m_pSession);
+
+    if (hnsStart < 0 || (hnsStop != 0 && hnsStop <= hnsStart))
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = m_pSession->SetStopTime(hnsStop);
+
+    if (SUCCEEDED(hr))
+    {
+        m_hnsStart = hnsStart;
+        m_hnsStop = hnsStop;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  GetMediaInfo
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::GetMediaInfo(MediaInfo *pInfo)
+{
+    assert (m_pSession);
+
+    return m_pSession->GetMediaInfo(pInfo);
+}
+
+//-------------------------------------------------------------------
+//  SetProgress
+//-------------------------------------------------------------------
+
+void CTranscoder::SetProgress(CProgressMonitor *pMonitor, PFN_TRANSCODE_PROGRESS pfnProgress, void *pContext)
+{
+    assert (!m_fPolling);
+
+    m_pProgressMonitor = pMonitor;
+    m_pfnProgress = pfnProgress;
+    m_pProgressContext = pContext;
+}
+
+//-------------------------------------------------------------------
+//  EncodeToFile
+//        
+//  Encodes to the output file and waits until the file is finalized.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::EncodeToFile(const WCHAR *sURL)
+{
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    return Encode(sURL, NULL);
+}
+
+HRESULT CTranscoder::EncodeToFile(IOutputSink *pSink)
+{
+    if (!pSink)
+    {
+        return E_INVALIDARG;
+    }
+
+    return Encode(NULL, pSink);
+}
+
+HRESULT CTranscoder::Encode(const WCHAR *sURL, IOutputSink *pSink)
+{
+    SyncEncode sync;
+    sync.fDone = FALSE;
+    sync.hr = S_OK;
+
+    HRESULT hr = BeginEncode(sURL, pSink, OnSyncEncodeComplete, &sync);
+
+    if (SUCCEEDED(hr))
+    {
+        std::unique_lock<std::mutex> lock(sync.lock);
+
+        while (!sync.fDone)
+        {
+            sync.cvDone.wait(lock);
+        }
+        hr = sync.hr;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  BeginEncodeToFile
+//        
+//  Builds the transcode topology based on the input source,
+//  configured transcode profile, and the output container settings,
+//  and requests the first session event. The rest of the encode is
+//  driven by session events (see HandleEvent).
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::BeginEncodeToFile(const WCHAR *sURL, PFN_TRANSCODE_COMPLETE pfnComplete, void *pContext)
+{
+    if (!sURL)
+    {
+        return E_INVALIDARG;
+    }
+
+    return BeginEncode(sURL, NULL, pfnComplete, pContext);
+}
+
+HRESULT CTranscoder::BeginEncodeToFile(IOutputSink *pSink, PFN_TRANSCODE_COMPLETE pfnComplete, void *pContext)
+{
+    if (!pSink)
+    {
+        return E_INVALIDARG;
+    }
+
+    return BeginEncode(NULL, pSink, pfnComplete, pContext);
+}
+
+//-------------------------------------------------------------------
+//  BeginEncode
+//
+//  Starts the encode to the file at sURL or, if sURL is NULL, into
+//  pSink.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::BeginEncode(const WCHAR *sURL, IOutputSink *pSink, PFN_TRANSCODE_COMPLETE pfnComplete, void *pContext)
+{
+    assert (m_pSession);
+    
+    if (!pfnComplete)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (m_pfnComplete)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = S_OK;
+
+    // Creating the output would truncate the input, which may still
+    // be mapped.
+    if (sURL && IsSameFile(m_szInput, sURL))
+    {
+        return HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION);
+    }
+
+    if (wcscpy_s(m_szOutput, MAX_PATH, sURL ? sURL : MEMORY_PATH_NAME) != 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+
+    m_pOutputSink = pSink;
+
+    // The topology phase lasts until the session reports it set.
+    BeginPhase();
+
+    //Create the transcode topology and set it on the session.
+    if (sURL)
+    {
+        hr = m_pSession->SetOutput(sURL);
+    }
+    else
+    {
+        hr = m_pSession->SetOutputSink(pSink);
+    }
+    
+    //Get session events. This will start the encoding session.
+    if (SUCCEEDED(hr))
+    {
+        m_pfnComplete = pfnComplete;
+        m_pCompleteContext = pContext;
+
+        hr = m_pSession->BeginGetEvent(this);
+
+        if (FAILED(hr))
+        {
+            m_pfnComplete = NULL;
+            m_pCompleteContext = NULL;
+        }
+    }
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  OnSessionEvent
+//
+//  Called on a backend thread with the next session event. Hands the
+//  event to the dispatcher, if there is one.
+//-------------------------------------------------------------------
+
+void CTranscoder::OnSessionEvent(HRESULT hr, const SessionEvent &event)
+{
+    if (m_pDispatcher)
+    {
+        HRESULT hrPut = m_pDispatcher->Put([this, hr, event]() {
+            HandleEvent(hr, event);
+        });
+
+        if (SUCCEEDED(hrPut))
+        {
+            return;
+        }
+        hr = hrPut;
+    }
+
+    HandleEvent(hr, event);
+}
+
+//-------------------------------------------------------------------
+//  Name: HandleEvent
+//        
+//  Controls the encoding session.
+//  
+//  The encoding starts when the session raises the 
+//  SessionEvent_TopologySet event. The session is closed after 
+//  receiving SessionEvent_Ended. The encoded file is finalized after 
+//  the session is closed. Every event except the last one requests
+//  the next, so each session has one request outstanding and no
+//  thread waits on it.
+//-------------------------------------------------------------------
+
+void CTranscoder::HandleEvent(HRESULT hr, const SessionEvent &event)
+{
+    assert (m_pSession);
+
+    if (SUCCEEDED(hr) && FAILED(event.hrStatus))
+    {
+        wprintf_s(L"Failed. 0x%X error condition triggered this event.\n", event.hrStatus);
+        hr = event.hrStatus;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        switch (event.type)
+        {
+        case SessionEvent_TopologySet:
+            EndPhase(Phase_Topology);
+            hr = Start();
+            if (SUCCEEDED(hr) && !m_fQuiet)
+            {
+                wprintf_s(L"Ready to start.\n");
+            }
+            break;
+
+        case SessionEvent_Started:
+            EndPhase(Phase_Start);
+            StartProgress();
+            if (!m_fQuiet)
+            {
+                wprintf_s(L"Started encoding...\n");
+            }
+            break;
+
+        case SessionEvent_Ended:
+            StopProgress();
+            EndPhase(Phase_Encode);
+            hr = m_pSession->Close();
+            if (SUCCEEDED(hr) && !m_fQuiet)
+            {
+                wprintf_s(L"Finished encoding.\n");
+            }
+            break;
+
+        case SessionEvent_Closed:
+            EndPhase(Phase_Finalize);
+            if (!m_fQuiet)
+            {
+                wprintf_s(L"Output file created.\n");
+            }
+            Complete(S_OK);
+            return;
+
+        default:
+            break;
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = m_pSession->BeginGetEvent(this);
+    }
+
+    if (FAILED(hr))
+    {
+        Complete(hr);
+    }
+}
+
+//-------------------------------------------------------------------
+//  Complete
+//
+//  Completes the statistics, logs them and reports the end of the
+//  encode. The callback may delete the transcoder, so no member is
+//  touched after it is called.
+//-------------------------------------------------------------------
+
+void CTranscoder::Complete(HRESULT hr)
+{
+    MediaInfo info;
+
+    StopProgress();
+
+    m_stats.wallSeconds = 0;
+    for (int i = 0; i < Phase_Count; i++)
+    {
+        m_stats.wallSeconds += m_stats.phaseSeconds[i];
+    }
+
+    m_stats.cbOutput = m_pOutputSink ? m_pOutputSink->Size() : GetPathSize(m_szOutput);
+    for (DWORD i = 0; i < m_cExtraOutputs; i++)
+    {
+        m_stats.cbOutput += GetPathSize(m_szExtraOutputs[i]);
+    }
+    m_stats.cbPeakMemory = GetPeakMemoryUsage();
+
+    if (SUCCEEDED(hr) && SUCCEEDED(m_pSession->GetMediaInfo(&info)))
+    {
+        LONGLONG hnsEnd = (m_hnsStop > 0 && m_hnsStop < info.hnsDuration) ? m_hnsStop : info.hnsDuration;
+
+        m_stats.hnsMedia = hnsEnd > m_hnsStart ? hnsEnd - m_hnsStart : 0;
+    }
+
+    if (m_pStatsLog)
+    {
+        (void)m_pStatsLog->Write(m_szInput, m_szOutput, m_pFormat ? m_pFormat->sName : NULL, hr, m_stats);
+    }
+
+    PFN_TRANSCODE_COMPLETE pfnComplete = m_pfnComplete;
+    void *pContext = m_pCompleteContext;
+
+    m_pfnComplete = NULL;
+    m_pCompleteContext = NULL;
+
+    pfnComplete(this, hr, pContext);
+}
+
+//-------------------------------------------------------------------
+//  BeginPhase / EndPhase
+//
+//  EndPhase adds the time since the last BeginPhase or EndPhase to
+//  the phase, so consecutive phases need no BeginPhase in between.
+//-------------------------------------------------------------------
+
+void CTranscoder::BeginPhase()
+{
+    m_tPhase = std::chrono::steady_clock::now();
+}
+
+void CTranscoder::EndPhase(TranscodePhase phase)
+{
+    std::chrono::steady_clock::time_point tNow = std::chrono::steady_clock::now();
+
+    m_stats.phaseSeconds[phase] += std::chrono::duration<double>(tNow - m_tPhase).count();
+    m_tPhase = tNow;
+}
+
+//-------------------------------------------------------------------
+//  StartProgress / StopProgress
+//
+//  Add the transcoder to the progress monitor for the Encode phase.
+//  Once StopProgress returns, no poll is running.
+//-------------------------------------------------------------------
+
+void CTranscoder::StartProgress()
+{
+    MediaInfo info;
+
+    if (m_pProgressMonitor == NULL || m_fPolling)
+    {
+        return;
+    }
+
+    m_hnsRange = 0;
+
+    if (SUCCEEDED(m_pSession->GetMediaInfo(&info)))
+    {
+        LONGLONG hnsEnd = (m_hnsStop > 0 && m_hnsStop < info.hnsDuration) ? m_hnsStop : info.hnsDuration;
+
+        m_hnsRange = hnsEnd > m_hnsStart ? hnsEnd - m_hnsStart : 0;
+    }
+
+    m_hnsLastPosition = 0;
+    m_tStarted = std::chrono::steady_clock::now();
+    m_tLastPoll = m_tStarted;
+    m_tLastMove = m_tStarted;
+
+    m_fPolling = TRUE;
+    m_pProgressMonitor->Add(this);
+}
+
+void CTranscoder::StopProgress()
+{
+    if (m_fPolling)
+    {
+        m_pProgressMonitor->Remove(this);
+        m_fPolling = FALSE;
+    }
+}
+
+//-------------------------------------------------------------------
+//  PollProgress
+//
+//  Called on the monitor thread. The real-time factor covers the time
+//  since the previous poll; the ETA assumes the average rate so far.
+//  The longest stall is kept in the job statistics.
+//-------------------------------------------------------------------
+
+void CTranscoder::PollProgress()
+{
+    LONGLONG hnsClock = 0;
+
+    if (FAILED(m_pSession->GetPosition(&hnsClock)))
+    {
+        return;
+    }
+
+    std::chrono::steady_clock::time_point tNow = std::chrono::steady_clock::now();
+
+    LONGLONG hnsPosition = hnsClock > m_hnsStart ? hnsClock - m_hnsStart : 0;
+
+    if (m_hnsRange > 0 && hnsPosition > m_hnsRange)
+    {
+        hnsPosition = m_hnsRange;
+    }
+
+    if (hnsPosition != m_hnsLastPosition)
+    {
+        m_tLastMove = tNow;
+    }
+
+    double sinceLastPoll = std::chrono::duration<double>(tNow - m_tLastPoll).count();
+
+    TranscodeProgress progress;
+
+    progress.hnsPosition = hnsPosition;
+    progress.hnsDuration = m_hnsRange;
+    progress.elapsedSeconds = std::chrono::duration<double>(tNow - m_tStarted).count();
+    progress.realtimeFactor = sinceLastPoll > 0 ?
+        (hnsPosition - m_hnsLastPosition) / 10000000.0 / sinceLastPoll : 0;
+    progress.etaSeconds = (m_hnsRange > 0 && hnsPosition > 0) ?
+        progress.elapsedSeconds * (m_hnsRange - hnsPosition) / hnsPosition : -1;
+    progress.stalledSeconds = std::chrono::duration<double>(tNow - m_tLastMove).count();
+
+    if (progress.stalledSeconds > m_stats.maxStallSeconds)
+    {
+        m_stats.maxStallSeconds = progress.stalledSeconds;
+    }
+
+    m_hnsLastPosition = hnsPosition;
+    m_tLastPoll = tNow;
+
+    if (m_pStatsLog)
+    {
+        (void)m_pStatsLog->WriteProgress(m_szInput, m_szOutput, progress);
+    }
+
+    if (m_pfnProgress)
+    {
+        m_pfnProgress(this, progress, m_pProgressContext);
+    }
+}
+
+//-------------------------------------------------------------------
+//  Start
+//
+//  Starts the encoding session.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::Start()
+{
+    assert(m_pSession != NULL);
+
+    HRESULT hr = m_pSession->Start(m_hnsStart);
+
+    if (FAILED(hr))
+    {
+        wprintf_s(L"Failed to start the session...\n");
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Shutdown
+//
+//  Shuts down the session and the media source.
+//-------------------------------------------------------------------
+
+HRESULT CTranscoder::Shutdown()
+{
+    HRESULT hr = S_OK;
+
+    if (m_pSession)
+    {
+        hr = m_pSession->Shutdown();
+    }
+
+    if (FAILED(hr))
+    {
+        wprintf_s(L"Failed to close the session...\n");
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ReleaseSession
+//
+//  Shuts down the session and returns it to the pool. A session that
+//  failed to shut down is deleted instead.
+//-------------------------------------------------------------------
+
+void CTranscoder::ReleaseSession()
+{
+    if (m_pSession == NULL)
+    {
+        return;
+    }
+
+    HRESULT hr = Shutdown();
+
+    if (SUCCEEDED(hr) && m_pSessionPool)
+    {
+        m_pSessionPool->Release(m_pSession);
+        m_pSession = NULL;
+    }
+
+    SafeDelete(&m_pSession);
+}
@@ -0,0 +1,184 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// Transcode.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+//
+// This sample demonstrates how to perform simple transcoding
+// to any of the output formats in the format registry.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <stdio.h>
+#include <assert.h>
+
+#include "Platform.h"
+#include "Formats.h"
+#include "Backend.h"
+#include "SessionPool.h"
+#include "WorkQueue.h"
+#include "Stats.h"
+#include "Progress.h"
+
+#include <chrono>
+
+class CTranscoder;
+
+// Completion of CTranscoder::BeginEncodeToFile. hr is the result of
+// the encode. The transcoder may be deleted inside the callback.
+typedef void (*PFN_TRANSCODE_COMPLETE)(CTranscoder *pTranscoder, HRESULT hr, void *pContext);
+
+// Periodic progress of a running encode, called on the thread of the
+// CProgressMonitor. It must return quickly and must not delete the
+// transcoder or call back into it.
+typedef void (*PFN_TRANSCODE_PROGRESS)(CTranscoder *pTranscoder, const TranscodeProgress &progress, void *pContext);
+
+class CTranscoder : public ISessionEventCallback
+{
+public:
+    // pDispatcher, if given, is the work queue on which session events
+    // are handled, normally a single thread shared by every transcoder.
+    // Without one, events are handled on the backend's threads.
+    CTranscoder(IMediaBackend *pBackend, CWorkQueue *pDispatcher = NULL);
+    virtual ~CTranscoder();
+
+    HRESULT SetOutputFormat(const OutputFormat *pFormat);
+
+    // Takes the session from pPool instead of creating one, and gives
+    // it back when the job is done. Not owned; call before OpenFile.
+    void    SetSessionPool(CSessionPool *pPool) { m_pSessionPool = pPool; }
+
+    // Ends the job so that the transcoder can run another: the session
+    // is shut down and returned to the pool, or deleted, and the range,
+    // outputs and statistics of the job are cleared. The output format
+    // and the stats log, progress and quiet settings are kept. Fails
+    // while an encode is running.
+    HRESULT Reset();
+
+    HRESULT OpenFile(const WCHAR *sURL);
+
+    // Opens cbData bytes at pData, a whole input file held in memory,
+    // instead of a URL. The caller keeps them valid and unchanged until
+    // the transcoder is deleted.
+    HRESULT OpenFile(const BYTE *pData, UINT64 cbData);
+    HRESULT ConfigureAudioOutput();
+    HRESULT ConfigureVideoOutput();
+    HRESULT ConfigureContainer();
+
+    // Also encodes the source to sURL in pFormat, from the same decoded
+    // samples as the output of EncodeToFile. Call after the Configure
+    // methods and before encoding; up to SESSION_MAX_OUTPUTS - 1 times.
+    HRESULT AddOutput(const OutputFormat *pFormat, const WCHAR *sURL);
+
+    // Lets the encode copy streams that already match the output
+    // format instead of re-encoding them. Allowed by default.
+    HRESULT SetStreamCopy(BOOL fAllow);
+
+    // Converts the audio to sampleRate (Hz); 0 keeps the source rate.
+    // Call after OpenFile and before ConfigureAudioOutput.
+    HRESULT SetSampleRate(UINT32 sampleRate);
+
+    // Encodes only [hnsStart, hnsStop) of the source (100-nanosecond
+    // units). hnsStop 0 encodes to the end. Call before encoding.
+    HRESULT SetRange(LONGLONG hnsStart, LONGLONG hnsStop);
+
+    // Source duration and output sample rate. Call after
+    // ConfigureAudioOutput.
+    HRESULT GetMediaInfo(MediaInfo *pInfo);
+
+    // Fails with HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION) if sURL, or
+    // a path given to AddOutput, names the input file.
+    HRESULT EncodeToFile(const WCHAR *sURL);
+
+    // Encodes the main output into pSink, such as a CMemoryOutput or a
+    // CCallbackOutput, instead of a file. The caller keeps pSink until
+    // the encode completes. Outputs added with AddOutput are files.
+    HRESULT EncodeToFile(IOutputSink *pSink);
+
+    // Starts the encode and returns. pfnComplete is called once when
+    // the output file is finalized or the encode fails; it is not
+    // called if this method fails.
+    HRESULT BeginEncodeToFile(const WCHAR *sURL, PFN_TRANSCODE_COMPLETE pfnComplete, void *pContext);
+    HRESULT BeginEncodeToFile(IOutputSink *pSink, PFN_TRANSCODE_COMPLETE pfnComplete, void *pContext);
+
+    // Appends the record of the job to pLog when the encode completes.
+    // Not owned; NULL stops logging.
+    void    SetStatsLog(CStatsLog *pLog) { m_pStatsLog = pLog; }
+
+    // Polls the encode with pMonitor from SessionEvent_Started until
+    // SessionEvent_Ended. Each poll is passed to pfnProgress, if given,
+    // and appended to the stats log, if any. Not owned; call before
+    // encoding.
+    void    SetProgress(CProgressMonitor *pMonitor, PFN_TRANSCODE_PROGRESS pfnProgress, void *pContext);
+
+    // Stops the progress messages ("Ready to start." ...) of each
+    // event; failures are still reported.
+    void    SetQuiet(BOOL fQuiet) { m_fQuiet = fQuiet; }
+
+    // Phase timings and byte counts of the job. Complete once the
+    // encode has completed.
+    const TranscodeStats& GetStats() const { return m_stats; }
+
+    // ISessionEventCallback
+    void    OnSessionEvent(HRESULT hr, const SessionEvent &event);
+
+private:
+
+    friend class CProgressMonitor;
+
+    HRESULT Open(const WCHAR *sURL, const BYTE *pData, UINT64 cbData);
+    HRESULT Encode(const WCHAR *sURL, IOutputSink *pSink);
+    HRESULT BeginEncode(const WCHAR *sURL, IOutputSink *pSink, PFN_TRANSCODE_COMPLETE pfnComplete, void *pContext);
+    HRESULT Shutdown();
+    void    ReleaseSession();
+    HRESULT Start();
+    void    HandleEvent(HRESULT hr, const SessionEvent &event);
+    void    Complete(HRESULT hr);
+
+    void    BeginPhase();
+    void    EndPhase(TranscodePhase phase);
+
+    void    StartProgress();
+    void    StopProgress();
+    void    PollProgress();
+
+    IMediaBackend*          m_pBackend;
+    CWorkQueue*             m_pDispatcher;
+    const OutputFormat*     m_pFormat;
+    LONGLONG                m_hnsStart;
+    LONGLONG                m_hnsStop;
+
+    ITranscodeSession*      m_pSession;
+    CSessionPool*           m_pSessionPool;
+
+    TranscodeStats          m_stats;
+    CStatsLog*              m_pStatsLog;
+    BOOL                    m_fQuiet;
+    std::chrono::steady_clock::time_point m_tPhase;
+    WCHAR                   m_szInput[MAX_PATH];
+    WCHAR                   m_szOutput[MAX_PATH];
+    IOutputSink*            m_pOutputSink;      // Instead of m_szOutput
+    WCHAR                   m_szExtraOutputs[SESSION_MAX_OUTPUTS - 1][MAX_PATH];
+    DWORD                   m_cExtraOutputs;
+
+    CProgressMonitor*       m_pProgressMonitor;
+    PFN_TRANSCODE_PROGRESS  m_pfnProgress;
+    void*                   m_pProgressContext;
+    BOOL                    m_fPolling;         // Added to the monitor
+    LONGLONG                m_hnsRange;         // Length of the encoded range; 0 if unknown
+    LONGLONG                m_hnsLastPosition;
+    std::chrono::steady_clock::time_point m_tStarted;
+    std::chrono::steady_clock::time_point m_tLastPoll;
+    std::chrono::steady_clock::time_point m_tLastMove;
+
+    PFN_TRANSCODE_COMPLETE  m_pfnComplete;
+    void*                   m_pCompleteContext;
+};
@@ -0,0 +1,589 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// WavFile.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "WavFile.h"
+
+#include <string.h>
+
+#define WAVE_TAG_PCM            0x0001
+#define WAVE_TAG_IEEE_FLOAT     0x0003
+#define WAVE_TAG_EXTENSIBLE     0xFFFE
+
+#define WAVE_MAX_HEADER_SIZE    104     // RIFF, ds64, WAVEFORMATEXTENSIBLE and data headers
+#define WAVE_STREAMING_SIZE     0xFFFFFFFF
+#define WAVE_DS64_SIZE          28      // ds64 payload without a chunk table
+#define WAVE_UNKNOWN_SIZE       ((UINT64)-1)
+
+static UINT32 ReadLE16(const BYTE *p)
+{
+    return (UINT32)p[0] | ((UINT32)p[1] << 8);
+}
+
+static UINT32 ReadLE32(const BYTE *p)
+{
+    return (UINT32)p[0] | ((UINT32)p[1] << 8) | ((UINT32)p[2] << 16) | ((UINT32)p[3] << 24);
+}
+
+static void WriteLE16(BYTE *p, UINT32 v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+}
+
+static UINT64 ReadLE64(const BYTE *p)
+{
+    return (UINT64)ReadLE32(p) | ((UINT64)ReadLE32(p + 4) << 32);
+}
+
+static void WriteLE32(BYTE *p, UINT32 v)
+{
+    p[0] = (BYTE)v;
+    p[1] = (BYTE)(v >> 8);
+    p[2] = (BYTE)(v >> 16);
+    p[3] = (BYTE)(v >> 24);
+}
+
+static void WriteLE64(BYTE *p, UINT64 v)
+{
+    WriteLE32(p, (UINT32)v);
+    WriteLE32(p + 4, (UINT32)(v >> 32));
+}
+
+BOOL IsWavHeader(const BYTE *pData, DWORD cb)
+{
+    return cb >= 12 &&
+        (memcmp(pData, "RIFF", 4) == 0 || memcmp(pData, "RF64", 4) == 0) &&
+        memcmp(pData + 8, "WAVE", 4) == 0;
+}
+
+//-------------------------------------------------------------------
+//  CWavReader
+//-------------------------------------------------------------------
+
+CWavReader::CWavReader() :
+    m_pFile(NULL),
+    m_cbDataOffset(0),
+    m_cbData(0),
+    m_cbPosition(0)
+{
+    memset(&m_format, 0, sizeof(m_format));
+}
+
+CWavReader::~CWavReader()
+{
+    Close();
+}
+
+void CWavReader::Close()
+{
+    m_pFile = NULL;
+    m_file.Close();
+}
+
+//-------------------------------------------------------------------
+//  Open
+//
+//  Opens the file and locates the fmt and data chunks.
+//-------------------------------------------------------------------
+
+HRESULT CWavReader::Open(const WCHAR *sPath)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    Close();
+
+    HRESULT hr = m_file.Open(sPath);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Open(&m_file);
+    }
+
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+HRESULT CWavReader::Open(CMappedFile *pFile)
+{
+    if (!pFile)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (pFile != &m_file)
+    {
+        Close();
+    }
+
+    m_pFile = pFile;
+
+    HRESULT hr = ParseHeader();
+
+    if (FAILED(hr))
+    {
+        Close();
+    }
+    return hr;
+}
+
+HRESULT CWavReader::ParseHeader()
+{
+    const BYTE *pHeader = NULL;
+    DWORD cbHeader = 0;
+
+    HRESULT hr = m_pFile->View(0, 12, &pHeader, &cbHeader);
+
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    if (!IsWavHeader(pHeader, cbHeader))
+    {
+        return MF_E_UNSUPPORTED_BYTESTREAM_TYPE;
+    }
+
+    UINT64 cbOffset = 12;
+    UINT64 cbData64 = WAVE_UNKNOWN_SIZE;    // From the ds64 chunk of an RF64 file
+    BOOL fFormat = FALSE;
+
+    for (;;)
+    {
+        const BYTE *pChunk = NULL;
+        DWORD cbView = 0;
+
+        hr = m_pFile->View(cbOffset, 8, &pChunk, &cbView);
+
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        if (cbView != 8)
+        {
+            return MF_E_INVALID_FORMAT;
+        }
+
+        BOOL fFmtChunk = memcmp(pChunk, "fmt ", 4) == 0;
+        BOOL fDataChunk = memcmp(pChunk, "data", 4) == 0;
+        BOOL fDs64Chunk = memcmp(pChunk, "ds64", 4) == 0;
+        UINT32 cbChunk = ReadLE32(pChunk + 4);
+
+        cbOffset += 8;
+
+        if (fDs64Chunk)
+        {
+            const BYTE *pDs64 = NULL;
+
+            hr = m_pFile->View(cbOffset, 24, &pDs64, &cbView);
+
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+
+            if (cbChunk < 24 || cbView != 24)
+            {
+                return MF_E_INVALID_FORMAT;
+            }
+
+            // RIFF size, data size, sample count.
+            cbData64 = ReadLE64(pDs64 + 8);
+        }
+        else if (fFmtChunk)
+        {
+            const BYTE *pFmt = NULL;
+            DWORD cbRead = cbChunk < 40 ? cbChunk : 40;
+
+            hr = m_pFile->View(cbOffset, cbRead, &pFmt, &cbView);
+
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+
+            if (cbChunk < 16 || cbView != cbRead)
+            {
+                return MF_E_INVALID_FORMAT;
+            }
+
+            UINT32 tag = ReadLE16(pFmt);
+
+            // WAVEFORMATEXTENSIBLE: the subformat GUID starts with the tag.
+            if (tag == WAVE_TAG_EXTENSIBLE && cbRead >= 26)
+            {
+                tag = ReadLE16(pFmt + 24);
+            }
+
+            if (tag != WAVE_TAG_PCM && tag != WAVE_TAG_IEEE_FLOAT)
+            {
+                return MF_E_INVALIDMEDIATYPE;
+            }
+
+            m_format.channels = ReadLE16(pFmt + 2);
+            m_format.sampleRate = ReadLE32(pFmt + 4);
+            m_format.bitsPerSample = ReadLE16(pFmt + 14);
+            m_format.fFloat = (tag == WAVE_TAG_IEEE_FLOAT);
+
+            if (!IsSupportedPcmFormat(m_format))
+            {
+                return MF_E_INVALIDMEDIATYPE;
+            }
+
+            fFormat = TRUE;
+        }
+        else if (fDataChunk)
+        {
+            if (!fFormat)
+            {
+                return MF_E_INVALID_FORMAT;
+            }
+
+            m_cbDataOffset = cbOffset;
+            m_cbData = cbChunk;
+            m_cbPosition = 0;
+
+            // In an RF64 file a data size of 0xFFFFFFFF defers to ds64.
+            // A writer that cannot seek back leaves it at 0xFFFFFFFF, or
+            // at 0 on a stream; the data then runs to the end of the
+            // input.
+            if (cbChunk == WAVE_STREAMING_SIZE && cbData64 != WAVE_UNKNOWN_SIZE)
+            {
+                m_cbData = cbData64;
+            }
+            else if (cbChunk == WAVE_STREAMING_SIZE || (cbChunk == 0 && m_pFile->IsStream()))
+            {
+                m_cbData = m_pFile->IsStream() ? WAVE_UNKNOWN_SIZE : m_pFile->Size() - cbOffset;
+            }
+
+            if (m_cbData != WAVE_UNKNOWN_SIZE)
+            {
+                m_cbData -= m_cbData % PcmBlockAlign(m_format);
+            }
+            return S_OK;
+        }
+
+        // Skip the rest of the chunk, including the pad byte.
+        cbOffset += (UINT64)cbChunk + (cbChunk & 1);
+
+        if (!m_pFile->IsStream() && cbOffset > m_pFile->Size())
+        {
+            return MF_E_INVALID_FORMAT;
+        }
+    }
+}
+
+UINT64 CWavReader::FrameCount() const
+{
+    UINT32 cbFrame = PcmBlockAlign(m_format);
+    return (cbFrame && m_cbData != WAVE_UNKNOWN_SIZE) ? m_cbData / cbFrame : 0;
+}
+
+LONGLONG CWavReader::Duration() const
+{
+    if (m_format.sampleRate == 0)
+    {
+        return 0;
+    }
+    return (LONGLONG)(FrameCount() * 10000000ULL / m_format.sampleRate);
+}
+
+HRESULT CWavReader::SeekToFrame(UINT64 iFrame)
+{
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    UINT64 cbPosition = iFrame * PcmBlockAlign(m_format);
+    if (cbPosition > m_cbData)
+    {
+        cbPosition = m_cbData;
+    }
+
+    m_cbPosition = cbPosition;
+    return S_OK;
+}
+
+HRESULT CWavReader::Read(DWORD cbMax, const BYTE **ppData, DWORD *pcbRead)
+{
+    if (!ppData || !pcbRead)
+    {
+        return E_POINTER;
+    }
+
+    *ppData = NULL;
+    *pcbRead = 0;
+
+    if (!m_pFile)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    UINT32 cbFrame = PcmBlockAlign(m_format);
+    UINT64 cbLeft = m_cbData - m_cbPosition;
+    DWORD cbWanted = (DWORD)(cbLeft < cbMax ? cbLeft : cbMax);
+
+    cbWanted -= cbWanted % cbFrame;
+
+    if (cbWanted == 0)
+    {
+        return S_OK;
+    }
+
+    DWORD cbRead = 0;
+
+    HRESULT hr = m_pFile->View(m_cbDataOffset + m_cbPosition, cbWanted, ppData, &cbRead);
+
+    if (SUCCEEDED(hr))
+    {
+        // A truncated file ends at the last whole frame.
+        cbRead -= cbRead % cbFrame;
+
+        m_cbPosition += cbRead;
+        *pcbRead = cbRead;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  CWavWriter
+//-------------------------------------------------------------------
+
+CWavWriter::CWavWriter() :
+    m_fDs64(FALSE),
+    m_cbHeader(0),
+    m_cbData(0)
+{
+    memset(&m_format, 0, sizeof(m_format));
+}
+
+CWavWriter::~CWavWriter()
+{
+
+}
+
+HRESULT CWavWriter::Create(const WCHAR *sPath, const PcmFormat &format, UINT64 cbExpected)
+{
+    if (!sPath)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!IsSupportedPcmFormat(format))
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    if (m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_file.Create(sPath, cbExpected ? cbExpected + WAVE_MAX_HEADER_SIZE : 0);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Begin(format);
+    }
+    return hr;
+}
+
+HRESULT CWavWriter::Create(IOutputSink *pSink, const PcmFormat &format, UINT64 cbExpected)
+{
+    if (!pSink)
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!IsSupportedPcmFormat(format))
+    {
+        return MF_E_INVALIDMEDIATYPE;
+    }
+
+    if (m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = m_file.Open(pSink, cbExpected ? cbExpected + WAVE_MAX_HEADER_SIZE : 0);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = Begin(format);
+    }
+    return hr;
+}
+
+HRESULT CWavWriter::Begin(const PcmFormat &format)
+{
+    m_format = format;
+    m_cbData = 0;
+
+    return WriteHeader();
+}
+
+//-------------------------------------------------------------------
+//  WriteHeader
+//
+//  Writes the header with unknown sizes. Unless the output is a stream,
+//  room for a ds64 chunk is kept as a JUNK chunk, so that Finalize can
+//  turn a file that outgrew 4 GB into RF64 in place.
+//-------------------------------------------------------------------
+
+HRESULT CWavWriter::WriteHeader()
+{
+    BYTE header[WAVE_MAX_HEADER_SIZE];
+
+    m_fDs64 = !m_file.IsStream();
+    m_cbHeader = FormatHeader(header, FALSE);
+
+    return m_file.Write(header, m_cbHeader);
+}
+
+//-------------------------------------------------------------------
+//  FormatHeader
+//
+//  Formats the RIFF header, the JUNK or ds64 chunk, the fmt chunk and
+//  the data chunk header. Formats that WAVEFORMATEX cannot describe
+//  unambiguously (more than two channels or more than 16 bits) use
+//  WAVEFORMATEXTENSIBLE. Until fFinal the sizes are left at 0xFFFFFFFF,
+//  which on a stream means the data runs to the end. Past 4 GB the
+//  RIFF and data sizes stay at 0xFFFFFFFF and ds64 holds the real ones
+//  (EBU Tech 3306).
+//-------------------------------------------------------------------
+
+DWORD CWavWriter::FormatHeader(BYTE *pHeader, BOOL fFinal) const
+{
+    static const BYTE subformatTail[14] =
+    {
+        0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+        0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+    };
+
+    BOOL fExtensible = m_format.channels > 2 || m_format.bitsPerSample > 16;
+    UINT32 cbFmt = fExtensible ? 40 : 16;
+    UINT32 tag = m_format.fFloat ? WAVE_TAG_IEEE_FLOAT : WAVE_TAG_PCM;
+    DWORD cbHeader = 12 + (m_fDs64 ? 8 + WAVE_DS64_SIZE : 0) + 8 + cbFmt + 8;
+
+    UINT64 cbRiff = cbHeader - 8 + m_cbData + (m_cbData & 1);
+    BOOL fRf64 = fFinal && m_fDs64 && cbRiff > 0xFFFFFFFFULL;
+    UINT32 cbRiff32 = (fFinal && !fRf64) ? (UINT32)cbRiff : WAVE_STREAMING_SIZE;
+    UINT32 cbData32 = (fFinal && !fRf64) ? (UINT32)m_cbData : WAVE_STREAMING_SIZE;
+
+    memset(pHeader, 0, cbHeader);
+
+    memcpy(pHeader, fRf64 ? "RF64" : "RIFF", 4);
+    WriteLE32(pHeader + 4, cbRiff32);
+    memcpy(pHeader + 8, "WAVE", 4);
+
+    BYTE *pChunk = pHeader + 12;
+
+    if (m_fDs64)
+    {
+        memcpy(pChunk, fRf64 ? "ds64" : "JUNK", 4);
+        WriteLE32(pChunk + 4, WAVE_DS64_SIZE);
+
+        if (fRf64)
+        {
+            UINT32 cbFrame = PcmBlockAlign(m_format);
+
+            WriteLE64(pChunk + 8, cbRiff);
+            WriteLE64(pChunk + 16, m_cbData);
+            WriteLE64(pChunk + 24, cbFrame ? m_cbData / cbFrame : 0);
+            WriteLE32(pChunk + 32, 0);              // No chunk size table
+        }
+        pChunk += 8 + WAVE_DS64_SIZE;
+    }
+
+    memcpy(pChunk, "fmt ", 4);
+    WriteLE32(pChunk + 4, cbFmt);
+
+    BYTE *pFmt = pChunk + 8;
+    WriteLE16(pFmt, fExtensible ? WAVE_TAG_EXTENSIBLE : tag);
+    WriteLE16(pFmt + 2, m_format.channels);
+    WriteLE32(pFmt + 4, m_format.sampleRate);
+    WriteLE32(pFmt + 8, PcmBytesPerSecond(m_format));
+    WriteLE16(pFmt + 12, PcmBlockAlign(m_format));
+    WriteLE16(pFmt + 14, m_format.bitsPerSample);
+
+    if (fExtensible)
+    {
+        WriteLE16(pFmt + 16, 22);                   // cbSize
+        WriteLE16(pFmt + 18, m_format.bitsPerSample);
+        WriteLE32(pFmt + 20, 0);                    // dwChannelMask: unspecified
+        WriteLE16(pFmt + 24, tag);
+        memcpy(pFmt + 26, subformatTail, sizeof(subformatTail));
+    }
+
+    BYTE *pData = pFmt + cbFmt;
+    memcpy(pData, "data", 4);
+    WriteLE32(pData + 4, cbData32);
+
+    return cbHeader;
+}
+
+HRESULT CWavWriter::Write(const BYTE *pData, DWORD cbData)
+{
+    HRESULT hr = m_file.Write(pData, cbData);
+
+    if (SUCCEEDED(hr))
+    {
+        m_cbData += cbData;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  Finalize
+//
+//  Pads the data chunk to an even size and, unless the output is a
+//  stream, rewrites the header with the final sizes in one write. A
+//  file of more than 4 GB becomes RF64.
+//-------------------------------------------------------------------
+
+HRESULT CWavWriter::Finalize()
+{
+    if (!m_file.IsOpen())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    HRESULT hr = S_OK;
+
+    if (m_cbData & 1)
+    {
+        BYTE pad = 0;
+        hr = m_file.Write(&pad, 1);
+    }
+
+    if (SUCCEEDED(hr) && !m_file.IsStream())
+    {
+        BYTE header[WAVE_MAX_HEADER_SIZE];
+        DWORD cbHeader = FormatHeader(header, TRUE);
+
+        hr = m_file.WriteAt(0, header, cbHeader);
+    }
+
+    HRESULT hrClose = m_file.Close();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = hrClose;
+    }
+    return hr;
+}
@@ -0,0 +1,111 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// WavFile.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// RIFF/WAVE reader and writer used by the portable backend.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+#include "MappedFile.h"
+#include "OutputFile.h"
+#include "Pcm.h"
+
+// Returns TRUE if the first cb bytes of a file look like a WAVE file.
+BOOL IsWavHeader(const BYTE *pData, DWORD cb);
+
+//-------------------------------------------------------------------
+//  CWavReader
+//
+//  Reads the PCM data chunk of a WAVE file in whole frames, straight
+//  out of the file's mapping.
+//-------------------------------------------------------------------
+
+class CWavReader
+{
+public:
+    CWavReader();
+    ~CWavReader();
+
+    HRESULT Open(const WCHAR *sPath);
+
+    // Reads from pFile, which the caller keeps open until Close.
+    HRESULT Open(CMappedFile *pFile);
+    void    Close();
+
+    const PcmFormat& Format() const { return m_format; }
+
+    // 0 if the data chunk runs to the end of an input stream of unknown
+    // length.
+    UINT64  FrameCount() const;
+    LONGLONG Duration() const;      // 100-nanosecond units
+
+    // Positions the reader at the given frame.
+    HRESULT SeekToFrame(UINT64 iFrame);
+
+    // Points *ppData at the next cbMax bytes or fewer, rounded down to
+    // whole frames, and consumes them. *pcbRead is 0 at the end of the
+    // data chunk. The data stays valid until the next Read.
+    HRESULT Read(DWORD cbMax, const BYTE **ppData, DWORD *pcbRead);
+
+private:
+
+    HRESULT ParseHeader();
+
+    CMappedFile m_file;             // If opened by path
+    CMappedFile* m_pFile;           // m_file or the caller's
+    PcmFormat   m_format;
+    UINT64      m_cbDataOffset;     // File offset of the data chunk payload
+    UINT64      m_cbData;           // Size of the data chunk payload
+    UINT64      m_cbPosition;       // Bytes of payload consumed
+};
+
+//-------------------------------------------------------------------
+//  CWavWriter
+//
+//  Writes a WAVE file through a write-behind COutputFile. The header is
+//  rewritten once, with the final sizes, when the file is finalized,
+//  and a file of more than 4 GB becomes RF64. On a stream the sizes
+//  stay at the 0xFFFFFFFF streaming size.
+//-------------------------------------------------------------------
+
+class CWavWriter
+{
+public:
+    CWavWriter();
+    ~CWavWriter();
+
+    // cbExpected is the estimated size of the samples, reserved on
+    // disk with the header; 0 reserves nothing.
+    HRESULT Create(const WCHAR *sPath, const PcmFormat &format, UINT64 cbExpected = 0);
+
+    // Writes to pSink, which the caller keeps until Finalize.
+    HRESULT Create(IOutputSink *pSink, const PcmFormat &format, UINT64 cbExpected = 0);
+    HRESULT Write(const BYTE *pData, DWORD cbData);
+    HRESULT Finalize();
+
+    // Closes the file as it is.
+    void    Close() { (void)m_file.Close(); }
+
+    UINT64  BytesWritten() const { return m_cbData; }
+
+private:
+
+    HRESULT Begin(const PcmFormat &format);
+    HRESULT WriteHeader();
+    DWORD   FormatHeader(BYTE *pHeader, BOOL fFinal) const;
+
+    COutputFile m_file;
+    PcmFormat   m_format;
+    BOOL        m_fDs64;            // Room kept for a ds64 chunk
+    DWORD       m_cbHeader;
+    UINT64      m_cbData;
+};
@@ -0,0 +1,168 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// WorkQueue.cpp
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "WorkQueue.h"
+
+#include <exception>
+
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+CWorkQueue::CWorkQueue() : m_fRunning(FALSE), m_fStopping(FALSE)
+{
+
+}
+
+CWorkQueue::~CWorkQueue()
+{
+    Stop();
+}
+
+HRESULT CWorkQueue::Start(DWORD cThreads)
+{
+    if (!m_threads.empty())
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    if (cThreads == 0)
+    {
+        cThreads = (DWORD)std::thread::hardware_concurrency();
+        cThreads = cThreads ? cThreads : 1;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_fRunning = TRUE;
+        m_fStopping = FALSE;
+    }
+
+    try
+    {
+        for (DWORD i = 0; i < cThreads; i++)
+        {
+            m_threads.push_back(std::thread(&CWorkQueue::ThreadProc, this));
+        }
+    }
+    catch (const std::exception&)
+    {
+        Stop();
+        return E_OUTOFMEMORY;
+    }
+    return S_OK;
+}
+
+void CWorkQueue::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_fStopping = TRUE;
+    }
+    m_cvItems.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); i++)
+    {
+        m_threads[i].join();
+    }
+    m_threads.clear();
+
+    // Items that arrived after the last thread exited run here.
+    for (;;)
+    {
+        WorkItem item;
+
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+
+            if (m_items.empty())
+            {
+                m_fRunning = FALSE;
+                break;
+            }
+
+            item = m_items.front();
+            m_items.pop_front();
+        }
+
+        item();
+    }
+}
+
+HRESULT CWorkQueue::Put(const WorkItem &item)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+
+        // Items queued while the queue drains still run.
+        if (!m_fRunning)
+        {
+            return MF_E_SHUTDOWN;
+        }
+
+        try
+        {
+            m_items.push_back(item);
+        }
+        catch (const std::exception&)
+        {
+            return E_OUTOFMEMORY;
+        }
+    }
+    m_cvItems.notify_one();
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  ThreadProc
+//
+//  Runs items until the queue is stopped and drained. On Windows each
+//  thread joins the multithreaded apartment, since items call into
+//  Media Foundation.
+//-------------------------------------------------------------------
+
+void CWorkQueue::ThreadProc()
+{
+#ifdef _WIN32
+    HRESULT hrCom = CoInitializeEx(NULL, COINIT_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+#endif
+
+    for (;;)
+    {
+        WorkItem item;
+
+        {
+            std::unique_lock<std::mutex> lock(m_lock);
+
+            while (m_items.empty() && !m_fStopping)
+            {
+                m_cvItems.wait(lock);
+            }
+
+            if (m_items.empty())
+            {
+                break;      // Stopping and drained.
+            }
+
+            item = m_items.front();
+            m_items.pop_front();
+        }
+
+        item();
+    }
+
+#ifdef _WIN32
+    if (SUCCEEDED(hrCom))
+    {
+        CoUninitialize();
+    }
+#endif
+}
@@ -0,0 +1,60 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// WorkQueue.h
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+//
+// A FIFO of work items served by a fixed set of threads. With one
+// thread it is the event dispatcher that drives CTranscoder sessions;
+// the portable backend uses a larger one to run jobs, in the role of
+// the Media Foundation work queues.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "Platform.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::function<void()> WorkItem;
+
+class CWorkQueue
+{
+public:
+    CWorkQueue();
+    ~CWorkQueue();
+
+    // Starts cThreads threads. 0 uses one per processor.
+    HRESULT Start(DWORD cThreads);
+
+    // Runs the items already queued, then stops the threads. Items
+    // may queue further items while the queue drains.
+    void    Stop();
+
+    // Queues an item. Fails with MF_E_SHUTDOWN when the queue is not
+    // running.
+    HRESULT Put(const WorkItem &item);
+
+    DWORD   ThreadCount() const { return (DWORD)m_threads.size(); }
+
+private:
+
+    void    ThreadProc();
+
+    std::mutex                  m_lock;
+    std::condition_variable     m_cvItems;
+    std::deque<WorkItem>        m_items;
+    std::vector<std::thread>    m_threads;
+    BOOL                        m_fRunning;
+    BOOL                        m_fStopping;
+};
@@ -0,0 +1,1005 @@
+//////////////////////////////////////////////////////////////////////////
+//
+// main.cpp - Defines the entry point for the console application.
+//
+// THIS CODE AND INFORMATION IS PROVIDED "AS IS" WITHOUT WARRANTY OF
+// ANY KIND, EITHER EXPRESSED OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE IMPLIED WARRANTIES OF MERCHANTABILITY AND/OR FITNESS FOR A
+// PARTICULAR PURPOSE.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//
+// This sample demonstrates how to perform simple transcoding
+// to any of the output formats in the format registry.
+//
+//////////////////////////////////////////////////////////////////////////
+
+#include "Transcode.h"
+#include "Batch.h"
+#include "Segment.h"
+#include "Ladder.h"
+#include "OutputFile.h"
+
+#include <stdlib.h>
+#include <wchar.h>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#ifndef _WIN32
+#include <locale.h>
+#endif
+
+// What every job of a run shares: the output format and any more
+// formats or ladder renditions encoded from the same decoded source,
+// the backend, whether streams may be copied, the output sample rate,
+// the number of segments to split a single file into, the log that
+// receives job statistics, the monitor that polls job progress and,
+// in batch and segmented mode, the dispatcher that handles session
+// events. Batch jobs take their sessions from a pool.
+struct TranscodeContext
+{
+    const OutputFormat  *pFormat;
+    const OutputFormat  *pExtraFormats[SESSION_MAX_OUTPUTS - 1];
+    DWORD               cExtraFormats;
+    const CBitrateLadder *pLadder;      // NULL without -ladder
+    IMediaBackend       *pBackend;
+    BOOL                fStreamCopy;
+    UINT32              sampleRate;     // 0 keeps the source rate
+    DWORD               cSegments;
+    CStatsLog           *pStatsLog;     // NULL without -stats
+    CProgressMonitor    *pProgress;     // NULL without -progress
+    CWorkQueue          *pDispatcher;
+    CSessionPool        *pSessionPool;  // Batch mode
+    struct TranscoderSlots *pTranscoders; // Batch mode
+    const WCHAR         *sInputFile;    // Segmented mode
+};
+
+//-------------------------------------------------------------------
+//  PrintProgress
+//
+//  Progress callback; pContext is the input file name.
+//-------------------------------------------------------------------
+
+static void PrintProgress(CTranscoder*, const TranscodeProgress &progress, void *pContext)
+{
+    const WCHAR *sInputFile = (const WCHAR*)pContext;
+
+    double position = progress.hnsPosition / 10000000.0;
+
+    if (progress.hnsDuration > 0)
+    {
+        double duration = progress.hnsDuration / 10000000.0;
+
+        wprintf_s(L"Progress: %ls %.1f%% (%.1f of %.1f s), %.1fx real time, ETA ",
+            sInputFile, 100 * position / duration, position, duration, progress.realtimeFactor);
+
+        if (progress.etaSeconds >= 0)
+        {
+            wprintf_s(L"%.1f s\n", progress.etaSeconds);
+        }
+        else
+        {
+            wprintf_s(L"unknown\n");
+        }
+    }
+    else
+    {
+        wprintf_s(L"Progress: %ls %.1f s, %.1fx real time\n",
+            sInputFile, position, progress.realtimeFactor);
+    }
+}
+
+//-------------------------------------------------------------------
+//  PrepareTranscoder
+//
+//  Opens the input file and configures the transcode profile.
+//-------------------------------------------------------------------
+
+static HRESULT PrepareTranscoder(CTranscoder *pTranscoder, const WCHAR *sInputFile, const TranscodeContext *pRun)
+{
+    HRESULT hr = S_OK;
+
+    pTranscoder->SetStatsLog(pRun->pStatsLog);
+
+    if (pRun->pProgress)
+    {
+        pTranscoder->SetProgress(pRun->pProgress, PrintProgress, (void*)sInputFile);
+    }
+
+    hr = pTranscoder->SetOutputFormat(pRun->pFormat);
+
+    // Create a media source for the input file.
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->OpenFile(sInputFile);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        wprintf_s(L"Opened file: %ls.\n", sInputFile);
+
+        hr = pTranscoder->SetSampleRate(pRun->sampleRate);
+    }
+
+    //Configure the profile and build a topology.
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureAudioOutput();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureVideoOutput();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->ConfigureContainer();
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->SetStreamCopy(pRun->fStreamCopy);
+    }
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  ParseFormatList
+//
+//  Parses the -f argument, one format name or several separated by
+//  commas. The first format is the main one. Formats that share an
+//  extension are rejected, since their outputs would have the same
+//  name.
+//-------------------------------------------------------------------
+
+static HRESULT ParseFormatList(const WCHAR *sList, TranscodeContext *pRun)
+{
+    const OutputFormat *formats[SESSION_MAX_OUTPUTS];
+    DWORD cFormats = 0;
+
+    const WCHAR *pName = sList;
+
+    while (*pName)
+    {
+        const WCHAR *pEnd = wcschr(pName, L',');
+        size_t cchName = pEnd ? (size_t)(pEnd - pName) : wcslen(pName);
+
+        WCHAR szName[32];
+
+        if (cchName == 0 || cchName >= ARRAYSIZE(szName))
+        {
+            wprintf_s(L"Unknown output format: %.*ls\n", (int)cchName, pName);
+            return E_INVALIDARG;
+        }
+
+        wmemcpy(szName, pName, cchName);
+        szName[cchName] = L'\0';
+
+        const OutputFormat *pFormat = FindOutputFormat(szName);
+
+        if (pFormat == NULL)
+        {
+            wprintf_s(L"Unknown output format: %ls\n", szName);
+            return E_INVALIDARG;
+        }
+
+        if (cFormats == ARRAYSIZE(formats))
+        {
+            wprintf_s(L"At most %u output formats.\n", (UINT32)ARRAYSIZE(formats));
+            return E_INVALIDARG;
+        }
+
+        for (DWORD i = 0; i < cFormats; i++)
+        {
+            if (_wcsicmp(formats[i]->sExtension, pFormat->sExtension) == 0)
+            {
+                wprintf_s(L"Output formats %ls and %ls both use %ls.\n",
+                    formats[i]->sName, pFormat->sName, pFormat->sExtension);
+                return E_INVALIDARG;
+            }
+        }
+
+        formats[cFormats++] = pFormat;
+        pName += cchName + (pEnd ? 1 : 0);
+    }
+
+    if (cFormats == 0)
+    {
+        return E_INVALIDARG;
+    }
+
+    pRun->pFormat = formats[0];
+    pRun->cExtraFormats = cFormats - 1;
+
+    for (DWORD i = 1; i < cFormats; i++)
+    {
+        pRun->pExtraFormats[i - 1] = formats[i];
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  GetMainOutput
+//
+//  Names the output of the main format: sOutputFile itself or, with a
+//  ladder, the top rendition named after it.
+//-------------------------------------------------------------------
+
+static HRESULT GetMainOutput(const WCHAR *sOutputFile, const TranscodeContext *pRun, WCHAR *szOutput)
+{
+    if (pRun->pLadder)
+    {
+        return pRun->pLadder->GetOutputName(0, sOutputFile, szOutput, MAX_PATH);
+    }
+
+    if (wcscpy_s(szOutput, MAX_PATH, sOutputFile) != 0)
+    {
+        return HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+    }
+    return S_OK;
+}
+
+//-------------------------------------------------------------------
+//  AddLadderOutputs
+//
+//  Adds an output for each ladder rendition below the top one.
+//-------------------------------------------------------------------
+
+static HRESULT AddLadderOutputs(CTranscoder *pTranscoder, const WCHAR *sOutputFile, const CBitrateLadder *pLadder)
+{
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 1; i < pLadder->RungCount() && SUCCEEDED(hr); i++)
+    {
+        WCHAR szOutput[MAX_PATH];
+
+        hr = pLadder->GetOutputName(i, sOutputFile, szOutput, MAX_PATH);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = pTranscoder->AddOutput(pLadder->GetFormat(i), szOutput);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            wprintf_s(L"Added output: %ls (%ls).\n", szOutput, pLadder->GetFormat(i)->sName);
+        }
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  AddExtraOutputs
+//
+//  Adds an output for each extra format, named after sOutputFile with
+//  the extension of the format, or for each ladder rendition.
+//-------------------------------------------------------------------
+
+static HRESULT AddExtraOutputs(CTranscoder *pTranscoder, const WCHAR *sOutputFile, const TranscodeContext *pRun)
+{
+    if (pRun->pLadder)
+    {
+        return AddLadderOutputs(pTranscoder, sOutputFile, pRun->pLadder);
+    }
+
+    size_t iName, cchBase;
+    SplitPathName(sOutputFile, &iName, &cchBase);
+
+    HRESULT hr = S_OK;
+
+    for (DWORD i = 0; i < pRun->cExtraFormats && SUCCEEDED(hr); i++)
+    {
+        const OutputFormat *pFormat = pRun->pExtraFormats[i];
+        WCHAR szOutput[MAX_PATH];
+
+        if (swprintf_s(szOutput, MAX_PATH, L"%.*ls%ls", (int)cchBase, sOutputFile, pFormat->sExtension) < 0)
+        {
+            hr = HRESULT_FROM_WIN32(ERROR_FILENAME_EXCED_RANGE);
+        }
+        else if (_wcsicmp(szOutput, sOutputFile) == 0)
+        {
+            wprintf_s(L"Output %ls would be written twice.\n", szOutput);
+            hr = E_INVALIDARG;
+        }
+        else
+        {
+            hr = pTranscoder->AddOutput(pFormat, szOutput);
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            wprintf_s(L"Added output: %ls (%ls).\n", szOutput, pFormat->sName);
+        }
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  BeginTranscodeSegment
+//
+//  Starts one segment of a segmented encode. The transcoder lives
+//  until the encode completes on the dispatcher thread.
+//-------------------------------------------------------------------
+
+static void OnSegmentEncoded(CTranscoder *pTranscoder, HRESULT hr, void *pContext)
+{
+    delete pTranscoder;
+
+    CSegmentedEncode::CompleteSegment((SegmentJob*)pContext, hr);
+}
+
+static HRESULT BeginTranscodeSegment(SegmentJob *pJob, void *pContext)
+{
+    const TranscodeContext *pRun = (const TranscodeContext*)pContext;
+
+    CTranscoder *pTranscoder = new (std::nothrow) CTranscoder(pRun->pBackend, pRun->pDispatcher);
+
+    if (pTranscoder == NULL)
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    HRESULT hr = PrepareTranscoder(pTranscoder, pRun->sInputFile, pRun);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->SetRange(pJob->hnsStart, pJob->hnsStop);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->BeginEncodeToFile(pJob->szOutput, OnSegmentEncoded, pJob);
+    }
+
+    if (FAILED(hr))
+    {
+        delete pTranscoder;
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  TranscodeFileSegmented
+//
+//  Splits the input into time ranges, encodes them concurrently and
+//  joins them. *pfDone is FALSE if the input is too short to split or
+//  the output cannot be joined; the caller then encodes it whole. The
+//  filler written by the fake backend cannot be joined. Several output
+//  formats share one decode, so they are not segmented, and neither is
+//  a rate conversion, whose filter would restart at every join.
+//  Standard input can be read only once, and standard output is
+//  written in order, so neither is segmented.
+//-------------------------------------------------------------------
+
+static HRESULT TranscodeFileSegmented(const WCHAR *sInputFile, const WCHAR *sOutputFile, TranscodeContext *pRun, BOOL *pfDone)
+{
+    *pfDone = FALSE;
+
+    if (!CanSegmentFormat(pRun->pFormat) || pRun->cExtraFormats > 0 || pRun->sampleRate != 0 ||
+        _wcsicmp(pRun->pBackend->GetName(), L"fake") == 0 ||
+        IsStdStreamPath(sInputFile) || IsStdStreamPath(sOutputFile))
+    {
+        return S_OK;
+    }
+
+    MediaInfo info = { 0, 0, 0 };
+    CSegmentedEncode encode;
+
+    HRESULT hr = S_OK;
+
+    // Probe the source for the length and the output sample rate.
+    {
+        CTranscoder probe(pRun->pBackend);
+
+        hr = PrepareTranscoder(&probe, sInputFile, pRun);
+
+        if (SUCCEEDED(hr))
+        {
+            hr = probe.GetMediaInfo(&info);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = encode.Plan(pRun->pFormat, info, pRun->cSegments, sOutputFile);
+    }
+
+    if (FAILED(hr) || encode.SegmentCount() < 2)
+    {
+        return hr;
+    }
+
+    wprintf_s(L"Encoding in %u segments.\n", encode.SegmentCount());
+
+    *pfDone = TRUE;
+    pRun->sInputFile = sInputFile;
+
+    hr = pRun->pDispatcher->Start(1);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = encode.Run(BeginTranscodeSegment, pRun);
+
+        pRun->pDispatcher->Stop();
+    }
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  TranscodeFile
+//
+//  Transcodes one file and waits for it. Used in single-file mode.
+//-------------------------------------------------------------------
+
+static HRESULT TranscodeFile(const WCHAR *sInputFile, const WCHAR *sOutputFile, TranscodeContext *pRun)
+{
+    if (IsSameFile(sInputFile, sOutputFile))
+    {
+        wprintf_s(L"Output %ls is the input file.\n", sOutputFile);
+        return HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION);
+    }
+
+    if (pRun->cSegments > 1)
+    {
+        BOOL fDone = FALSE;
+
+        HRESULT hr = TranscodeFileSegmented(sInputFile, sOutputFile, pRun, &fDone);
+
+        if (SUCCEEDED(hr) && fDone)
+        {
+            wprintf_s(L"Output file created: %ls\n", sOutputFile);
+        }
+
+        if (FAILED(hr) || fDone)
+        {
+            return hr;
+        }
+    }
+
+    CTranscoder transcoder(pRun->pBackend);
+
+    WCHAR szOutput[MAX_PATH];
+
+    HRESULT hr = PrepareTranscoder(&transcoder, sInputFile, pRun);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = GetMainOutput(sOutputFile, pRun, szOutput);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = AddExtraOutputs(&transcoder, sOutputFile, pRun);
+    }
+
+    //Transcode and generate the output file.
+
+    if (SUCCEEDED(hr))
+    {
+        hr = transcoder.EncodeToFile(szOutput);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        wprintf_s(L"Output file created: %ls\n", szOutput);
+    }
+
+    return hr;
+}
+
+//-------------------------------------------------------------------
+//  TranscoderSlots
+//
+//  The transcoders of a batch, one per job in flight. A job takes an
+//  idle slot when it starts and returns it, with the transcoder reset,
+//  when it completes and before the batch frees its place, so a slot
+//  is always idle when a job starts.
+//-------------------------------------------------------------------
+
+struct TranscoderSlot
+{
+    CTranscoder             *pTranscoder;
+    BatchJob                *pJob;          // Running on the transcoder
+    struct TranscoderSlots  *pOwner;
+};
+
+struct TranscoderSlots
+{
+    std::mutex                      lock;
+    std::vector<TranscoderSlot>     slots;
+    std::vector<TranscoderSlot*>    idle;
+
+    ~TranscoderSlots()
+    {
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            delete slots[i].pTranscoder;
+        }
+    }
+
+    HRESULT Create(DWORD cSlots, const TranscodeContext *pRun)
+    {
+        try
+        {
+            TranscoderSlot slot = { NULL, NULL, this };
+
+            slots.assign(cSlots, slot);
+            idle.reserve(cSlots);
+        }
+        catch (const std::exception&)
+        {
+            return E_OUTOFMEMORY;
+        }
+
+        for (DWORD i = 0; i < cSlots; i++)
+        {
+            slots[i].pTranscoder = new (std::nothrow) CTranscoder(pRun->pBackend, pRun->pDispatcher);
+
+            if (slots[i].pTranscoder == NULL)
+            {
+                return E_OUTOFMEMORY;
+            }
+
+            slots[i].pTranscoder->SetSessionPool(pRun->pSessionPool);
+
+            idle.push_back(&slots[i]);
+        }
+        return S_OK;
+    }
+
+    TranscoderSlot* Take()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+
+        if (idle.empty())
+        {
+            return NULL;
+        }
+
+        TranscoderSlot *pSlot = idle.back();
+        idle.pop_back();
+        return pSlot;
+    }
+
+    // Reset hands the session of the job back to the session pool.
+    void Return(TranscoderSlot *pSlot)
+    {
+        (void)pSlot->pTranscoder->Reset();
+        pSlot->pJob = NULL;
+
+        std::lock_guard<std::mutex> guard(lock);
+        idle.push_back(pSlot);
+    }
+};
+
+//-------------------------------------------------------------------
+//  BeginTranscodeFile
+//
+//  Starts one batch job on an idle transcoder of the batch. The
+//  transcoder is reset for the next job when the encode completes on
+//  the dispatcher thread.
+//-------------------------------------------------------------------
+
+static void OnJobEncoded(CTranscoder*, HRESULT hr, void *pContext)
+{
+    TranscoderSlot *pSlot = (TranscoderSlot*)pContext;
+    BatchJob *pJob = pSlot->pJob;
+
+    pSlot->pOwner->Return(pSlot);
+
+    CBatch::CompleteJob(pJob, hr);
+}
+
+static HRESULT BeginTranscodeFile(BatchJob *pJob, void *pContext)
+{
+    const TranscodeContext *pRun = (const TranscodeContext*)pContext;
+
+    TranscoderSlot *pSlot = pRun->pTranscoders->Take();
+
+    if (pSlot == NULL)
+    {
+        return MF_E_INVALIDREQUEST;
+    }
+
+    CTranscoder *pTranscoder = pSlot->pTranscoder;
+
+    pSlot->pJob = pJob;
+
+    WCHAR szOutput[MAX_PATH];
+
+    HRESULT hr = PrepareTranscoder(pTranscoder, pJob->szInput, pRun);
+
+    if (SUCCEEDED(hr))
+    {
+        hr = GetMainOutput(pJob->szOutput, pRun, szOutput);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = AddExtraOutputs(pTranscoder, pJob->szOutput, pRun);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pTranscoder->BeginEncodeToFile(szOutput, OnJobEncoded, pSlot);
+    }
+
+    if (FAILED(hr))
+    {
+        pRun->pTranscoders->Return(pSlot);
+    }
+    return hr;
+}
+
+static void PrintUsage(const WCHAR *sExe)
+{
+    wprintf_s(L"Usage: %ls [options] [-f format[,format...]] input_file output_file\n", sExe);
+    wprintf_s(L"       %ls [options] -f format[,format...] -batch manifest_file|input_dir output_dir [workers]\n", sExe);
+    wprintf_s(L"\nOptions:\n");
+    wprintf_s(L"  -backend name    Media backend (see below)\n");
+    wprintf_s(L"  -cache file      Keep encoder capabilities in file between runs\n");
+    wprintf_s(L"  -copy on|off     Copy streams that already match the format (default on)\n");
+    wprintf_s(L"  -rate hz         Convert the audio to this sample rate\n");
+    wprintf_s(L"  -stats file      Append a JSON record of each job's timings to file\n");
+    wprintf_s(L"  -progress ms     Report the progress of each job every ms milliseconds\n");
+    wprintf_s(L"  -segments n      Encode a single file as up to n concurrent time ranges (wav, aac)\n");
+    wprintf_s(L"  -ladder list     Encode a video format as the renditions in list, video profile\n");
+    wprintf_s(L"                   indices separated by commas or \"all\", from one decode\n");
+    wprintf_s(L"\nAn input_file of - reads standard input and an output_file of - writes\n");
+    wprintf_s(L"standard output, with a single format given to -f (portable and fake\n");
+    wprintf_s(L"backends). Messages then go to standard error.\n");
+    wprintf_s(L"\nFormats (the input is decoded once for all the formats given to -f; each\n");
+    wprintf_s(L"format after the first writes next to the output file with its extension):\n");
+
+    for (UINT32 i = 0; i < GetOutputFormatCount(); i++)
+    {
+        const OutputFormat *pFormat = GetOutputFormat(i);
+        wprintf_s(L"  %-8ls %-5ls %ls\n", pFormat->sName, pFormat->sExtension, pFormat->sDescription);
+    }
+
+#ifdef _WIN32
+    wprintf_s(L"\nBackends: mf (default), portable, fake\n");
+#else
+    wprintf_s(L"\nBackends: portable (default), fake\n");
+#endif
+}
+
+//-------------------------------------------------------------------
+//  RunBatch
+//
+//  Collects the batch from a manifest file or a directory and runs it.
+//  A transcoder and a session are made ready for each worker before
+//  the first job, and each job hands them on to the next.
+//-------------------------------------------------------------------
+
+static HRESULT RunBatch(const WCHAR *sSource, const WCHAR *sOutputDir, DWORD cWorkers, TranscodeContext *pRun)
+{
+    const OutputFormat *pFormat = pRun->pFormat;
+
+    const DWORD cSlots = cWorkers ? cWorkers : DefaultWorkerCount();
+
+    CBatch batch;
+    CSessionPool pool(pRun->pBackend, cSlots);
+    TranscoderSlots transcoders;
+
+    HRESULT hr = S_OK;
+
+    if (!PathExists(sSource))
+    {
+        hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    else if (PathIsDirectory(sSource))
+    {
+        hr = batch.AddFromDirectory(sSource, sOutputDir, pFormat->sExtension);
+    }
+    else
+    {
+        hr = batch.AddFromManifest(sSource, sOutputDir, pFormat->sExtension);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        wprintf_s(L"Batch of %u files (%ls).\n", batch.JobCount(), pFormat->sName);
+
+        hr = pool.Reserve(batch.JobCount());
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        pRun->pSessionPool = &pool;
+
+        hr = transcoders.Create(batch.JobCount() < cSlots ? batch.JobCount() : cSlots, pRun);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pRun->pDispatcher->Start(1);
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        pRun->pTranscoders = &transcoders;
+
+        hr = batch.Run(BeginTranscodeFile, pRun, cWorkers);
+
+        pRun->pDispatcher->Stop();
+        pRun->pTranscoders = NULL;
+    }
+
+    pRun->pSessionPool = NULL;
+
+    ProfileCacheStats stats;
+
+    if (SUCCEEDED(hr) && SUCCEEDED(pRun->pBackend->GetProfileCacheStats(&stats)) &&
+        stats.cHits + stats.cMisses > 0)
+    {
+        wprintf_s(L"Profile cache: %llu hits, %llu misses.\n", stats.cHits, stats.cMisses);
+    }
+    return hr;
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+#ifdef _WIN32
+    (void)HeapSetInformation(NULL, HeapEnableTerminationOnCorruption, NULL, 0);
+#endif
+
+    TranscodeContext run;
+    memset(&run, 0, sizeof(run));
+
+    const WCHAR *sBackend = NULL;
+    const WCHAR *sCacheFile = NULL;
+    BOOL fStreamCopy = TRUE;
+    UINT32 sampleRate = 0;
+    DWORD cSegments = 1;
+    const WCHAR *sStatsFile = NULL;
+    DWORD msProgress = 0;
+    UINT32 rungs[LADDER_MAX_RUNGS];
+    DWORD cRungs = 0;
+    int iArg = 1;
+
+    // Options come first, in any order. "-" alone is a file name.
+    while (argc - iArg > 1 && argv[iArg][0] == L'-' && !IsStdStreamPath(argv[iArg]) &&
+        _wcsicmp(argv[iArg], L"-batch") != 0)
+    {
+        if (_wcsicmp(argv[iArg], L"-backend") == 0)
+        {
+            sBackend = argv[iArg + 1];
+        }
+        else if (_wcsicmp(argv[iArg], L"-cache") == 0)
+        {
+            sCacheFile = argv[iArg + 1];
+        }
+        else if (_wcsicmp(argv[iArg], L"-copy") == 0 &&
+            (_wcsicmp(argv[iArg + 1], L"on") == 0 || _wcsicmp(argv[iArg + 1], L"off") == 0))
+        {
+            fStreamCopy = (_wcsicmp(argv[iArg + 1], L"on") == 0);
+        }
+        else if (_wcsicmp(argv[iArg], L"-rate") == 0 && _wtoi(argv[iArg + 1]) > 0)
+        {
+            sampleRate = (UINT32)_wtoi(argv[iArg + 1]);
+        }
+        else if (_wcsicmp(argv[iArg], L"-stats") == 0)
+        {
+            sStatsFile = argv[iArg + 1];
+        }
+        else if (_wcsicmp(argv[iArg], L"-progress") == 0 && _wtoi(argv[iArg + 1]) > 0)
+        {
+            msProgress = (DWORD)_wtoi(argv[iArg + 1]);
+        }
+        else if (_wcsicmp(argv[iArg], L"-segments") == 0 && _wtoi(argv[iArg + 1]) > 0)
+        {
+            cSegments = (DWORD)_wtoi(argv[iArg + 1]);
+        }
+        else if (_wcsicmp(argv[iArg], L"-ladder") == 0)
+        {
+            if (FAILED(ParseLadderRungs(argv[iArg + 1], rungs, &cRungs)))
+            {
+                wprintf_s(L"Invalid ladder: %ls\n", argv[iArg + 1]);
+                PrintUsage(argv[0]);
+                return 0;
+            }
+        }
+        else if (_wcsicmp(argv[iArg], L"-f") == 0)
+        {
+            if (FAILED(ParseFormatList(argv[iArg + 1], &run)))
+            {
+                PrintUsage(argv[0]);
+                return 0;
+            }
+        }
+        else
+        {
+            PrintUsage(argv[0]);
+            return 0;
+        }
+        iArg += 2;
+    }
+
+    BOOL fBatch = (argc - iArg >= 3 && _wcsicmp(argv[iArg], L"-batch") == 0);
+
+    if (fBatch ? (argc - iArg > 4 || run.pFormat == NULL) : (argc - iArg != 2))
+    {
+        PrintUsage(argv[0]);
+        return 0;
+    }
+
+    BOOL fStdStream = !fBatch && (IsStdStreamPath(argv[iArg]) || IsStdStreamPath(argv[iArg + 1]));
+
+    if (!fBatch && IsStdStreamPath(argv[iArg + 1]))
+    {
+        // Nothing but the output may reach standard output from here on.
+        if (FAILED(ReserveStdoutForOutput()))
+        {
+            return 0;
+        }
+
+        if (run.cExtraFormats > 0 || cRungs > 0)
+        {
+            wprintf_s(L"Only one output can be written to standard output.\n");
+            return 0;
+        }
+    }
+
+    if (!fBatch && run.pFormat == NULL)
+    {
+        // Pick the format from the extension of the output file.
+        run.pFormat = FindOutputFormatForFile(argv[iArg + 1]);
+        if (run.pFormat == NULL)
+        {
+            wprintf_s(L"Cannot tell the output format from %ls; use -f.\n", argv[iArg + 1]);
+            return 0;
+        }
+    }
+
+    CBitrateLadder ladder;
+
+    if (cRungs > 0)
+    {
+        if (run.cExtraFormats > 0 || FAILED(ladder.Plan(run.pFormat, rungs, cRungs)))
+        {
+            wprintf_s(L"A ladder needs a single output format with video.\n");
+            return 0;
+        }
+
+        run.pFormat = ladder.GetFormat(0);
+        run.pLadder = &ladder;
+
+        wprintf_s(L"Ladder of %u renditions, a keyframe every %u frames.\n",
+            ladder.RungCount(), GetVideoProfile(run.pFormat)->keyframeSpacing);
+    }
+
+    IMediaBackend *pBackend = NULL;
+
+    HRESULT hr = CreateMediaBackend(sBackend, &pBackend);
+
+    if (FAILED(hr))
+    {
+        wprintf_s(L"Unknown backend: %ls\n", sBackend);
+        PrintUsage(argv[0]);
+        return 0;
+    }
+
+    // Media Foundation opens its input and output by URL.
+    if (fStdStream && _wcsicmp(pBackend->GetName(), L"mf") == 0)
+    {
+        wprintf_s(L"The mf backend cannot read standard input or write standard output.\n");
+        SafeDelete(&pBackend);
+        return 0;
+    }
+
+    if (sCacheFile)
+    {
+        hr = pBackend->SetCacheFile(sCacheFile);
+    }
+
+    CStatsLog statsLog;
+
+    if (SUCCEEDED(hr) && sStatsFile)
+    {
+        hr = statsLog.Open(sStatsFile);
+    }
+
+#ifdef _WIN32
+    if (SUCCEEDED(hr))
+    {
+        hr = CoInitializeEx(NULL, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+    }
+#endif
+
+    if (SUCCEEDED(hr))
+    {
+        hr = pBackend->Startup();
+    }
+
+    CProgressMonitor progress;
+
+    if (SUCCEEDED(hr) && msProgress > 0)
+    {
+        hr = progress.Start(msProgress);
+    }
+
+    CWorkQueue dispatcher;
+
+    run.pBackend = pBackend;
+    run.fStreamCopy = fStreamCopy;
+    run.sampleRate = sampleRate;
+    run.cSegments = cSegments;
+    run.pStatsLog = sStatsFile ? &statsLog : NULL;
+    run.pProgress = msProgress > 0 ? &progress : NULL;
+    run.pDispatcher = &dispatcher;
+
+    if (SUCCEEDED(hr) && !fBatch)
+    {
+        const WCHAR* sInputFile = argv[iArg];       // Audio source file name
+        const WCHAR* sOutputFile = argv[iArg + 1];  // Output file name
+
+        hr = TranscodeFile(sInputFile, sOutputFile, &run);
+    }
+    else if (SUCCEEDED(hr))
+    {
+        const WCHAR* sSource = argv[iArg + 1];      // Manifest file or input directory
+        const WCHAR* sOutputDir = argv[iArg + 2];   // Output directory
+        DWORD cWorkers = (argc - iArg == 4) ? (DWORD)_wtoi(argv[iArg + 3]) : 0;
+
+        hr = RunBatch(sSource, sOutputDir, cWorkers, &run);
+    }
+
+    progress.Stop();
+
+    pBackend->Shutdown();
+    SafeDelete(&pBackend);
+
+#ifdef _WIN32
+    CoUninitialize();
+#endif
+
+    if (FAILED(hr))
+    {
+        wprintf_s(L"Could not create the output file (0x%X).\n", hr);
+    }
+
+    return 0;
+}
+
+#ifndef _WIN32
+
+//-------------------------------------------------------------------
+//  main
+//
+//  Converts the arguments from the locale encoding and calls wmain.
+//-------------------------------------------------------------------
+
+int main(int argc, char* argv[])
+{
+    setlocale(LC_ALL, "");
+
+    wchar_t **wargv = new wchar_t*[argc + 1];
+
+    for (int i = 0; i < argc; i++)
+    {
+        size_t cch = mbstowcs(NULL, argv[i], 0);
+
+        wargv[i] = new wchar_t[cch == (size_t)-1 ? 1 : cch + 1];
+        if (cch == (size_t)-1 || mbstowcs(wargv[i], argv[i], cch + 1) == (size_t)-1)
+        {
+            wargv[i][0] = L'\0';
+        }
+    }
+    wargv[argc] = NULL;
+
+    int result = wmain(argc, wargv);
+
+    for (int i = 0; i < argc; i++)
+    {
+        delete [] wargv[i];
+    }
+    delete [] wargv;
+
+    return result;
+}
+
+#endif